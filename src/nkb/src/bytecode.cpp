@@ -6,6 +6,7 @@
 #include "nkb/common.h"
 #include "nkb/ir.h"
 #include "ntk/allocator.h"
+#include "ntk/arena.h"
 #include "ntk/atom.h"
 #include "ntk/common.h"
 #include "ntk/dyn_array.h"
@@ -57,19 +58,21 @@ NkBcOpcode s_ir2opcode[] = {
 typedef NkSlice(NkBcInstr) NkBcInstrArray;
 
 #ifdef ENABLE_LOGGING
-void inspect(NkBcInstrArray instrs, NkStream out) {
-    auto inspect_ref = [&](NkBcRef const &ref, bool expand_values) {
+void inspect(NkBcProc proc, NkStream out) {
+    auto inspect_ref = [&](NkBcRef const &ref, nktype_t type, bool expand_values) {
         if (ref.kind == NkBcRef_None) {
             nk_printf(out, "(null)");
             return;
         } else if (ref.kind == NkBcRef_Instr) {
-            nk_printf(out, "instr@%zi", ref.offset / sizeof(NkBcInstr));
+            nk_printf(out, "instr@%zu", ref.offset / sizeof(NkBcInstr));
             return;
         } else if (ref.kind == NkBcRef_VariadicMarker) {
             nk_printf(out, "...");
             return;
         }
-        for (usize i = 0; i < ref.indir; i++) {
+        // The first indirection of a data ref goes through the data table
+        usize const indir = ref.kind == NkBcRef_Data ? ref.indir - 1 : ref.indir;
+        for (usize i = 0; i < indir; i++) {
             nk_printf(out, "[");
         }
         switch (ref.kind) {
@@ -82,7 +85,7 @@ void inspect(NkBcInstrArray instrs, NkStream out) {
                 break;
             case NkBcRef_Data:
                 if (expand_values) {
-                    nkirv_inspect(nkbc_deref(nullptr, &ref), ref.type, out);
+                    nkirv_inspect(nkbc_deref((u8 *)proc->data.data, &ref), type, out);
                 } else {
                     nk_printf(out, "data");
                 }
@@ -95,24 +98,24 @@ void inspect(NkBcInstrArray instrs, NkStream out) {
                 break;
         }
         if (!expand_values) {
-            nk_printf(out, "+%zx", ref.offset);
+            nk_printf(out, "+%" PRIx32, ref.offset);
         }
-        for (usize i = 0; i < ref.indir; i++) {
+        for (usize i = 0; i < indir; i++) {
             nk_printf(out, "]");
         }
         if (ref.post_offset && !expand_values) {
-            nk_printf(out, "+%zx", ref.post_offset);
+            nk_printf(out, "+%" PRIx32, ref.post_offset);
         }
-        if (ref.type) {
+        if (type) {
             nk_printf(out, ":");
-            nkirt_inspect(ref.type, out);
+            nkirt_inspect(type, out);
         }
     };
 
-    auto inspect_arg = [&](NkBcArg const &arg, bool expand_values) {
+    auto inspect_arg = [&](NkBcArg const &arg, nktype_t type, bool expand_values) {
         switch (arg.kind) {
             case NkBcArg_Ref: {
-                inspect_ref(arg.ref, expand_values);
+                inspect_ref(arg.ref, type, expand_values);
                 break;
             }
 
@@ -122,7 +125,8 @@ void inspect(NkBcInstrArray instrs, NkStream out) {
                     if (i) {
                         nk_printf(out, ", ");
                     }
-                    inspect_ref(arg.refs.data[i], expand_values);
+                    inspect_ref(
+                        proc->refs.data[arg.refs.first + i], proc->ref_types.data[arg.refs.first + i], expand_values);
                 }
                 nk_printf(out, ")");
                 break;
@@ -132,19 +136,22 @@ void inspect(NkBcInstrArray instrs, NkStream out) {
         }
     };
 
-    for (auto const &instr : nk_iterate(instrs)) {
-        nk_printf(out, "%5zu |%13s", (&instr - instrs.data), nkbcOpcodeName(instr.code));
+    for (auto const &instr : nk_iterate(proc->instrs)) {
+        auto const instr_index = &instr - proc->instrs.data;
+        auto const &types = proc->instr_types.data[instr_index];
+
+        nk_printf(out, "%5zu |%20s", instr_index, nkbcOpcodeName(instr.code));
 
         for (usize i = 1; i < 3; i++) {
             if (instr.arg[i].kind != NkBcArg_None) {
                 nk_printf(out, ((i > 1) ? ", " : " "));
-                inspect_arg(instr.arg[i], true);
+                inspect_arg(instr.arg[i], types.arg_t[i], true);
             }
         }
 
-        if (instr.arg[0].ref.kind != NkBcRef_None) {
+        if (instr.arg[0].kind == NkBcArg_Ref && instr.arg[0].ref.kind != NkBcRef_None) {
             nk_printf(out, " -> ");
-            inspect_arg(instr.arg[0], false);
+            inspect_arg(instr.arg[0], types.arg_t[0], false);
         }
 
         nk_printf(out, "\n");
@@ -152,6 +159,171 @@ void inspect(NkBcInstrArray instrs, NkStream out) {
 }
 #endif // ENABLE_LOGGING
 
+enum EOperandForm {
+    Operand_Other,
+    Operand_Frame,
+    Operand_Data,
+};
+
+// Direct data refs still have one indirection, through the data table
+EOperandForm getOperandForm(NkBcArg const &arg) {
+    if (arg.kind == NkBcArg_Ref && !arg.ref.post_offset) {
+        if (arg.ref.kind == NkBcRef_Frame && arg.ref.indir == 0) {
+            return Operand_Frame;
+        } else if (arg.ref.kind == NkBcRef_Data && arg.ref.indir == 1) {
+            return Operand_Data;
+        }
+    }
+    return Operand_Other;
+}
+
+enum EFastFormKind {
+    FastForm_None,
+    FastForm_Mov,
+    FastForm_Jmp,
+    FastForm_Bin,
+};
+
+struct FastForm {
+    u16 code;
+    EFastFormKind kind;
+};
+
+// Maps a specialized opcode to the first of its fast forms
+FastForm getFastForm(u16 code) {
+    switch (code) {
+#define FAST_SIZ_OPX(NAME, SIZ) \
+    case nkop_##NAME##_##SIZ:   \
+        return {nkop_##NAME##_##SIZ##_f, FastForm_Mov};
+#define FAST_JMP_OPX(NAME, SIZ) \
+    case nkop_##NAME##_##SIZ:   \
+        return {nkop_##NAME##_##SIZ##_f, FastForm_Jmp};
+#define FAST_INT_OPX(NAME, TYPE) \
+    case nkop_##NAME##_##TYPE:   \
+        return {nkop_##NAME##_##TYPE##_ff, FastForm_Bin};
+#define FAST_BOOL_OPX(NAME, TYPE) \
+    case nkop_##NAME##_##TYPE:    \
+        return {nkop_##NAME##_##TYPE##_ff, FastForm_Bin};
+#include "bytecode.inl"
+
+        default:
+            return {nkop_nop, FastForm_None};
+    }
+}
+
+// Returns the opcode that computes the same result with the source operands swapped, or nop if there is none
+u16 getSwappedOpcode(u16 code) {
+    static struct {
+        u16 from;
+        u16 to;
+    } const s_swapped_ops[] = {
+        {nkop_add, nkop_add},
+        {nkop_mul, nkop_mul},
+        {nkop_and, nkop_and},
+        {nkop_or, nkop_or},
+        {nkop_xor, nkop_xor},
+        {nkop_cmp_eq, nkop_cmp_eq},
+        {nkop_cmp_ne, nkop_cmp_ne},
+        {nkop_cmp_lt, nkop_cmp_gt},
+        {nkop_cmp_le, nkop_cmp_ge},
+        {nkop_cmp_gt, nkop_cmp_lt},
+        {nkop_cmp_ge, nkop_cmp_le},
+    };
+
+    static constexpr u16 c_int_type_count = nkop_and_u64 - nkop_and;
+
+    for (auto const &op : s_swapped_ops) {
+        if (code > op.from && code <= op.from + c_int_type_count) {
+            return op.to + (code - op.from);
+        }
+    }
+    return nkop_nop;
+}
+
+void selectFastForm(NkBcInstr &instr) {
+    NK_PROF_FUNC();
+
+    auto fast = getFastForm(instr.code);
+
+    switch (fast.kind) {
+        case FastForm_None:
+            break;
+
+        case FastForm_Mov: {
+            auto const src = getOperandForm(instr.arg[1]);
+            if (getOperandForm(instr.arg[0]) == Operand_Frame && src != Operand_Other) {
+                instr.code = fast.code + (src == Operand_Data);
+            }
+            break;
+        }
+
+        case FastForm_Jmp: {
+            auto const cond = getOperandForm(instr.arg[1]);
+            if (cond != Operand_Other) {
+                instr.code = fast.code + (cond == Operand_Data);
+            }
+            break;
+        }
+
+        case FastForm_Bin: {
+            if (getOperandForm(instr.arg[0]) != Operand_Frame) {
+                break;
+            }
+
+            auto lhs = getOperandForm(instr.arg[1]);
+            auto rhs = getOperandForm(instr.arg[2]);
+
+            if (lhs == Operand_Data && rhs == Operand_Frame) {
+                auto const swapped_code = getSwappedOpcode(instr.code);
+                if (swapped_code != nkop_nop) {
+                    auto const tmp = instr.arg[1];
+                    instr.arg[1] = instr.arg[2];
+                    instr.arg[2] = tmp;
+
+                    fast = getFastForm(swapped_code);
+                    lhs = Operand_Frame;
+                    rhs = Operand_Data;
+                }
+            }
+
+            if (lhs == Operand_Frame && rhs != Operand_Other) {
+                instr.code = fast.code + (rhs == Operand_Data);
+            }
+            break;
+        }
+    }
+}
+
+bool isFusableCmp(u16 code) {
+    switch (code) {
+#define FAST_BOOL_OPX(NAME, TYPE)   \
+    case nkop_##NAME##_##TYPE##_ff: \
+    case nkop_##NAME##_##TYPE##_fd:
+#include "bytecode.inl"
+        return true;
+
+        default:
+            return false;
+    }
+}
+
+// Fuses comparisons with the conditional jumps on their result that immediately follow them.
+// The jump instruction is kept in place, so it remains a valid jump target.
+void fuseInstrs(NkBcInstrArray instrs) {
+    NK_PROF_FUNC();
+
+    for (usize i = 0; i + 1 < instrs.size; i++) {
+        auto &instr = instrs.data[i];
+        auto const &next = instrs.data[i + 1];
+
+        if (isFusableCmp(instr.code) && (next.code == nkop_jmpz_8_f || next.code == nkop_jmpnz_8_f) &&
+            next.arg[1].ref.offset == instr.arg[0].ref.offset) {
+            // *_jmpz forms follow the unfused ones, and *_jmpnz forms follow those
+            instr.code += next.code == nkop_jmpz_8_f ? 2 : 4;
+        }
+    }
+}
+
 NK_PRINTF_LIKE(2) static void reportError(NkIrRunCtx ctx, char const *fmt, ...) {
     nk_assert(!ctx->error_str.data && "run error is already initialized");
 
@@ -201,11 +373,12 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
 
     NK_LOG_TRC("%s", __func__);
 
-    auto const tmp_alloc = nk_arena_getAllocator(ctx->tmp_arena);
-    auto const frame = nk_arena_grab(ctx->tmp_arena);
+    // Errors are reported into ctx->tmp_arena, so it must not be reused as scratch
+    auto const scratch = nk_scratch_begin(ctx->tmp_arena);
     defer {
-        nk_arena_popFrame(ctx->tmp_arena, frame);
+        nk_scratch_end(scratch);
     };
+    auto const tmp_alloc = nk_arena_getAllocator(scratch.arena);
 
     auto const &ir = *ctx->ir;
     auto const &ir_proc = ir.procs.data[proc.idx];
@@ -218,6 +391,11 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
               .frame_size = ir_proc.frame_size,
               .frame_align = ir_proc.frame_align,
               .instrs{NKDA_INIT(ir.alloc)},
+              .refs{NKDA_INIT(ir.alloc)},
+              .data{NKDA_INIT(ir.alloc)},
+              .call_sites{NKDA_INIT(ir.alloc)},
+              .instr_types{NKDA_INIT(ir.alloc)},
+              .ref_types{NKDA_INIT(ir.alloc)},
           });
 
     enum ERelocType {
@@ -229,7 +407,7 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
     struct Reloc {
         usize instr_index;
         usize arg_index;
-        usize ref_index;
+        usize data_slot;
         usize target_id;
         ERelocType reloc_type;
         NkIrProcInfo const *proc_info{};
@@ -244,6 +422,8 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
     NkDynArray(Reloc) relocs{NKDA_INIT(tmp_alloc)};
     NkDynArray(NkIrProc) referenced_procs{NKDA_INIT(tmp_alloc)};
 
+    NkIntptrHashMap data_slots{NK_HASH_TREE_INIT(tmp_alloc)};
+
     for (usize block_idx = 0; block_idx < ir_proc.blocks.size; block_idx++) {
         auto block_id = ir_proc.blocks.data[block_idx];
         while (block_id >= block_info.size) {
@@ -255,94 +435,161 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
         };
     }
 
-    auto const translate_ref =
-        [&](usize instr_index, usize arg_index, usize ref_index, NkBcRef &ref, NkIrRef const &ir_ref) {
-            NK_PROF_SCOPE(nk_cs2s("translate_ref"));
-            ref = {
-                .offset = ir_ref.offset,
-                .post_offset = ir_ref.post_offset,
-                .type = ir_ref.type,
-                .kind = (NkBcRefKind)ir_ref.kind,
-                .indir = ir_ref.indir,
-            };
-
-            switch (ir_ref.kind) {
-                case NkIrRef_None:
-                    break;
-                case NkIrRef_Frame:
-                    ref.offset += ir_proc.locals.data[ir_ref.index].offset;
-                    break;
-                case NkIrRef_Arg:
-                    ref.offset += ir_ref.index * sizeof(void *);
-                    ref.indir++;
-                    break;
-                case NkIrRef_Data: {
-                    ref.offset += (usize)getDataAddr(ctx, ir_ref.index);
-                    break;
+    auto const get_data_slot = [&](void *addr) -> usize {
+        auto const found = NkIntptrHashMap_find(&data_slots, (intptr_t)addr);
+        if (found) {
+            return *found;
+        }
+        auto const slot = bc_proc.data.size;
+        nkda_append(&bc_proc.data, addr);
+        NkIntptrHashMap_insert(&data_slots, (intptr_t)addr, slot);
+        return slot;
+    };
+
+    auto const translate_ref = [&](NkBcRef &ref, NkIrRef const &ir_ref) {
+        NK_PROF_SCOPE(nk_cs2s("translate_ref"));
+
+        usize offset = ir_ref.offset;
+        usize post_offset = ir_ref.post_offset;
+        usize indir = ir_ref.indir;
+        auto kind = (NkBcRefKind)ir_ref.kind;
+
+        switch (ir_ref.kind) {
+            case NkIrRef_None:
+                break;
+            case NkIrRef_Frame:
+                offset += ir_proc.locals.data[ir_ref.index].offset;
+                break;
+            case NkIrRef_Arg:
+                offset += ir_ref.index * sizeof(void *);
+                indir++;
+                break;
+            case NkIrRef_Data: {
+                offset = get_data_slot((u8 *)getDataAddr(ctx, ir_ref.index) + offset) * sizeof(void *);
+                indir++;
+                break;
+            }
+            case NkIrRef_Proc: {
+                kind = NkBcRef_Data;
+                auto const data_slot = bc_proc.data.size;
+                nkda_append(&bc_proc.data, nullptr);
+                offset = data_slot * sizeof(void *);
+                indir++;
+                if (ir_ref.type->as.proc.info.call_conv == NkCallConv_Cdecl) {
+                    nkda_append(
+                        &relocs,
+                        {
+                            .instr_index{},
+                            .arg_index{},
+                            .data_slot = data_slot,
+                            .target_id = ir_ref.index,
+                            .reloc_type = Reloc_Closure,
+                            .proc_info = &ir_ref.type->as.proc.info,
+                        });
+                } else {
+                    nkda_append(
+                        &relocs,
+                        {
+                            .instr_index{},
+                            .arg_index{},
+                            .data_slot = data_slot,
+                            .target_id = ir_ref.index,
+                            .reloc_type = Reloc_Proc,
+                        });
                 }
-                case NkIrRef_Proc: {
-                    ref.kind = NkBcRef_Data;
-                    if (ir_ref.type->as.proc.info.call_conv == NkCallConv_Cdecl) {
-                        nkda_append(
-                            &relocs,
-                            {
-                                .instr_index = instr_index,
-                                .arg_index = arg_index,
-                                .ref_index = ref_index,
-                                .target_id = ir_ref.index,
-                                .reloc_type = Reloc_Closure,
-                                .proc_info = &ir_ref.type->as.proc.info,
-                            });
-                    } else {
-                        nkda_append(
-                            &relocs,
-                            {
-                                .instr_index = instr_index,
-                                .arg_index = arg_index,
-                                .ref_index = ref_index,
-                                .target_id = ir_ref.index,
-                                .reloc_type = Reloc_Proc,
-                            });
-                    }
-                    nkda_append(&referenced_procs, {ir_ref.index});
-                    break;
+                nkda_append(&referenced_procs, {ir_ref.index});
+                break;
+            }
+            case NkIrRef_ExternData: {
+                auto data = ir.extern_data.data[ir_ref.index];
+                auto sym = ExternSymTree_findItem(&ctx->extern_syms, data.name);
+                if (!sym) {
+                    reportError(ctx, "undefined reference to `%s`", nk_atom2cs(data.name));
+                    return false;
                 }
-                case NkIrRef_ExternData: {
-                    auto data = ir.extern_data.data[ir_ref.index];
-                    auto sym = ExternSymTree_findItem(&ctx->extern_syms, data.name);
-                    if (!sym) {
-                        reportError(ctx, "undefined reference to `%s`", nk_atom2cs(data.name));
-                        return false;
-                    }
 
-                    ref.kind = NkBcRef_Data;
-                    ref.offset += (usize)sym->val;
-                    break;
+                kind = NkBcRef_Data;
+                offset = get_data_slot((u8 *)sym->val + offset) * sizeof(void *);
+                indir++;
+                break;
+            }
+            case NkIrRef_ExternProc: {
+                auto proc = ir.extern_procs.data[ir_ref.index];
+                auto sym = ExternSymTree_findItem(&ctx->extern_syms, proc.name);
+                if (!sym) {
+                    reportError(ctx, "undefined reference to `%s`", nk_atom2cs(proc.name));
+                    return false;
                 }
-                case NkIrRef_ExternProc: {
-                    auto proc = ir.extern_procs.data[ir_ref.index];
-                    auto sym = ExternSymTree_findItem(&ctx->extern_syms, proc.name);
-                    if (!sym) {
-                        reportError(ctx, "undefined reference to `%s`", nk_atom2cs(proc.name));
-                        return false;
-                    }
 
-                    auto sym_addr = nk_allocT<void *>(ir.alloc);
-                    *sym_addr = sym->val;
+                auto sym_addr = nk_allocT<void *>(ir.alloc);
+                *sym_addr = sym->val;
 
-                    ref.kind = NkBcRef_Data;
-                    ref.offset += (usize)sym_addr;
-                    break;
-                }
-                case NkIrRef_VariadicMarker: {
-                    ref.kind = NkBcRef_VariadicMarker;
-                    break;
+                kind = NkBcRef_Data;
+                offset = get_data_slot((u8 *)sym_addr + offset) * sizeof(void *);
+                indir++;
+                break;
+            }
+            case NkIrRef_VariadicMarker: {
+                kind = NkBcRef_VariadicMarker;
+                break;
+            }
+        }
+
+        // Fold the post offset of direct frame refs, so that they qualify for fast forms
+        if (kind == NkBcRef_Frame && !indir) {
+            offset += post_offset;
+            post_offset = 0;
+        }
+
+        if (offset > UINT32_MAX || post_offset > UINT32_MAX || indir > 0xf) {
+            reportError(ctx, "reference is out of the bytecode range");
+            return false;
+        }
+
+        ref = {
+            .offset = (u32)offset,
+            .post_offset = (u32)post_offset,
+            .kind = kind,
+            .indir = (u8)indir,
+        };
+
+        return true;
+    };
+
+    auto const prepare_call_site = [&](NkBcInstr &instr) {
+        auto &refs = instr.arg[2].refs;
+        auto const is_variadic = instr.code == nkop_call_extv;
+
+        usize nfixedargs = refs.size;
+        usize argc = refs.size;
+        auto argt = bc_proc.ref_types.data + refs.first;
+
+        if (is_variadic) {
+            argc--;
+            auto const varargt = nk_allocT<nktype_t>(tmp_alloc, argc);
+            for (usize i = 0, j = 0; i < refs.size; i++) {
+                if (bc_proc.refs.data[refs.first + i].kind == NkBcRef_VariadicMarker) {
+                    nfixedargs = i;
+                } else {
+                    varargt[j++] = argt[i];
                 }
             }
+            argt = varargt;
+        }
 
-            return true;
+        NkNativeCallData const call_data{
+            .proc{},
+            .nfixedargs = nfixedargs,
+            .is_variadic = is_variadic,
+            .argt = argt,
+            .argc = argc,
+            .rett = bc_proc.instr_types.data[bc_proc.instrs.size - 1].arg_t[0],
         };
 
+        refs.call_site = bc_proc.call_sites.size;
+        nkda_append(&bc_proc.call_sites, nk_native_prepareCall(&ctx->ffi_ctx, ir.alloc, &call_data));
+    };
+
     auto const translate_arg = [&](usize instr_index, usize arg_index, NkBcArg &arg, NkIrArg const &ir_arg) {
         NK_PROF_SCOPE(nk_cs2s("translate_arg"));
         switch (ir_arg.kind) {
@@ -353,21 +600,24 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
 
             case NkIrArg_Ref: {
                 arg.kind = NkBcArg_Ref;
-                if (!translate_ref(instr_index, arg_index, -1ul, arg.ref, ir_arg.ref)) {
+                if (!translate_ref(arg.ref, ir_arg.ref)) {
                     return false;
                 }
+                bc_proc.instr_types.data[instr_index].arg_t[arg_index] = ir_arg.ref.type;
                 break;
             }
 
             case NkIrArg_RefArray: {
                 arg.kind = NkBcArg_RefArray;
-                auto refs = nk_allocT<NkBcRef>(ir.alloc, ir_arg.refs.size);
-                for (usize i = 0; i < ir_arg.refs.size; i++) {
-                    if (!translate_ref(instr_index, arg_index, i, refs[i], ir_arg.refs.data[i])) {
+                arg.refs = {(u32)bc_proc.refs.size, (u32)ir_arg.refs.size, 0};
+                for (auto const &ir_ref : nk_iterate(ir_arg.refs)) {
+                    NkBcRef ref;
+                    if (!translate_ref(ref, ir_ref)) {
                         return false;
                     }
+                    nkda_append(&bc_proc.refs, ref);
+                    nkda_append(&bc_proc.ref_types, ir_ref.type);
                 }
-                arg.refs = {refs, ir_arg.refs.size};
                 break;
             }
 
@@ -379,7 +629,7 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
                     {
                         .instr_index = instr_index,
                         .arg_index = arg_index,
-                        .ref_index = -1ul,
+                        .data_slot{},
                         .target_id = ir_arg.id,
                         .reloc_type = Reloc_Block,
                     });
@@ -524,6 +774,7 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
                 }
 
                 nkda_append(&bc_proc.instrs, {});
+                nkda_append(&bc_proc.instr_types, {});
                 auto &instr = nks_last(bc_proc.instrs);
                 instr.code = code;
                 for (usize ai = 0; ai < 3; ai++) {
@@ -531,10 +782,18 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
                         return false;
                     }
                 }
+
+                if (code == nkop_call_ext || code == nkop_call_extv) {
+                    prepare_call_site(instr);
+                }
+
+                selectFastForm(instr);
             }
         }
     }
 
+    fuseInstrs({NKS_INIT(bc_proc.instrs)});
+
     for (auto proc : nk_iterate(referenced_procs)) {
         if (!translateProc(ctx, proc)) {
             return false;
@@ -542,18 +801,16 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
     }
 
     for (auto const &reloc : nk_iterate(relocs)) {
-        auto &arg = bc_proc.instrs.data[reloc.instr_index].arg[reloc.arg_index];
-        auto &ref = reloc.ref_index == -1ul ? arg.ref : arg.refs.data[reloc.ref_index];
-
         switch (reloc.reloc_type) {
             case Reloc_Block: {
+                auto &ref = bc_proc.instrs.data[reloc.instr_index].arg[reloc.arg_index].ref;
                 ref.offset = block_info.data[reloc.target_id].first_instr * sizeof(NkBcInstr);
                 break;
             }
             case Reloc_Proc: {
                 auto sym_addr = nk_allocT<void *>(ir.alloc);
                 *sym_addr = ctx->procs.data[reloc.target_id];
-                ref.offset = (usize)sym_addr;
+                bc_proc.data.data[reloc.data_slot] = sym_addr;
                 break;
             }
             case Reloc_Closure: {
@@ -561,13 +818,11 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
                     .proc{.bytecode = ctx->procs.data[reloc.target_id]},
                     .nfixedargs = reloc.proc_info->args_t.size,
                     .is_variadic = (bool)(reloc.proc_info->flags & NkProcVariadic),
-                    .argv{},
                     .argt = reloc.proc_info->args_t.data,
                     .argc = reloc.proc_info->args_t.size,
-                    .retv{},
                     .rett = reloc.proc_info->ret_t,
                 };
-                ref.offset = (usize)nk_native_makeClosure(&ctx->ffi_ctx, ctx->tmp_arena, ir.alloc, &call_data);
+                bc_proc.data.data[reloc.data_slot] = nk_native_makeClosure(&ctx->ffi_ctx, ir.alloc, &call_data);
                 break;
             }
         }
@@ -582,10 +837,14 @@ bool translateProc(NkIrRunCtx ctx, NkIrProc proc) {
         nksb_printf(&sb, "_proc%zu", proc.idx);
     }
     nksb_printf(&sb, "\n");
-    inspect({NKS_INIT(bc_proc.instrs)}, nksb_getStream(&sb));
+    inspect(&bc_proc, nksb_getStream(&sb));
     NK_LOG_INF(NKS_FMT, NKS_ARG(sb));
 #endif // ENABLE_LOGGING
 
+    ctx->bc_instr_count += bc_proc.instrs.size;
+    ctx->bc_size += bc_proc.instrs.size * sizeof(NkBcInstr) + bc_proc.refs.size * sizeof(NkBcRef) +
+                    bc_proc.data.size * sizeof(void *);
+
     return true;
 }
 
@@ -615,21 +874,30 @@ NkIrRunCtx nkir_createRunCtx(NkIrProg ir, NkArena *tmp_arena) {
 
         .procs{NKDA_INIT(ir->alloc)},
         .data{NKDA_INIT(ir->alloc)},
-        .extern_syms{NULL, ir->alloc},
+        .extern_syms{NK_HASH_TREE_INIT(ir->alloc)},
 
         .ffi_ctx{
             .alloc = ir->alloc,
-            .types{NULL, ir->alloc},
+            .types{NK_HASH_TREE_INIT(ir->alloc)},
             .mtx = nk_mutex_alloc(0),
         },
 
         .error_str{},
+
+        .bc_instr_count = 0,
+        .bc_size = 0,
     };
 }
 
 void nkir_freeRunCtx(NkIrRunCtx ctx) {
     NK_LOG_TRC("%s", __func__);
 
+    NK_LOG_INF(
+        "bytecode: %zu instrs, %zu bytes, %.1f bytes/instr",
+        ctx->bc_instr_count,
+        ctx->bc_size,
+        ctx->bc_instr_count ? (f64)ctx->bc_size / ctx->bc_instr_count : 0.0);
+
     nk_mutex_free(ctx->ffi_ctx.mtx);
 
     nk_freeT(ctx->ir->alloc, ctx);
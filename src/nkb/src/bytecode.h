@@ -34,17 +34,21 @@ typedef enum {
     NkBcRef_Count,
 } NkBcRefKind; // must preserve NkIrRefKind order
 
+// Refs are packed to keep instructions small. Data refs address a slot in the proc data table,
+// which holds the actual address, so that every offset fits in 32 bits.
 typedef struct {
-    usize offset;
-    usize post_offset;
-    nktype_t type;
-    NkBcRefKind kind;
-    u8 indir;
+    u32 offset;
+    u32 post_offset;
+    u8 kind : 4;
+    u8 indir : 4;
 } NkBcRef;
 
+// Ref arrays are stored out of line in the proc ref pool.
+// External calls also keep the index of their prepared call site here.
 typedef struct {
-    NkBcRef *data;
-    usize size;
+    u32 first;
+    u32 size;
+    u32 call_site;
 } NkBcRefArray;
 
 typedef enum {
@@ -59,7 +63,7 @@ typedef struct {
         NkBcRef ref;
         NkBcRefArray refs;
     };
-    NkBcArgKind kind;
+    u8 kind;
 } NkBcArg;
 
 typedef struct {
@@ -67,13 +71,26 @@ typedef struct {
     u16 code;
 } NkBcInstr;
 
+// Types are only needed for generic and external ops, and are kept apart from the instructions
+typedef struct {
+    nktype_t arg_t[3];
+} NkBcInstrTypes;
+
 typedef struct NkBcProc_T *NkBcProc;
 
+typedef struct NkNativeCallSite_T *NkNativeCallSite;
+
 struct NkBcProc_T {
     NkIrRunCtx ctx;
     usize frame_size;
     usize frame_align;
     NkDynArray(NkBcInstr) instrs;
+    NkDynArray(NkBcRef) refs;
+    NkDynArray(void *) data;
+    NkDynArray(NkNativeCallSite) call_sites;
+
+    NkDynArray(NkBcInstrTypes) instr_types;
+    NkDynArray(nktype_t) ref_types;
 };
 
 typedef struct {
@@ -81,7 +98,6 @@ typedef struct {
     void *val;
 } TypeTree_kv;
 
-// TODO: Use hash map for types
 NK_HASH_TREE_TYPEDEF(TypeTree, TypeTree_kv);
 NK_HASH_TREE_PROTO(TypeTree, TypeTree_kv, u32);
 
@@ -96,7 +112,6 @@ typedef struct {
     void *val;
 } ExternSym_kv;
 
-// TODO: Use hash map or linear array for extern syms
 NK_HASH_TREE_TYPEDEF(ExternSymTree, ExternSym_kv);
 NK_HASH_TREE_PROTO(ExternSymTree, ExternSym_kv, NkAtom);
 
@@ -111,6 +126,9 @@ struct NkIrRunCtx_T {
     NkFfiContext ffi_ctx;
 
     NkString error_str;
+
+    usize bc_instr_count;
+    usize bc_size;
 };
 
 NK_INLINE void *nkbc_deref(u8 *base, NkBcRef const *ref) {
@@ -43,6 +43,58 @@
 #define BOOL_NUM_OP(NAME) NUM_OP(NAME)
 #endif
 
+#ifndef FAST_SIZ_OPX
+#define FAST_SIZ_OPX(NAME, SIZ) \
+    OPX(NAME, SIZ##_f)          \
+    OPX(NAME, SIZ##_d)
+#endif
+
+#ifndef FAST_JMP_OPX
+#define FAST_JMP_OPX(NAME, SIZ) \
+    OPX(NAME, SIZ##_f)          \
+    OPX(NAME, SIZ##_d)
+#endif
+
+#ifndef FAST_INT_OPX
+#define FAST_INT_OPX(NAME, TYPE) \
+    OPX(NAME, TYPE##_ff)         \
+    OPX(NAME, TYPE##_fd)
+#endif
+
+#ifndef FAST_BOOL_OPX
+#define FAST_BOOL_OPX(NAME, TYPE) \
+    OPX(NAME, TYPE##_ff)          \
+    OPX(NAME, TYPE##_fd)          \
+    OPX(NAME, TYPE##_ff_jmpz)     \
+    OPX(NAME, TYPE##_fd_jmpz)     \
+    OPX(NAME, TYPE##_ff_jmpnz)    \
+    OPX(NAME, TYPE##_fd_jmpnz)
+#endif
+
+#define FAST_SIZ_OP(NAME)  \
+    FAST_SIZ_OPX(NAME, 8)  \
+    FAST_SIZ_OPX(NAME, 16) \
+    FAST_SIZ_OPX(NAME, 32) \
+    FAST_SIZ_OPX(NAME, 64)
+
+#define FAST_JMP_OP(NAME)  \
+    FAST_JMP_OPX(NAME, 8)  \
+    FAST_JMP_OPX(NAME, 16) \
+    FAST_JMP_OPX(NAME, 32) \
+    FAST_JMP_OPX(NAME, 64)
+
+#define FAST_INT_OP(NAME)   \
+    FAST_INT_OPX(NAME, i32) \
+    FAST_INT_OPX(NAME, u32) \
+    FAST_INT_OPX(NAME, i64) \
+    FAST_INT_OPX(NAME, u64)
+
+#define FAST_BOOL_OP(NAME)   \
+    FAST_BOOL_OPX(NAME, i32) \
+    FAST_BOOL_OPX(NAME, u32) \
+    FAST_BOOL_OPX(NAME, i64) \
+    FAST_BOOL_OPX(NAME, u64)
+
 OP(nop)
 
 OP(ret)
@@ -128,10 +180,48 @@ OPX(syscall, 4)
 OPX(syscall, 5)
 OPX(syscall, 6)
 
+// Fast forms, selected by the translator when every source operand is a direct frame (f) or data (d) reference,
+// and the destination, if any, is a direct frame reference.
+// Fused forms (*_jmpz, *_jmpnz) also perform the conditional jump that immediately follows the comparison.
+
+FAST_SIZ_OP(mov)
+
+FAST_JMP_OP(jmpz)
+FAST_JMP_OP(jmpnz)
+
+FAST_INT_OP(add)
+FAST_INT_OP(sub)
+FAST_INT_OP(mul)
+FAST_INT_OP(div)
+FAST_INT_OP(mod)
+
+FAST_INT_OP(and)
+FAST_INT_OP(or)
+FAST_INT_OP(xor)
+FAST_INT_OP(lsh)
+FAST_INT_OP(rsh)
+
+FAST_BOOL_OP(cmp_eq)
+FAST_BOOL_OP(cmp_ne)
+FAST_BOOL_OP(cmp_lt)
+FAST_BOOL_OP(cmp_le)
+FAST_BOOL_OP(cmp_gt)
+FAST_BOOL_OP(cmp_ge)
+
 OP(label)
 OP(comment)
 OP(line)
 
+#undef FAST_BOOL_OP
+#undef FAST_INT_OP
+#undef FAST_JMP_OP
+#undef FAST_SIZ_OP
+
+#undef FAST_BOOL_OPX
+#undef FAST_INT_OPX
+#undef FAST_JMP_OPX
+#undef FAST_SIZ_OPX
+
 #undef BOOL_NUM_OP
 #undef NUM_OP
 #undef FP2I_OP
@@ -6,6 +6,9 @@
 #include <ffi.h>
 #endif
 
+#include <array>
+#include <utility>
+
 #include "interp.h"
 #include "nkb/common.h"
 #include "ntk/allocator.h"
@@ -117,13 +120,13 @@ ffi_type *getNativeHandle(NkFfiContext *ctx, nktype_t type) {
     return ffi_t;
 }
 
-ffi_type **getNativeHandleArray(NkFfiContext *ctx, NkArena *stack, NkTypeArray types) {
-    ffi_type **elements = nk_arena_allocT<ffi_type *>(stack, types.size + 1);
+ffi_type **getNativeHandleArray(NkFfiContext *ctx, NkAllocator alloc, NkTypeArray types) {
+    ffi_type **elements = (ffi_type **)nk_allocT<void *>(alloc, types.size + 1);
     for (usize i = 0; i < types.size; i++) {
         elements[i] = getNativeHandle(ctx, types.data[i]);
     }
     elements[types.size] = nullptr;
-    return (ffi_type **)elements;
+    return elements;
 }
 
 void ffiPrepareCif(ffi_cif *cif, usize nfixedargs, bool is_variadic, ffi_type *rtype, ffi_type **atypes, usize argc) {
@@ -136,6 +139,186 @@ void ffiPrepareCif(ffi_cif *cif, usize nfixedargs, bool is_variadic, ffi_type *r
     nk_assert(status == FFI_OK && "ffi_prep_cif failed");
 }
 
+// Trampolines rely on whole and f64 args being passed the same way regardless of their position
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || defined(_M_ARM64)
+#define NK_NATIVE_TRAMPOLINES
+#endif
+
+constexpr usize c_max_trampoline_args = 6;
+
+using NkNativeInvokeFunc = void (*)(NkNativeCallSite site, void *proc, void *retv, void **argv);
+
+} // namespace
+
+struct NkNativeCallSite_T {
+    ffi_cif cif;
+    NkNativeInvokeFunc invoke;
+    u8 ret_size;
+    u8 arg_value_types[c_max_trampoline_args];
+};
+
+namespace {
+
+void invokeFfi(NkNativeCallSite site, void *proc, void *retv, void **argv) {
+    NK_PROF_SCOPE(nk_cs2s("ffi_call"));
+    ffi_call(&site->cif, FFI_FN(proc), retv, argv);
+}
+
+#ifdef NK_NATIVE_TRAMPOLINES
+
+// Whole args are widened to u64 according to their type, so that the callee sees properly extended registers
+NK_INLINE u64 loadWholeArg(u8 value_type, void *arg) {
+    switch (value_type) {
+        case Int8:
+            return (u64)(i64)(*(i8 *)arg);
+        case Int16:
+            return (u64)(i64)(*(i16 *)arg);
+        case Int32:
+            return (u64)(i64)(*(i32 *)arg);
+        case Uint8:
+            return *(u8 *)arg;
+        case Uint16:
+            return *(u16 *)arg;
+        case Uint32:
+            return *(u32 *)arg;
+        default:
+            return *(u64 *)arg;
+    }
+}
+
+NK_INLINE void storeWholeRet(u8 size, void *retv, u64 val) {
+    switch (size) {
+        case 1:
+            *(u8 *)retv = (u8)val;
+            break;
+        case 2:
+            *(u16 *)retv = (u16)val;
+            break;
+        case 4:
+            *(u32 *)retv = (u32)val;
+            break;
+        case 8:
+            *(u64 *)retv = val;
+            break;
+        default:
+            break;
+    }
+}
+
+template <usize... Is>
+void invokeWhole(NkNativeCallSite site, void *proc, void *retv, void **argv, std::index_sequence<Is...>) {
+    using Func = u64 (*)(decltype((void)Is, u64{})...);
+    auto const ret = ((Func)proc)(loadWholeArg(site->arg_value_types[Is], argv[Is])...);
+    storeWholeRet(site->ret_size, retv, ret);
+}
+
+template <usize... Is>
+void invokeFloat(NkNativeCallSite site, void *proc, void *retv, void **argv, std::index_sequence<Is...>) {
+    using Func = f64 (*)(decltype((void)Is, f64{})...);
+    auto const ret = ((Func)proc)(*(f64 *)argv[Is]...);
+    if (site->ret_size) {
+        *(f64 *)retv = ret;
+    }
+}
+
+template <usize N>
+void invokeWholeN(NkNativeCallSite site, void *proc, void *retv, void **argv) {
+    invokeWhole(site, proc, retv, argv, std::make_index_sequence<N>{});
+}
+
+template <usize N>
+void invokeFloatN(NkNativeCallSite site, void *proc, void *retv, void **argv) {
+    invokeFloat(site, proc, retv, argv, std::make_index_sequence<N>{});
+}
+
+template <usize... Ns>
+constexpr auto makeWholeTrampolines(std::index_sequence<Ns...>) {
+    return std::array<NkNativeInvokeFunc, sizeof...(Ns)>{invokeWholeN<Ns>...};
+}
+
+template <usize... Ns>
+constexpr auto makeFloatTrampolines(std::index_sequence<Ns...>) {
+    return std::array<NkNativeInvokeFunc, sizeof...(Ns)>{invokeFloatN<Ns>...};
+}
+
+constexpr auto s_whole_trampolines = makeWholeTrampolines(std::make_index_sequence<c_max_trampoline_args + 1>{});
+constexpr auto s_float_trampolines = makeFloatTrampolines(std::make_index_sequence<c_max_trampoline_args + 1>{});
+
+enum ETrampolineClass {
+    Trampoline_Void,
+    Trampoline_Whole,
+    Trampoline_Float,
+    Trampoline_None,
+};
+
+ETrampolineClass classifyType(nktype_t type) {
+    if (!type) {
+        return Trampoline_Void;
+    }
+    switch (type->kind) {
+        case NkIrType_Numeric:
+            if (NKIR_NUMERIC_IS_WHOLE(type->as.num.value_type)) {
+                return Trampoline_Whole;
+            } else if (type->as.num.value_type == Float64) {
+                return Trampoline_Float;
+            } else {
+                return Trampoline_None;
+            }
+        case NkIrType_Pointer:
+        case NkIrType_Procedure:
+            return Trampoline_Whole;
+        case NkIrType_Aggregate:
+            return type->size ? Trampoline_None : Trampoline_Void;
+        default:
+            return Trampoline_None;
+    }
+}
+
+// Picks a trampoline for non-variadic calls with up to c_max_trampoline_args args that are either all whole
+// numbers/pointers or all f64, returning a matching or void type; everything else goes through libffi
+NkNativeInvokeFunc selectTrampoline(NkNativeCallSite site, NkNativeCallData const *call_data) {
+    if (call_data->is_variadic || call_data->argc > c_max_trampoline_args) {
+        return invokeFfi;
+    }
+
+    auto const ret_class = classifyType(call_data->rett);
+    if (ret_class == Trampoline_None) {
+        return invokeFfi;
+    }
+
+    auto args_class = ret_class;
+    for (usize i = 0; i < call_data->argc; i++) {
+        auto const arg_t = call_data->argt[i];
+        auto const arg_class = classifyType(arg_t);
+        if (arg_class == Trampoline_Void || arg_class == Trampoline_None ||
+            (args_class != Trampoline_Void && args_class != arg_class)) {
+            return invokeFfi;
+        }
+        args_class = arg_class;
+        site->arg_value_types[i] = arg_t->kind == NkIrType_Numeric ? (u8)arg_t->as.num.value_type : (u8)Uint64;
+    }
+
+    site->ret_size = ret_class == Trampoline_Void ? 0 : (u8)call_data->rett->size;
+
+    switch (args_class) {
+        case Trampoline_Void:
+        case Trampoline_Whole:
+            return s_whole_trampolines[call_data->argc];
+        case Trampoline_Float:
+            return s_float_trampolines[call_data->argc];
+        default:
+            return invokeFfi;
+    }
+}
+
+#else // NK_NATIVE_TRAMPOLINES
+
+NkNativeInvokeFunc selectTrampoline(NkNativeCallSite, NkNativeCallData const *) {
+    return invokeFfi;
+}
+
+#endif // NK_NATIVE_TRAMPOLINES
+
 struct NkIrNativeClosure_T {
     void *code;
     ffi_cif cif;
@@ -152,26 +335,34 @@ void ffiClosure(ffi_cif *, void *resp, void **args, void *userdata) {
 
 } // namespace
 
-void nk_native_invoke(NkFfiContext *ctx, NkArena *stack, NkNativeCallData const *call_data) {
+NkNativeCallSite nk_native_prepareCall(NkFfiContext *ctx, NkAllocator alloc, NkNativeCallData const *call_data) {
     NK_PROF_FUNC();
     NK_LOG_TRC("%s", __func__);
 
-    ffi_cif cif;
+    NkNativeCallSite site;
 
     NK_MUTEX_GUARD_SCOPE(ctx->mtx) {
+        site = new (nk_allocT<NkNativeCallSite_T>(alloc)) NkNativeCallSite_T{};
+
         auto const rtype = getNativeHandle(ctx, call_data->rett);
-        auto const atypes = getNativeHandleArray(ctx, stack, {call_data->argt, call_data->argc});
+        auto const atypes = getNativeHandleArray(ctx, alloc, {call_data->argt, call_data->argc});
 
-        ffiPrepareCif(&cif, call_data->nfixedargs, call_data->is_variadic, rtype, atypes, call_data->argc);
+        ffiPrepareCif(&site->cif, call_data->nfixedargs, call_data->is_variadic, rtype, atypes, call_data->argc);
     }
 
-    {
-        NK_PROF_SCOPE(nk_cs2s("ffi_call"));
-        ffi_call(&cif, FFI_FN(call_data->proc.native), call_data->retv, call_data->argv);
-    }
+    site->invoke = selectTrampoline(site, call_data);
+
+    return site;
+}
+
+void nk_native_invokePrepared(NkNativeCallSite site, void *proc, void *retv, void **argv) {
+    NK_PROF_FUNC();
+    NK_LOG_TRC("%s", __func__);
+
+    site->invoke(site, proc, retv, argv);
 }
 
-void *nk_native_makeClosure(NkFfiContext *ctx, NkArena *stack, NkAllocator alloc, NkNativeCallData const *call_data) {
+void *nk_native_makeClosure(NkFfiContext *ctx, NkAllocator alloc, NkNativeCallData const *call_data) {
     NK_PROF_FUNC();
     NK_LOG_TRC("%s", __func__);
 
@@ -182,7 +373,7 @@ void *nk_native_makeClosure(NkFfiContext *ctx, NkArena *stack, NkAllocator alloc
         cl->proc = call_data->proc.bytecode;
 
         auto const rtype = getNativeHandle(ctx, call_data->rett);
-        auto const atypes = getNativeHandleArray(ctx, stack, {call_data->argt, call_data->argc});
+        auto const atypes = getNativeHandleArray(ctx, alloc, {call_data->argt, call_data->argc});
 
         ffiPrepareCif(&cl->cif, call_data->nfixedargs, call_data->is_variadic, rtype, atypes, call_data->argc);
     }
@@ -15,15 +15,16 @@ typedef struct {
     } proc;
     usize nfixedargs;
     bool is_variadic;
-    void **argv;
     nktype_t const *argt;
     usize argc;
-    void *retv;
     nktype_t rett;
 } NkNativeCallData;
 
-void nk_native_invoke(NkFfiContext *ctx, NkArena *stack, NkNativeCallData const *call_data);
-void *nk_native_makeClosure(NkFfiContext *ctx, NkArena *stack, NkAllocator alloc, NkNativeCallData const *call_data);
+// Call sites are prepared once at translation time, invoking a prepared call site takes no locks and allocates nothing
+NkNativeCallSite nk_native_prepareCall(NkFfiContext *ctx, NkAllocator alloc, NkNativeCallData const *call_data);
+void nk_native_invokePrepared(NkNativeCallSite site, void *proc, void *retv, void **argv);
+
+void *nk_native_makeClosure(NkFfiContext *ctx, NkAllocator alloc, NkNativeCallData const *call_data);
 
 #ifdef __cplusplus
 }
@@ -12,45 +12,32 @@
 #include "ntk/syscall.h"
 #include "ntk/utils.h"
 
+// Threaded dispatch relies on the labels-as-values extension,
+// and is disabled when per-instruction logging or profiling is requested
+#if defined(ENABLE_THREADED_DISPATCH) && defined(__GNUC__) && !defined(ENABLE_LOGGING) && !defined(ENABLE_PROFILING)
+#define NKB_THREADED_DISPATCH 1
+#else
+#define NKB_THREADED_DISPATCH 0
+#endif
+
 namespace {
 
 NK_LOG_USE_SCOPE(interp);
 
-struct ProgramFrame {
-    NkBcInstr const *pinstr;
-    NkFfiContext *ffi_ctx;
-};
-
 struct ControlFrame {
     ControlFrame *next{};
 
     NkArenaFrame stack_frame;
     u8 *base_frame;
     u8 *base_arg;
-    u8 *base_instr;
+    NkBcProc proc;
     void *const *ret;
     NkBcInstr const *pinstr;
 };
 
 struct InterpContext {
-    struct Base { // repeats the layout of NkBcRefKind
-        u8 *none;
-        u8 *frame;
-        u8 *arg;
-        u8 *data;
-        u8 *instr;
-    };
-
-    union {
-        u8 *base_ar[NkBcRef_Count];
-        Base base;
-    };
     NkArena stack;
     ControlFrame *ctrl_stack;
-    NkArenaFrame stack_frame;
-    void *const *ret;
-    NkBcInstr const *pinstr;
-    NkFfiContext *ffi_ctx;
 
     ~InterpContext() {
         NK_LOG_TRC("deinitializing stack...");
@@ -59,333 +46,310 @@ struct InterpContext {
     }
 };
 
-thread_local InterpContext ctx;
+thread_local InterpContext g_ctx;
+
+// Operand bases are passed explicitly, so that the interpreter loop can keep them in locals
+// instead of reloading them from the thread-local context after every store
 
-void *getRefAddr(NkBcRef const &ref) {
-    return nkbc_deref(ctx.base_ar[ref.kind], &ref);
+NK_FORCEINLINE inline void *getRefAddr(u8 *const *base, NkBcRef const &ref) {
+    return nkbc_deref(base[ref.kind], &ref);
 }
 
 template <class T>
-T &deref(NkBcArg const &arg) {
+NK_FORCEINLINE inline T &deref(u8 *const *base, NkBcArg const &arg) {
     nk_assert(arg.kind == NkBcArg_Ref);
-    return *(T *)getRefAddr(arg.ref);
+    return *(T *)getRefAddr(base, arg.ref);
 }
 
 template <class T>
-T &deref(NkBcRef const &ref) {
-    return *(T *)getRefAddr(ref);
+NK_FORCEINLINE inline T &deref(u8 *const *base, NkBcRef const &ref) {
+    return *(T *)getRefAddr(base, ref);
 }
 
-void jumpTo(NkBcInstr const *pinstr) {
-    NK_LOG_DBG("jumping to instr@%p", (void *)pinstr);
-    ctx.pinstr = pinstr;
+// Fast forms skip the generic reference resolution, as the translator guarantees that
+// their operands are direct references with no post offset, and no indirection other than the data table
+
+template <class T>
+NK_FORCEINLINE inline T &derefFrame(u8 *const *base, NkBcArg const &arg) {
+    return *(T *)(base[NkBcRef_Frame] + arg.ref.offset);
+}
+
+template <class T>
+NK_FORCEINLINE inline T &derefData(u8 *const *base, NkBcArg const &arg) {
+    return *(T *)*(u8 **)(base[NkBcRef_Data] + arg.ref.offset);
 }
 
-void jumpTo(NkBcArg const &arg) {
-    jumpTo(&deref<NkBcInstr>(arg));
+NK_FORCEINLINE inline NkBcRef const *getRefs(NkBcProc proc, NkBcArg const &arg) {
+    nk_assert(arg.kind == NkBcArg_RefArray);
+    return proc->refs.data + arg.refs.first;
 }
 
-void jumpCall(NkBcProc proc, void *const *args, void *const *ret, NkArenaFrame stack_frame) {
-    auto new_ctrl_frame = new (nk_arena_allocT<ControlFrame>(&ctx.stack)) ControlFrame{
-        .stack_frame = ctx.stack_frame,
-        .base_frame = ctx.base.frame,
-        .base_arg = ctx.base.arg,
-        .base_instr = ctx.base.instr,
-        .ret = ctx.ret,
-        .pinstr = ctx.pinstr,
+NK_FORCEINLINE inline NkBcInstrTypes const &getTypes(NkBcProc proc, NkBcInstr const *instr) {
+    return proc->instr_types.data[instr - proc->instrs.data];
+}
+
+NK_FORCEINLINE inline NkBcInstr const *getJumpTarget(u8 *const *base, NkBcArg const &arg) {
+    return (NkBcInstr const *)(base[NkBcRef_Instr] + arg.ref.offset);
+}
+
+void interp(InterpContext &ctx, NkBcProc proc, void **args, void **ret) {
+    u8 *base[NkBcRef_Count]{};
+    NkBcProc cur_proc = nullptr;
+    void *const *retv = nullptr;
+    NkArenaFrame stack_frame{};
+
+    NkBcInstr const *pinstr = nullptr;
+    NkBcInstr const *instr = nullptr;
+
+    auto const jumpTo = [&](NkBcInstr const *target) {
+        NK_LOG_DBG("jumping to instr@%p", (void *)target);
+        pinstr = target;
     };
-    nk_list_push(ctx.ctrl_stack, new_ctrl_frame);
 
-    ctx.stack_frame = stack_frame;
-    ctx.base.frame = (u8 *)nk_arena_allocAligned(&ctx.stack, proc->frame_size, proc->frame_align);
-    memset(ctx.base.frame, 0, proc->frame_size);
-    ctx.base.arg = (u8 *)args;
-    ctx.base.instr = (u8 *)proc->instrs.data;
+    auto const jumpCall = [&](NkBcProc proc, void *const *args, void *const *ret, NkArenaFrame new_stack_frame) {
+        auto new_ctrl_frame = new (nk_arena_allocT<ControlFrame>(&ctx.stack)) ControlFrame{
+            .stack_frame = stack_frame,
+            .base_frame = base[NkBcRef_Frame],
+            .base_arg = base[NkBcRef_Arg],
+            .proc = cur_proc,
+            .ret = retv,
+            .pinstr = pinstr,
+        };
+        nk_list_push(ctx.ctrl_stack, new_ctrl_frame);
+
+        stack_frame = new_stack_frame;
+        base[NkBcRef_Frame] = (u8 *)nk_arena_allocAligned(&ctx.stack, proc->frame_size, proc->frame_align);
+        memset(base[NkBcRef_Frame], 0, proc->frame_size);
+        base[NkBcRef_Arg] = (u8 *)args;
+        base[NkBcRef_Data] = (u8 *)proc->data.data;
+        base[NkBcRef_Instr] = (u8 *)proc->instrs.data;
+
+        cur_proc = proc;
+
+        retv = ret;
+
+        jumpTo(proc->instrs.data);
+
+        NK_LOG_DBG("stack_frame=%zu", stack_frame.size);
+        NK_LOG_DBG("frame=%p", (void *)base[NkBcRef_Frame]);
+        NK_LOG_DBG("arg=%p", (void *)base[NkBcRef_Arg]);
+        NK_LOG_DBG("ret=%p", (void *)retv);
+        NK_LOG_DBG("pinstr=%p", (void *)pinstr);
+    };
 
-    ctx.ret = ret;
+    jumpCall(proc, args, ret, nk_arena_grab(&ctx.stack));
 
-    jumpTo(proc->instrs.data);
+#if NKB_THREADED_DISPATCH
 
-    NK_LOG_DBG("stack_frame=%zu", ctx.stack_frame.size);
-    NK_LOG_DBG("frame=%p", (void *)ctx.base.frame);
-    NK_LOG_DBG("arg=%p", (void *)ctx.base.arg);
-    NK_LOG_DBG("ret=%p", (void *)ctx.ret);
-    NK_LOG_DBG("pinstr=%p", (void *)ctx.pinstr);
-}
+    static void *const s_dispatch_table[] = {
+#define OP(NAME) &&NK_CAT(op_, NAME),
+#define OPX(NAME, EXT) &&NK_CAT(op_, NK_CAT(NAME, NK_CAT(_, EXT))),
+#include "bytecode.inl"
+    };
+
+    static_assert(NK_ARRAY_COUNT(s_dispatch_table) == NkBcOpcode_Count);
+
+#define CASE(NAME) NK_CAT(op_, NAME):
+#define CASE_DEFAULT
+
+#define DISPATCH()                                                          \
+    do {                                                                    \
+        instr = pinstr++;                                                   \
+        nk_assert(instr->code < NkBcOpcode_Count && "unknown instruction"); \
+        goto *s_dispatch_table[instr->code];                                \
+    } while (0)
+
+#define NEXT() DISPATCH()
+
+    DISPATCH();
+
+    {
+
+#else // NKB_THREADED_DISPATCH
+
+#define CASE(NAME) case NK_CAT(nkop_, NAME):
+#define CASE_DEFAULT default:
+
+#define NEXT() break
+
+    for (;;) {
+        instr = pinstr++;
+
+        nk_assert(instr->code < NkBcOpcode_Count && "unknown instruction");
+        NK_LOG_DBG("instr: %zu %s", (instr - (NkBcInstr *)base[NkBcRef_Instr]), nkbcOpcodeName(instr->code));
+
+#ifdef ENABLE_LOGGING
+        void *dst_ref_data = nullptr;
+        nktype_t dst_type = nullptr;
+        auto const &dst = instr->arg[0];
+        if (dst.kind == NkBcArg_Ref && dst.ref.kind != NkBcRef_None) {
+            dst_ref_data = getRefAddr(base, dst.ref);
+            dst_type = getTypes(cur_proc, instr).arg_t[0];
+        }
+#endif // ENABLE_LOGGING
 
-void interp(NkBcInstr const &instr) {
 #ifdef ENABLE_PROFILING
-    NKSB_FIXED_BUFFER(sb, 128);
-    nksb_printf(&sb, "interp: %s", nkbcOpcodeName(instr.code));
+        NKSB_FIXED_BUFFER(sb, 128);
+        nksb_printf(&sb, "interp: %s", nkbcOpcodeName(instr->code));
 #endif // ENABLE_PROFILING
-    NK_PROF_SCOPE(sb);
+        NK_PROF_SCOPE(sb);
 
-    switch (instr.code) {
-        case nkop_nop: {
-            break;
-        }
+        switch (instr->code) {
 
-        case nkop_ret: {
-            if (instr.arg[1].ref.kind) {
-                memcpy(*ctx.ret, getRefAddr(instr.arg[1].ref), instr.arg[1].ref.type->size);
+#endif // NKB_THREADED_DISPATCH
+
+            CASE(nop) {
+                NEXT();
             }
 
-            auto const fr = *ctx.ctrl_stack;
-            nk_list_pop(ctx.ctrl_stack);
+            CASE(ret) {
+                if (instr->arg[1].ref.kind) {
+                    memcpy(*retv, getRefAddr(base, instr->arg[1].ref), getTypes(cur_proc, instr).arg_t[1]->size);
+                }
 
-            nk_arena_popFrame(&ctx.stack, ctx.stack_frame);
+                auto const fr = *ctx.ctrl_stack;
+                nk_list_pop(ctx.ctrl_stack);
 
-            ctx.stack_frame = fr.stack_frame;
-            ctx.base.frame = fr.base_frame;
-            ctx.base.arg = fr.base_arg;
-            ctx.base.instr = fr.base_instr;
+                nk_arena_popFrame(&ctx.stack, stack_frame);
 
-            ctx.ret = fr.ret;
+                stack_frame = fr.stack_frame;
+                base[NkBcRef_Frame] = fr.base_frame;
+                base[NkBcRef_Arg] = fr.base_arg;
 
-            jumpTo(fr.pinstr);
-            break;
-        }
+                retv = fr.ret;
 
-        case nkop_jmp: {
-            jumpTo(instr.arg[1]);
-            break;
-        }
+                jumpTo(fr.pinstr);
+                if (!pinstr) {
+                    goto exit;
+                }
 
-        case nkop_jmpz_8: {
-            if (!deref<u8>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
-            }
-            break;
-        }
+                cur_proc = fr.proc;
+                base[NkBcRef_Data] = (u8 *)cur_proc->data.data;
+                base[NkBcRef_Instr] = (u8 *)cur_proc->instrs.data;
 
-        case nkop_jmpz_16: {
-            if (!deref<u16>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
+                NEXT();
             }
-            break;
-        }
 
-        case nkop_jmpz_32: {
-            if (!deref<u32>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
+            CASE(jmp) {
+                jumpTo(&deref<NkBcInstr>(base, instr->arg[1]));
+                NEXT();
             }
-            break;
-        }
 
-        case nkop_jmpz_64: {
-            if (!deref<u64>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
-            }
-            break;
-        }
+#define JMP_OP_IT(NAME, TYPE, SIZ, COND)                    \
+    CASE(NK_CAT(NAME, NK_CAT(_, SIZ))) {                    \
+        if (COND deref<TYPE>(base, instr->arg[1])) {        \
+            jumpTo(&deref<NkBcInstr>(base, instr->arg[2])); \
+        }                                                   \
+        NEXT();                                             \
+    }
 
-        case nkop_jmpnz_8: {
-            if (deref<u8>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
-            }
-            break;
-        }
+            JMP_OP_IT(jmpz, u8, 8, !)
+            JMP_OP_IT(jmpz, u16, 16, !)
+            JMP_OP_IT(jmpz, u32, 32, !)
+            JMP_OP_IT(jmpz, u64, 64, !)
 
-        case nkop_jmpnz_16: {
-            if (deref<u16>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
-            }
-            break;
-        }
+            JMP_OP_IT(jmpnz, u8, 8, )
+            JMP_OP_IT(jmpnz, u16, 16, )
+            JMP_OP_IT(jmpnz, u32, 32, )
+            JMP_OP_IT(jmpnz, u64, 64, )
 
-        case nkop_jmpnz_32: {
-            if (deref<u32>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
-            }
-            break;
-        }
+#undef JMP_OP_IT
 
-        case nkop_jmpnz_64: {
-            if (deref<u64>(instr.arg[1])) {
-                jumpTo(instr.arg[2]);
-            }
-            break;
-        }
+            CASE(call_jmp) {
+                auto const new_stack_frame = nk_arena_grab(&ctx.stack);
+
+                auto const proc = deref<NkBcProc>(base, instr->arg[1]);
+
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                auto const argc = instr->arg[2].refs.size;
+                auto const argv = nk_arena_allocT<void *>(&ctx.stack, argc + 1);
+                for (usize i = 0; i < argc; i++) {
+                    argv[i] = getRefAddr(base, refs[i]);
+                }
 
-        case nkop_call_jmp: {
-            auto const stack_frame = nk_arena_grab(&ctx.stack);
+                auto const new_retv = argv + argc;
+                new_retv[0] = getRefAddr(base, instr->arg[0].ref);
 
-            auto const proc = deref<NkBcProc>(instr.arg[1]);
+                jumpCall(proc, argv, new_retv, new_stack_frame);
 
-            auto const argc = instr.arg[2].refs.size;
-            auto const argv = nk_arena_allocT<void *>(&ctx.stack, argc + 1);
-            for (usize i = 0; i < argc; i++) {
-                argv[i] = getRefAddr(instr.arg[2].refs.data[i]);
+                NEXT();
             }
 
-            auto const retv = argv + argc;
-            retv[0] = getRefAddr(instr.arg[0].ref);
+            CASE(call_ext) {
+                auto const frame = nk_arena_grab(&ctx.stack);
 
-            jumpCall(proc, argv, retv, stack_frame);
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                auto const argc = instr->arg[2].refs.size;
+                auto const argv = nk_arena_allocT<void *>(&ctx.stack, argc);
+                for (usize i = 0; i < argc; i++) {
+                    argv[i] = getRefAddr(base, refs[i]);
+                }
 
-            break;
-        }
+                nk_native_invokePrepared(
+                    cur_proc->call_sites.data[instr->arg[2].refs.call_site],
+                    deref<void *>(base, instr->arg[1]),
+                    getRefAddr(base, instr->arg[0].ref),
+                    argv);
 
-        case nkop_call_ext: {
-            auto const frame = nk_arena_grab(&ctx.stack);
-            defer {
                 nk_arena_popFrame(&ctx.stack, frame);
-            };
-
-            auto const argc = instr.arg[2].refs.size;
-            auto const argv = nk_arena_allocT<void *>(&ctx.stack, argc);
-            auto const argt = nk_arena_allocT<nktype_t>(&ctx.stack, argc);
-            for (usize i = 0; i < argc; i++) {
-                argv[i] = getRefAddr(instr.arg[2].refs.data[i]);
-                argt[i] = instr.arg[2].refs.data[i].type;
+                NEXT();
             }
 
-            NkNativeCallData const call_data{
-                .proc{.native = deref<void *>(instr.arg[1])},
-                .nfixedargs = argc,
-                .is_variadic = false,
-                .argv = argv,
-                .argt = argt,
-                .argc = argc,
-                .retv = getRefAddr(instr.arg[0].ref),
-                .rett = instr.arg[0].ref.type,
-            };
-
-            nk_native_invoke(ctx.ffi_ctx, &ctx.stack, &call_data);
-            break;
-        }
+            CASE(call_extv) {
+                auto const frame = nk_arena_grab(&ctx.stack);
 
-        case nkop_call_extv: {
-            auto const frame = nk_arena_grab(&ctx.stack);
-            defer {
-                nk_arena_popFrame(&ctx.stack, frame);
-            };
-
-            usize nfixedargs = 0;
-            auto const argc = instr.arg[2].refs.size - 1;
-            auto const argv = nk_arena_allocT<void *>(&ctx.stack, argc);
-            auto const argt = nk_arena_allocT<nktype_t>(&ctx.stack, argc);
-            for (usize i = 0; i < instr.arg[2].refs.size; i++) {
-                auto const &ref = instr.arg[2].refs.data[i];
-                if (ref.kind == NkBcRef_VariadicMarker) {
-                    nfixedargs = i;
-                    continue;
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                auto const argc = instr->arg[2].refs.size - 1;
+                auto const argv = nk_arena_allocT<void *>(&ctx.stack, argc);
+                for (usize i = 0, j = 0; i < instr->arg[2].refs.size; i++) {
+                    if (refs[i].kind != NkBcRef_VariadicMarker) {
+                        argv[j++] = getRefAddr(base, refs[i]);
+                    }
                 }
-                argv[i - (bool)nfixedargs] = getRefAddr(ref);
-                argt[i - (bool)nfixedargs] = ref.type;
-            }
 
-            NkNativeCallData const call_data{
-                .proc{.native = deref<void *>(instr.arg[1])},
-                .nfixedargs = nfixedargs,
-                .is_variadic = true,
-                .argv = argv,
-                .argt = argt,
-                .argc = argc,
-                .retv = getRefAddr(instr.arg[0].ref),
-                .rett = instr.arg[0].ref.type,
-            };
-
-            nk_native_invoke(ctx.ffi_ctx, &ctx.stack, &call_data);
-            break;
-        }
+                nk_native_invokePrepared(
+                    cur_proc->call_sites.data[instr->arg[2].refs.call_site],
+                    deref<void *>(base, instr->arg[1]),
+                    getRefAddr(base, instr->arg[0].ref),
+                    argv);
 
-        case nkop_sext_8_16: {
-            deref<i16>(instr.arg[0]) = deref<i8>(instr.arg[1]);
-            break;
-        }
-        case nkop_sext_8_32: {
-            deref<i32>(instr.arg[0]) = deref<i8>(instr.arg[1]);
-            break;
-        }
-        case nkop_sext_8_64: {
-            deref<i64>(instr.arg[0]) = deref<i8>(instr.arg[1]);
-            break;
-        }
-        case nkop_sext_16_32: {
-            deref<i32>(instr.arg[0]) = deref<i16>(instr.arg[1]);
-            break;
-        }
-        case nkop_sext_16_64: {
-            deref<i64>(instr.arg[0]) = deref<i16>(instr.arg[1]);
-            break;
-        }
-        case nkop_sext_32_64: {
-            deref<i64>(instr.arg[0]) = deref<i32>(instr.arg[1]);
-            break;
-        }
+                nk_arena_popFrame(&ctx.stack, frame);
+                NEXT();
+            }
 
-        case nkop_zext_8_16: {
-            deref<u16>(instr.arg[0]) = deref<u8>(instr.arg[1]);
-            break;
-        }
-        case nkop_zext_8_32: {
-            deref<u32>(instr.arg[0]) = deref<u8>(instr.arg[1]);
-            break;
-        }
-        case nkop_zext_8_64: {
-            deref<u64>(instr.arg[0]) = deref<u8>(instr.arg[1]);
-            break;
-        }
-        case nkop_zext_16_32: {
-            deref<u32>(instr.arg[0]) = deref<u16>(instr.arg[1]);
-            break;
-        }
-        case nkop_zext_16_64: {
-            deref<u64>(instr.arg[0]) = deref<u16>(instr.arg[1]);
-            break;
-        }
-        case nkop_zext_32_64: {
-            deref<u64>(instr.arg[0]) = deref<u32>(instr.arg[1]);
-            break;
-        }
+#define CVT_OP_IT(NAME, DST_TYPE, SRC_TYPE)                                                    \
+    CASE(NAME) {                                                                               \
+        deref<DST_TYPE>(base, instr->arg[0]) = (DST_TYPE)deref<SRC_TYPE>(base, instr->arg[1]); \
+        NEXT();                                                                                \
+    }
 
-        case nkop_fext: {
-            deref<f64>(instr.arg[0]) = deref<f32>(instr.arg[1]);
-            break;
-        }
+            CVT_OP_IT(sext_8_16, i16, i8)
+            CVT_OP_IT(sext_8_32, i32, i8)
+            CVT_OP_IT(sext_8_64, i64, i8)
+            CVT_OP_IT(sext_16_32, i32, i16)
+            CVT_OP_IT(sext_16_64, i64, i16)
+            CVT_OP_IT(sext_32_64, i64, i32)
 
-        case nkop_trunc_16_8: {
-            deref<u8>(instr.arg[0]) = deref<u16>(instr.arg[1]);
-            break;
-        }
-        case nkop_trunc_32_8: {
-            deref<u8>(instr.arg[0]) = deref<u32>(instr.arg[1]);
-            break;
-        }
-        case nkop_trunc_64_8: {
-            deref<u8>(instr.arg[0]) = deref<u64>(instr.arg[1]);
-            break;
-        }
-        case nkop_trunc_32_16: {
-            deref<u16>(instr.arg[0]) = deref<u32>(instr.arg[1]);
-            break;
-        }
-        case nkop_trunc_64_16: {
-            deref<u16>(instr.arg[0]) = deref<u64>(instr.arg[1]);
-            break;
-        }
-        case nkop_trunc_64_32: {
-            deref<u32>(instr.arg[0]) = deref<u64>(instr.arg[1]);
-            break;
-        }
+            CVT_OP_IT(zext_8_16, u16, u8)
+            CVT_OP_IT(zext_8_32, u32, u8)
+            CVT_OP_IT(zext_8_64, u64, u8)
+            CVT_OP_IT(zext_16_32, u32, u16)
+            CVT_OP_IT(zext_16_64, u64, u16)
+            CVT_OP_IT(zext_32_64, u64, u32)
 
-        case nkop_ftrunc: {
-            deref<f32>(instr.arg[0]) = deref<f64>(instr.arg[1]);
-            break;
-        }
+            CVT_OP_IT(fext, f64, f32)
 
-#define FP2I_OP_IT(TYPE, VALUE_TYPE, FTYPE, SIZ)                      \
-    case NK_CAT(NK_CAT(NK_CAT(nkop_fp2i_, SIZ), _), TYPE): {          \
-        deref<TYPE>(instr.arg[0]) = (TYPE)deref<FTYPE>(instr.arg[1]); \
-        break;                                                        \
-    }
+            CVT_OP_IT(trunc_16_8, u8, u16)
+            CVT_OP_IT(trunc_32_8, u8, u32)
+            CVT_OP_IT(trunc_64_8, u8, u64)
+            CVT_OP_IT(trunc_32_16, u16, u32)
+            CVT_OP_IT(trunc_64_16, u16, u64)
+            CVT_OP_IT(trunc_64_32, u32, u64)
 
-#define I2FP_OP_IT(TYPE, VALUE_TYPE, FTYPE, SIZ)                       \
-    case NK_CAT(NK_CAT(NK_CAT(nkop_i2fp_, SIZ), _), TYPE): {           \
-        deref<FTYPE>(instr.arg[0]) = (FTYPE)deref<TYPE>(instr.arg[1]); \
-        break;                                                         \
-    }
+            CVT_OP_IT(ftrunc, f32, f64)
+
+#define FP2I_OP_IT(TYPE, VALUE_TYPE, FTYPE, SIZ) CVT_OP_IT(NK_CAT(NK_CAT(NK_CAT(fp2i_, SIZ), _), TYPE), TYPE, FTYPE)
+#define I2FP_OP_IT(TYPE, VALUE_TYPE, FTYPE, SIZ) CVT_OP_IT(NK_CAT(NK_CAT(NK_CAT(i2fp_, SIZ), _), TYPE), FTYPE, TYPE)
 
 #define FP2I_OP(FTYPE, SIZ) NKIR_NUMERIC_ITERATE_INT(FP2I_OP_IT, FTYPE, SIZ)
 #define I2FP_OP(FTYPE, SIZ) NKIR_NUMERIC_ITERATE_INT(I2FP_OP_IT, FTYPE, SIZ)
@@ -401,46 +365,36 @@ void interp(NkBcInstr const &instr) {
 #undef I2FP_OP_IT
 #undef FP2I_OP_IT
 
-        case nkop_mov: {
-            memcpy(getRefAddr(instr.arg[0].ref), getRefAddr(instr.arg[1].ref), instr.arg[0].ref.type->size);
-            break;
-        }
-
-        case nkop_mov_8: {
-            deref<u8>(instr.arg[0]) = deref<u8>(instr.arg[1]);
-            break;
-        }
-
-        case nkop_mov_16: {
-            deref<u16>(instr.arg[0]) = deref<u16>(instr.arg[1]);
-            break;
-        }
+            CASE(mov) {
+                memcpy(
+                    getRefAddr(base, instr->arg[0].ref),
+                    getRefAddr(base, instr->arg[1].ref),
+                    getTypes(cur_proc, instr).arg_t[0]->size);
+                NEXT();
+            }
 
-        case nkop_mov_32: {
-            deref<u32>(instr.arg[0]) = deref<u32>(instr.arg[1]);
-            break;
-        }
+            CVT_OP_IT(mov_8, u8, u8)
+            CVT_OP_IT(mov_16, u16, u16)
+            CVT_OP_IT(mov_32, u32, u32)
+            CVT_OP_IT(mov_64, u64, u64)
 
-        case nkop_mov_64: {
-            deref<u64>(instr.arg[0]) = deref<u64>(instr.arg[1]);
-            break;
-        }
+#undef CVT_OP_IT
 
-        case nkop_lea: {
-            deref<void *>(instr.arg[0]) = &deref<u8>(instr.arg[1]);
-            break;
-        }
+            CASE(lea) {
+                deref<void *>(base, instr->arg[0]) = &deref<u8>(base, instr->arg[1]);
+                NEXT();
+            }
 
-#define NUM_BIN_OP_IT(TYPE, VALUE_TYPE, NAME, OP)                                           \
-    case NK_CAT(NK_CAT(NK_CAT(nkop_, NAME), _), TYPE): {                                    \
-        deref<TYPE>(instr.arg[0]) = deref<TYPE>(instr.arg[1]) OP deref<TYPE>(instr.arg[2]); \
-        break;                                                                              \
+#define NUM_BIN_OP_IT(TYPE, VALUE_TYPE, NAME, OP)                                                                \
+    CASE(NK_CAT(NK_CAT(NAME, _), TYPE)) {                                                                        \
+        deref<TYPE>(base, instr->arg[0]) = deref<TYPE>(base, instr->arg[1]) OP deref<TYPE>(base, instr->arg[2]); \
+        NEXT();                                                                                                  \
     }
 
-#define NUM_BIN_BOOL_OP_IT(TYPE, VALUE_TYPE, NAME, OP)                                    \
-    case NK_CAT(NK_CAT(NK_CAT(nkop_, NAME), _), TYPE): {                                  \
-        deref<u8>(instr.arg[0]) = deref<TYPE>(instr.arg[1]) OP deref<TYPE>(instr.arg[2]); \
-        break;                                                                            \
+#define NUM_BIN_BOOL_OP_IT(TYPE, VALUE_TYPE, NAME, OP)                                                         \
+    CASE(NK_CAT(NK_CAT(NAME, _), TYPE)) {                                                                      \
+        deref<u8>(base, instr->arg[0]) = deref<TYPE>(base, instr->arg[1]) OP deref<TYPE>(base, instr->arg[2]); \
+        NEXT();                                                                                                \
     }
 
 #define NUM_BIN_OP(NAME, OP) NKIR_NUMERIC_ITERATE(NUM_BIN_OP_IT, NAME, OP)
@@ -472,123 +426,285 @@ void interp(NkBcInstr const &instr) {
 #undef NUM_BIN_BOOL_OP
 #undef NUM_BIN_BOOL_OP_IT
 
-#if NK_SYSCALLS_AVAILABLE
-        case nkop_syscall_0: {
-            deref<long>(instr.arg[0]) = nk_syscall0(deref<long>(instr.arg[1]));
-            break;
-        }
+#define FAST_DEREF_f derefFrame
+#define FAST_DEREF_d derefData
 
-        case nkop_syscall_1: {
-            deref<long>(instr.arg[0]) = nk_syscall1(deref<long>(instr.arg[1]), deref<long>(instr.arg[2].refs.data[0]));
-            break;
-        }
+#define FAST_MOV_OP_IT(TYPE, SIZ, KIND)                                                               \
+    CASE(NK_CAT(mov_, NK_CAT(SIZ, NK_CAT(_, KIND)))) {                                                \
+        derefFrame<TYPE>(base, instr->arg[0]) = NK_CAT(FAST_DEREF_, KIND)<TYPE>(base, instr->arg[1]); \
+        NEXT();                                                                                       \
+    }
 
-        case nkop_syscall_2: {
-            deref<long>(instr.arg[0]) = nk_syscall2(
-                deref<long>(instr.arg[1]),
-                deref<long>(instr.arg[2].refs.data[0]),
-                deref<long>(instr.arg[2].refs.data[1]));
-            break;
-        }
+#define FAST_MOV_OP(TYPE, SIZ)   \
+    FAST_MOV_OP_IT(TYPE, SIZ, f) \
+    FAST_MOV_OP_IT(TYPE, SIZ, d)
 
-        case nkop_syscall_3: {
-            deref<long>(instr.arg[0]) = nk_syscall3(
-                deref<long>(instr.arg[1]),
-                deref<long>(instr.arg[2].refs.data[0]),
-                deref<long>(instr.arg[2].refs.data[1]),
-                deref<long>(instr.arg[2].refs.data[2]));
-            break;
-        }
+            FAST_MOV_OP(u8, 8)
+            FAST_MOV_OP(u16, 16)
+            FAST_MOV_OP(u32, 32)
+            FAST_MOV_OP(u64, 64)
 
-        case nkop_syscall_4: {
-            deref<long>(instr.arg[0]) = nk_syscall4(
-                deref<long>(instr.arg[1]),
-                deref<long>(instr.arg[2].refs.data[0]),
-                deref<long>(instr.arg[2].refs.data[1]),
-                deref<long>(instr.arg[2].refs.data[2]),
-                deref<long>(instr.arg[2].refs.data[3]));
-            break;
-        }
+#undef FAST_MOV_OP
+#undef FAST_MOV_OP_IT
 
-        case nkop_syscall_5: {
-            deref<long>(instr.arg[0]) = nk_syscall5(
-                deref<long>(instr.arg[1]),
-                deref<long>(instr.arg[2].refs.data[0]),
-                deref<long>(instr.arg[2].refs.data[1]),
-                deref<long>(instr.arg[2].refs.data[2]),
-                deref<long>(instr.arg[2].refs.data[3]),
-                deref<long>(instr.arg[2].refs.data[4]));
-            break;
-        }
+#define FAST_JMP_OP_IT(NAME, TYPE, SIZ, COND, KIND)                      \
+    CASE(NK_CAT(NAME, NK_CAT(_, NK_CAT(SIZ, NK_CAT(_, KIND))))) {        \
+        if (COND NK_CAT(FAST_DEREF_, KIND)<TYPE>(base, instr->arg[1])) { \
+            jumpTo(getJumpTarget(base, instr->arg[2]));                  \
+        }                                                                \
+        NEXT();                                                          \
+    }
 
-        case nkop_syscall_6: {
-            deref<long>(instr.arg[0]) = nk_syscall6(
-                deref<long>(instr.arg[1]),
-                deref<long>(instr.arg[2].refs.data[0]),
-                deref<long>(instr.arg[2].refs.data[1]),
-                deref<long>(instr.arg[2].refs.data[2]),
-                deref<long>(instr.arg[2].refs.data[3]),
-                deref<long>(instr.arg[2].refs.data[4]),
-                deref<long>(instr.arg[2].refs.data[5]));
-            break;
-        }
-#endif // NK_SYSCALLS_AVAILABLE
+#define FAST_JMP_OP(NAME, TYPE, SIZ, COND)   \
+    FAST_JMP_OP_IT(NAME, TYPE, SIZ, COND, f) \
+    FAST_JMP_OP_IT(NAME, TYPE, SIZ, COND, d)
+
+            FAST_JMP_OP(jmpz, u8, 8, !)
+            FAST_JMP_OP(jmpz, u16, 16, !)
+            FAST_JMP_OP(jmpz, u32, 32, !)
+            FAST_JMP_OP(jmpz, u64, 64, !)
+
+            FAST_JMP_OP(jmpnz, u8, 8, )
+            FAST_JMP_OP(jmpnz, u16, 16, )
+            FAST_JMP_OP(jmpnz, u32, 32, )
+            FAST_JMP_OP(jmpnz, u64, 64, )
+
+#undef FAST_JMP_OP
+#undef FAST_JMP_OP_IT
 
-        default:
-            nk_assert(!"unknown opcode");
-            break;
+#define FAST_BIN_OP_IT(TYPE, NAME, OP, KIND)                                                               \
+    CASE(NK_CAT(NAME, NK_CAT(_, NK_CAT(TYPE, NK_CAT(_f, KIND))))) {                                        \
+        derefFrame<TYPE>(base, instr->arg[0]) =                                                            \
+            derefFrame<TYPE>(base, instr->arg[1]) OP NK_CAT(FAST_DEREF_, KIND)<TYPE>(base, instr->arg[2]); \
+        NEXT();                                                                                            \
     }
-}
 
-} // namespace
+// The fused jump reads its target from the conditional jump that follows, which is skipped if not taken
+#define FAST_CMP_JMP_OP_IT(TYPE, NAME, OP, KIND, JMP, COND)                                                            \
+    CASE(NK_CAT(NAME, NK_CAT(_, NK_CAT(TYPE, NK_CAT(NK_CAT(_f, KIND), NK_CAT(_, JMP)))))) {                            \
+        u8 const cond = derefFrame<TYPE>(base, instr->arg[1]) OP NK_CAT(FAST_DEREF_, KIND)<TYPE>(base, instr->arg[2]); \
+        derefFrame<u8>(base, instr->arg[0]) = cond;                                                                    \
+        if (COND cond) {                                                                                               \
+            jumpTo(getJumpTarget(base, pinstr->arg[2]));                                                               \
+        } else {                                                                                                       \
+            pinstr++;                                                                                                  \
+        }                                                                                                              \
+        NEXT();                                                                                                        \
+    }
 
-void nkir_interp_invoke(NkBcProc proc, void **args, void **ret) {
-    NK_PROF_FUNC();
-    NK_LOG_TRC("%s", __func__);
+#define FAST_CMP_OP_IT(TYPE, NAME, OP, KIND)                                                               \
+    CASE(NK_CAT(NAME, NK_CAT(_, NK_CAT(TYPE, NK_CAT(_f, KIND))))) {                                        \
+        derefFrame<u8>(base, instr->arg[0]) =                                                              \
+            derefFrame<TYPE>(base, instr->arg[1]) OP NK_CAT(FAST_DEREF_, KIND)<TYPE>(base, instr->arg[2]); \
+        NEXT();                                                                                            \
+    }                                                                                                      \
+    FAST_CMP_JMP_OP_IT(TYPE, NAME, OP, KIND, jmpz, !)                                                      \
+    FAST_CMP_JMP_OP_IT(TYPE, NAME, OP, KIND, jmpnz, )
+
+#define FAST_BIN_OP_TYPE(TYPE, NAME, OP) \
+    FAST_BIN_OP_IT(TYPE, NAME, OP, f)    \
+    FAST_BIN_OP_IT(TYPE, NAME, OP, d)
+
+#define FAST_CMP_OP_TYPE(TYPE, NAME, OP) \
+    FAST_CMP_OP_IT(TYPE, NAME, OP, f)    \
+    FAST_CMP_OP_IT(TYPE, NAME, OP, d)
+
+#define FAST_BIN_OP(NAME, OP)       \
+    FAST_BIN_OP_TYPE(i32, NAME, OP) \
+    FAST_BIN_OP_TYPE(u32, NAME, OP) \
+    FAST_BIN_OP_TYPE(i64, NAME, OP) \
+    FAST_BIN_OP_TYPE(u64, NAME, OP)
+
+#define FAST_CMP_OP(NAME, OP)       \
+    FAST_CMP_OP_TYPE(i32, NAME, OP) \
+    FAST_CMP_OP_TYPE(u32, NAME, OP) \
+    FAST_CMP_OP_TYPE(i64, NAME, OP) \
+    FAST_CMP_OP_TYPE(u64, NAME, OP)
+
+            FAST_BIN_OP(add, +)
+            FAST_BIN_OP(sub, -)
+            FAST_BIN_OP(mul, *)
+            FAST_BIN_OP(div, /)
+            FAST_BIN_OP(mod, %)
+
+            FAST_BIN_OP(and, &)
+            FAST_BIN_OP(or, |)
+            FAST_BIN_OP(xor, ^)
+            FAST_BIN_OP(lsh, <<)
+            FAST_BIN_OP(rsh, >>)
+
+            FAST_CMP_OP(cmp_eq, ==)
+            FAST_CMP_OP(cmp_ne, !=)
+            FAST_CMP_OP(cmp_ge, >=)
+            FAST_CMP_OP(cmp_gt, >)
+            FAST_CMP_OP(cmp_le, <=)
+            FAST_CMP_OP(cmp_lt, <)
+
+#undef FAST_CMP_OP
+#undef FAST_BIN_OP
+#undef FAST_CMP_OP_TYPE
+#undef FAST_BIN_OP_TYPE
+#undef FAST_CMP_OP_IT
+#undef FAST_CMP_JMP_OP_IT
+#undef FAST_BIN_OP_IT
+
+#undef FAST_DEREF_d
+#undef FAST_DEREF_f
 
-    NK_LOG_DBG("program @%p", (void *)proc->ctx);
+#if NK_SYSCALLS_AVAILABLE
+            CASE(syscall_0) {
+                deref<long>(base, instr->arg[0]) = nk_syscall0(deref<long>(base, instr->arg[1]));
+                NEXT();
+            }
 
-    ProgramFrame pfr{
-        .pinstr = ctx.pinstr,
-        .ffi_ctx = ctx.ffi_ctx,
-    };
+            CASE(syscall_1) {
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                deref<long>(base, instr->arg[0]) =
+                    nk_syscall1(deref<long>(base, instr->arg[1]), deref<long>(base, refs[0]));
+                NEXT();
+            }
 
-    ctx.pinstr = nullptr;
-    ctx.ffi_ctx = &proc->ctx->ffi_ctx;
+            CASE(syscall_2) {
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                deref<long>(base, instr->arg[0]) = nk_syscall2(
+                    deref<long>(base, instr->arg[1]),
+                    deref<long>(base, refs[0]),
+                    deref<long>(base, refs[1]));
+                NEXT();
+            }
 
-    NK_LOG_DBG("instr=%p", (void *)ctx.base.instr);
+            CASE(syscall_3) {
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                deref<long>(base, instr->arg[0]) = nk_syscall3(
+                    deref<long>(base, instr->arg[1]),
+                    deref<long>(base, refs[0]),
+                    deref<long>(base, refs[1]),
+                    deref<long>(base, refs[2]));
+                NEXT();
+            }
 
-    jumpCall(proc, args, ret, nk_arena_grab(&ctx.stack));
+            CASE(syscall_4) {
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                deref<long>(base, instr->arg[0]) = nk_syscall4(
+                    deref<long>(base, instr->arg[1]),
+                    deref<long>(base, refs[0]),
+                    deref<long>(base, refs[1]),
+                    deref<long>(base, refs[2]),
+                    deref<long>(base, refs[3]));
+                NEXT();
+            }
 
-    while (ctx.pinstr) {
-        auto pinstr = ctx.pinstr++;
+            CASE(syscall_5) {
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                deref<long>(base, instr->arg[0]) = nk_syscall5(
+                    deref<long>(base, instr->arg[1]),
+                    deref<long>(base, refs[0]),
+                    deref<long>(base, refs[1]),
+                    deref<long>(base, refs[2]),
+                    deref<long>(base, refs[3]),
+                    deref<long>(base, refs[4]));
+                NEXT();
+            }
 
-        nk_assert(pinstr->code < NkBcOpcode_Count && "unknown instruction");
-        NK_LOG_DBG("instr: %zu %s", (pinstr - (NkBcInstr *)ctx.base.instr), nkbcOpcodeName(pinstr->code));
+            CASE(syscall_6) {
+                auto const refs = getRefs(cur_proc, instr->arg[2]);
+                deref<long>(base, instr->arg[0]) = nk_syscall6(
+                    deref<long>(base, instr->arg[1]),
+                    deref<long>(base, refs[0]),
+                    deref<long>(base, refs[1]),
+                    deref<long>(base, refs[2]),
+                    deref<long>(base, refs[3]),
+                    deref<long>(base, refs[4]),
+                    deref<long>(base, refs[5]));
+                NEXT();
+            }
+#else  // NK_SYSCALLS_AVAILABLE
+            CASE(syscall_0)
+            CASE(syscall_1)
+            CASE(syscall_2)
+            CASE(syscall_3)
+            CASE(syscall_4)
+            CASE(syscall_5)
+            CASE(syscall_6)
+#endif // NK_SYSCALLS_AVAILABLE
 
-#ifdef ENABLE_LOGGING
-        void *dst_ref_data = nullptr;
-        auto const &dst = pinstr->arg[0];
-        if (dst.kind == NkBcArg_Ref && dst.ref.kind != NkBcRef_None) {
-            dst_ref_data = getRefAddr(dst.ref);
-        }
-#endif // ENABLE_LOGGING
+            // Generic opcodes are always specialized by the translator
+            CASE(jmpz)
+            CASE(jmpnz)
+            CASE(call)
+            CASE(ext)
+            CASE(sext)
+            CASE(zext)
+            CASE(trunc)
+            CASE(fp2i)
+            CASE(fp2i_32)
+            CASE(fp2i_64)
+            CASE(i2fp)
+            CASE(i2fp_32)
+            CASE(i2fp_64)
+            CASE(add)
+            CASE(sub)
+            CASE(mul)
+            CASE(div)
+            CASE(mod)
+            CASE(and)
+            CASE(or)
+            CASE(xor)
+            CASE(lsh)
+            CASE(rsh)
+            CASE(cmp_eq)
+            CASE(cmp_ne)
+            CASE(cmp_lt)
+            CASE(cmp_le)
+            CASE(cmp_gt)
+            CASE(cmp_ge)
+            CASE(syscall)
+            CASE(label)
+            CASE(comment)
+            CASE(line)
+            CASE_DEFAULT {
+                nk_assert(!"unknown opcode");
+                NEXT();
+            }
+
+#if NKB_THREADED_DISPATCH
+
+    }
+
+#undef DISPATCH
 
-        interp(*pinstr);
+#else // NKB_THREADED_DISPATCH
+
+        }
 
 #ifdef ENABLE_LOGGING
         if (dst_ref_data) {
             NKSB_FIXED_BUFFER(sb, 256);
-            nkirv_inspect(dst_ref_data, dst.ref.type, nksb_getStream(&sb));
+            nkirv_inspect(dst_ref_data, dst_type, nksb_getStream(&sb));
             nksb_printf(&sb, ":");
-            nkirt_inspect(dst.ref.type, nksb_getStream(&sb));
+            nkirt_inspect(dst_type, nksb_getStream(&sb));
             NK_LOG_DBG("res=" NKS_FMT, NKS_ARG(sb));
         }
 #endif // ENABLE_LOGGING
     }
 
+#endif // NKB_THREADED_DISPATCH
+
+#undef NEXT
+#undef CASE_DEFAULT
+#undef CASE
+
+exit:
     NK_LOG_TRC("exiting...");
+}
+
+} // namespace
+
+void nkir_interp_invoke(NkBcProc proc, void **args, void **ret) {
+    NK_PROF_FUNC();
+    NK_LOG_TRC("%s", __func__);
+
+    NK_LOG_DBG("program @%p", (void *)proc->ctx);
 
-    ctx.pinstr = pfr.pinstr;
-    ctx.ffi_ctx = pfr.ffi_ctx;
+    interp(g_ctx, proc, args, ret);
 }
@@ -0,0 +1,213 @@
+#include "ffi_adapter.h"
+
+#include <cstdarg>
+
+#include <gtest/gtest.h>
+
+#include "nkb/common.h"
+#include "ntk/arena.h"
+#include "ntk/common.h"
+#include "ntk/log.h"
+#include "ntk/thread.h"
+
+namespace {
+
+struct Pair {
+    i64 a;
+    i64 b;
+};
+
+i64 test_mixed(i8 a, i16 b, u8 c, u32 d, i64 e, i64 *f) {
+    return a + b + c + d + e + *f;
+}
+
+i8 test_negate(i8 val) {
+    return -val;
+}
+
+f64 test_fma(f64 a, f64 b, f64 c) {
+    return a * b + c;
+}
+
+void test_store(i64 *dst, i64 val) {
+    *dst = val;
+}
+
+i64 test_pairSum(Pair pair) {
+    return pair.a + pair.b;
+}
+
+i64 test_varSum(i32 count, ...) {
+    va_list ap;
+    va_start(ap, count);
+    i64 sum = 0;
+    for (i32 i = 0; i < count; i++) {
+        sum += va_arg(ap, i64);
+    }
+    va_end(ap);
+    return sum;
+}
+
+class ffi_adapter : public testing::Test {
+    void SetUp() override {
+        NK_LOG_INIT({});
+
+        m_ctx = {
+            .alloc = nk_arena_getAllocator(&m_arena),
+            .types{NK_HASH_TREE_INIT(nk_arena_getAllocator(&m_arena))},
+            .mtx = nk_mutex_alloc(0),
+        };
+    }
+
+    void TearDown() override {
+        nk_mutex_free(m_ctx.mtx);
+        nk_arena_free(&m_arena);
+    }
+
+protected:
+    static NkIrType makeNumeric(NkIrNumericValueType value_type, u32 id) {
+        return {
+            .as{.num{value_type}},
+            .size = (u64)NKIR_NUMERIC_TYPE_SIZE(value_type),
+            .flags = 0,
+            .align = (u8)NKIR_NUMERIC_TYPE_SIZE(value_type),
+            .kind = NkIrType_Numeric,
+            .id = id,
+        };
+    }
+
+    NkNativeCallSite prepare(NkTypeArray argt, nktype_t rett, usize nfixedargs = 0, bool is_variadic = false) {
+        NkNativeCallData const call_data{
+            .proc{},
+            .nfixedargs = is_variadic ? nfixedargs : argt.size,
+            .is_variadic = is_variadic,
+            .argt = argt.data,
+            .argc = argt.size,
+            .rett = rett,
+        };
+        return nk_native_prepareCall(&m_ctx, nk_arena_getAllocator(&m_arena), &call_data);
+    }
+
+protected:
+    NkArena m_arena{};
+    NkFfiContext m_ctx{};
+
+    NkIrType m_i8_t = makeNumeric(Int8, 0);
+    NkIrType m_i16_t = makeNumeric(Int16, 1);
+    NkIrType m_u8_t = makeNumeric(Uint8, 2);
+    NkIrType m_i32_t = makeNumeric(Int32, 3);
+    NkIrType m_u32_t = makeNumeric(Uint32, 4);
+    NkIrType m_i64_t = makeNumeric(Int64, 5);
+    NkIrType m_f64_t = makeNumeric(Float64, 6);
+    NkIrType m_ptr_t{
+        .as{},
+        .size = sizeof(void *),
+        .flags = 0,
+        .align = alignof(void *),
+        .kind = NkIrType_Pointer,
+        .id = 7,
+    };
+};
+
+} // namespace
+
+TEST_F(ffi_adapter, whole_args) {
+    nktype_t const argt[] = {&m_i8_t, &m_i16_t, &m_u8_t, &m_u32_t, &m_i64_t, &m_ptr_t};
+    auto const site = prepare({argt, NK_ARRAY_COUNT(argt)}, &m_i64_t);
+
+    i8 a = -1;
+    i16 b = -2;
+    u8 c = 0xff;
+    u32 d = 0xffffffff;
+    i64 e = -4;
+    i64 f_val = 100;
+    i64 *f = &f_val;
+    void *argv[] = {&a, &b, &c, &d, &e, &f};
+
+    i64 ret = 0;
+    nk_native_invokePrepared(site, (void *)test_mixed, &ret, argv);
+
+    EXPECT_EQ(ret, test_mixed(a, b, c, d, e, f));
+}
+
+TEST_F(ffi_adapter, narrow_ret) {
+    nktype_t const argt[] = {&m_i8_t};
+    auto const site = prepare({argt, NK_ARRAY_COUNT(argt)}, &m_i8_t);
+
+    i8 val = 5;
+    void *argv[] = {&val};
+
+    i64 ret = 0x7777777777777777;
+    nk_native_invokePrepared(site, (void *)test_negate, &ret, argv);
+
+    EXPECT_EQ(*(i8 *)&ret, -5);
+    EXPECT_EQ(ret & ~(i64)0xff, 0x7777777777777700);
+}
+
+TEST_F(ffi_adapter, float_args) {
+    nktype_t const argt[] = {&m_f64_t, &m_f64_t, &m_f64_t};
+    auto const site = prepare({argt, NK_ARRAY_COUNT(argt)}, &m_f64_t);
+
+    f64 a = 1.5;
+    f64 b = 4.0;
+    f64 c = 0.25;
+    void *argv[] = {&a, &b, &c};
+
+    f64 ret = 0;
+    nk_native_invokePrepared(site, (void *)test_fma, &ret, argv);
+
+    EXPECT_EQ(ret, 6.25);
+}
+
+TEST_F(ffi_adapter, void_ret) {
+    nktype_t const argt[] = {&m_ptr_t, &m_i64_t};
+    auto const site = prepare({argt, NK_ARRAY_COUNT(argt)}, nullptr);
+
+    i64 dst = 0;
+    i64 *pdst = &dst;
+    i64 val = 42;
+    void *argv[] = {&pdst, &val};
+
+    nk_native_invokePrepared(site, (void *)test_store, nullptr, argv);
+
+    EXPECT_EQ(dst, 42);
+}
+
+TEST_F(ffi_adapter, aggregate_fallback) {
+    NkIrAggregateElemInfo const elems[] = {{&m_i64_t, 2, 0}};
+    NkIrType const pair_t{
+        .as{.aggr{{elems, NK_ARRAY_COUNT(elems)}}},
+        .size = sizeof(Pair),
+        .flags = 0,
+        .align = alignof(Pair),
+        .kind = NkIrType_Aggregate,
+        .id = 8,
+    };
+
+    nktype_t const argt[] = {&pair_t};
+    auto const site = prepare({argt, NK_ARRAY_COUNT(argt)}, &m_i64_t);
+
+    Pair pair{3, 4};
+    void *argv[] = {&pair};
+
+    i64 ret = 0;
+    nk_native_invokePrepared(site, (void *)test_pairSum, &ret, argv);
+
+    EXPECT_EQ(ret, 7);
+}
+
+TEST_F(ffi_adapter, variadic_fallback) {
+    nktype_t const argt[] = {&m_i32_t, &m_i64_t, &m_i64_t, &m_i64_t};
+    auto const site = prepare({argt, NK_ARRAY_COUNT(argt)}, &m_i64_t, 1, true);
+
+    i32 count = 3;
+    i64 a = 1;
+    i64 b = 20;
+    i64 c = 300;
+    void *argv[] = {&count, &a, &b, &c};
+
+    i64 ret = 0;
+    nk_native_invokePrepared(site, (void *)test_varSum, &ret, argv);
+
+    EXPECT_EQ(ret, 321);
+}
@@ -0,0 +1,436 @@
+#include <gtest/gtest.h>
+
+#include "nkb/common.h"
+#include "nkb/ir.h"
+#include "ntk/arena.h"
+#include "ntk/atom.h"
+#include "ntk/common.h"
+#include "ntk/log.h"
+#include "ntk/string.h"
+#include "ntk/string_builder.h"
+#include "ntk/time.h"
+#include "ntk/utils.h"
+
+namespace {
+
+NK_LOG_USE_SCOPE(test);
+
+i64 test_extAdd(i64 lhs, i64 rhs) {
+    return lhs + rhs;
+}
+
+class interp : public testing::Test {
+    void SetUp() override {
+        NK_LOG_INIT({});
+
+        buildIr();
+    }
+
+    void TearDown() override {
+        nkir_freeRunCtx(m_run_ctx);
+
+        nk_arena_free(&m_tmp_arena);
+        nk_arena_free(&m_arena);
+    }
+
+protected:
+    void buildIr() {
+        u32 type_id = 0;
+
+        m_u8_t = {
+            .as{.num{Uint8}},
+            .size = 1,
+            .flags = 0,
+            .align = 1,
+            .kind = NkIrType_Numeric,
+            .id = type_id++,
+        };
+
+        m_i64_t = {
+            .as{.num{Int64}},
+            .size = 8,
+            .flags = 0,
+            .align = 8,
+            .kind = NkIrType_Numeric,
+            .id = type_id++,
+        };
+
+        m_args_t[0] = &m_i64_t;
+        m_args_t[1] = &m_i64_t;
+
+        m_fast_exp_t = {
+            .as{.proc{{
+                .args_t{m_args_t, 2},
+                .ret_t = &m_i64_t,
+                .call_conv = NkCallConv_Nk,
+                .flags = 0,
+            }}},
+            .size = 8,
+            .flags = 0,
+            .align = 8,
+            .kind = NkIrType_Procedure,
+            .id = type_id++,
+        };
+
+        m_bench_t = {
+            .as{.proc{{
+                .args_t{m_args_t, 1},
+                .ret_t = &m_i64_t,
+                .call_conv = NkCallConv_Nk,
+                .flags = 0,
+            }}},
+            .size = 8,
+            .flags = 0,
+            .align = 8,
+            .kind = NkIrType_Procedure,
+            .id = type_id++,
+        };
+
+        m_ext_add_t = {
+            .as{.proc{{
+                .args_t{m_args_t, 2},
+                .ret_t = &m_i64_t,
+                .call_conv = NkCallConv_Cdecl,
+                .flags = 0,
+            }}},
+            .size = 8,
+            .flags = 0,
+            .align = 8,
+            .kind = NkIrType_Procedure,
+            .id = type_id++,
+        };
+
+        m_ir = nkir_createProgram(&m_arena);
+
+        auto const makeConst = [&](i64 val) {
+            auto const data = nkir_makeRodata(m_ir, 0, &m_i64_t, NkIrVisibility_Local);
+            *(i64 *)nkir_getDataPtr(m_ir, data) = val;
+            return nkir_makeDataRef(m_ir, data);
+        };
+
+        auto const makeLocal = [&](char const *name, nktype_t type) {
+            return nkir_makeFrameRef(m_ir, nkir_makeLocalVar(m_ir, nk_cs2atom(name), type));
+        };
+
+        // Emits `a := pow(b, n)`, the same way test/run/fast_exp.nkl computes it
+        auto const emitFastExp = [&](NkIrRef a, NkIrRef b, NkIrRef n) {
+            auto const c = makeLocal("c", &m_i64_t);
+            auto const r = makeLocal("r", &m_i64_t);
+            auto const cond = makeLocal("cond", &m_u8_t);
+
+            auto const zero = makeConst(0);
+            auto const one = makeConst(1);
+            auto const two = makeConst(2);
+
+            auto const loop_l = nkir_createLabel(m_ir, nk_cs2atom("@loop"));
+            auto const skip_l = nkir_createLabel(m_ir, nk_cs2atom("@skip"));
+            auto const end_l = nkir_createLabel(m_ir, nk_cs2atom("@end"));
+
+            nkir_emit(m_ir, nkir_make_mov(m_ir, a, one));
+            nkir_emit(m_ir, nkir_make_mov(m_ir, c, b));
+            nkir_emit(m_ir, nkir_make_label(loop_l));
+            nkir_emit(m_ir, nkir_make_cmp_ne(m_ir, cond, n, zero));
+            nkir_emit(m_ir, nkir_make_jmpz(m_ir, cond, end_l));
+            nkir_emit(m_ir, nkir_make_mod(m_ir, r, n, two));
+            nkir_emit(m_ir, nkir_make_cmp_eq(m_ir, cond, r, one));
+            nkir_emit(m_ir, nkir_make_jmpz(m_ir, cond, skip_l));
+            nkir_emit(m_ir, nkir_make_mul(m_ir, a, a, c));
+            nkir_emit(m_ir, nkir_make_label(skip_l));
+            nkir_emit(m_ir, nkir_make_div(m_ir, n, n, two));
+            nkir_emit(m_ir, nkir_make_mul(m_ir, c, c, c));
+            nkir_emit(m_ir, nkir_make_jmp(m_ir, loop_l));
+            nkir_emit(m_ir, nkir_make_label(end_l));
+        };
+
+        m_fast_exp = nkir_createProc(m_ir);
+
+        // proc fast_exp(b: i64, n: i64) i64
+        {
+            nkir_startProc(
+                m_ir,
+                m_fast_exp,
+                {
+                    .name = nk_cs2atom("fast_exp"),
+                    .proc_t = &m_fast_exp_t,
+                    .arg_names{},
+                    .file = 0,
+                    .line = 0,
+                    .visibility = NkIrVisibility_Default,
+                });
+            nkir_emit(m_ir, nkir_make_label(nkir_createLabel(m_ir, nk_cs2atom("@start"))));
+
+            auto const a = makeLocal("a", &m_i64_t);
+            auto const n = makeLocal("n", &m_i64_t);
+            nkir_emit(m_ir, nkir_make_mov(m_ir, n, nkir_makeArgRef(m_ir, 1)));
+            emitFastExp(a, nkir_makeArgRef(m_ir, 0), n);
+            nkir_emit(m_ir, nkir_make_ret(m_ir, a));
+
+            nkir_finishProc(m_ir, m_fast_exp, 0);
+        }
+
+        m_bench = nkir_createProc(m_ir);
+
+        // proc bench(iters: i64) i64 {
+        //     acc := 0;
+        //     for i in 0..iters {
+        //         acc += pow(2, i & 31);
+        //     }
+        //     return acc;
+        // }
+        {
+            nkir_startProc(
+                m_ir,
+                m_bench,
+                {
+                    .name = nk_cs2atom("bench"),
+                    .proc_t = &m_bench_t,
+                    .arg_names{},
+                    .file = 0,
+                    .line = 0,
+                    .visibility = NkIrVisibility_Default,
+                });
+            nkir_emit(m_ir, nkir_make_label(nkir_createLabel(m_ir, nk_cs2atom("@start"))));
+
+            auto const acc = makeLocal("acc", &m_i64_t);
+            auto const i = makeLocal("i", &m_i64_t);
+            auto const a = makeLocal("a", &m_i64_t);
+            auto const n = makeLocal("n", &m_i64_t);
+            auto const cond = makeLocal("cond", &m_u8_t);
+
+            auto const loop_l = nkir_createLabel(m_ir, nk_cs2atom("@bench_loop"));
+            auto const end_l = nkir_createLabel(m_ir, nk_cs2atom("@bench_end"));
+
+            nkir_emit(m_ir, nkir_make_label(loop_l));
+            nkir_emit(m_ir, nkir_make_cmp_lt(m_ir, cond, i, nkir_makeArgRef(m_ir, 0)));
+            nkir_emit(m_ir, nkir_make_jmpz(m_ir, cond, end_l));
+            nkir_emit(m_ir, nkir_make_and(m_ir, n, i, makeConst(31)));
+            emitFastExp(a, makeConst(2), n);
+            nkir_emit(m_ir, nkir_make_add(m_ir, acc, acc, a));
+            nkir_emit(m_ir, nkir_make_add(m_ir, i, i, makeConst(1)));
+            nkir_emit(m_ir, nkir_make_jmp(m_ir, loop_l));
+            nkir_emit(m_ir, nkir_make_label(end_l));
+            nkir_emit(m_ir, nkir_make_ret(m_ir, acc));
+
+            nkir_finishProc(m_ir, m_bench, 0);
+        }
+
+        m_forms = nkir_createProc(m_ir);
+
+        // proc forms(x: i64, y: i64) i64 {
+        //     if 10 < x {
+        //         return x - y;
+        //     }
+        //     return 100 - y;
+        // }
+        {
+            nkir_startProc(
+                m_ir,
+                m_forms,
+                {
+                    .name = nk_cs2atom("forms"),
+                    .proc_t = &m_fast_exp_t,
+                    .arg_names{},
+                    .file = 0,
+                    .line = 0,
+                    .visibility = NkIrVisibility_Default,
+                });
+            nkir_emit(m_ir, nkir_make_label(nkir_createLabel(m_ir, nk_cs2atom("@start"))));
+
+            auto const x = makeLocal("x", &m_i64_t);
+            auto const y = makeLocal("y", &m_i64_t);
+            auto const r = makeLocal("r", &m_i64_t);
+            auto const cond = makeLocal("cond", &m_u8_t);
+
+            auto const then_l = nkir_createLabel(m_ir, nk_cs2atom("@then"));
+
+            nkir_emit(m_ir, nkir_make_mov(m_ir, x, nkir_makeArgRef(m_ir, 0)));
+            nkir_emit(m_ir, nkir_make_mov(m_ir, y, nkir_makeArgRef(m_ir, 1)));
+            nkir_emit(m_ir, nkir_make_cmp_lt(m_ir, cond, makeConst(10), x));
+            nkir_emit(m_ir, nkir_make_jmpnz(m_ir, cond, then_l));
+            nkir_emit(m_ir, nkir_make_sub(m_ir, r, makeConst(100), y));
+            nkir_emit(m_ir, nkir_make_ret(m_ir, r));
+            nkir_emit(m_ir, nkir_make_label(then_l));
+            nkir_emit(m_ir, nkir_make_sub(m_ir, r, x, y));
+            nkir_emit(m_ir, nkir_make_ret(m_ir, r));
+
+            nkir_finishProc(m_ir, m_forms, 0);
+        }
+
+        m_ext_bench = nkir_createProc(m_ir);
+
+        // extern "c" proc test_extAdd(lhs: i64, rhs: i64) i64
+        //
+        // proc ext_bench(iters: i64) i64 {
+        //     acc := 0;
+        //     for i in 0..iters {
+        //         acc = test_extAdd(acc, i);
+        //     }
+        //     return acc;
+        // }
+        {
+            nkir_startProc(
+                m_ir,
+                m_ext_bench,
+                {
+                    .name = nk_cs2atom("ext_bench"),
+                    .proc_t = &m_bench_t,
+                    .arg_names{},
+                    .file = 0,
+                    .line = 0,
+                    .visibility = NkIrVisibility_Default,
+                });
+            nkir_emit(m_ir, nkir_make_label(nkir_createLabel(m_ir, nk_cs2atom("@start"))));
+
+            auto const ext_add =
+                nkir_makeExternProcRef(m_ir, nkir_makeExternProc(m_ir, nk_cs2atom("test_extAdd"), &m_ext_add_t));
+
+            auto const acc = makeLocal("acc", &m_i64_t);
+            auto const i = makeLocal("i", &m_i64_t);
+            auto const cond = makeLocal("cond", &m_u8_t);
+
+            auto const loop_l = nkir_createLabel(m_ir, nk_cs2atom("@ext_loop"));
+            auto const end_l = nkir_createLabel(m_ir, nk_cs2atom("@ext_end"));
+
+            NkIrRef const args[] = {acc, i};
+
+            nkir_emit(m_ir, nkir_make_label(loop_l));
+            nkir_emit(m_ir, nkir_make_cmp_lt(m_ir, cond, i, nkir_makeArgRef(m_ir, 0)));
+            nkir_emit(m_ir, nkir_make_jmpz(m_ir, cond, end_l));
+            nkir_emit(m_ir, nkir_make_call(m_ir, acc, ext_add, {args, NK_ARRAY_COUNT(args)}));
+            nkir_emit(m_ir, nkir_make_add(m_ir, i, i, makeConst(1)));
+            nkir_emit(m_ir, nkir_make_jmp(m_ir, loop_l));
+            nkir_emit(m_ir, nkir_make_label(end_l));
+            nkir_emit(m_ir, nkir_make_ret(m_ir, acc));
+
+            nkir_finishProc(m_ir, m_ext_bench, 0);
+        }
+
+#ifdef ENABLE_LOGGING
+        NkStringBuilder sb{NKSB_INIT(nk_arena_getAllocator(&m_tmp_arena))};
+        nkir_inspectProgram(m_ir, nksb_getStream(&sb));
+        NK_LOG_INF("IR:\n" NKS_FMT, NKS_ARG(sb));
+#endif // ENABLE_LOGGING
+
+        m_run_ctx = nkir_createRunCtx(m_ir, &m_tmp_arena);
+        nkir_setExternSymAddr(m_run_ctx, nk_cs2atom("test_extAdd"), (void *)test_extAdd);
+    }
+
+    i64 invokeProc(NkIrProc proc, i64 arg0, i64 arg1 = 0) {
+        i64 result = -1;
+        void *args[] = {&arg0, &arg1};
+        void *rets[] = {&result};
+
+        if (!nkir_invoke(m_run_ctx, proc, args, rets)) {
+            auto const msg = nkir_getRunErrorString(m_run_ctx);
+            (void)msg;
+            NK_LOG_ERR(NKS_FMT, NKS_ARG(msg));
+        }
+
+        return result;
+    }
+
+protected:
+    NkArena m_arena{};
+    NkArena m_tmp_arena{};
+
+    NkIrType m_u8_t;
+    NkIrType m_i64_t;
+    nktype_t m_args_t[2];
+    NkIrType m_fast_exp_t;
+    NkIrType m_bench_t;
+    NkIrType m_ext_add_t;
+
+    NkIrProg m_ir;
+    NkIrProc m_fast_exp;
+    NkIrProc m_bench;
+    NkIrProc m_forms;
+    NkIrProc m_ext_bench;
+    NkIrRunCtx m_run_ctx;
+};
+
+} // namespace
+
+TEST_F(interp, fast_exp) {
+    EXPECT_EQ(invokeProc(m_fast_exp, 2, 16), 65536);
+    EXPECT_EQ(invokeProc(m_fast_exp, 3, 5), 243);
+    EXPECT_EQ(invokeProc(m_fast_exp, 7, 0), 1);
+}
+
+TEST_F(interp, operand_forms) {
+    EXPECT_EQ(invokeProc(m_forms, 20, 5), 15);
+    EXPECT_EQ(invokeProc(m_forms, 11, 20), -9);
+    EXPECT_EQ(invokeProc(m_forms, 10, 5), 95);
+    EXPECT_EQ(invokeProc(m_forms, -3, 1), 99);
+}
+
+TEST_F(interp, loop) {
+    EXPECT_EQ(invokeProc(m_bench, 0), 0);
+    EXPECT_EQ(invokeProc(m_bench, 1), 1);
+    EXPECT_EQ(invokeProc(m_bench, 4), 15);
+    // Wraps around at 32
+    EXPECT_EQ(invokeProc(m_bench, 34), 0xffffffffll + 3);
+}
+
+TEST_F(interp, DISABLED_bench) {
+    static constexpr i64 c_iters = 1 << 16;
+
+    i64 expected = 0;
+    for (i64 i = 0; i < c_iters; i++) {
+        expected += (i64)1 << (i & 31);
+    }
+
+    // Warm up to exclude translation from the measurement
+    EXPECT_EQ(invokeProc(m_bench, 1), 1);
+
+    static constexpr int c_runs = 5;
+
+    i64 best_ns = INT64_MAX;
+    for (int run = 0; run < c_runs; run++) {
+        auto const start_ns = nk_now_ns();
+        auto const result = invokeProc(m_bench, c_iters);
+        auto const elapsed_ns = nk_now_ns() - start_ns;
+
+        EXPECT_EQ(result, expected);
+
+        best_ns = nk_mini(best_ns, elapsed_ns);
+    }
+
+    printf(
+        "interp bench (%s dispatch): %" PRIi64 " iterations in %.3f ms, %.2f ns/iteration\n",
+        TEST_DISPATCH,
+        c_iters,
+        best_ns * 1e-6,
+        (f64)best_ns / c_iters);
+}
+
+TEST_F(interp, ext_call) {
+    EXPECT_EQ(invokeProc(m_ext_bench, 0), 0);
+    EXPECT_EQ(invokeProc(m_ext_bench, 1), 0);
+    EXPECT_EQ(invokeProc(m_ext_bench, 10), 45);
+}
+
+TEST_F(interp, DISABLED_ext_call_bench) {
+    static constexpr i64 c_iters = 1 << 16;
+
+    // Warm up to exclude translation from the measurement
+    EXPECT_EQ(invokeProc(m_ext_bench, 1), 0);
+
+    static constexpr int c_runs = 5;
+
+    i64 best_ns = INT64_MAX;
+    for (int run = 0; run < c_runs; run++) {
+        auto const start_ns = nk_now_ns();
+        auto const result = invokeProc(m_ext_bench, c_iters);
+        auto const elapsed_ns = nk_now_ns() - start_ns;
+
+        EXPECT_EQ(result, c_iters * (c_iters - 1) / 2);
+
+        best_ns = nk_mini(best_ns, elapsed_ns);
+    }
+
+    printf(
+        "interp ext call bench: %" PRIi64 " calls in %.3f ms, %.2f ns/call\n",
+        c_iters,
+        best_ns * 1e-6,
+        (f64)best_ns / c_iters);
+}
@@ -37,6 +37,32 @@ typedef enum {
     NkIrOutput_Object,
 } NkIrOutputKind;
 
+typedef enum {
+    NkIrOpt_O0 = 0,
+    NkIrOpt_O1,
+    NkIrOpt_O2,
+    NkIrOpt_O3,
+    NkIrOpt_Os,
+    NkIrOpt_Oz,
+} NkIrOptLevel;
+
+typedef struct {
+    NkIrOptLevel level;
+    NkString passes; // Custom LLVM pass pipeline, e.g. `function(sroa,instcombine)`, replaces the one of the level
+} NkIrOptProfile;
+
+typedef struct {
+    NkString cpu;      // `native` selects the host CPU with its features, `generic` is used if empty
+    NkString features; // Comma separated, e.g. `+avx2,-fma`
+} NkIrTargetOpts;
+
+typedef enum {
+    NkIrJit_Eager = 0, // The whole dependency closure of a symbol is compiled on the first lookup
+    NkIrJit_Lazy,      // Procs are compiled on their first call
+    NkIrJit_Tiered,    // Procs are compiled without optimizations on their first call, and recompiled in the background
+                       // once hot
+} NkIrJitMode;
+
 typedef enum {
     NkIrRef_None = 0,
 
@@ -229,12 +255,26 @@ typedef NkDynArray(NkIrSymbolAddress) NkIrSymbolAddressDynArray;
 NkbState nkir_createState(void);
 void nkir_freeState(NkbState nkb);
 
+void nkir_setJitMode(NkbState nkb, NkIrJitMode mode);
+
+// Number of threads generating code in nkir_exportModule, each compiling a part of the module.
+// 1 by default, 0 selects the number of hardware threads
+void nkir_setCodegenThreadCount(NkbState nkb, usize count);
+
+// Reuses object code compiled for identical symbols across runs, keyed by their ir, the target and the opt profile.
+// Objects are kept in dir, trimmed to max_size bytes when the state is freed, 0 means no limit.
+// Disabled by default, an empty dir disables it again
+void nkir_setObjectCache(NkbState nkb, NkString dir, u64 max_size);
+
 NkIrModule nkir_createModule(NkbState nkb);
 
-NkIrTarget nkir_createTarget(NkbState nkb, NkString triple);
+NkIrTarget nkir_createTarget(NkbState nkb, NkString triple, NkIrTargetOpts opts);
 
 NkArena *nkir_moduleGetArena(NkIrModule mod);
 
+// O3 by default
+void nkir_moduleSetJitOptProfile(NkIrModule mod, NkIrOptProfile opt);
+
 void nkir_moduleDefineSymbol(NkIrModule mod, NkIrSymbol const *sym);
 
 NkIrRefDynArray nkir_moduleNewRefArray(NkIrModule mod);
@@ -246,8 +286,10 @@ NkIrRelocDynArray nkir_moduleNewRelocArray(NkIrModule mod);
 typedef void *(*NkIrSymbolResolver)(NkAtom sym, void *userdata);
 void nkir_setSymbolResolver(NkIrModule mod, NkIrSymbolResolver fn, void *userdata);
 
+// Returns a view of the symbols, it must not be used while symbols are being defined on other threads
 NkIrSymbolArray nkir_moduleGetSymbols(NkIrModule mod);
-NkIrSymbol const *nkir_findSymbol(NkIrModule mod, NkAtom sym);
+// Copies the first definition of the symbol, safe to call while symbols are being defined on other threads
+bool nkir_findSymbol(NkIrModule mod, NkAtom sym, NkIrSymbol *out);
 
 /// Utility
 
@@ -297,7 +339,7 @@ NkIrInstr nkir_make_comment(NkString comment);
 
 /// Output
 
-bool nkir_exportModule(NkIrModule mod, NkIrTarget target, NkString out_file, NkIrOutputKind kind);
+bool nkir_exportModule(NkIrModule mod, NkIrTarget target, NkString out_file, NkIrOutputKind kind, NkIrOptProfile opt);
 
 /// Runtime
 
@@ -305,6 +347,13 @@ bool nkir_invoke(NkIrModule mod, NkAtom sym, void **args, void **ret);
 void *nkir_getSymbolAddress(NkIrModule mod, NkAtom sym);
 bool nkir_defineExternSymbols(NkIrModule mod, NkIrSymbolAddressArray syms);
 
+typedef struct {
+    usize invoke_thunks; // Compiled by nkir_invoke, one per invoked proc
+    usize tier_ups;      // Hot procs switched to optimized code in the tiered mode, done in the background
+} NkIrModuleStats;
+
+NkIrModuleStats nkir_moduleGetStats(NkIrModule mod);
+
 /// Inspection
 
 void nkir_printName(NkStream out, char const *kind, NkAtom name);
@@ -1,20 +1,26 @@
 #include "nkb/ir.h"
 
+#include <assert.h>
+#include <inttypes.h>
+
 #include "common.h"
 #include "linker.h"
 #include "llvm_adapter.h"
+#include "obj_cache.h"
 #include "nkb/types.h"
 #include "ntk/arena.h"
 #include "ntk/atom.h"
 #include "ntk/common.h"
 #include "ntk/dyn_array.h"
 #include "ntk/error.h"
+#include "ntk/hash_tree.h"
 #include "ntk/log.h"
-#include "ntk/path.h"
 #include "ntk/profiler.h"
 #include "ntk/slice.h"
 #include "ntk/stream.h"
 #include "ntk/string.h"
+#include "ntk/string_builder.h"
+#include "ntk/thread.h"
 #include "ntk/utils.h"
 
 NK_LOG_USE_SCOPE(ir);
@@ -87,26 +93,62 @@ static bool isJumpInstr(u8 code) {
     }
 }
 
+NK_HASH_TREE_DEFINE_KV(SymbolIndexMap, NkAtom, usize, nk_atom_hash, nk_atom_equal);
+
+// Calls the proc with arguments and the result passed by pointer, see nkir_invoke
+typedef void (*InvokeThunk)(void **args, void **ret);
+
+NK_HASH_TREE_DEFINE_KV(InvokeThunkMap, NkAtom, InvokeThunk, nk_atom_hash, nk_atom_equal);
+
+typedef NkSlice(NkAtom const) NkAtomArray;
+typedef NkDynArray(NkAtom) NkAtomDynArray;
+
+typedef struct {
+    NkAtomArray deps; // Unique symbols referenced by the symbol, gathered on first use
+    bool deps_gathered;
+} SymbolInfo;
+
+typedef NkDynArray(SymbolInfo) SymbolInfoDynArray;
+
 typedef struct NkbState_T {
     NkArena arena;
-    NkArena scratch;
 
     NkLlvmState llvm;
     NkLlvmJitState _llvm_jit;
+    NkIrJitMode jit_mode;
+    usize codegen_threads;
+    NkObjCache obj_cache;
 
     NkDynArray(NkLlvmTarget) created_targets;
+    NkDynArray(NkIrModule) modules;
+
+    NkHandle mtx; // Guards the arena, the lists and the JIT creation, modules are built and run concurrently
 } NkbState_T;
 
 typedef struct NkIrModule_T {
     NkbState nkb;
+    NkArena arena;    // Holds the ir, used by the thread building the module
+    NkArena rt_arena; // Holds the runtime state, guarded by mtx
+
     NkIrSymbolDynArray syms;
+    SymbolInfoDynArray sym_infos; // Parallel to syms
+    SymbolIndexMap sym_index;     // Name to the index of its first definition in syms
 
     NkAtomSet rt_loaded_syms;
+    InvokeThunkMap invoke_thunks; // Proc name to its thunk, compiled on the first invoke
+
+    NkIrModuleStats stats;
 
     NkIrSymbolResolver sym_resolver_fn;
     void *sym_resolver_userdata;
 
+    NkIrOptProfile jit_opt;
+
     NkLlvmJitDylib _llvm_jit_dylib;
+
+    // Guards the runtime state and the symbols, as procs are compiled on the threads that first call them.
+    // Recursive, because building a symbol loads its dependencies, which may resolve through the same module
+    NkHandle mtx;
 } NkIrModule_T;
 
 NkbState nkir_createState(void) {
@@ -116,9 +158,12 @@ NkbState nkir_createState(void) {
     NkbState nkb = nk_arena_allocT(&arena, NkbState_T);
     *nkb = (NkbState_T){
         .arena = arena,
+        .codegen_threads = 1,
     };
     nkb->llvm = nk_llvm_createState(&nkb->arena);
     nkb->created_targets.alloc = nk_arena_getAllocator(&nkb->arena);
+    nkb->modules.alloc = nk_arena_getAllocator(&nkb->arena);
+    nkb->mtx = nk_mutex_alloc(0);
 
     return nkb;
 }
@@ -135,36 +180,86 @@ void nkir_freeState(NkbState nkb) {
     nk_llvm_freeJitState(nkb->_llvm_jit);
     nk_llvm_freeState(nkb->llvm);
 
-    nk_arena_free(&nkb->scratch);
+    nk_objcache_close(nkb->obj_cache);
+
+    NK_ITERATE(NkIrModule const *, it, nkb->modules) {
+        NkIrModule mod = *it;
+        nk_mutex_free(mod->mtx);
+        nk_arena_free(&mod->rt_arena);
+        nk_arena_free(&mod->arena);
+    }
+
+    nk_mutex_free(nkb->mtx);
 
     NkArena arena = nkb->arena;
     nk_arena_free(&arena);
 }
 
+void nkir_setJitMode(NkbState nkb, NkIrJitMode mode) {
+    TRY(nkb);
+
+    nkb->jit_mode = mode;
+}
+
+void nkir_setCodegenThreadCount(NkbState nkb, usize count) {
+    TRY(nkb);
+
+    nkb->codegen_threads = count ? count : nk_thread_hardwareConcurrency();
+}
+
+void nkir_setObjectCache(NkbState nkb, NkString dir, u64 max_size) {
+    NK_LOG_TRC("%s", __func__);
+
+    TRY(nkb);
+
+    nk_objcache_close(nkb->obj_cache);
+    nkb->obj_cache = dir.size ? nk_objcache_open(dir, max_size) : NULL;
+}
+
 NkIrModule nkir_createModule(NkbState nkb) {
     TRY(nkb, NULL);
 
-    NkIrModule mod = nk_arena_allocT(&nkb->arena, NkIrModule_T);
+    NkIrModule mod = NULL;
+    NK_MUTEX_GUARD_SCOPE(nkb->mtx) {
+        mod = nk_arena_allocT(&nkb->arena, NkIrModule_T);
+        nkda_append(&nkb->modules, mod);
+    }
+
     *mod = (NkIrModule_T){
         .nkb = nkb,
-        .syms = {.alloc = nk_arena_getAllocator(&nkb->arena)},
 
-        .rt_loaded_syms = {.alloc = nk_arena_getAllocator(&nkb->arena)},
+        .jit_opt = {.level = NkIrOpt_O3},
+
+        .mtx = nk_mutex_alloc(NkMutex_Recursive),
     };
+
+    mod->syms.alloc = nk_arena_getAllocator(&mod->arena);
+    mod->sym_infos.alloc = nk_arena_getAllocator(&mod->arena);
+    mod->sym_index = (SymbolIndexMap){NK_HASH_TREE_INIT(nk_arena_getAllocator(&mod->arena))};
+
+    mod->rt_loaded_syms.alloc = nk_arena_getAllocator(&mod->rt_arena);
+    mod->invoke_thunks = (InvokeThunkMap){NK_HASH_TREE_INIT(nk_arena_getAllocator(&mod->rt_arena))};
+
     return mod;
 }
 
-NkIrTarget nkir_createTarget(NkbState nkb, NkString triple) {
+NkIrTarget nkir_createTarget(NkbState nkb, NkString triple, NkIrTargetOpts opts) {
     NK_LOG_TRC("%s", __func__);
 
     TRY(nkb, NULL);
 
     NkLlvmTarget tgt = NULL;
-    NK_ARENA_SCOPE(&nkb->scratch) {
-        tgt = nk_llvm_createTarget(nkb->llvm, nk_tprintf(&nkb->scratch, NKS_FMT, NKS_ARG(triple)));
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        tgt = nk_llvm_createTarget(
+            nkb->llvm,
+            nk_tprintf(scratch, NKS_FMT, NKS_ARG(triple)),
+            nk_tprintf(scratch, NKS_FMT, NKS_ARG(opts.cpu)),
+            nk_tprintf(scratch, NKS_FMT, NKS_ARG(opts.features)));
     }
     if (tgt) {
-        nkda_append(&nkb->created_targets, tgt);
+        NK_MUTEX_GUARD_SCOPE(nkb->mtx) {
+            nkda_append(&nkb->created_targets, tgt);
+        }
     }
     return (NkIrTarget)tgt;
 }
@@ -172,43 +267,68 @@ NkIrTarget nkir_createTarget(NkbState nkb, NkString triple) {
 NkArena *nkir_moduleGetArena(NkIrModule mod) {
     TRY(mod, NULL);
 
-    return &mod->nkb->arena;
+    return &mod->arena;
+}
+
+NkIrModuleStats nkir_moduleGetStats(NkIrModule mod) {
+    TRY(mod, (NkIrModuleStats){0});
+
+    NkIrModuleStats stats = {0};
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        stats = mod->stats;
+    }
+    return stats;
+}
+
+void nkir_moduleSetJitOptProfile(NkIrModule mod, NkIrOptProfile opt) {
+    TRY(mod);
+
+    mod->jit_opt = (NkIrOptProfile){
+        .level = opt.level,
+        .passes = nks_copy(nk_arena_getAllocator(&mod->arena), opt.passes),
+    };
 }
 
 void nkir_moduleDefineSymbol(NkIrModule mod, NkIrSymbol const *sym) {
     TRY(mod && sym);
 
-    nkda_append(&mod->syms, *sym);
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        // Inserting doesn't overwrite, so lookups keep finding the first definition
+        SymbolIndexMap_insert(&mod->sym_index, sym->name, mod->syms.size);
+
+        nkda_append(&mod->syms, *sym);
+        nkda_append(&mod->sym_infos, (SymbolInfo){0});
+    }
 }
 
 NkIrRefDynArray nkir_moduleNewRefArray(NkIrModule mod) {
     TRY(mod, (NkIrRefDynArray){0});
 
-    return (NkIrRefDynArray){.alloc = nk_arena_getAllocator(&mod->nkb->arena)};
+    return (NkIrRefDynArray){.alloc = nk_arena_getAllocator(&mod->arena)};
 }
 
 NkIrInstrDynArray nkir_moduleNewInstrArray(NkIrModule mod) {
     TRY(mod, (NkIrInstrDynArray){0});
 
-    return (NkIrInstrDynArray){.alloc = nk_arena_getAllocator(&mod->nkb->arena)};
+    return (NkIrInstrDynArray){.alloc = nk_arena_getAllocator(&mod->arena)};
 }
 
 NkIrTypeDynArray nkir_moduleNewTypeArray(NkIrModule mod) {
     TRY(mod, (NkIrTypeDynArray){0});
 
-    return (NkIrTypeDynArray){.alloc = nk_arena_getAllocator(&mod->nkb->arena)};
+    return (NkIrTypeDynArray){.alloc = nk_arena_getAllocator(&mod->arena)};
 }
 
 NkIrParamDynArray nkir_moduleNewParamArray(NkIrModule mod) {
     TRY(mod, (NkIrParamDynArray){0});
 
-    return (NkIrParamDynArray){.alloc = nk_arena_getAllocator(&mod->nkb->arena)};
+    return (NkIrParamDynArray){.alloc = nk_arena_getAllocator(&mod->arena)};
 }
 
 NkIrRelocDynArray nkir_moduleNewRelocArray(NkIrModule mod) {
     TRY(mod, (NkIrRelocDynArray){0});
 
-    return (NkIrRelocDynArray){.alloc = nk_arena_getAllocator(&mod->nkb->arena)};
+    return (NkIrRelocDynArray){.alloc = nk_arena_getAllocator(&mod->arena)};
 }
 
 void nkir_setSymbolResolver(NkIrModule mod, NkIrSymbolResolver fn, void *userdata) {
@@ -226,15 +346,23 @@ NkIrSymbolArray nkir_moduleGetSymbols(NkIrModule mod) {
     return (NkIrSymbolArray){NKS_INIT(mod->syms)};
 }
 
-NkIrSymbol const *nkir_findSymbol(NkIrModule mod, NkAtom sym) {
-    TRY(mod, NULL);
+static NkIrSymbol const *findSymbol(NkIrModule mod, NkAtom sym) {
+    usize const *idx = SymbolIndexMap_find(&mod->sym_index, sym);
+    return idx ? &mod->syms.data[*idx] : NULL;
+}
 
-    NK_ITERATE(NkIrSymbol *, it, mod->syms) {
-        if (it->name == sym) {
-            return it;
+// Symbols are copied out under the lock, because the module may be extended while it runs on other threads
+bool nkir_findSymbol(NkIrModule mod, NkAtom sym_name, NkIrSymbol *out) {
+    TRY(mod && out, false);
+
+    NkIrSymbol const *sym = NULL;
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        sym = findSymbol(mod, sym_name);
+        if (sym) {
+            *out = *sym;
         }
     }
-    return NULL;
+    return sym;
 }
 
 void nkir_convertToPic(NkArena *scratch, NkIrInstrArray instrs, NkIrInstrDynArray *out) {
@@ -424,12 +552,281 @@ NkIrInstr nkir_make_comment(NkString comment) {
     };
 }
 
+static_assert((int)NkIrOpt_O0 == NkLlvmOptLevel_O0, "");
+static_assert((int)NkIrOpt_O1 == NkLlvmOptLevel_O1, "");
+static_assert((int)NkIrOpt_O2 == NkLlvmOptLevel_O2, "");
+static_assert((int)NkIrOpt_O3 == NkLlvmOptLevel_O3, "");
+static_assert((int)NkIrOpt_Os == NkLlvmOptLevel_Os, "");
+static_assert((int)NkIrOpt_Oz == NkLlvmOptLevel_Oz, "");
+
+static NkLlvmOptProfile llvmOptProfile(NkIrOptProfile opt) {
+    return (NkLlvmOptProfile){
+        .level = (NkLlvmOptLevel)opt.level,
+        .passes = opt.passes,
+    };
+}
+
+static NkAtomArray getSymbolDeps(NkArena *conflict, NkIrModule mod, usize sym_idx);
+static NkIrSymbol symToExtern(NkArena *arena, NkIrSymbol sym);
+
+#define NO_UNIT ((usize)-1)
+
+static bool isDefinition(NkIrSymbol const *sym) {
+    return sym->kind == NkIrSymbol_Proc || sym->kind == NkIrSymbol_Data;
+}
+
+static usize countDefinitions(NkIrModule mod) {
+    usize count = 0;
+    NK_ITERATE(NkIrSymbol const *, sym, mod->syms) {
+        count += isDefinition(sym);
+    }
+    return count;
+}
+
+static usize symbolWeight(NkIrSymbol const *sym) {
+    return sym->kind == NkIrSymbol_Proc ? sym->proc.instrs.size + 1 : 1;
+}
+
+// Index of the definition the name refers to, or NO_UNIT for externs
+static usize findDefinition(NkIrModule mod, NkAtom name) {
+    usize const *idx = SymbolIndexMap_find(&mod->sym_index, name);
+    return idx && isDefinition(&mod->syms.data[*idx]) ? *idx : NO_UNIT;
+}
+
+// Assigns definitions to units of roughly equal size. Units are grown along the references
+// starting from the first unassigned symbol, so that callees mostly end up next to their callers.
+static usize *partitionSymbols(NkArena *scratch, NkIrModule mod, usize unit_count) {
+    usize const sym_count = mod->syms.size;
+
+    usize *unit_of = nk_arena_allocTn(scratch, usize, sym_count);
+    usize total_weight = 0;
+    for (usize i = 0; i < sym_count; i++) {
+        unit_of[i] = NO_UNIT;
+        if (isDefinition(&mod->syms.data[i])) {
+            total_weight += symbolWeight(&mod->syms.data[i]);
+        }
+    }
+
+    usize const unit_weight = (total_weight + unit_count - 1) / unit_count;
+
+    usize unit = 0;
+    usize weight = 0;
+
+    NK_SCRATCH_SCOPE(queue_arena, scratch) {
+        NkDynArray(usize) queue = {.alloc = nk_arena_getAllocator(queue_arena)};
+
+        for (usize seed = 0; seed < sym_count; seed++) {
+            if (unit_of[seed] != NO_UNIT || findDefinition(mod, mod->syms.data[seed].name) != seed) {
+                continue;
+            }
+
+            nkda_clear(&queue);
+            nkda_append(&queue, seed);
+
+            for (usize head = 0; head < queue.size; head++) {
+                usize const idx = queue.data[head];
+                if (unit_of[idx] != NO_UNIT) {
+                    continue;
+                }
+
+                if (weight >= unit_weight && unit + 1 < unit_count) {
+                    unit++;
+                    weight = 0;
+                }
+
+                unit_of[idx] = unit;
+                weight += symbolWeight(&mod->syms.data[idx]);
+
+                NkAtomArray const deps = getSymbolDeps(queue_arena, mod, idx);
+                NK_ITERATE(NkAtom const *, dep, deps) {
+                    usize const dep_idx = findDefinition(mod, *dep);
+                    if (dep_idx != NO_UNIT && unit_of[dep_idx] == NO_UNIT) {
+                        nkda_append(&queue, dep_idx);
+                    }
+                }
+            }
+        }
+    }
+
+    // Redefinitions stay with the definition their name refers to
+    for (usize i = 0; i < sym_count; i++) {
+        if (unit_of[i] == NO_UNIT && isDefinition(&mod->syms.data[i])) {
+            unit_of[i] = unit_of[findDefinition(mod, mod->syms.data[i].name)];
+        }
+    }
+
+    return unit_of;
+}
+
+static NkLlvmCodegenUnit *buildCodegenUnits(NkArena *scratch, NkIrModule mod, usize unit_count) {
+    usize const sym_count = mod->syms.size;
+
+    usize const *unit_of = partitionSymbols(scratch, mod, unit_count);
+
+    // Local symbols referenced from other units have to be visible to the linker
+    bool *exported = nk_arena_allocTn(scratch, bool, sym_count);
+    memset(exported, 0, sym_count * sizeof(bool));
+    for (usize i = 0; i < sym_count; i++) {
+        if (unit_of[i] != NO_UNIT) {
+            NkAtomArray const deps = getSymbolDeps(scratch, mod, i);
+            NK_ITERATE(NkAtom const *, dep, deps) {
+                usize const dep_idx = findDefinition(mod, *dep);
+                if (dep_idx != NO_UNIT && unit_of[dep_idx] != unit_of[i]) {
+                    exported[dep_idx] = true;
+                }
+            }
+        }
+    }
+
+    NkLlvmCodegenUnit *units = nk_arena_allocTn(scratch, NkLlvmCodegenUnit, unit_count);
+
+    for (usize unit = 0; unit < unit_count; unit++) {
+        NkIrSymbolDynArray syms = {.alloc = nk_arena_getAllocator(scratch)};
+        NkAtomSet declared = {.alloc = nk_arena_getAllocator(scratch)};
+
+        for (usize i = 0; i < sym_count; i++) {
+            if (unit_of[i] == unit) {
+                NkIrSymbol sym = mod->syms.data[i];
+                if (exported[i] && (sym.vis == NkIrVisibility_Local || sym.vis == NkIrVisibility_Internal)) {
+                    sym.vis = NkIrVisibility_Hidden;
+                }
+                nkda_append(&syms, sym);
+                NkAtomSet_insert(&declared, sym.name);
+            }
+        }
+
+        for (usize i = 0; i < sym_count; i++) {
+            if (unit_of[i] != unit) {
+                continue;
+            }
+
+            NkAtomArray const deps = getSymbolDeps(scratch, mod, i);
+            NK_ITERATE(NkAtom const *, dep, deps) {
+                if (!NkAtomSet_find(&declared, *dep)) {
+                    NkAtomSet_insert(&declared, *dep);
+
+                    NkIrSymbol const *dep_sym = findSymbol(mod, *dep);
+                    nk_assert(dep_sym && "symbol not found, invalid ir");
+                    nkda_append(&syms, isDefinition(dep_sym) ? symToExtern(scratch, *dep_sym) : *dep_sym);
+                }
+            }
+        }
+
+        units[unit] = (NkLlvmCodegenUnit){
+            .ir = {NKS_INIT(syms)},
+        };
+    }
+
+    return units;
+}
+
+static void printTypeLayout(NkStream out, NkIrType type) {
+    if (!type) {
+        nk_printf(out, " -");
+        return;
+    }
+
+    nk_printf(out, " %d:%" PRIu64 ":%" PRIu32, (int)type->kind, type->size, type->align);
+    if (type->kind == NkIrType_Aggregate) {
+        nk_printf(out, "{");
+        NK_ITERATE(NkIrAggregateElemInfo const *, elem, type->aggr) {
+            nk_printf(out, " [%" PRIu32 "]@%" PRIu32, elem->count, elem->offset);
+            printTypeLayout(out, elem->type);
+        }
+        nk_printf(out, " }");
+    } else {
+        nk_printf(out, ":%d", (int)type->num);
+    }
+}
+
+// The dump shows types by their elements only, so the layout of every type the symbol uses is printed separately
+static void printSymbolLayouts(NkStream out, NkIrSymbol const *sym) {
+    nk_printf(out, "layouts");
+
+    switch (sym->kind) {
+        case NkIrSymbol_Proc:
+            NK_ITERATE(NkIrParam const *, param, sym->proc.params) {
+                printTypeLayout(out, param->type);
+            }
+            printTypeLayout(out, sym->proc.ret.type);
+
+            NK_ITERATE(NkIrInstr const *, instr, sym->proc.instrs) {
+                for (usize i = 0; i < NK_ARRAY_COUNT(instr->arg); i++) {
+                    NkIrArg const *arg = &instr->arg[i];
+                    if (arg->kind == NkIrArg_Ref) {
+                        printTypeLayout(out, arg->ref.type);
+                    } else if (arg->kind == NkIrArg_RefArray) {
+                        NK_ITERATE(NkIrRef const *, ref, arg->refs) {
+                            printTypeLayout(out, ref->type);
+                        }
+                    } else if (arg->kind == NkIrArg_Type) {
+                        printTypeLayout(out, arg->type);
+                    }
+                }
+            }
+            break;
+
+        case NkIrSymbol_Data:
+            printTypeLayout(out, sym->data.type);
+            break;
+
+        case NkIrSymbol_Extern:
+            if (sym->extrn.kind == NkIrExtern_Proc) {
+                NK_ITERATE(NkIrType const *, type, sym->extrn.proc.param_types) {
+                    printTypeLayout(out, *type);
+                }
+                printTypeLayout(out, sym->extrn.proc.ret_type);
+            } else {
+                printTypeLayout(out, sym->extrn.data.type);
+            }
+            break;
+
+        case NkIrSymbol_None:
+            break;
+    }
+
+    nk_printf(out, "\n");
+}
+
+// Object code depends only on the ir of the symbols, the target and the opt profile,
+// so the key hashes their textual dump with the version of LLVM that produces the code
+static NkObjCacheKey objCacheKey(
+    NkArena *scratch,
+    NkIrSymbolArray syms,
+    NkLlvmTarget tgt,
+    NkIrOptProfile opt,
+    char const *kind) {
+    NkStringBuilder sb = {.alloc = nk_arena_getAllocator(scratch)};
+    NkStream out = nksb_getStream(&sb);
+
+    nk_printf(out, "nkb2 obj v2 %s\n", kind);
+    nk_llvm_inspectTarget(out, tgt);
+    nk_printf(out, "\nopt %d passes " NKS_FMT "\n", (int)opt.level, NKS_ARG(opt.passes));
+
+    NK_ITERATE(NkIrSymbol const *, sym, syms) {
+        // Attributes not shown by the dump
+        nk_printf(out, "sym %d %d %u", (int)sym->kind, (int)sym->vis, (unsigned)sym->flags);
+        if (sym->kind == NkIrSymbol_Proc) {
+            nk_printf(out, " %u", (unsigned)sym->proc.flags);
+        } else if (sym->kind == NkIrSymbol_Data) {
+            nk_printf(out, " %u", (unsigned)sym->data.flags);
+        }
+        nk_printf(out, "\n");
+        printSymbolLayouts(out, sym);
+
+        nkir_inspectSymbol(out, scratch, sym);
+    }
+
+    return nk_objcache_key((NkString){NKS_INIT(sb)});
+}
+
 static bool exportModuleImpl(
     NkArena *scratch,
     NkIrModule mod,
     NkIrTarget target,
     NkString out_file,
-    NkIrOutputKind kind) {
+    NkIrOutputKind kind,
+    NkIrOptProfile opt) {
     NK_LOG_TRC("%s", __func__);
 
     NkbState nkb = mod->nkb;
@@ -455,93 +852,120 @@ static bool exportModuleImpl(
         out_file = nk_tsprintf(scratch, NKS_FMT "%s", NKS_ARG(out_file), file_ext);
     }
 
-    char tmp_path[NK_MAX_PATH];
-    if (nk_getTempPath(tmp_path, sizeof(tmp_path)) < 0) {
-        nk_error_printf("Failed to get temporary directory path: %s", nk_getLastErrorString());
-        return false;
+    NkLlvmTarget tgt = (NkLlvmTarget)target;
+
+    usize unit_count = 1;
+    NkLlvmCodegenUnit *units = NULL;
+
+    // Units are built from a snapshot of the symbols, so that other threads can keep defining them during codegen
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        unit_count = nk_maxu(nk_minu(nkb->codegen_threads, countDefinitions(mod)), 1);
+
+        if (unit_count > 1) {
+            units = buildCodegenUnits(scratch, mod, unit_count);
+        } else {
+            NkIrSymbol *syms = nk_arena_allocTn(scratch, NkIrSymbol, mod->syms.size);
+            memcpy(syms, mod->syms.data, mod->syms.size * sizeof(NkIrSymbol));
+
+            units = nk_arena_allocT(scratch, NkLlvmCodegenUnit);
+            *units = (NkLlvmCodegenUnit){.ir = {syms, mod->syms.size}};
+        }
     }
 
-    // TODO: Generate temporary file more rebustly, and cleanup
-    NkString obj_file = kind == NkIrOutput_Object
-                            ? nk_tsprintf(scratch, NKS_FMT, NKS_ARG(out_file))
-                            : nk_tsprintf(scratch, "%s" NKS_FMT ".o", tmp_path, NKS_ARG(out_file));
+    // Units found in the cache are loaded from it, the rest are compiled and stored
+    NkObjCacheKey *keys = nk_arena_allocTn(scratch, NkObjCacheKey, unit_count);
+    NkDynArray(NkLlvmCodegenUnit) misses = {.alloc = nk_arena_getAllocator(scratch)};
+    NkDynArray(usize) miss_indices = {.alloc = nk_arena_getAllocator(scratch)};
 
-    NkLlvmTarget tgt = (NkLlvmTarget)target;
+    for (usize i = 0; i < unit_count; i++) {
+        if (nkb->obj_cache) {
+            keys[i] = objCacheKey(scratch, units[i].ir, tgt, opt, "export");
+            if (nk_objcache_load(nkb->obj_cache, nk_default_allocator, keys[i], &units[i].obj)) {
+                continue;
+            }
+        }
 
-    NkLlvmModule llvm_mod = nk_llvm_compilerIr(scratch, nkb->llvm, (NkIrSymbolArray){NKS_INIT(mod->syms)});
-    nk_llvm_optimizeIr(scratch, llvm_mod, tgt, NkLlvmOptLevel_O3); // TODO: Hardcoded opt level
+        nkda_append(&misses, units[i]);
+        nkda_append(&miss_indices, i);
+    }
 
-    TRY(nk_llvm_emitObjectFile(llvm_mod, tgt, obj_file), false);
+    bool ret = true;
 
-    if (kind != NkIrOutput_None && kind != NkIrOutput_Object) {
-        nk_link((NkLikerOpts){
+    if (misses.size > 1) {
+        ret = nk_llvm_emitObjectsParallel(tgt, llvmOptProfile(opt), (NkLlvmCodegenUnitArray){NKS_INIT(misses)});
+    } else if (misses.size == 1) {
+        NkLlvmModule llvm_mod = nk_llvm_compilerIr(scratch, nkb->llvm, misses.data[0].ir);
+        ret = nk_llvm_optimizeIr(scratch, llvm_mod, tgt, llvmOptProfile(opt)) &&
+              nk_llvm_emitObject(llvm_mod, tgt, nk_default_allocator, &misses.data[0].obj);
+        nk_llvm_freeModule(llvm_mod);
+    }
+
+    for (usize i = 0; i < misses.size; i++) {
+        usize const unit_idx = miss_indices.data[i];
+        units[unit_idx].obj = misses.data[i].obj;
+
+        if (ret && nkb->obj_cache) {
+            nk_objcache_store(nkb->obj_cache, keys[unit_idx], units[unit_idx].obj);
+        }
+    }
+
+    // Objects are passed to the linker in memory, it only touches the disk when it has to
+    NkString *objs = nk_arena_allocTn(scratch, NkString, unit_count);
+    for (usize i = 0; i < unit_count; i++) {
+        objs[i] = units[i].obj;
+    }
+
+    if (ret && kind != NkIrOutput_None) {
+        ret = nk_link((NkLikerOpts){
             .scratch = scratch,
             .out_kind = kind,
-            .obj_file = obj_file,
+            .objs = {objs, unit_count},
             .out_file = out_file,
         });
     }
 
-    return true;
+    for (usize i = 0; i < unit_count; i++) {
+        nk_free(nk_default_allocator, (void *)objs[i].data, objs[i].size);
+    }
+
+    return ret;
 }
 
-bool nkir_exportModule(NkIrModule mod, NkIrTarget target, NkString out_file, NkIrOutputKind kind) {
+bool nkir_exportModule(NkIrModule mod, NkIrTarget target, NkString out_file, NkIrOutputKind kind, NkIrOptProfile opt) {
     NK_LOG_TRC("%s", __func__);
 
     TRY(mod && target, false);
 
     bool ret = false;
-    NkbState nkb = mod->nkb;
-    NkArena *scratch = &nkb->scratch;
-    NK_ARENA_SCOPE(scratch) {
-        ret = exportModuleImpl(scratch, mod, target, out_file, kind);
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ret = exportModuleImpl(scratch, mod, target, out_file, kind, opt);
     }
     return ret;
 }
 
-bool nkir_invoke(NkIrModule mod, NkAtom sym, void **args, void **ret) {
-    NK_LOG_TRC("%s", __func__);
-
-    TRY(mod, false);
-
-    (void)mod;
-    (void)sym;
-    (void)args;
-    (void)ret;
-    nk_assert(!"TODO: `nkir_invoke` not implemented");
-    return false;
-}
-
 static NkLlvmJitState getLlvmJitState(NkbState nkb) {
-    if (!nkb->_llvm_jit) {
-        nkb->_llvm_jit = nk_llvm_createJitState(nkb->llvm);
+    NkLlvmJitState jit = NULL;
+    NK_MUTEX_GUARD_SCOPE(nkb->mtx) {
+        if (!nkb->_llvm_jit) {
+            nkb->_llvm_jit = nk_llvm_createJitState(nkb->llvm);
+        }
+        jit = nkb->_llvm_jit;
     }
-    return nkb->_llvm_jit;
+    return jit;
 }
 
 static NkLlvmJitDylib getLlvmJitDylib(NkIrModule mod) {
-    if (!mod->_llvm_jit_dylib) {
-        NkbState nkb = mod->nkb;
-        mod->_llvm_jit_dylib = nk_llvm_createJitDylib(nkb->llvm, getLlvmJitState(nkb));
-    }
-    return mod->_llvm_jit_dylib;
-}
-
-static void collectSymbols(NkIrModule mod, _NkAtomSet_Node *node, NkIrSymbolDynArray *out) {
-    if (!node) {
-        return;
+    NkLlvmJitDylib jdl = NULL;
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        if (!mod->_llvm_jit_dylib) {
+            NkbState nkb = mod->nkb;
+            mod->_llvm_jit_dylib = nk_llvm_createJitDylib(nkb->llvm, getLlvmJitState(nkb));
+        }
+        jdl = mod->_llvm_jit_dylib;
     }
-
-    NkIrSymbol const *sym = nkir_findSymbol(mod, node->item);
-    nk_assert(sym && "symbol not found, invalid ir");
-    nkda_append(out, *sym);
-
-    collectSymbols(mod, node->child[0], out);
-    collectSymbols(mod, node->child[1], out);
+    return jdl;
 }
 
-typedef NkDynArray(NkAtom) NkAtomDynArray;
-
 static void gatherDeps(NkIrSymbol const *sym, NkAtomDynArray *out) {
     switch (sym->kind) {
         case NkIrSymbol_Proc:
@@ -586,34 +1010,71 @@ static void gatherDeps(NkIrSymbol const *sym, NkAtomDynArray *out) {
     }
 }
 
-static void getSymbolDependencies(NkIrModule mod, NkAtom sym_name, NkIrSymbolDynArray *out) {
+static NkAtomArray getSymbolDeps(NkArena *conflict, NkIrModule mod, usize sym_idx) {
+    NkAtomArray deps = {0};
+
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        SymbolInfo *info = &mod->sym_infos.data[sym_idx];
+
+        if (!info->deps_gathered) {
+            NK_SCRATCH_SCOPE(scratch, conflict) {
+                NkAtomDynArray all_deps = {.alloc = nk_arena_getAllocator(scratch)};
+                gatherDeps(&mod->syms.data[sym_idx], &all_deps);
+
+                NkAtomSet seen = {.alloc = nk_arena_getAllocator(scratch)};
+                usize dep_count = 0;
+
+                NK_ITERATE(NkAtom const *, dep, all_deps) {
+                    if (!NkAtomSet_find(&seen, *dep)) {
+                        NkAtomSet_insert(&seen, *dep);
+                        all_deps.data[dep_count++] = *dep;
+                    }
+                }
+
+                NkAtom *unique_deps = nk_arena_allocTn(&mod->rt_arena, NkAtom, dep_count);
+                memcpy(unique_deps, all_deps.data, dep_count * sizeof(NkAtom));
+
+                info->deps = (NkAtomArray){unique_deps, dep_count};
+            }
+
+            info->deps_gathered = true;
+        }
+
+        deps = info->deps;
+    }
+
+    return deps;
+}
+
+static void getSymbolDependencies(NkArena *out_arena, NkIrModule mod, NkAtom sym_name, NkIrSymbolDynArray *out) {
     NK_LOG_TRC("%s", __func__);
 
     NK_PROF_FUNC() {
         NK_LOG_DBG("Getting dependencies for `%s`", nk_atom2cs(sym_name));
 
-        NkbState nkb = mod->nkb;
-        NkArena *scratch = &nkb->scratch;
+        NK_SCRATCH_SCOPE(scratch, out_arena) {
+            NkAtomDynArray stack = {.alloc = nk_arena_getAllocator(scratch)};
+            NkAtomSet visited = {.alloc = nk_arena_getAllocator(scratch)};
+
+            nkda_append(&stack, sym_name);
 
-        NkAtomDynArray stack = {.alloc = nk_arena_getAllocator(scratch)};
-        NkAtomSet deps = {.alloc = nk_arena_getAllocator(scratch)};
+            while (stack.size) {
+                NkAtom const sym_name = nks_last(stack);
+                nkda_pop(&stack, 1);
 
-        nkda_append(&stack, sym_name);
+                if (!NkAtomSet_find(&visited, sym_name)) {
+                    NkAtomSet_insert(&visited, sym_name);
 
-        while (stack.size) {
-            NkAtom const sym_name = nks_last(stack);
-            nkda_pop(&stack, 1);
+                    usize const *idx = SymbolIndexMap_find(&mod->sym_index, sym_name);
+                    nk_assert(idx && "symbol not found, invalid ir");
 
-            if (!NkAtomSet_find(&deps, sym_name)) {
-                NkAtomSet_insert(&deps, sym_name);
+                    nkda_append(out, mod->syms.data[*idx]);
 
-                NkIrSymbol const *sym = nkir_findSymbol(mod, sym_name);
-                nk_assert(sym && "symbol not found, invalid ir");
-                gatherDeps(sym, &stack);
+                    NkAtomArray const deps = getSymbolDeps(scratch, mod, *idx);
+                    nkda_appendMany(&stack, deps.data, deps.size);
+                }
             }
         }
-
-        collectSymbols(mod, deps.root, out);
     }
 }
 
@@ -667,11 +1128,208 @@ static NkIrSymbol symToExtern(NkArena *arena, NkIrSymbol sym) {
     return sym;
 }
 
-static void *getSymbolAddressImpl(NkArena *scratch, NkIrModule mod, NkAtom sym_name) {
+// Number of calls and loop iterations after which a proc is recompiled with optimizations in the tiered mode
+#define TIER_UP_THRESHOLD 1000
+
+static bool loadSymbolLazy(NkArena *scratch, NkIrModule mod, NkAtom sym_name);
+
+static void countPromotion(NkAtom NK_UNUSED sym_name, void *userdata) {
+    NkIrModule mod = userdata;
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        mod->stats.tier_ups++;
+    }
+}
+
+static NkLlvmSymbolBuild buildLazySymbol(NkAtom sym_name, void *userdata) {
+    NkIrModule mod = userdata;
     NkbState nkb = mod->nkb;
 
+    NkLlvmSymbolBuild build = {0};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        NkIrSymbol sym = {0};
+        NkAtomArray deps = {0};
+        NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+            usize const *idx = SymbolIndexMap_find(&mod->sym_index, sym_name);
+            nk_assert(idx && "symbol not found, invalid ir");
+
+            sym = mod->syms.data[*idx];
+            deps = getSymbolDeps(scratch, mod, *idx);
+        }
+
+        NkIrSymbolDynArray syms = {.alloc = nk_arena_getAllocator(scratch)};
+
+        // Every symbol lives in a module of its own, so it has to be visible to the others
+        sym.vis = NkIrVisibility_Default;
+        nkda_append(&syms, sym);
+
+        bool deps_loaded = true;
+
+        NK_ITERATE(NkAtom const *, dep, deps) {
+            if (*dep != sym_name) {
+                NkIrSymbol dep_sym = {0};
+                if (!loadSymbolLazy(scratch, mod, *dep) || !nkir_findSymbol(mod, *dep, &dep_sym)) {
+                    deps_loaded = false;
+                    break;
+                }
+                nkda_append(&syms, symToExtern(scratch, dep_sym));
+            }
+        }
+
+        if (deps_loaded) {
+            NkIrSymbolArray const ir = {NKS_INIT(syms)};
+
+            // Tiered code calls back into the process, so only plain lazy code can be reused across runs
+            if (nkb->obj_cache && nkb->jit_mode == NkIrJit_Lazy) {
+                NkLlvmTarget tgt = nk_llvm_getJitTarget(getLlvmJitState(nkb));
+
+                build.cache = nkb->obj_cache;
+                build.key = objCacheKey(scratch, ir, tgt, mod->jit_opt, "lazy");
+
+                nk_objcache_load(build.cache, nk_default_allocator, build.key, &build.obj);
+            }
+
+            if (!build.obj.size) {
+                build.module = nk_llvm_compilerIr(scratch, nkb->llvm, ir);
+            }
+        }
+    }
+
+    return build;
+}
+
+static void *resolveExtern(NkIrModule mod, NkAtom sym_name) {
+    nk_assert(mod->sym_resolver_fn && "Symbol resolver is not set up");
+
+    return mod->sym_resolver_fn(sym_name, mod->sym_resolver_userdata);
+}
+
+// Registers the symbol with the JIT without compiling it, its dependencies are registered once it gets built
+static bool loadSymbolLazy(NkArena *scratch, NkIrModule mod, NkAtom sym_name) {
+    NkIrSymbolKind kind = NkIrSymbol_None;
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        if (!NkAtomSet_find(&mod->rt_loaded_syms, sym_name)) {
+            NkIrSymbol const *sym = findSymbol(mod, sym_name);
+            nk_assert(sym && "symbol not found, invalid ir");
+
+            kind = sym->kind;
+        }
+    }
+
+    if (kind == NkIrSymbol_None) {
+        return true;
+    }
+
+    // Externs are resolved without the lock, the resolver may look up symbols of modules built on other threads
+    void *extern_addr = NULL;
+    if (kind == NkIrSymbol_Extern) {
+        extern_addr = resolveExtern(mod, sym_name);
+        if (!extern_addr) {
+            nk_error_printf("Failed to get address of `%s`", nk_atom2cs(sym_name));
+            return false;
+        }
+    }
+
+    NkbState nkb = mod->nkb;
+    NkLlvmJitState jit = getLlvmJitState(nkb);
+    NkLlvmJitDylib jdl = getLlvmJitDylib(mod);
+
+    bool ret = true;
+
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        // Another thread might have loaded the symbol in the meantime
+        if (!NkAtomSet_find(&mod->rt_loaded_syms, sym_name)) {
+            switch (kind) {
+                case NkIrSymbol_Proc:
+                case NkIrSymbol_Data:
+                    ret = nk_llvm_defineLazySymbol(
+                        &mod->rt_arena,
+                        jit,
+                        jdl,
+                        (NkLlvmLazySymbol){
+                            .sym = sym_name,
+                            .is_proc = kind == NkIrSymbol_Proc,
+                            .opt = llvmOptProfile(mod->jit_opt),
+                            .hot_threshold = nkb->jit_mode == NkIrJit_Tiered ? TIER_UP_THRESHOLD : 0,
+                            .build_fn = buildLazySymbol,
+                            .promoted_fn = countPromotion,
+                            .userdata = mod,
+                        });
+                    break;
+
+                case NkIrSymbol_Extern: {
+                    NkIrSymbolAddress const sym_addr = {
+                        .sym = sym_name,
+                        .addr = extern_addr,
+                    };
+                    ret = nk_llvm_defineExternSymbols(scratch, jit, jdl, (NkIrSymbolAddressArray){&sym_addr, 1});
+                    break;
+                }
+
+                case NkIrSymbol_None:
+                    break;
+            }
+
+            if (ret) {
+                NkAtomSet_insert(&mod->rt_loaded_syms, sym_name);
+            }
+        }
+    }
+
+    return ret;
+}
+
+static bool jitSymbolsEager(NkArena *scratch, NkIrModule mod, NkIrSymbolArray ir) {
+    NkbState nkb = mod->nkb;
+    NkLlvmJitState jit = getLlvmJitState(nkb);
+    NkLlvmJitDylib jdl = getLlvmJitDylib(mod);
+
+    if (!nkb->obj_cache) {
+        NkLlvmModule llvm_mod = nk_llvm_compilerIr(scratch, nkb->llvm, ir);
+        TRY(llvm_mod, false);
+
+        NkLlvmTarget tgt = nk_llvm_acquireJitTarget(jit);
+        nk_llvm_optimizeIr(scratch, llvm_mod, tgt, llvmOptProfile(mod->jit_opt));
+        nk_llvm_releaseJitTarget(jit, tgt);
+
+        return nk_llvm_jitModule(llvm_mod, jit, jdl);
+    }
+
+    NkObjCacheKey const key = objCacheKey(scratch, ir, nk_llvm_getJitTarget(jit), mod->jit_opt, "eager");
+    NkAllocator const alloc = nk_arena_getAllocator(scratch);
+
+    NkString obj = {0};
+    if (!nk_objcache_load(nkb->obj_cache, alloc, key, &obj)) {
+        NkLlvmModule llvm_mod = nk_llvm_compilerIr(scratch, nkb->llvm, ir);
+        TRY(llvm_mod, false);
+
+        NkLlvmTarget tgt = nk_llvm_acquireJitTarget(jit);
+        bool const compiled = nk_llvm_optimizeIr(scratch, llvm_mod, tgt, llvmOptProfile(mod->jit_opt)) &&
+                              nk_llvm_emitObject(llvm_mod, tgt, alloc, &obj);
+        nk_llvm_releaseJitTarget(jit, tgt);
+
+        nk_llvm_freeModule(llvm_mod);
+        TRY(compiled, false);
+
+        nk_objcache_store(nkb->obj_cache, key, obj);
+    }
+
+    return nk_llvm_jitObject(jit, jdl, obj);
+}
+
+// Compiles the symbol along with its dependencies that are not loaded yet
+static bool loadSymbolEager(NkArena *scratch, NkIrModule mod, NkAtom sym_name) {
     NkIrSymbolDynArray deps = {.alloc = nk_arena_getAllocator(scratch)};
-    getSymbolDependencies(mod, sym_name, &deps);
+    NkAtomDynArray externs = {.alloc = nk_arena_getAllocator(scratch)};
+
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        getSymbolDependencies(scratch, mod, sym_name, &deps);
+
+        NK_ITERATE(NkIrSymbol const *, dep, deps) {
+            if (dep->kind == NkIrSymbol_Extern && !NkAtomSet_find(&mod->rt_loaded_syms, dep->name)) {
+                nkda_append(&externs, dep->name);
+            }
+        }
+    }
 
     NK_LOG_STREAM_DBG {
         NkStream log = nk_log_getStream();
@@ -685,51 +1343,167 @@ static void *getSymbolAddressImpl(NkArena *scratch, NkIrModule mod, NkAtom sym_n
         nk_printf(log, " ]");
     }
 
-    NkIrSymbolAddressDynArray to_define = {.alloc = nk_arena_getAllocator(scratch)};
+    // Externs are resolved without the lock, the resolver may look up symbols of modules built on other threads
+    NkIrSymbolAddressDynArray resolved = {.alloc = nk_arena_getAllocator(scratch)};
 
-    NK_ITERATE(NkIrSymbol *, dep, deps) {
-        if (NkAtomSet_find(&mod->rt_loaded_syms, dep->name)) {
-            if (dep->kind == NkIrSymbol_Proc || dep->kind == NkIrSymbol_Data) {
-                *dep = symToExtern(scratch, *dep);
+    NK_ITERATE(NkAtom const *, name, externs) {
+        void *addr = resolveExtern(mod, *name);
+        if (!addr) {
+            nk_error_printf(
+                "Failed to get address of `%s`, dependency `%s` not found",
+                nk_atom2cs(sym_name),
+                nk_atom2cs(*name));
+            return false;
+        }
+
+        nkda_append(
+            &resolved,
+            ((NkIrSymbolAddress){
+                .sym = *name,
+                .addr = addr,
+            }));
+    }
+
+    NkbState nkb = mod->nkb;
+
+    bool ret = true;
+
+    // Marking and compiling happen under one lock, so that no thread looks up a symbol marked, but not yet compiled.
+    // Symbols are only marked once they are defined in the JIT, so that a retry after a failure loads them again.
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        NkIrSymbolAddressDynArray to_define = {.alloc = nk_arena_getAllocator(scratch)};
+        NK_ITERATE(NkIrSymbolAddress const *, it, resolved) {
+            if (!NkAtomSet_find(&mod->rt_loaded_syms, it->sym)) {
+                nkda_append(&to_define, *it);
             }
-        } else {
-            NkAtomSet_insert(&mod->rt_loaded_syms, dep->name);
-
-            if (dep->kind == NkIrSymbol_Extern) {
-                nk_assert(mod->sym_resolver_fn && "Symbol resolver is not set up");
-
-                void *addr = mod->sym_resolver_fn(dep->name, mod->sym_resolver_userdata);
-                if (!addr) {
-                    nk_error_printf(
-                        "Failed to get address of `%s`, dependency `%s` not found",
-                        nk_atom2cs(sym_name),
-                        nk_atom2cs(dep->name));
-                    return NULL;
+        }
+
+        bool has_definitions = false;
+        NK_ITERATE(NkIrSymbol *, dep, deps) {
+            if (dep->kind == NkIrSymbol_Proc || dep->kind == NkIrSymbol_Data) {
+                if (NkAtomSet_find(&mod->rt_loaded_syms, dep->name)) {
+                    *dep = symToExtern(scratch, *dep);
+                } else {
+                    has_definitions = true;
                 }
+            }
+        }
 
-                nkda_append(
-                    &to_define,
-                    ((NkIrSymbolAddress){
-                        .sym = dep->name,
-                        .addr = addr,
-                    }));
+        ret = nk_llvm_defineExternSymbols(
+            scratch, getLlvmJitState(nkb), getLlvmJitDylib(mod), (NkIrSymbolAddressArray){NKS_INIT(to_define)});
+        if (ret) {
+            NK_ITERATE(NkIrSymbolAddress const *, it, to_define) {
+                NkAtomSet_insert(&mod->rt_loaded_syms, it->sym);
+            }
+        }
+
+        if (ret && has_definitions) {
+            ret = jitSymbolsEager(scratch, mod, (NkIrSymbolArray){NKS_INIT(deps)});
+        }
+        if (ret) {
+            NK_ITERATE(NkIrSymbol const *, dep, deps) {
+                if (dep->kind == NkIrSymbol_Proc || dep->kind == NkIrSymbol_Data) {
+                    NkAtomSet_insert(&mod->rt_loaded_syms, dep->name);
+                }
             }
         }
     }
 
+    return ret;
+}
+
+static void *getSymbolAddressImpl(NkArena *scratch, NkIrModule mod, NkAtom sym_name) {
+    NkbState nkb = mod->nkb;
+
+    if (nkb->jit_mode == NkIrJit_Lazy || nkb->jit_mode == NkIrJit_Tiered) {
+        // Procs resolve to stubs that compile them on the first call
+        TRY(loadSymbolLazy(scratch, mod, sym_name), NULL);
+    } else {
+        TRY(loadSymbolEager(scratch, mod, sym_name), NULL);
+    }
+
+    // Looking up without the lock, as the lookup may wait for a symbol being compiled on another thread
+    return nk_llvm_getSymbolAddress(getLlvmJitState(nkb), getLlvmJitDylib(mod), sym_name);
+}
+
+static InvokeThunk getInvokeThunk(NkArena *scratch, NkIrModule mod, NkAtom sym_name) {
+    InvokeThunk thunk = NULL;
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        InvokeThunk const *found = InvokeThunkMap_find(&mod->invoke_thunks, sym_name);
+        if (found) {
+            thunk = *found;
+        }
+    }
+    if (thunk) {
+        return thunk;
+    }
+
+    NkIrSymbol sym = {0};
+    if (!nkir_findSymbol(mod, sym_name, &sym)) {
+        nk_error_printf("Symbol not found: %s", nk_atom2cs(sym_name));
+        return NULL;
+    }
+
+    NkIrSymbol const proc = symToExtern(scratch, sym);
+    if (proc.kind != NkIrSymbol_Extern || proc.extrn.kind != NkIrExtern_Proc) {
+        nk_error_printf("Cannot invoke `%s`, it is not a proc", nk_atom2cs(sym_name));
+        return NULL;
+    }
+    if (proc.extrn.proc.flags & NkIrProc_Variadic) {
+        nk_error_printf("Cannot invoke `%s`, variadic procs are not supported", nk_atom2cs(sym_name));
+        return NULL;
+    }
+
+    // Loads the proc along with its dependencies, so that the thunk only needs to reference it
+    TRY(getSymbolAddressImpl(scratch, mod, sym_name), NULL);
+
+    NkStringBuilder thunk_name = {.alloc = nk_arena_getAllocator(scratch)};
+    nkir_printSymbolName(nksb_getStream(&thunk_name), sym_name);
+    nksb_printf(&thunk_name, ".invoke");
+    NkAtom const thunk_atom = nk_s2atom((NkString){NKS_INIT(thunk_name)});
+
+    NkbState nkb = mod->nkb;
     NkLlvmJitState jit = getLlvmJitState(nkb);
-    NkLlvmJitDylib jdl = getLlvmJitDylib(mod);
+    NkLlvmJitDylib jit_dylib = getLlvmJitDylib(mod);
 
-    nk_llvm_defineExternSymbols(scratch, jit, jdl, (NkIrSymbolAddressArray){NKS_INIT(to_define)});
+    // The thunk only references the proc, which is already loaded, so its lookup never waits for other threads
+    NK_MUTEX_GUARD_SCOPE(mod->mtx) {
+        InvokeThunk const *found = InvokeThunkMap_find(&mod->invoke_thunks, sym_name);
+        if (found) {
+            thunk = *found;
+        } else {
+            NkLlvmModule llvm_mod = nk_llvm_compileInvokeThunk(scratch, nkb->llvm, &proc, thunk_atom);
+            if (llvm_mod && nk_llvm_jitModule(llvm_mod, jit, jit_dylib)) {
+                thunk = (InvokeThunk)nk_llvm_getSymbolAddress(jit, jit_dylib, thunk_atom);
+            }
+            if (thunk) {
+                InvokeThunkMap_insert(&mod->invoke_thunks, sym_name, thunk);
+                mod->stats.invoke_thunks++;
+            }
+        }
+    }
 
-    NkLlvmModule llvm_mod = nk_llvm_compilerIr(scratch, nkb->llvm, (NkIrSymbolArray){NKS_INIT(deps)});
+    return thunk;
+}
 
-    NkLlvmTarget tgt = nk_llvm_getJitTarget(jit);
-    nk_llvm_optimizeIr(scratch, llvm_mod, tgt, NkLlvmOptLevel_O3); // TODO: Hardcoded opt level
+bool nkir_invoke(NkIrModule mod, NkAtom sym, void **args, void **ret) {
+    NK_LOG_TRC("%s", __func__);
 
-    nk_llvm_jitModule(llvm_mod, jit, jdl);
+    TRY(mod, false);
 
-    return nk_llvm_getSymbolAddress(jit, jdl, sym_name);
+    InvokeThunk thunk = NULL;
+    NK_PROF_FUNC() {
+        NK_SCRATCH_SCOPE(scratch, NULL) {
+            thunk = getInvokeThunk(scratch, mod, sym);
+        }
+    }
+
+    if (!thunk) {
+        return false;
+    }
+
+    thunk(args, ret);
+    return true;
 }
 
 void *nkir_getSymbolAddress(NkIrModule mod, NkAtom sym) {
@@ -737,17 +1511,15 @@ void *nkir_getSymbolAddress(NkIrModule mod, NkAtom sym) {
 
     TRY(mod, false);
 
-    NkbState nkb = mod->nkb;
-    NkArena *scratch = &nkb->scratch;
-
-    if (!nkir_findSymbol(mod, sym)) {
+    NkIrSymbol found = {0};
+    if (!nkir_findSymbol(mod, sym, &found)) {
         nk_error_printf("Symbol not found: %s", nk_atom2cs(sym));
         return NULL;
     }
 
     void *addr = NULL;
     NK_PROF_FUNC() {
-        NK_ARENA_SCOPE(scratch) {
+        NK_SCRATCH_SCOPE(scratch, NULL) {
             addr = getSymbolAddressImpl(scratch, mod, sym);
         }
     }
@@ -761,9 +1533,8 @@ bool nkir_defineExternSymbols(NkIrModule mod, NkIrSymbolAddressArray syms) {
     TRY(mod, false);
 
     NkbState nkb = mod->nkb;
-    NkArena *scratch = &nkb->scratch;
 
-    NK_ARENA_SCOPE(scratch) {
+    NK_SCRATCH_SCOPE(scratch, NULL) {
         nk_llvm_defineExternSymbols(scratch, getLlvmJitState(nkb), getLlvmJitDylib(mod), syms);
     }
 
@@ -1,59 +1,159 @@
 #include "linker.h"
 
+#include "linker_internal.h"
 #include "nkb/ir.h"
 #include "ntk/arena.h"
 #include "ntk/error.h"
+#include "ntk/file.h"
 #include "ntk/log.h"
+#include "ntk/path.h"
 #include "ntk/process.h"
 #include "ntk/profiler.h"
 #include "ntk/string_builder.h"
+#include "ntk/time.h"
 
 NK_LOG_USE_SCOPE(linker);
 
-bool nk_link(NkLikerOpts const opts) {
-    NK_LOG_TRC("%s", __func__);
+// External linkers read their inputs from disk, the paths are null-terminated
+static bool writeTempObjects(NkArena *scratch, NkLikerOpts const opts, NkStringArray *out) {
+    char tmp_path[NK_MAX_PATH];
+    if (nk_getTempPath(tmp_path, sizeof(tmp_path)) < 0) {
+        nk_error_printf("Failed to get temporary directory path: %s", nk_getLastErrorString());
+        return false;
+    }
 
-    NK_PROF_FUNC_BEGIN();
+    NkString const out_name = nk_path_getFilename(opts.out_file);
+    u64 const stamp = nk_now_ns();
 
-    NkArena *scratch = opts.scratch;
-    NkIrOutputKind kind = opts.out_kind;
+    NkString *paths = nk_arena_allocTn(scratch, NkString, opts.objs.size);
+    for (usize i = 0; i < opts.objs.size; i++) {
+        paths[i] = nk_tsprintf(scratch, "%s" NKS_FMT ".%" PRIx64 ".%zu.o", tmp_path, NKS_ARG(out_name), stamp, i);
 
-    if (kind == NkIrOutput_None || kind == NkIrOutput_Object) {
-        NK_PROF_END();
-        return false;
+        if (!nk_file_write(paths[i], opts.objs.data[i])) {
+            nk_error_printf(
+                "Failed to write object file `" NKS_FMT "`: %s", NKS_ARG(paths[i]), nk_getLastErrorString());
+            for (usize j = 0; j <= i; j++) {
+                nk_remove(paths[j].data);
+            }
+            return false;
+        }
     }
 
-    NkStringBuilder link_cmd = {.alloc = nk_arena_getAllocator(scratch)};
+    *out = (NkStringArray){paths, opts.objs.size};
+    return true;
+}
 
-    if (kind == NkIrOutput_Archiv) {
-        nksb_printf(&link_cmd, "ar rcs");
-        nksb_printf(&link_cmd, " \"" NKS_FMT "\"", NKS_ARG(opts.out_file));
-        nksb_printf(&link_cmd, " \"" NKS_FMT "\"", NKS_ARG(opts.obj_file));
+static void removeTempObjects(NkStringArray paths) {
+    NK_ITERATE(NkString const *, path, paths) {
+        nk_remove(path->data);
+    }
+}
+
+#ifdef NK_HAS_LLD
+
+static bool canLinkWithLld(NkIrOutputKind kind) {
+    switch (kind) {
+        case NkIrOutput_Object:
+            return true;
+
+        // Otherwise the compiler driver has to supply the C runtime libraries
+        case NkIrOutput_Shared:
+#if defined(NK_LIBM_PATH) && defined(NK_LIBC_PATH) && defined(NK_LIBGCC_PATH)
+            return true;
+#else
+            return false;
+#endif
+
+        // Executables need the C runtime startup files, which only the compiler driver knows how to find
+        case NkIrOutput_Binary:
+        case NkIrOutput_Static:
+        case NkIrOutput_Archiv:
+        case NkIrOutput_None:
+            return false;
+    }
+
+    return false;
+}
+
+static bool runLld(NkArena *scratch, NkLikerOpts const opts) {
+    NkDynArray(NkString) args = {.alloc = nk_arena_getAllocator(scratch)};
+
+    nkda_append(&args, nk_cs2s("ld.lld"));
+
+    if (opts.out_kind == NkIrOutput_Object) {
+        nkda_append(&args, nk_cs2s("-r"));
     } else {
-        // TODO: Do not depend on gcc for linking
-        nksb_printf(&link_cmd, "gcc");
-
-        switch (kind) {
-            case NkIrOutput_Binary:
-                break;
-
-            case NkIrOutput_Static:
-                nksb_printf(&link_cmd, " -static");
-                break;
-
-            case NkIrOutput_Shared:
-                nksb_printf(&link_cmd, " -shared");
-                break;
-
-            case NkIrOutput_None:
-            case NkIrOutput_Archiv:
-            case NkIrOutput_Object:
-                nk_assert(!"unreachable");
-                break;
+        nkda_append(&args, nk_cs2s("-shared"));
+        nkda_append(&args, nk_cs2s("--eh-frame-hdr"));
+    }
+
+    nkda_append(&args, nk_cs2s("-o"));
+    nkda_append(&args, opts.out_file);
+
+#if defined(NK_LIBM_PATH) && defined(NK_LIBC_PATH) && defined(NK_LIBGCC_PATH)
+    // The libraries the gcc driver passes, the shared ones are only recorded as needed when used
+    if (opts.out_kind != NkIrOutput_Object) {
+        nkda_append(&args, nk_cs2s("--push-state"));
+        nkda_append(&args, nk_cs2s("--as-needed"));
+        nkda_append(&args, nk_cs2s(NK_LIBM_PATH)); // TODO: Hardcoded libm
+        nkda_append(&args, nk_cs2s(NK_LIBC_PATH));
+#ifdef NK_LIBGCC_S_PATH
+        nkda_append(&args, nk_cs2s(NK_LIBGCC_S_PATH));
+#endif // NK_LIBGCC_S_PATH
+        nkda_append(&args, nk_cs2s("--pop-state"));
+        nkda_append(&args, nk_cs2s(NK_LIBGCC_PATH));
+    }
+#endif // NK_LIBM_PATH && NK_LIBC_PATH && NK_LIBGCC_PATH
+
+    NK_LOG_STREAM_INF {
+        NkStream log = nk_log_getStream();
+        nk_printf(log, "Linking %zu objects in memory:", opts.objs.size);
+        NK_ITERATE(NkString const *, arg, args) {
+            nk_printf(log, " " NKS_FMT, NKS_ARG(*arg));
         }
+    }
+
+    return linkWithLld((NkStringArray){NKS_INIT(args)}, opts.objs);
+}
+
+#endif // NK_HAS_LLD
+
+static bool runExternalLinker(NkArena *scratch, NkLikerOpts const opts, NkStringArray obj_files) {
+    NkIrOutputKind const kind = opts.out_kind;
+
+    NkStringBuilder link_cmd = {.alloc = nk_arena_getAllocator(scratch)};
+
+    // TODO: Do not depend on gcc for linking
+    nksb_printf(&link_cmd, "gcc");
+
+    switch (kind) {
+        case NkIrOutput_Binary:
+            break;
 
-        nksb_printf(&link_cmd, " -o \"" NKS_FMT "\"", NKS_ARG(opts.out_file));
-        nksb_printf(&link_cmd, " \"" NKS_FMT "\"", NKS_ARG(opts.obj_file));
+        case NkIrOutput_Static:
+            nksb_printf(&link_cmd, " -static");
+            break;
+
+        case NkIrOutput_Shared:
+            nksb_printf(&link_cmd, " -shared");
+            break;
+
+        case NkIrOutput_Object:
+            // Merges the objects into a relocatable one
+            nksb_printf(&link_cmd, " -r -nostdlib");
+            break;
+
+        case NkIrOutput_None:
+        case NkIrOutput_Archiv:
+            nk_assert(!"unreachable");
+            break;
+    }
+
+    nksb_printf(&link_cmd, " -o \"" NKS_FMT "\"", NKS_ARG(opts.out_file));
+    NK_ITERATE(NkString const *, obj_file, obj_files) {
+        nksb_printf(&link_cmd, " \"" NKS_FMT "\"", NKS_ARG(*obj_file));
+    }
+    if (kind != NkIrOutput_Object) {
         nksb_printf(&link_cmd, " -lm"); // TODO: Hardcoded libm
     }
 
@@ -62,15 +162,62 @@ bool nk_link(NkLikerOpts const opts) {
     i32 exit_code = 0;
     if (nk_exec(scratch, (NkString){NKS_INIT(link_cmd)}, NULL, NULL, NULL, &exit_code) < 0) {
         nk_error_printf("Failed to run the linker: %s", nk_getLastErrorString());
-        NK_PROF_END();
         return false;
     }
     if (exit_code) {
         nk_error_printf("Linker returned nonzero exit code");
-        NK_PROF_END();
         return false;
     }
 
-    NK_PROF_END();
     return true;
 }
+
+static bool linkImpl(NkArena *scratch, NkLikerOpts const opts) {
+    NkIrOutputKind const kind = opts.out_kind;
+
+    if (kind == NkIrOutput_None) {
+        return false;
+    }
+
+    // A single object needs no linking
+    if (kind == NkIrOutput_Object && opts.objs.size == 1) {
+        if (!nk_file_write(opts.out_file, opts.objs.data[0])) {
+            nk_error_printf(
+                "Failed to write object file `" NKS_FMT "`: %s", NKS_ARG(opts.out_file), nk_getLastErrorString());
+            return false;
+        }
+        return true;
+    }
+
+    if (kind == NkIrOutput_Archiv) {
+        NK_LOG_INF("Archiving %zu objects into `" NKS_FMT "`", opts.objs.size, NKS_ARG(opts.out_file));
+        return writeArchive(opts.out_file, opts.objs);
+    }
+
+#ifdef NK_HAS_LLD
+    if (canLinkWithLld(kind) && lldAvailable()) {
+        return runLld(scratch, opts);
+    }
+#endif // NK_HAS_LLD
+
+    NkStringArray obj_files = {0};
+    if (!writeTempObjects(scratch, opts, &obj_files)) {
+        return false;
+    }
+
+    bool const ret = runExternalLinker(scratch, opts, obj_files);
+
+    removeTempObjects(obj_files);
+
+    return ret;
+}
+
+bool nk_link(NkLikerOpts const opts) {
+    NK_LOG_TRC("%s", __func__);
+
+    bool ret = false;
+    NK_PROF_FUNC() {
+        ret = linkImpl(opts.scratch, opts);
+    }
+    return ret;
+}
@@ -0,0 +1,170 @@
+#include <llvm/Object/Archive.h>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#ifdef NK_HAS_LLD
+#include <lld/Common/Driver.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+LLD_HAS_DRIVER(elf)
+#endif // NK_HAS_LLD
+
+#include "linker_internal.h"
+#include "ntk/error.h"
+
+namespace {
+
+template <class TRet, class... TArgs>
+auto symtabParam(TRet (*)(TArgs...)) -> std::decay_t<std::tuple_element_t<2, std::tuple<TArgs...>>>;
+
+// The symbol table flag of llvm::writeArchive became an enum in later versions
+template <class T>
+T normalSymtab() {
+    if constexpr (std::is_same_v<T, bool>) {
+        return true;
+    } else {
+        return T::NormalSymtab;
+    }
+}
+
+std::string toString(NkString str) {
+    return {str.data, str.size};
+}
+
+} // namespace
+
+bool writeArchive(NkString out_file, NkStringArray objs) {
+    std::vector<std::string> names;
+    names.reserve(objs.size);
+
+    std::vector<llvm::NewArchiveMember> members;
+    members.reserve(objs.size);
+
+    for (usize i = 0; i < objs.size; i++) {
+        names.emplace_back(std::to_string(i) + ".o");
+        members.emplace_back(llvm::MemoryBufferRef{{objs.data[i].data, objs.data[i].size}, names.back()});
+    }
+
+#ifdef __APPLE__
+    auto const kind = llvm::object::Archive::K_DARWIN;
+#else
+    auto const kind = llvm::object::Archive::K_GNU;
+#endif
+
+    using SymtabParam = decltype(symtabParam(&llvm::writeArchive));
+
+    auto const path = toString(out_file);
+    auto err = llvm::writeArchive(path, members, normalSymtab<SymtabParam>(), kind, true, false);
+    if (err) {
+        nk_error_printf("Failed to write archive `%s`: %s", path.c_str(), llvm::toString(std::move(err)).c_str());
+        return false;
+    }
+    return true;
+}
+
+#ifdef NK_HAS_LLD
+
+namespace {
+
+// lld keeps global state, so it only runs on one thread at a time
+std::mutex s_lld_mtx;
+bool s_lld_can_run = true;
+
+} // namespace
+
+bool lldAvailable(void) {
+    std::lock_guard lock{s_lld_mtx};
+    return s_lld_can_run;
+}
+
+namespace {
+
+// lld only opens its inputs by path, so the objects become anonymous files that live in memory
+class MemFiles {
+public:
+    ~MemFiles() {
+        for (int fd : m_fds) {
+            close(fd);
+        }
+    }
+
+    bool add(NkString data, std::string *path) {
+        int const fd = memfd_create("nk.obj", MFD_CLOEXEC);
+        if (fd < 0) {
+            nk_error_printf("Failed to create an in-memory object file: %s", std::strerror(errno));
+            return false;
+        }
+        m_fds.emplace_back(fd);
+
+        for (usize written = 0; written < data.size;) {
+            ssize_t const res = write(fd, data.data + written, data.size - written);
+            if (res < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                nk_error_printf("Failed to write an in-memory object file: %s", std::strerror(errno));
+                return false;
+            }
+            written += res;
+        }
+
+        *path = "/proc/self/fd/" + std::to_string(fd);
+        return true;
+    }
+
+private:
+    std::vector<int> m_fds;
+};
+
+} // namespace
+
+bool linkWithLld(NkStringArray args, NkStringArray objs) {
+    std::vector<std::string> strs;
+    strs.reserve(args.size + objs.size);
+
+    for (usize i = 0; i < args.size; i++) {
+        strs.emplace_back(toString(args.data[i]));
+    }
+
+    MemFiles files;
+    for (usize i = 0; i < objs.size; i++) {
+        if (!files.add(objs.data[i], &strs.emplace_back())) {
+            return false;
+        }
+    }
+
+    std::vector<char const *> argv;
+    argv.reserve(strs.size());
+
+    for (auto const &str : strs) {
+        argv.emplace_back(str.c_str());
+    }
+
+    std::string err_str;
+    llvm::raw_string_ostream err{err_str};
+
+    std::lock_guard lock{s_lld_mtx};
+
+    auto const res = lld::lldMain(argv, llvm::nulls(), err, {{lld::Gnu, &lld::elf::link}});
+    s_lld_can_run = res.canRunAgain;
+
+    if (res.retCode) {
+        nk_error_printf("Linker failed: %s", err.str().c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif // NK_HAS_LLD
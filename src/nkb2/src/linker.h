@@ -12,7 +12,7 @@ extern "C" {
 typedef struct {
     NkArena *scratch;
     NkIrOutputKind out_kind;
-    NkString obj_file;
+    NkStringArray objs; // Object code in memory
     NkString out_file;
 } NkLikerOpts;
 
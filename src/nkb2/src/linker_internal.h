@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ntk/string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Writes the objects into a static archive with a symbol index, as `ar rcs` would
+bool writeArchive(NkString out_file, NkStringArray objs);
+
+#ifdef NK_HAS_LLD
+
+// lld cannot run again after some of its errors, the external linker is used from then on
+bool lldAvailable(void);
+
+// Runs the ELF linker in process, args start with the program name.
+// The objects are passed to it in memory, after the args
+bool linkWithLld(NkStringArray args, NkStringArray objs);
+
+#endif // NK_HAS_LLD
+
+#ifdef __cplusplus
+}
+#endif
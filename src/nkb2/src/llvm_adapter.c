@@ -1,22 +1,29 @@
 #include "llvm_adapter.h"
 
+#include <llvm-c/Analysis.h>
 #include <llvm-c/Core.h>
 #include <llvm-c/Error.h>
-#include <llvm-c/IRReader.h>
 #include <llvm-c/LLJIT.h>
 #include <llvm-c/Orc.h>
 #include <llvm-c/TargetMachine.h>
 #include <llvm-c/Transforms/PassBuilder.h>
 #include <llvm-c/Types.h>
+#include <llvm/Config/llvm-config.h>
+#include <string.h>
 
 #include "llvm_adapter_internal.h"
+#include "llvm_builder.h"
 #include "llvm_emitter.h"
 #include "ntk/arena.h"
 #include "ntk/common.h"
 #include "ntk/error.h"
+#include "ntk/hash_tree.h"
 #include "ntk/log.h"
 #include "ntk/profiler.h"
 #include "ntk/string_builder.h"
+#include "ntk/thread.h"
+#include "ntk/time.h"
+#include "ntk/utils.h"
 
 NK_LOG_USE_SCOPE(llvm_adapter);
 
@@ -34,13 +41,6 @@ static LLVMTargetMachineRef tm_unwrap(NkLlvmTarget val) {
     return (LLVMTargetMachineRef)val;
 }
 
-static NkLlvmJitDylib jd_wrap(LLVMOrcJITDylibRef val) {
-    return (NkLlvmJitDylib)val;
-}
-static LLVMOrcJITDylibRef jd_unwrap(NkLlvmJitDylib val) {
-    return (LLVMOrcJITDylibRef)val;
-}
-
 static NkLlvmModule m_wrap(LLVMModuleRef val) {
     return (NkLlvmModule)val;
 }
@@ -61,7 +61,6 @@ NkLlvmState nk_llvm_createState(NkArena *arena) {
         llvm = nk_arena_allocT(arena, NkLlvmState_T);
         *llvm = (NkLlvmState_T){
             .arena = arena,
-            .ctx = LLVMContextCreate(),
         };
     }
     return llvm;
@@ -71,13 +70,13 @@ void nk_llvm_freeState(NkLlvmState llvm) {
     NK_LOG_TRC("%s", __func__);
 
     TRY(llvm);
-
-    NK_PROF_FUNC() {
-        LLVMContextDispose(llvm->ctx);
-    }
 }
 
-static LLVMTargetMachineRef createTargetImpl(char const *triple, LLVMCodeModel cm) {
+static LLVMTargetMachineRef createTargetImpl(
+    char const *triple,
+    char const *cpu,
+    char const *features,
+    LLVMCodeModel cm) {
     char *triple_norm = LLVMNormalizeTargetTriple(triple);
 
     LLVMTargetRef t = NULL;
@@ -89,14 +88,66 @@ static LLVMTargetMachineRef createTargetImpl(char const *triple, LLVMCodeModel c
         return NULL;
     }
 
-    LLVMTargetMachineRef tm =
-        LLVMCreateTargetMachine(t, triple_norm, "generic", "", LLVMCodeGenLevelDefault, LLVMRelocPIC, cm);
+    char *host_cpu = NULL;
+    char *host_features = NULL;
+    if (cpu && strcmp(cpu, "native") == 0) {
+        host_cpu = LLVMGetHostCPUName();
+        host_features = LLVMGetHostCPUFeatures();
+    }
 
+    LLVMTargetMachineRef tm = NULL;
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        if (host_cpu) {
+            cpu = host_cpu;
+            // Explicit features come last, so that they override the host ones
+            features = features && *features ? nk_tprintf(scratch, "%s,%s", host_features, features) : host_features;
+        }
+
+        tm = LLVMCreateTargetMachine(
+            t,
+            triple_norm,
+            cpu && *cpu ? cpu : "generic",
+            features ? features : "",
+            LLVMCodeGenLevelDefault,
+            LLVMRelocPIC,
+            cm);
+    }
+
+    LLVMDisposeMessage(host_features);
+    LLVMDisposeMessage(host_cpu);
     LLVMDisposeMessage(triple_norm);
 
     return tm;
 }
 
+// Target machines are not safe to share between threads, so every task gets a copy of its own
+static LLVMTargetMachineRef cloneTarget(LLVMTargetMachineRef tm, LLVMCodeModel cm) {
+    char *triple = LLVMGetTargetMachineTriple(tm);
+    char *cpu = LLVMGetTargetMachineCPU(tm);
+    char *features = LLVMGetTargetMachineFeatureString(tm);
+
+    LLVMTargetMachineRef clone = LLVMCreateTargetMachine(
+        LLVMGetTargetMachineTarget(tm),
+        triple,
+        cpu,
+        features,
+        LLVMCodeGenLevelDefault,
+        LLVMRelocPIC,
+        cm);
+
+    LLVMDisposeMessage(features);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(triple);
+
+    return clone;
+}
+
+// Called in place of a lazily compiled proc that failed to compile
+static void lazyCallFailed(void) {
+    NK_LOG_ERR("Failed to compile a proc on its first call");
+    nk_trap();
+}
+
 NkLlvmJitState nk_llvm_createJitState(NkLlvmState llvm) {
     NK_LOG_TRC("%s", __func__);
 
@@ -113,16 +164,30 @@ NkLlvmJitState nk_llvm_createJitState(NkLlvmState llvm) {
             nk_error_printf("Failed to create JIT: %s", err_msg);
             LLVMDisposeErrorMessage(err_msg);
         } else {
-            LLVMOrcThreadSafeContextRef tsc = LLVMOrcCreateNewThreadSafeContext();
-
             char *triple = LLVMGetDefaultTargetTriple();
-            LLVMTargetMachineRef tm = createTargetImpl(triple, LLVMCodeModelJITDefault);
+            LLVMTargetMachineRef tm = createTargetImpl(triple, NULL, NULL, LLVMCodeModelJITDefault);
             if (tm) {
+                LLVMOrcLazyCallThroughManagerRef lctm = NULL;
+                err = LLVMOrcCreateLocalLazyCallThroughManager(
+                    triple,
+                    LLVMOrcLLJITGetExecutionSession(lljit),
+                    (LLVMOrcJITTargetAddress)(uintptr_t)lazyCallFailed,
+                    &lctm);
+                if (err) {
+                    char *err_msg = LLVMGetErrorMessage(err);
+                    nk_error_printf("Failed to create lazy call-through manager: %s", err_msg);
+                    LLVMDisposeErrorMessage(err_msg);
+                }
+
                 jit = nk_arena_allocT(llvm->arena, NkLlvmJitState_T);
                 *jit = (NkLlvmJitState_T){
                     .lljit = lljit,
-                    .tsc = tsc,
                     .tm = tm,
+                    .free_tms = {.alloc = nk_default_allocator},
+                    .mtx = nk_mutex_alloc(0),
+                    .lctm = lctm,
+                    .dylibs = {.alloc = nk_default_allocator},
+                    .promotions = {.alloc = nk_default_allocator},
                 };
             }
             LLVMDisposeMessage(triple);
@@ -138,8 +203,29 @@ void nk_llvm_freeJitState(NkLlvmJitState jit) {
 
     NK_PROF_FUNC() {
         if (jit) {
+            // Promotions use the dylibs and the JIT, so they have to finish first
+            NK_ITERATE(NkHandle const *, thread, jit->promotions) {
+                nk_thread_join(*thread);
+            }
+            nkda_free(&jit->promotions);
+
+            NK_ITERATE(NkLlvmJitDylib const *, dl, jit->dylibs) {
+                if ((*dl)->ism) {
+                    LLVMOrcDisposeIndirectStubsManager((*dl)->ism);
+                }
+                nk_freeT(nk_default_allocator, *dl, NkLlvmJitDylib_T);
+            }
+            nkda_free(&jit->dylibs);
+            if (jit->lctm) {
+                LLVMOrcDisposeLazyCallThroughManager(jit->lctm);
+            }
+            NK_ITERATE(LLVMTargetMachineRef const *, tm, jit->free_tms) {
+                LLVMDisposeTargetMachine(*tm);
+            }
+            nkda_free(&jit->free_tms);
+            nk_mutex_free(jit->mtx);
+
             LLVMDisposeTargetMachine(jit->tm);
-            LLVMOrcDisposeThreadSafeContext(jit->tsc);
             LLVMOrcDisposeLLJIT(jit->lljit);
         }
     }
@@ -151,34 +237,90 @@ NkLlvmTarget nk_llvm_getJitTarget(NkLlvmJitState jit) {
     return tm_wrap(jit->tm);
 }
 
+static LLVMTargetMachineRef acquireJitTm(NkLlvmJitState jit) {
+    LLVMTargetMachineRef tm = NULL;
+    NK_MUTEX_GUARD_SCOPE(jit->mtx) {
+        if (jit->free_tms.size) {
+            tm = nks_last(jit->free_tms);
+            nkda_pop(&jit->free_tms, 1);
+        }
+    }
+    return tm ? tm : cloneTarget(jit->tm, LLVMCodeModelJITDefault);
+}
+
+static void releaseJitTm(NkLlvmJitState jit, LLVMTargetMachineRef tm) {
+    NK_MUTEX_GUARD_SCOPE(jit->mtx) {
+        nkda_append(&jit->free_tms, tm);
+    }
+}
+
+NkLlvmTarget nk_llvm_acquireJitTarget(NkLlvmJitState jit) {
+    TRY(jit, NULL);
+
+    return tm_wrap(acquireJitTm(jit));
+}
+
+void nk_llvm_releaseJitTarget(NkLlvmJitState jit, NkLlvmTarget tgt) {
+    TRY(jit && tgt);
+
+    releaseJitTm(jit, tm_unwrap(tgt));
+}
+
 NkLlvmJitDylib nk_llvm_createJitDylib(NkLlvmState NK_UNUSED llvm, NkLlvmJitState jit) {
     NK_LOG_TRC("%s", __func__);
 
     TRY(llvm && jit, NULL);
 
-    LLVMOrcJITDylibRef jd = NULL;
+    NkLlvmJitDylib dl = NULL;
     NK_PROF_FUNC() {
         LLVMOrcExecutionSessionRef es = LLVMOrcLLJITGetExecutionSession(jit->lljit);
 
-        LLVMErrorRef err = LLVMOrcExecutionSessionCreateJITDylib(es, &jd, "main");
-        if (err) {
-            char *err_msg = LLVMGetErrorMessage(err);
-            nk_error_printf("Failed to create the JIT DyLib: %s", err_msg);
-            LLVMDisposeErrorMessage(err_msg);
+        NK_SCRATCH_SCOPE(scratch, NULL) {
+            NK_MUTEX_GUARD_SCOPE(jit->mtx) {
+                // Dylib names have to be unique within the session
+                char const *name = nk_tprintf(scratch, "main.%zu", jit->dylibs.size);
+
+                LLVMOrcJITDylibRef jd = NULL;
+                LLVMErrorRef err = LLVMOrcExecutionSessionCreateJITDylib(es, &jd, name);
+                if (err) {
+                    char *err_msg = LLVMGetErrorMessage(err);
+                    nk_error_printf("Failed to create the JIT DyLib: %s", err_msg);
+                    LLVMDisposeErrorMessage(err_msg);
+                } else {
+                    char *triple = LLVMGetDefaultTargetTriple();
+
+                    dl = nk_allocT(nk_default_allocator, NkLlvmJitDylib_T);
+                    *dl = (NkLlvmJitDylib_T){
+                        .jd = jd,
+                        .ism = LLVMOrcCreateLocalIndirectStubsManager(triple),
+                    };
+                    nkda_append(&jit->dylibs, dl);
+
+                    LLVMDisposeMessage(triple);
+                }
+            }
         }
     }
-    return jd_wrap(jd);
+    return dl;
 }
 
-NkLlvmTarget nk_llvm_createTarget(NkLlvmState NK_UNUSED llvm, char const *triple) {
+NkLlvmTarget nk_llvm_createTarget(
+    NkLlvmState NK_UNUSED llvm,
+    char const *triple,
+    char const *cpu,
+    char const *features) {
     NK_LOG_TRC("%s", __func__);
 
     TRY(llvm && triple, NULL);
 
     LLVMTargetMachineRef tm = NULL;
     NK_PROF_FUNC() {
-        NK_LOG_INF("Creating target for triple: %s", triple);
-        tm = createTargetImpl(triple, LLVMCodeModelDefault);
+        NK_LOG_INF(
+            "Creating target for triple: %s, cpu: %s, features: %s",
+            triple,
+            cpu && *cpu ? cpu : "generic",
+            features ? features : "");
+        tm = createTargetImpl(triple, cpu, features, LLVMCodeModelDefault);
     }
     return tm_wrap(tm);
 }
@@ -194,6 +336,59 @@ void nk_llvm_freeTarget(NkLlvmTarget tgt) {
     }
 }
 
+static LLVMModuleRef verifyModule(LLVMModuleRef module) {
+    char *error = NULL;
+    if (module && LLVMVerifyModule(module, LLVMReturnStatusAction, &error)) {
+        nk_error_printf("Failed to build IR: %s", error);
+        LLVMDisposeModule(module);
+        module = NULL;
+    }
+    LLVMDisposeMessage(error);
+
+    return module;
+}
+
+static LLVMModuleRef compileIrImpl(NkArena *scratch, LLVMContextRef ctx, NkIrSymbolArray ir) {
+    // The textual IR is only rendered for the log, the module is built directly
+    NK_LOG_STREAM_INF {
+        NkStream log = nk_log_getStream();
+        nk_printf(log, "LLVM IR:\n");
+        NK_ARENA_SCOPE(scratch) {
+            nk_llvm_emitIr(log, scratch, ir);
+        }
+    }
+
+    return verifyModule(nk_llvm_buildModule(scratch, ctx, ir));
+}
+
+void nk_llvm_inspectTarget(NkStream out, NkLlvmTarget tgt) {
+    LLVMTargetMachineRef tm = tm_unwrap(tgt);
+
+    char *triple = LLVMGetTargetMachineTriple(tm);
+    char *cpu = LLVMGetTargetMachineCPU(tm);
+    char *features = LLVMGetTargetMachineFeatureString(tm);
+
+    nk_printf(out, "llvm %s target %s cpu %s features %s", LLVM_VERSION_STRING, triple, cpu, features);
+
+    LLVMDisposeMessage(features);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(triple);
+}
+
+// Every module is built in a context of its own, so that modules can be built and compiled on different threads
+static LLVMModuleRef withOwnContext(LLVMContextRef ctx, LLVMModuleRef module) {
+    if (!module) {
+        LLVMContextDispose(ctx);
+    }
+    return module;
+}
+
+static void disposeModule(LLVMModuleRef module) {
+    LLVMContextRef ctx = LLVMGetModuleContext(module);
+    LLVMDisposeModule(module);
+    LLVMContextDispose(ctx);
+}
+
 NkLlvmModule nk_llvm_compilerIr(NkArena *scratch, NkLlvmState llvm, NkIrSymbolArray ir) {
     NK_LOG_TRC("%s", __func__);
 
@@ -201,27 +396,33 @@ NkLlvmModule nk_llvm_compilerIr(NkArena *scratch, NkLlvmState llvm, NkIrSymbolAr
 
     LLVMModuleRef module = NULL;
     NK_PROF_FUNC() {
-        NkStringBuilder llvm_ir = {.alloc = nk_arena_getAllocator(scratch)};
-        nk_llvm_emitIr(nksb_getStream(&llvm_ir), scratch, ir);
-        nksb_appendNull(&llvm_ir);
-        llvm_ir.size--;
-
-        NK_LOG_STREAM_INF {
-            NkStream log = nk_log_getStream();
-            nk_printf(log, "LLVM IR:\n" NKS_FMT, NKS_ARG(llvm_ir));
-        }
+        LLVMContextRef ctx = LLVMContextCreate();
+        module = withOwnContext(ctx, compileIrImpl(scratch, ctx, ir));
+    }
+    return m_wrap(module);
+}
 
-        LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(llvm_ir.data, llvm_ir.size, "main", 1);
+NkLlvmModule nk_llvm_compileInvokeThunk(NkArena *scratch, NkLlvmState llvm, NkIrSymbol const *proc, NkAtom name) {
+    NK_LOG_TRC("%s", __func__);
 
-        char *error = NULL;
-        if (LLVMParseIRInContext(llvm->ctx, buffer, &module, &error)) {
-            nk_error_printf("Failed to parse IR: %s", error);
-            LLVMDisposeMessage(error);
-        }
+    TRY(scratch && llvm && proc, NULL);
+
+    LLVMModuleRef module = NULL;
+    NK_PROF_FUNC() {
+        LLVMContextRef ctx = LLVMContextCreate();
+        module = withOwnContext(ctx, verifyModule(nk_llvm_buildInvokeThunk(scratch, ctx, proc, name)));
     }
     return m_wrap(module);
 }
 
+void nk_llvm_freeModule(NkLlvmModule mod) {
+    NK_LOG_TRC("%s", __func__);
+
+    TRY(mod);
+
+    disposeModule(m_unwrap(mod));
+}
+
 static char optLevelChar(NkLlvmOptLevel opt) {
     switch (opt) {
         case NkLlvmOptLevel_O0:
@@ -240,7 +441,7 @@ static char optLevelChar(NkLlvmOptLevel opt) {
     return '0';
 }
 
-bool nk_llvm_optimizeIr(NkArena *scratch, NkLlvmModule mod, NkLlvmTarget tgt, NkLlvmOptLevel opt) {
+bool nk_llvm_optimizeIr(NkArena *scratch, NkLlvmModule mod, NkLlvmTarget tgt, NkLlvmOptProfile opt) {
     NK_LOG_TRC("%s", __func__);
 
     TRY(scratch && mod && tgt, false);
@@ -252,7 +453,10 @@ bool nk_llvm_optimizeIr(NkArena *scratch, NkLlvmModule mod, NkLlvmTarget tgt, Nk
 
         LLVMPassBuilderOptionsRef pbo = LLVMCreatePassBuilderOptions();
 
-        LLVMErrorRef err = LLVMRunPasses(module, nk_tprintf(scratch, "default<O%c>", optLevelChar(opt)), tm, pbo);
+        char const *passes = opt.passes.size ? nk_tprintf(scratch, NKS_FMT, NKS_ARG(opt.passes))
+                                              : nk_tprintf(scratch, "default<O%c>", optLevelChar(opt.level));
+
+        LLVMErrorRef err = LLVMRunPasses(module, passes, tm, pbo);
         if (err) {
             char *err_msg = LLVMGetErrorMessage(err);
             nk_error_printf("Failed to optimize IR module: %s", err_msg);
@@ -292,7 +496,7 @@ bool nk_llvm_defineExternSymbols(NkArena *scratch, NkLlvmJitState jit, NkLlvmJit
         }
         mu = LLVMOrcAbsoluteSymbols(llvm_syms.data, llvm_syms.size);
 
-        LLVMOrcJITDylibRef jd = jd_unwrap(dl);
+        LLVMOrcJITDylibRef jd = dl->jd;
 
         LLVMErrorRef err = LLVMOrcJITDylibDefine(jd, mu);
         if (err) {
@@ -306,43 +510,181 @@ bool nk_llvm_defineExternSymbols(NkArena *scratch, NkLlvmJitState jit, NkLlvmJit
     return ret;
 }
 
-bool nk_llvm_emitObjectFile(NkLlvmModule mod, NkLlvmTarget tgt, NkString obj_file) {
+static LLVMMemoryBufferRef emitObjectImpl(LLVMModuleRef module, LLVMTargetMachineRef tm) {
+    LLVMMemoryBufferRef buf = NULL;
+    char *error = NULL;
+    if (LLVMTargetMachineEmitToMemoryBuffer(tm, module, LLVMObjectFile, &error, &buf) != 0) {
+        nk_error_printf("Failed to emit object code: %s", error);
+        LLVMDisposeMessage(error);
+        return NULL;
+    }
+    return buf;
+}
+
+bool nk_llvm_emitObject(NkLlvmModule mod, NkLlvmTarget tgt, NkAllocator alloc, NkString *out) {
     NK_LOG_TRC("%s", __func__);
 
-    TRY(mod && tgt, false);
+    TRY(mod && tgt && out, false);
+
+    bool ret = false;
+    NK_PROF_FUNC() {
+        LLVMMemoryBufferRef buf = emitObjectImpl(m_unwrap(mod), tm_unwrap(tgt));
+        if (buf) {
+            *out = nks_copy(alloc, (NkString){LLVMGetBufferStart(buf), LLVMGetBufferSize(buf)});
+            LLVMDisposeMemoryBuffer(buf);
+            ret = true;
+        }
+    }
+    return ret;
+}
+
+typedef struct {
+    NkLlvmCodegenUnit *unit;
+    LLVMTargetMachineRef tm;
+    NkLlvmOptProfile opt;
+
+    NkArena err_arena;
+    NkErrorState err;
+    NkHandle thread;
+    bool ok;
+} CodegenTask;
+
+static void codegenTask(void *arg) {
+    CodegenTask *task = arg;
+
+    NK_ERROR_SCOPE(&task->err) {
+        u64 const NK_UNUSED start_ns = nk_now_ns();
+
+        LLVMContextRef ctx = LLVMContextCreate();
+
+        NK_SCRATCH_SCOPE(scratch, NULL) {
+            LLVMModuleRef module = compileIrImpl(scratch, ctx, task->unit->ir);
+            if (module) {
+                task->ok =
+                    nk_llvm_optimizeIr(scratch, m_wrap(module), tm_wrap(task->tm), task->opt) &&
+                    nk_llvm_emitObject(m_wrap(module), tm_wrap(task->tm), nk_default_allocator, &task->unit->obj);
+                LLVMDisposeModule(module);
+            }
+        }
+
+        LLVMContextDispose(ctx);
+
+        NK_LOG_INF(
+            "Generated %zu bytes of object code from %zu symbols in %.2f ms",
+            task->unit->obj.size,
+            task->unit->ir.size,
+            (nk_now_ns() - start_ns) / 1e6);
+    }
+}
+
+// Releases the scratch memory of the worker right away, rather than leaving it until the thread exits
+static void codegenThread(void *arg) {
+    codegenTask(arg);
+    nk_scratch_free();
+}
+
+bool nk_llvm_emitObjectsParallel(NkLlvmTarget tgt, NkLlvmOptProfile opt, NkLlvmCodegenUnitArray units) {
+    NK_LOG_TRC("%s", __func__);
+
+    TRY(tgt, false);
 
     bool ret = true;
     NK_PROF_FUNC() {
-        LLVMTargetMachineRef tm = tm_unwrap(tgt);
+        CodegenTask *tasks = nk_allocTn(nk_default_allocator, CodegenTask, units.size);
+
+        NK_ITERATE(NkLlvmCodegenUnit *, unit, units) {
+            CodegenTask *task = &tasks[NK_INDEX(unit, units)];
+            *task = (CodegenTask){
+                .unit = unit,
+                .tm = cloneTarget(tm_unwrap(tgt), LLVMCodeModelDefault),
+                .opt = opt,
+            };
+            task->err.alloc = nk_arena_getAllocator(&task->err_arena);
+
+            task->thread = nk_thread_start(codegenThread, task);
+            if (nk_handleIsNull(task->thread)) {
+                NK_LOG_WRN("Failed to start a codegen thread: %s", nk_getLastErrorString());
+                codegenTask(task);
+            }
+        }
 
-        char *error = NULL;
-        if (LLVMTargetMachineEmitToFile(tm, m_unwrap(mod), obj_file.data, LLVMObjectFile, &error) != 0) {
-            nk_error_printf("Failed to emit object file `" NKS_FMT "`: %s", NKS_ARG(obj_file), error);
-            LLVMDisposeMessage(error);
-            ret = false;
+        for (usize i = 0; i < units.size; i++) {
+            CodegenTask *task = &tasks[i];
+
+            if (!nk_handleIsNull(task->thread)) {
+                nk_thread_join(task->thread);
+            }
+
+            // Errors of the worker threads are reported to the caller's error state
+            for (NkErrorNode const *node = task->err.errors; node; node = node->next) {
+                nk_error_printf(NKS_FMT, NKS_ARG(node->msg));
+            }
+            ret &= task->ok;
+
+            LLVMDisposeTargetMachine(task->tm);
+            nk_arena_free(&task->err_arena);
         }
+
+        nk_freeTn(nk_default_allocator, tasks, CodegenTask, units.size);
     }
     return ret;
 }
 
+static LLVMMemoryBufferRef objBuffer(NkString obj) {
+    return LLVMCreateMemoryBufferWithMemoryRangeCopy(obj.data, obj.size, "nk.obj");
+}
+
+static bool addObject(NkLlvmJitState jit, LLVMOrcJITDylibRef jd, LLVMMemoryBufferRef buf) {
+    LLVMErrorRef err = LLVMOrcLLJITAddObjectFile(jit->lljit, jd, buf);
+    if (err) {
+        char *err_msg = LLVMGetErrorMessage(err);
+        nk_error_printf("Failed to load object code: %s", err_msg);
+        LLVMDisposeErrorMessage(err_msg);
+        return false;
+    }
+    return true;
+}
+
+// Modules are compiled here rather than by the compile layer of the JIT, which shares one target machine
+// between all the threads. The module is consumed, it is not optimized if opt is null
+static LLVMMemoryBufferRef compileJitModule(NkLlvmJitState jit, LLVMModuleRef module, NkLlvmOptProfile const *opt) {
+    LLVMTargetMachineRef tm = acquireJitTm(jit);
+
+    bool optimized = true;
+    if (opt) {
+        NK_SCRATCH_SCOPE(scratch, NULL) {
+            optimized = nk_llvm_optimizeIr(scratch, m_wrap(module), tm_wrap(tm), *opt);
+        }
+    }
+    LLVMMemoryBufferRef buf = optimized ? emitObjectImpl(module, tm) : NULL;
+
+    releaseJitTm(jit, tm);
+    disposeModule(module);
+
+    return buf;
+}
+
 bool nk_llvm_jitModule(NkLlvmModule mod, NkLlvmJitState jit, NkLlvmJitDylib dl) {
     NK_LOG_TRC("%s", __func__);
 
     TRY(mod && jit && dl, false);
 
-    bool ret = true;
+    bool ret = false;
     NK_PROF_FUNC() {
-        LLVMOrcThreadSafeModuleRef tsm = LLVMOrcCreateNewThreadSafeModule(m_unwrap(mod), jit->tsc);
+        LLVMMemoryBufferRef buf = compileJitModule(jit, m_unwrap(mod), NULL);
+        ret = buf && addObject(jit, dl->jd, buf);
+    }
+    return ret;
+}
 
-        LLVMOrcJITDylibRef jd = jd_unwrap(dl);
+bool nk_llvm_jitObject(NkLlvmJitState jit, NkLlvmJitDylib dl, NkString obj) {
+    NK_LOG_TRC("%s", __func__);
 
-        LLVMErrorRef err = LLVMOrcLLJITAddLLVMIRModule(jit->lljit, jd, tsm);
-        if (err) {
-            char *err_msg = LLVMGetErrorMessage(err);
-            nk_error_printf("Failed to compile IR module: %s", err_msg);
-            LLVMDisposeErrorMessage(err_msg);
-            ret = false;
-        }
+    TRY(jit && dl, false);
+
+    bool ret = false;
+    NK_PROF_FUNC() {
+        ret = addObject(jit, dl->jd, objBuffer(obj));
     }
     return ret;
 }
@@ -354,8 +696,331 @@ void *nk_llvm_getSymbolAddress(NkLlvmJitState jit, NkLlvmJitDylib dl, NkAtom sym
 
     void *addr = NULL;
     NK_PROF_FUNC() {
-        LLVMOrcJITDylibRef jd = jd_unwrap(dl);
+        LLVMOrcJITDylibRef jd = dl->jd;
         addr = lookupSymbol(jit->lljit, jd, nk_atom2cs(sym));
     }
     return addr;
 }
+
+static char const *getSymbolName(NkArena *arena, NkAtom sym) {
+    NkStringBuilder sb = {.alloc = nk_arena_getAllocator(arena)};
+    nkir_printSymbolName(nksb_getStream(&sb), sym);
+    nksb_appendNull(&sb);
+    return sb.data;
+}
+
+typedef struct {
+    NkLlvmLazySymbol info;
+    NkLlvmJitState jit;
+    NkLlvmJitDylib dl;
+} LazySymbolCtx;
+
+NK_INLINE u64 blockHash(LLVMBasicBlockRef block) {
+    return nk_hashVal(block);
+}
+
+NK_INLINE bool blockEqual(LLVMBasicBlockRef lhs, LLVMBasicBlockRef rhs) {
+    return lhs == rhs;
+}
+
+NK_HASH_TREE_DEFINE_K(BlockSet, LLVMBasicBlockRef, blockHash, blockEqual);
+
+// Renames the proc defined by the module, the original name belongs to its stub
+static LLVMValueRef renameProc(NkArena *scratch, LLVMModuleRef module, NkAtom sym, char const *suffix) {
+    LLVMValueRef proc = LLVMGetNamedFunction(module, getSymbolName(scratch, sym));
+    nk_assert(proc && "lazy proc is not defined by its module");
+
+    char const *name = nk_tprintf(scratch, "%s.%s", getSymbolName(scratch, sym), suffix);
+    LLVMSetValueName2(proc, name, strlen(name));
+
+    return proc;
+}
+
+static void queuePromotion(LazySymbolCtx const *lazy);
+
+// Makes the proc count its calls and loop iterations, and request promotion once the count reaches the threshold
+static void instrumentProc(LLVMModuleRef module, LLVMValueRef proc, LazySymbolCtx const *lazy) {
+    LLVMContextRef llvm = LLVMGetModuleContext(module);
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(llvm);
+
+    LLVMTypeRef const i64_t = LLVMInt64TypeInContext(llvm);
+    LLVMTypeRef const ptr_t = LLVMPointerTypeInContext(llvm, 0);
+    LLVMTypeRef const void_t = LLVMVoidTypeInContext(llvm);
+
+    LLVMValueRef counter = LLVMAddGlobal(module, i64_t, "nk.hot_counter");
+    LLVMSetInitializer(counter, LLVMConstInt(i64_t, 0, false));
+    LLVMSetLinkage(counter, LLVMInternalLinkage);
+
+    LLVMTypeRef const tick_t = LLVMFunctionType(void_t, NULL, 0, false);
+    LLVMValueRef tick = LLVMAddFunction(module, "nk.hot_tick", tick_t);
+    LLVMSetLinkage(tick, LLVMInternalLinkage);
+
+    {
+        LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(llvm, tick, "entry");
+        LLVMBasicBlockRef promote = LLVMAppendBasicBlockInContext(llvm, tick, "promote");
+        LLVMBasicBlockRef done = LLVMAppendBasicBlockInContext(llvm, tick, "done");
+
+        LLVMPositionBuilderAtEnd(builder, entry);
+        LLVMValueRef count = LLVMBuildAtomicRMW(
+            builder, LLVMAtomicRMWBinOpAdd, counter, LLVMConstInt(i64_t, 1, false), LLVMAtomicOrderingMonotonic, false);
+        LLVMValueRef is_hot = LLVMBuildICmp(
+            builder, LLVMIntEQ, count, LLVMConstInt(i64_t, lazy->info.hot_threshold - 1, false), "");
+        LLVMBuildCondBr(builder, is_hot, promote, done);
+
+        LLVMPositionBuilderAtEnd(builder, promote);
+        LLVMTypeRef const promote_t = LLVMFunctionType(void_t, (LLVMTypeRef[]){ptr_t}, 1, false);
+        LLVMValueRef const promote_fn = LLVMConstIntToPtr(LLVMConstInt(i64_t, (uintptr_t)queuePromotion, false), ptr_t);
+        LLVMValueRef const ctx = LLVMConstIntToPtr(LLVMConstInt(i64_t, (uintptr_t)lazy, false), ptr_t);
+        LLVMBuildCall2(builder, promote_t, promote_fn, (LLVMValueRef[]){ctx}, 1, "");
+        LLVMBuildBr(builder, done);
+
+        LLVMPositionBuilderAtEnd(builder, done);
+        LLVMBuildRetVoid(builder);
+    }
+
+    LLVMPositionBuilderBefore(builder, LLVMGetFirstInstruction(LLVMGetEntryBasicBlock(proc)));
+    LLVMBuildCall2(builder, tick_t, tick, NULL, 0, "");
+
+    // Blocks are laid out in the order of the source, so a branch to a block already seen is a loop back-edge
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        BlockSet seen = {NK_HASH_TREE_INIT(nk_arena_getAllocator(scratch))};
+
+        for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(proc); block; block = LLVMGetNextBasicBlock(block)) {
+            BlockSet_insert(&seen, block);
+
+            LLVMValueRef term = LLVMGetBasicBlockTerminator(block);
+            unsigned const succ_count = term ? LLVMGetNumSuccessors(term) : 0;
+            for (unsigned i = 0; i < succ_count; i++) {
+                if (BlockSet_find(&seen, LLVMGetSuccessor(term, i))) {
+                    LLVMPositionBuilderBefore(builder, term);
+                    LLVMBuildCall2(builder, tick_t, tick, NULL, 0, "");
+                    break;
+                }
+            }
+        }
+    }
+
+    LLVMDisposeBuilder(builder);
+}
+
+static void promoteHotProc(LazySymbolCtx const *lazy) {
+    NK_LOG_TRC("%s", __func__);
+
+    NK_PROF_FUNC() {
+        i64 const NK_UNUSED start_ns = nk_now_ns();
+
+        NkLlvmSymbolBuild const build = lazy->info.build_fn(lazy->info.sym, lazy->info.userdata);
+        nk_assert(!build.obj.size && "hot procs are never cached");
+
+        LLVMModuleRef module = m_unwrap(build.module);
+        if (!module) {
+            NK_LOG_ERR("Failed to rebuild hot proc `%s`, it stays unoptimized", nk_atom2cs(lazy->info.sym));
+        } else {
+            NK_SCRATCH_SCOPE(scratch, NULL) {
+                renameProc(scratch, module, lazy->info.sym, "hot");
+
+                char const *name = getSymbolName(scratch, lazy->info.sym);
+                char const *hot_name = nk_tprintf(scratch, "%s.hot", name);
+
+                void *addr = NULL;
+                LLVMMemoryBufferRef buf = compileJitModule(lazy->jit, module, &lazy->info.opt);
+                if (!buf) {
+                    NK_LOG_ERR("Failed to compile hot proc `%s`", name);
+                } else if (addObject(lazy->jit, lazy->dl->jd, buf)) {
+                    addr = lookupSymbol(lazy->jit->lljit, lazy->dl->jd, hot_name);
+                }
+
+                if (addr && updateStub(lazy->jit->lljit, lazy->dl->ism, name, addr)) {
+                    NK_LOG_INF(
+                        "`%s` promoted to O%c after %u calls and loop iterations, recompiled in %.2f ms",
+                        name,
+                        optLevelChar(lazy->info.opt.level),
+                        lazy->info.hot_threshold,
+                        (nk_now_ns() - start_ns) / 1e6);
+
+                    if (lazy->info.promoted_fn) {
+                        lazy->info.promoted_fn(lazy->info.sym, lazy->info.userdata);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void promotionTask(LazySymbolCtx const *lazy) {
+    NkArena err_arena = {0};
+    NkErrorState err = {.alloc = nk_arena_getAllocator(&err_arena)};
+
+    NK_ERROR_SCOPE(&err) {
+        promoteHotProc(lazy);
+    }
+
+    // Nobody waits for the promotion, so its errors can only be logged
+    for (NkErrorNode const *node = err.errors; node; node = node->next) {
+        NK_LOG_ERR(NKS_FMT, NKS_ARG(node->msg));
+    }
+    nk_arena_free(&err_arena);
+}
+
+static void promotionThread(void *arg) {
+    promotionTask(arg);
+    nk_scratch_free();
+}
+
+// Called by the hot proc, which keeps running unoptimized until the stub is redirected to the recompiled code
+static void queuePromotion(LazySymbolCtx const *lazy) {
+    NkLlvmJitState jit = lazy->jit;
+
+    bool started = false;
+    NK_MUTEX_GUARD_SCOPE(jit->mtx) {
+        NkHandle const thread = nk_thread_start(promotionThread, (void *)lazy);
+        if (!nk_handleIsNull(thread)) {
+            nkda_append(&jit->promotions, thread);
+            started = true;
+        }
+    }
+
+    if (!started) {
+        NK_LOG_WRN("Failed to start a promotion thread: %s", nk_getLastErrorString());
+        promotionTask(lazy);
+    }
+}
+
+static void materializeLazySymbol(void *ctx, LLVMOrcMaterializationResponsibilityRef mr) {
+    NK_LOG_TRC("%s", __func__);
+
+    LazySymbolCtx const *lazy = ctx;
+
+    NK_PROF_FUNC() {
+        NkLlvmSymbolBuild const build = lazy->info.build_fn(lazy->info.sym, lazy->info.userdata);
+        LLVMModuleRef module = m_unwrap(build.module);
+
+        LLVMOrcObjectLayerRef obj_layer = LLVMOrcLLJITGetObjLinkingLayer(lazy->jit->lljit);
+
+        if (build.obj.size) {
+            NK_SCRATCH_SCOPE(scratch, NULL) {
+                NK_LOG_INF("`%s` loaded from the object cache", getSymbolName(scratch, lazy->info.sym));
+            }
+
+            LLVMOrcObjectLayerEmit(obj_layer, mr, objBuffer(build.obj));
+            nk_free(nk_default_allocator, (void *)build.obj.data, build.obj.size);
+        } else if (module) {
+            NkLlvmOptProfile opt = lazy->info.opt;
+
+            NK_SCRATCH_SCOPE(scratch, NULL) {
+                if (lazy->info.is_proc) {
+                    LLVMValueRef proc = renameProc(scratch, module, lazy->info.sym, "impl");
+
+                    if (lazy->info.hot_threshold) {
+                        instrumentProc(module, proc, lazy);
+                        opt = (NkLlvmOptProfile){.level = NkLlvmOptLevel_O0};
+                    }
+                }
+
+                NK_LOG_INF(
+                    "`%s` compiled at O%c%s",
+                    getSymbolName(scratch, lazy->info.sym),
+                    optLevelChar(opt.level),
+                    lazy->info.is_proc && lazy->info.hot_threshold ? ", counting calls" : "");
+            }
+
+            LLVMMemoryBufferRef buf = compileJitModule(lazy->jit, module, &opt);
+            if (buf) {
+                if (build.cache) {
+                    nk_objcache_store(
+                        build.cache, build.key, (NkString){LLVMGetBufferStart(buf), LLVMGetBufferSize(buf)});
+                }
+                LLVMOrcObjectLayerEmit(obj_layer, mr, buf);
+            } else {
+                LLVMOrcMaterializationResponsibilityFailMaterialization(mr);
+                LLVMOrcDisposeMaterializationResponsibility(mr);
+            }
+        } else {
+            LLVMOrcMaterializationResponsibilityFailMaterialization(mr);
+            LLVMOrcDisposeMaterializationResponsibility(mr);
+        }
+    }
+}
+
+static void discardLazySymbol(void *ctx, LLVMOrcJITDylibRef jd, LLVMOrcSymbolStringPoolEntryRef sym) {
+    (void)ctx;
+    (void)jd;
+    (void)sym;
+}
+
+static void destroyLazySymbol(void *ctx) {
+    // Context is allocated in the arena passed to nk_llvm_defineLazySymbol
+    (void)ctx;
+}
+
+static bool defineInJitDylib(LLVMOrcJITDylibRef jd, LLVMOrcMaterializationUnitRef mu) {
+    LLVMErrorRef err = LLVMOrcJITDylibDefine(jd, mu);
+    if (err) {
+        char *err_msg = LLVMGetErrorMessage(err);
+        nk_error_printf("Failed to define lazy symbol: %s", err_msg);
+        LLVMDisposeErrorMessage(err_msg);
+        LLVMOrcDisposeMaterializationUnit(mu);
+        return false;
+    }
+    return true;
+}
+
+bool nk_llvm_defineLazySymbol(NkArena *arena, NkLlvmJitState jit, NkLlvmJitDylib dl, NkLlvmLazySymbol sym) {
+    NK_LOG_TRC("%s", __func__);
+
+    TRY(arena && jit && dl && sym.build_fn, false);
+    TRY(!sym.is_proc || (jit->lctm && dl->ism), false);
+
+    bool ret = true;
+    NK_PROF_FUNC() {
+        LLVMOrcJITDylibRef jd = dl->jd;
+
+        LazySymbolCtx *ctx = nk_arena_allocT(arena, LazySymbolCtx);
+        *ctx = (LazySymbolCtx){
+            .info = sym,
+            .jit = jit,
+            .dl = dl,
+        };
+
+        NK_SCRATCH_SCOPE(scratch, arena) {
+            LLVMJITSymbolFlags flags = {.GenericFlags = LLVMJITSymbolGenericFlagsExported};
+            if (sym.is_proc) {
+                flags.GenericFlags |= LLVMJITSymbolGenericFlagsCallable;
+            }
+
+            char const *name = getSymbolName(scratch, sym.sym);
+            LLVMOrcSymbolStringPoolEntryRef const impl_name =
+                LLVMOrcLLJITMangleAndIntern(jit->lljit, sym.is_proc ? nk_tprintf(scratch, "%s.impl", name) : name);
+
+            LLVMOrcCSymbolFlagsMapPair mu_sym = {
+                .Name = impl_name,
+                .Flags = flags,
+            };
+
+            if (sym.is_proc) {
+                // One reference goes to the materialization unit, the other to the stub
+                LLVMOrcRetainSymbolStringPoolEntry(impl_name);
+            }
+
+            ret = defineInJitDylib(
+                jd,
+                LLVMOrcCreateCustomMaterializationUnit(
+                    name, ctx, &mu_sym, 1, NULL, materializeLazySymbol, discardLazySymbol, destroyLazySymbol));
+
+            if (sym.is_proc) {
+                LLVMOrcCSymbolAliasMapPair stub = {
+                    .Name = LLVMOrcLLJITMangleAndIntern(jit->lljit, name),
+                    .Entry = {impl_name, flags},
+                };
+
+                if (ret) {
+                    ret = defineInJitDylib(jd, LLVMOrcLazyReexports(jit->lctm, dl->ism, jd, &stub, 1));
+                } else {
+                    LLVMOrcReleaseSymbolStringPoolEntry(stub.Name);
+                    LLVMOrcReleaseSymbolStringPoolEntry(impl_name);
+                }
+            }
+        }
+    }
+    return ret;
+}
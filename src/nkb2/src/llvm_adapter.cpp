@@ -1,5 +1,7 @@
 #include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/GlobalValue.h>
 #include <llvm/Support/Error.h>
 
 #include "llvm_adapter_internal.h"
@@ -17,3 +19,20 @@ void *lookupSymbol(LLVMOrcLLJITRef clljit, LLVMOrcJITDylibRef cjd, char const *n
     }
     return sym.get().toPtr<void *>();
 }
+
+bool updateStub(LLVMOrcLLJITRef clljit, LLVMOrcIndirectStubsManagerRef cism, char const *name, void *addr) {
+    auto *lljit = reinterpret_cast<llvm::orc::LLJIT *>(clljit);
+    auto *ism = reinterpret_cast<llvm::orc::IndirectStubsManager *>(cism);
+
+    // Stubs are named after the mangled symbol names
+    auto err = ism->updatePointer(*lljit->mangleAndIntern(name), llvm::orc::ExecutorAddr::fromPtr(addr));
+    if (err) {
+        nk_error_printf("Failed to update stub: %s", llvm::toString(std::move(err)).c_str());
+        return false;
+    }
+    return true;
+}
+
+void setDsoLocal(LLVMValueRef global) {
+    llvm::unwrap<llvm::GlobalValue>(global)->setDSOLocal(true);
+}
@@ -3,6 +3,8 @@
 #include "nkb/ir.h"
 #include "ntk/arena.h"
 #include "ntk/atom.h"
+#include "ntk/stream.h"
+#include "obj_cache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,27 +27,88 @@ typedef enum {
     NkLlvmOptLevel_Oz,
 } NkLlvmOptLevel;
 
+typedef struct {
+    NkLlvmOptLevel level;
+    NkString passes; // Replaces the default pipeline of the level if not empty
+} NkLlvmOptProfile;
+
 NkLlvmState nk_llvm_createState(NkArena *arena);
 void nk_llvm_freeState(NkLlvmState llvm);
 
+// The JIT state and its dylibs can be used from several threads at once
 NkLlvmJitState nk_llvm_createJitState(NkLlvmState llvm);
 void nk_llvm_freeJitState(NkLlvmJitState jit);
 
+// Only for inspection, JIT code is generated with copies of the target, see nk_llvm_acquireJitTarget
 NkLlvmTarget nk_llvm_getJitTarget(NkLlvmJitState jit);
 
+// Target machines cannot be shared between threads, the JIT hands out copies of its target and reuses them
+NkLlvmTarget nk_llvm_acquireJitTarget(NkLlvmJitState jit);
+void nk_llvm_releaseJitTarget(NkLlvmJitState jit, NkLlvmTarget tgt);
+
 NkLlvmJitDylib nk_llvm_createJitDylib(NkLlvmState llvm, NkLlvmJitState jit);
 
-NkLlvmTarget nk_llvm_createTarget(NkLlvmState llvm, char const *triple);
+NkLlvmTarget nk_llvm_createTarget(NkLlvmState llvm, char const *triple, char const *cpu, char const *features);
 void nk_llvm_freeTarget(NkLlvmTarget tgt);
 
+// Prints everything about the target and the LLVM build that affects the generated code
+void nk_llvm_inspectTarget(NkStream out, NkLlvmTarget tgt);
+
+// Every module gets an LLVM context of its own, which is freed along with it
 NkLlvmModule nk_llvm_compilerIr(NkArena *scratch, NkLlvmState llvm, NkIrSymbolArray ir);
-bool nk_llvm_optimizeIr(NkArena *scratch, NkLlvmModule mod, NkLlvmTarget tgt, NkLlvmOptLevel opt);
+
+// Modules that are not passed to nk_llvm_jitModule have to be freed
+void nk_llvm_freeModule(NkLlvmModule mod);
+
+// Compiles the thunk of nk_llvm_buildInvokeThunk, proc is an extern proc declaration
+NkLlvmModule nk_llvm_compileInvokeThunk(NkArena *scratch, NkLlvmState llvm, NkIrSymbol const *proc, NkAtom name);
+
+bool nk_llvm_optimizeIr(NkArena *scratch, NkLlvmModule mod, NkLlvmTarget tgt, NkLlvmOptProfile opt);
 
 bool nk_llvm_defineExternSymbols(NkArena *scratch, NkLlvmJitState jit, NkLlvmJitDylib dl, NkIrSymbolAddressArray syms);
 
-bool nk_llvm_emitObjectFile(NkLlvmModule mod, NkLlvmTarget tgt, NkString obj_file);
+bool nk_llvm_emitObject(NkLlvmModule mod, NkLlvmTarget tgt, NkAllocator alloc, NkString *out);
+
+typedef struct {
+    NkIrSymbolArray ir; // Must be self-contained, symbols of the other units are declared as externs
+    NkString obj;       // Emitted object code, allocated with nk_default_allocator
+} NkLlvmCodegenUnit;
+
+typedef NkSlice(NkLlvmCodegenUnit) NkLlvmCodegenUnitArray;
+
+// Builds, optimizes and emits every unit on a thread of its own, each with a separate LLVM context
+bool nk_llvm_emitObjectsParallel(NkLlvmTarget tgt, NkLlvmOptProfile opt, NkLlvmCodegenUnitArray units);
 
+// Compiles the module on the calling thread, the module is consumed
 bool nk_llvm_jitModule(NkLlvmModule mod, NkLlvmJitState jit, NkLlvmJitDylib dl);
+bool nk_llvm_jitObject(NkLlvmJitState jit, NkLlvmJitDylib dl, NkString obj);
+
+typedef struct {
+    NkLlvmModule module; // Unoptimized module defining the symbol
+    NkString obj;        // Or its object code loaded from the cache, allocated with nk_default_allocator
+    NkObjCache cache;    // If set, the object code compiled from the module is stored under the key
+    NkObjCacheKey key;
+} NkLlvmSymbolBuild;
+
+// Called when the symbol is needed for the first time, returns neither module nor object on failure
+typedef NkLlvmSymbolBuild (*NkLlvmSymbolBuilder)(NkAtom sym, void *userdata);
+// Called on the promotion thread once the calls go to the optimized code
+typedef void (*NkLlvmSymbolPromoted)(NkAtom sym, void *userdata);
+
+typedef struct {
+    NkAtom sym;
+    bool is_proc; // Procs are compiled on the first call through a stub, data on the first reference
+    NkLlvmOptProfile opt;
+    // Procs with a hot threshold are compiled at O0 first, counting their calls and loop iterations,
+    // and are recompiled with opt on a thread of their own once the count reaches the threshold
+    u32 hot_threshold;
+    NkLlvmSymbolBuilder build_fn;
+    NkLlvmSymbolPromoted promoted_fn; // Optional
+    void *userdata;
+} NkLlvmLazySymbol;
+
+// The symbol keeps its info in arena until the JIT state is freed
+bool nk_llvm_defineLazySymbol(NkArena *arena, NkLlvmJitState jit, NkLlvmJitDylib dl, NkLlvmLazySymbol sym);
 void *nk_llvm_getSymbolAddress(NkLlvmJitState jit, NkLlvmJitDylib dl, NkAtom sym);
 
 #ifdef __cplusplus
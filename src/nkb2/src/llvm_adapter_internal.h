@@ -7,6 +7,7 @@
 
 #include "llvm_adapter.h"
 #include "ntk/arena.h"
+#include "ntk/dyn_array.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,17 +15,31 @@ extern "C" {
 
 typedef struct NkLlvmState_T {
     NkArena *arena;
-    LLVMContextRef ctx;
 } NkLlvmState_T;
 
 typedef struct NkLlvmJitState_T {
     LLVMOrcLLJITRef lljit;
-    LLVMOrcThreadSafeContextRef tsc;
     LLVMTargetMachineRef tm;
+    NkDynArray(LLVMTargetMachineRef) free_tms; // Copies of tm not in use by any thread
+    NkHandle mtx;
+    LLVMOrcLazyCallThroughManagerRef lctm;
+    NkDynArray(struct NkLlvmJitDylib_T *) dylibs;
+    NkDynArray(NkHandle) promotions; // Threads recompiling hot procs, joined when the state is freed
 } NkLlvmJitState_T;
 
+typedef struct NkLlvmJitDylib_T {
+    LLVMOrcJITDylibRef jd;
+    // Stubs are named after the symbols, so modules defining the same names cannot share a stubs manager
+    LLVMOrcIndirectStubsManagerRef ism;
+} NkLlvmJitDylib_T;
+
 void *lookupSymbol(LLVMOrcLLJITRef jit, LLVMOrcJITDylibRef jd, char const *name);
 
+// Redirects the stub of a lazily compiled proc
+bool updateStub(LLVMOrcLLJITRef jit, LLVMOrcIndirectStubsManagerRef ism, char const *name, void *addr);
+
+void setDsoLocal(LLVMValueRef global);
+
 #ifdef __cplusplus
 }
 #endif
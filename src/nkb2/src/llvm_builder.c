@@ -0,0 +1,968 @@
+#include "llvm_builder.h"
+
+#include <llvm-c/Core.h>
+#include <string.h>
+
+#include "common.h"
+#include "llvm_adapter_internal.h"
+#include "nkb/ir.h"
+#include "nkb/types.h"
+#include "ntk/allocator.h"
+#include "ntk/arena.h"
+#include "ntk/atom.h"
+#include "ntk/common.h"
+#include "ntk/error.h"
+#include "ntk/hash_tree.h"
+#include "ntk/log.h"
+#include "ntk/profiler.h"
+#include "ntk/string.h"
+#include "ntk/string_builder.h"
+#include "ntk/utils.h"
+
+NK_LOG_USE_SCOPE(llvm_builder);
+
+// Builds the same module as the textual emitter in llvm_emitter.c, but directly through the C API.
+// Locals are SSA values, pointers are converted to integers and back at the same places the emitter does it.
+
+NK_INLINE u64 irTypeHash(NkIrType type) {
+    return nk_hashVal(type);
+}
+
+NK_INLINE bool irTypeEqual(NkIrType lhs, NkIrType rhs) {
+    return lhs == rhs;
+}
+
+NK_HASH_TREE_DEFINE_KV(LlvmValueMap, NkAtom, LLVMValueRef, nk_atom_hash, nk_atom_equal);
+NK_HASH_TREE_DEFINE_KV(LlvmTypeMap, NkIrType, LLVMTypeRef, irTypeHash, irTypeEqual);
+
+typedef struct {
+    NkIrInstrArray instrs;
+
+    LabelArray labels;
+    LLVMBasicBlockRef *blocks;
+
+    LlvmValueMap locals;
+
+    usize next_label;
+} ProcContext;
+
+typedef struct {
+    NkArena *scratch;
+
+    LLVMContextRef llvm;
+    LLVMModuleRef module;
+    LLVMBuilderRef builder;
+
+    LLVMTypeRef ptr_t;
+    LLVMTypeRef void_t;
+
+    unsigned sret_kind;
+    unsigned byval_kind;
+    unsigned align_kind;
+
+    LlvmValueMap globals;
+    LlvmTypeMap types; // Only types without relocations are cached
+
+    ProcContext proc;
+
+    bool failed;
+} Context;
+
+static LLVMTypeRef getTypeEx(Context *ctx, NkIrType type, usize base_offset, NkIrRelocArray relocs);
+
+static LLVMTypeRef getType(Context *ctx, NkIrType type) {
+    return getTypeEx(ctx, type, 0, (NkIrRelocArray){0});
+}
+
+static NkIrReloc const *findReloc(NkIrRelocArray relocs, usize offset) {
+    NK_ITERATE(NkIrReloc const *, reloc, relocs) {
+        if (reloc->offset == offset) {
+            return reloc;
+        }
+    }
+    return NULL;
+}
+
+static LLVMTypeRef buildNumericType(Context *ctx, NkIrNumericValueType value_type) {
+    switch (value_type) {
+        case Int8:
+        case Uint8:
+            return LLVMInt8TypeInContext(ctx->llvm);
+        case Int16:
+        case Uint16:
+            return LLVMInt16TypeInContext(ctx->llvm);
+        case Int32:
+        case Uint32:
+            return LLVMInt32TypeInContext(ctx->llvm);
+        case Int64:
+        case Uint64:
+            return LLVMInt64TypeInContext(ctx->llvm);
+        case Float32:
+            return LLVMFloatTypeInContext(ctx->llvm);
+        case Float64:
+            return LLVMDoubleTypeInContext(ctx->llvm);
+    }
+
+    nk_assert(!"unreachable");
+    return NULL;
+}
+
+static LLVMTypeRef buildAggregateType(Context *ctx, NkIrType type, usize base_offset, NkIrRelocArray relocs) {
+    if (!type->size) {
+        return ctx->void_t;
+    }
+
+    LLVMTypeRef *elem_types = nk_arena_allocTn(ctx->scratch, LLVMTypeRef, type->aggr.size);
+
+    NK_ITERATE(NkIrAggregateElemInfo const *, elem, type->aggr) {
+        usize const offset = base_offset + elem->offset;
+
+        LLVMTypeRef elem_t = elem->type->kind == NkIrType_Numeric && findReloc(relocs, offset)
+                                 ? ctx->ptr_t
+                                 : getTypeEx(ctx, elem->type, offset, relocs);
+        if (elem->count > 1) {
+            elem_t = LLVMArrayType(elem_t, elem->count);
+        }
+
+        elem_types[NK_INDEX(elem, type->aggr)] = elem_t;
+    }
+
+    return LLVMStructTypeInContext(ctx->llvm, elem_types, type->aggr.size, false);
+}
+
+static LLVMTypeRef getTypeEx(Context *ctx, NkIrType type, usize base_offset, NkIrRelocArray relocs) {
+    if (!type) {
+        return ctx->void_t;
+    }
+
+    if (!relocs.size) {
+        LLVMTypeRef const *found = LlvmTypeMap_find(&ctx->types, type);
+        if (found) {
+            return *found;
+        }
+    }
+
+    LLVMTypeRef llvm_type = NULL;
+
+    switch (type->kind) {
+        case NkIrType_Aggregate:
+            llvm_type = buildAggregateType(ctx, type, base_offset, relocs);
+            break;
+
+        case NkIrType_Numeric:
+            llvm_type = buildNumericType(ctx, type->num);
+            break;
+    }
+
+    if (!relocs.size) {
+        LlvmTypeMap_insert(&ctx->types, type, llvm_type);
+    }
+
+    return llvm_type;
+}
+
+static char const *getSymbolName(Context *ctx, NkAtom sym) {
+    NkString const str = nk_atom2s(sym);
+    if (str.size) {
+        return str.data;
+    }
+
+    NkStringBuilder sb = {.alloc = nk_arena_getAllocator(ctx->scratch)};
+    nkir_printSymbolName(nksb_getStream(&sb), sym);
+    nksb_appendNull(&sb);
+    return sb.data;
+}
+
+static LLVMValueRef getGlobal(Context *ctx, NkAtom sym) {
+    LLVMValueRef const *found = LlvmValueMap_find(&ctx->globals, sym);
+    if (!found) {
+        nk_error_printf("Undefined symbol `%s`", getSymbolName(ctx, sym));
+        ctx->failed = true;
+        return LLVMConstNull(ctx->ptr_t);
+    }
+    return *found;
+}
+
+static void setVisibility(LLVMValueRef global, NkIrVisibility vis) {
+    switch (vis) {
+        case NkIrVisibility_Hidden:
+            LLVMSetVisibility(global, LLVMHiddenVisibility);
+            break;
+        case NkIrVisibility_Default:
+            setDsoLocal(global);
+            break;
+        case NkIrVisibility_Protected:
+            LLVMSetVisibility(global, LLVMProtectedVisibility);
+            break;
+        case NkIrVisibility_Internal:
+            LLVMSetVisibility(global, LLVMHiddenVisibility);
+            break;
+        case NkIrVisibility_Local:
+            LLVMSetLinkage(global, LLVMInternalLinkage);
+            break;
+        case NkIrVisibility_Unknown:
+            nk_assert(!"unreachable");
+            break;
+    }
+}
+
+static LLVMAttributeRef makeTypeAttr(Context *ctx, unsigned kind, NkIrType type) {
+    return LLVMCreateTypeAttribute(ctx->llvm, kind, getType(ctx, type));
+}
+
+static LLVMAttributeRef makeAlignAttr(Context *ctx, NkIrType type) {
+    return LLVMCreateEnumAttribute(ctx->llvm, ctx->align_kind, type->align);
+}
+
+static LLVMValueRef buildNumericConst(Context *ctx, void const *addr, NkIrType type) {
+    LLVMTypeRef const llvm_type = getType(ctx, type);
+
+    switch (type->num) {
+        case Int8:
+            return LLVMConstInt(llvm_type, (u64)(*(i8 const *)addr), true);
+        case Uint8:
+            return LLVMConstInt(llvm_type, *(u8 const *)addr, false);
+        case Int16:
+            return LLVMConstInt(llvm_type, (u64)(*(i16 const *)addr), true);
+        case Uint16:
+            return LLVMConstInt(llvm_type, *(u16 const *)addr, false);
+        case Int32:
+            return LLVMConstInt(llvm_type, (u64)(*(i32 const *)addr), true);
+        case Uint32:
+            return LLVMConstInt(llvm_type, *(u32 const *)addr, false);
+        case Int64:
+            return LLVMConstInt(llvm_type, (u64)(*(i64 const *)addr), true);
+        case Uint64:
+            return LLVMConstInt(llvm_type, *(u64 const *)addr, false);
+        case Float32:
+            return LLVMConstReal(llvm_type, *(f32 const *)addr);
+        case Float64:
+            return LLVMConstReal(llvm_type, *(f64 const *)addr);
+    }
+
+    nk_assert(!"unreachable");
+    return NULL;
+}
+
+static LLVMValueRef buildConst(
+    Context *ctx,
+    u8 const *base_addr,
+    usize base_offset,
+    NkIrRelocArray relocs,
+    NkIrType type) {
+    switch (type->kind) {
+        case NkIrType_Aggregate: {
+            LLVMValueRef *elems = nk_arena_allocTn(ctx->scratch, LLVMValueRef, type->aggr.size);
+
+            NK_ITERATE(NkIrAggregateElemInfo const *, elem, type->aggr) {
+                usize offset = base_offset + elem->offset;
+
+                LLVMValueRef elem_val = NULL;
+                if (elem->count > 1 && elem->type->kind == NkIrType_Numeric && elem->type->size == 1) {
+                    elem_val = LLVMConstStringInContext(ctx->llvm, (char const *)base_addr + offset, elem->count, true);
+                } else {
+                    LLVMValueRef *vals = nk_arena_allocTn(ctx->scratch, LLVMValueRef, elem->count);
+                    for (usize i = 0; i < elem->count; i++) {
+                        NkIrReloc const *reloc =
+                            elem->type->kind == NkIrType_Numeric ? findReloc(relocs, offset) : NULL;
+                        vals[i] = reloc ? getGlobal(ctx, reloc->sym)
+                                        : buildConst(ctx, base_addr, offset, relocs, elem->type);
+                        offset += elem->type->size;
+                    }
+                    elem_val = elem->count > 1 ? LLVMConstArray(LLVMTypeOf(vals[0]), vals, elem->count) : vals[0];
+                }
+
+                elems[NK_INDEX(elem, type->aggr)] = elem_val;
+            }
+
+            return LLVMConstStructInContext(ctx->llvm, elems, type->aggr.size, false);
+        }
+
+        case NkIrType_Numeric:
+            return buildNumericConst(ctx, base_addr + base_offset, type);
+    }
+
+    nk_assert(!"unreachable");
+    return NULL;
+}
+
+static LLVMValueRef declareProc(
+    Context *ctx,
+    NkAtom name,
+    NkIrType ret_t,
+    bool sret,
+    NkIrTypeArray param_types,
+    bool variadic) {
+    usize const arg_count = param_types.size + sret;
+    LLVMTypeRef *arg_types = nk_arena_allocTn(ctx->scratch, LLVMTypeRef, arg_count);
+
+    usize arg_idx = 0;
+    if (sret) {
+        arg_types[arg_idx++] = ctx->ptr_t;
+    }
+    NK_ITERATE(NkIrType const *, type, param_types) {
+        arg_types[arg_idx++] = (*type)->kind == NkIrType_Aggregate ? ctx->ptr_t : getType(ctx, *type);
+    }
+
+    LLVMTypeRef const proc_t =
+        LLVMFunctionType(sret ? ctx->void_t : getType(ctx, ret_t), arg_types, arg_count, variadic);
+    LLVMValueRef const proc = LLVMAddFunction(ctx->module, getSymbolName(ctx, name), proc_t);
+
+    if (sret) {
+        LLVMAddAttributeAtIndex(proc, 1, makeTypeAttr(ctx, ctx->sret_kind, ret_t));
+        LLVMAddAttributeAtIndex(proc, 1, makeAlignAttr(ctx, ret_t));
+    }
+    NK_ITERATE(NkIrType const *, type, param_types) {
+        if ((*type)->kind == NkIrType_Aggregate) {
+            LLVMAttributeIndex const attr_idx = 1 + sret + NK_INDEX(type, param_types);
+            LLVMAddAttributeAtIndex(proc, attr_idx, makeTypeAttr(ctx, ctx->byval_kind, *type));
+            LLVMAddAttributeAtIndex(proc, attr_idx, makeAlignAttr(ctx, *type));
+        }
+    }
+
+    return proc;
+}
+
+static void declareSymbol(Context *ctx, NkIrSymbol const *sym) {
+    LLVMValueRef global = NULL;
+
+    switch (sym->kind) {
+        case NkIrSymbol_None:
+            return;
+
+        case NkIrSymbol_Proc: {
+            NkIrParamArray const params = sym->proc.params;
+            NkIrType *param_types = nk_arena_allocTn(ctx->scratch, NkIrType, params.size);
+            NK_ITERATE(NkIrParam const *, param, params) {
+                param_types[NK_INDEX(param, params)] = param->type;
+            }
+
+            global = declareProc(
+                ctx,
+                sym->name,
+                sym->proc.ret.type,
+                sym->proc.ret.name,
+                (NkIrTypeArray){param_types, params.size},
+                false);
+            setVisibility(global, sym->vis);
+            break;
+        }
+
+        case NkIrSymbol_Data: {
+            NkIrData const *data = &sym->data;
+            LLVMTypeRef const type = getTypeEx(ctx, data->type, 0, data->addr ? data->relocs : (NkIrRelocArray){0});
+
+            global = LLVMAddGlobal(ctx->module, type, getSymbolName(ctx, sym->name));
+            LLVMSetGlobalConstant(global, (data->flags & NkIrData_ReadOnly) != 0);
+            setVisibility(global, sym->vis);
+            break;
+        }
+
+        case NkIrSymbol_Extern:
+            switch (sym->extrn.kind) {
+                case NkIrExtern_Proc: {
+                    NkIrType const ret_t = sym->extrn.proc.ret_type;
+                    global = declareProc(
+                        ctx,
+                        sym->name,
+                        ret_t,
+                        ret_t->kind == NkIrType_Aggregate && ret_t->size,
+                        sym->extrn.proc.param_types,
+                        sym->extrn.proc.flags & NkIrProc_Variadic);
+                    break;
+                }
+
+                case NkIrExtern_Data:
+                    global =
+                        LLVMAddGlobal(ctx->module, getType(ctx, sym->extrn.data.type), getSymbolName(ctx, sym->name));
+                    break;
+            }
+            break;
+    }
+
+    LlvmValueMap_insert(&ctx->globals, sym->name, global)->val = global;
+}
+
+static void defineLocal(Context *ctx, NkIrRef const *ref, LLVMValueRef val) {
+    nk_assert(ref->kind == NkIrRef_Local && "invalid destination");
+    LlvmValueMap_insert(&ctx->proc.locals, ref->sym, val)->val = val;
+}
+
+static LLVMValueRef getRef(Context *ctx, NkIrRef const *ref) {
+    switch (ref->kind) {
+        case NkIrRef_None:
+        case NkIrRef_VariadicMarker:
+            return NULL;
+
+        case NkIrRef_Null:
+            return LLVMConstNull(getType(ctx, ref->type));
+
+        case NkIrRef_Local:
+        case NkIrRef_Param: {
+            LLVMValueRef const *found = LlvmValueMap_find(&ctx->proc.locals, ref->sym);
+            if (!found) {
+                nk_error_printf("Use of undefined local `%s`", getSymbolName(ctx, ref->sym));
+                ctx->failed = true;
+                return LLVMGetUndef(getType(ctx, ref->type));
+            }
+            return *found;
+        }
+
+        case NkIrRef_Global:
+            return getGlobal(ctx, ref->sym);
+
+        case NkIrRef_Imm:
+            return buildNumericConst(ctx, &ref->imm, ref->type);
+    }
+
+    nk_assert(!"unreachable");
+    return NULL;
+}
+
+static bool isPtr(LLVMValueRef val) {
+    return LLVMGetTypeKind(LLVMTypeOf(val)) == LLVMPointerTypeKind;
+}
+
+static LLVMValueRef getRefAsInt(Context *ctx, NkIrRef const *ref) {
+    LLVMValueRef const val = getRef(ctx, ref);
+    return isPtr(val) ? LLVMBuildPtrToInt(ctx->builder, val, getType(ctx, ref->type), "") : val;
+}
+
+static LLVMValueRef getRefAsPtr(Context *ctx, NkIrRef const *ref) {
+    LLVMValueRef const val = getRef(ctx, ref);
+    return isPtr(val) ? val : LLVMBuildIntToPtr(ctx->builder, val, ctx->ptr_t, "");
+}
+
+static LLVMBasicBlockRef getLabelBlock(Context *ctx, NkIrInstr const *instr, usize arg_idx) {
+    NkIrArg const *arg = &instr->arg[arg_idx];
+    usize const instr_idx = NK_INDEX(instr, ctx->proc.instrs);
+
+    Label const *label = NULL;
+
+    switch (arg->kind) {
+        case NkIrArg_Label:
+            label = findLabelByName(ctx->proc.labels, arg->label);
+            break;
+
+        case NkIrArg_LabelRel:
+            label = findLabelByIdx(ctx->proc.labels, instr_idx + arg->offset);
+            break;
+
+        default:
+            nk_assert(!"unreachable");
+            break;
+    }
+
+    nk_assert(label && "invalid label");
+
+    return ctx->proc.blocks[NK_INDEX(label, ctx->proc.labels)];
+}
+
+static LLVMBasicBlockRef insertBlockAfterCurrent(Context *ctx) {
+    LLVMBasicBlockRef const current = LLVMGetInsertBlock(ctx->builder);
+    LLVMBasicBlockRef const block = LLVMAppendBasicBlockInContext(ctx->llvm, LLVMGetBasicBlockParent(current), "");
+    LLVMMoveBasicBlockAfter(block, current);
+    return block;
+}
+
+static void buildBinop(Context *ctx, NkIrInstr const *instr, LLVMOpcode sop, LLVMOpcode uop, LLVMOpcode fop) {
+    NkIrRef const *ref0 = &instr->arg[0].ref;
+    NkIrRef const *ref1 = &instr->arg[1].ref;
+    NkIrRef const *ref2 = &instr->arg[2].ref;
+
+    LLVMValueRef const lhs = getRefAsInt(ctx, ref1);
+    LLVMValueRef const rhs = getRefAsInt(ctx, ref2);
+
+    NkIrType const type = ref1->type;
+
+    nk_assert(type->kind == NkIrType_Numeric);
+
+    LLVMOpcode const op = NKIR_NUMERIC_IS_FLT(type->num) ? fop : NKIR_NUMERIC_IS_SIGNED(type->num) ? sop : uop;
+
+    defineLocal(ctx, ref0, LLVMBuildBinOp(ctx->builder, op, lhs, rhs, ""));
+}
+
+static void buildLogic(Context *ctx, NkIrInstr const *instr, LLVMOpcode sop, LLVMOpcode uop) {
+    nk_assert(NKIR_NUMERIC_IS_INT(instr->arg[1].ref.type->num));
+    buildBinop(ctx, instr, sop, uop, sop);
+}
+
+static void buildCondJmp(Context *ctx, NkIrInstr const *instr, LLVMIntPredicate ipred, LLVMRealPredicate fpred) {
+    NkIrRef const *ref1 = &instr->arg[1].ref;
+
+    NkIrType const type = ref1->type;
+    nk_assert(type->kind == NkIrType_Numeric);
+
+    LLVMValueRef const val = getRef(ctx, ref1);
+    LLVMValueRef const zero = LLVMConstNull(LLVMTypeOf(val));
+
+    LLVMValueRef const cond = NKIR_NUMERIC_IS_INT(type->num) ? LLVMBuildICmp(ctx->builder, ipred, val, zero, "")
+                                                             : LLVMBuildFCmp(ctx->builder, fpred, val, zero, "");
+
+    LLVMBasicBlockRef const next = insertBlockAfterCurrent(ctx);
+    LLVMBuildCondBr(ctx->builder, cond, getLabelBlock(ctx, instr, 2), next);
+    LLVMPositionBuilderAtEnd(ctx->builder, next);
+}
+
+static void buildCmp(
+    Context *ctx,
+    NkIrInstr const *instr,
+    LLVMIntPredicate spred,
+    LLVMIntPredicate upred,
+    LLVMRealPredicate fpred) {
+    NkIrRef const *ref0 = &instr->arg[0].ref;
+    NkIrRef const *ref1 = &instr->arg[1].ref;
+    NkIrRef const *ref2 = &instr->arg[2].ref;
+
+    NkIrType const type = ref1->type;
+    NkIrType const dst_type = ref0->type;
+
+    nk_assert(type->kind == NkIrType_Numeric);
+
+    nk_assert(dst_type->kind == NkIrType_Numeric);
+    nk_assert(NKIR_NUMERIC_IS_INT(dst_type->num));
+
+    LLVMValueRef const lhs = getRefAsInt(ctx, ref1);
+    LLVMValueRef const rhs = getRefAsInt(ctx, ref2);
+
+    LLVMValueRef const cond =
+        NKIR_NUMERIC_IS_INT(type->num)
+            ? LLVMBuildICmp(ctx->builder, NKIR_NUMERIC_IS_SIGNED(type->num) ? spred : upred, lhs, rhs, "")
+            : LLVMBuildFCmp(ctx->builder, fpred, lhs, rhs, "");
+
+    LLVMTypeRef const dst_t = getType(ctx, dst_type);
+    defineLocal(
+        ctx,
+        ref0,
+        NKIR_NUMERIC_IS_SIGNED(dst_type->num) ? LLVMBuildSExt(ctx->builder, cond, dst_t, "")
+                                              : LLVMBuildZExt(ctx->builder, cond, dst_t, ""));
+}
+
+static LLVMOpcode getCastOpcode(NkIrType src_t, NkIrType dst_t) {
+    bool const src_is_int = NKIR_NUMERIC_IS_INT(src_t->num);
+    bool const dst_is_int = NKIR_NUMERIC_IS_INT(dst_t->num);
+    bool const src_is_signed = NKIR_NUMERIC_IS_SIGNED(src_t->num);
+    bool const dst_is_signed = NKIR_NUMERIC_IS_SIGNED(dst_t->num);
+
+    if (src_is_int == dst_is_int) {
+        if (src_t->size == dst_t->size) {
+            return LLVMBitCast;
+        } else if (src_t->size < dst_t->size) {
+            return src_is_int ? (src_is_signed ? LLVMSExt : LLVMZExt) : LLVMFPExt;
+        } else {
+            return src_is_int ? LLVMTrunc : LLVMFPTrunc;
+        }
+    } else if (src_is_int) {
+        return src_is_signed ? LLVMSIToFP : LLVMUIToFP;
+    } else {
+        return dst_is_signed ? LLVMFPToSI : LLVMFPToUI;
+    }
+}
+
+static void buildCast(Context *ctx, NkIrInstr const *instr) {
+    NkIrRef const *ref0 = &instr->arg[0].ref;
+    NkIrRef const *ref1 = &instr->arg[1].ref;
+
+    NkIrType const src_t = ref1->type;
+    NkIrType const dst_t = ref0->type;
+    nk_assert(src_t->kind == NkIrType_Numeric);
+    nk_assert(dst_t->kind == NkIrType_Numeric);
+
+    LLVMValueRef const val = getRefAsInt(ctx, ref1);
+    defineLocal(
+        ctx, ref0, LLVMBuildCast(ctx->builder, getCastOpcode(src_t, dst_t), val, getType(ctx, dst_t), ""));
+}
+
+static void buildCall(Context *ctx, NkIrInstr const *instr) {
+    NkIrRef const *ref0 = &instr->arg[0].ref;
+    NkIrRef const *ref1 = &instr->arg[1].ref;
+    NkIrRefArray const arg_refs = instr->arg[2].refs;
+
+    LLVMValueRef const proc = getRefAsPtr(ctx, ref1);
+
+    bool const has_dst = ref0->kind && ref0->kind != NkIrRef_Null;
+    bool const sret = has_dst && ref0->type->kind == NkIrType_Aggregate && ref0->type->size;
+
+    usize const max_arg_count = arg_refs.size + sret;
+    LLVMValueRef *args = nk_arena_allocTn(ctx->scratch, LLVMValueRef, max_arg_count);
+    LLVMTypeRef *param_types = nk_arena_allocTn(ctx->scratch, LLVMTypeRef, max_arg_count);
+
+    usize arg_count = 0;
+    usize param_count = 0;
+    bool variadic = false;
+
+    if (sret) {
+        args[arg_count++] = getRefAsPtr(ctx, ref0);
+        param_types[param_count++] = ctx->ptr_t;
+    }
+
+    NK_ITERATE(NkIrRef const *, arg_ref, arg_refs) {
+        if (arg_ref->kind == NkIrRef_VariadicMarker) {
+            variadic = true;
+            continue;
+        }
+        LLVMValueRef const arg = getRef(ctx, arg_ref);
+        if (!variadic) {
+            param_types[param_count++] = LLVMTypeOf(arg);
+        }
+        args[arg_count++] = arg;
+    }
+
+    LLVMTypeRef const ret_t = sret || !ref0->kind ? ctx->void_t : getType(ctx, ref0->type);
+    LLVMTypeRef const proc_t = LLVMFunctionType(ret_t, param_types, param_count, variadic);
+
+    LLVMValueRef const call = LLVMBuildCall2(ctx->builder, proc_t, proc, args, arg_count, "");
+
+    if (sret) {
+        LLVMAddCallSiteAttribute(call, 1, makeTypeAttr(ctx, ctx->sret_kind, ref0->type));
+        LLVMAddCallSiteAttribute(call, 1, makeAlignAttr(ctx, ref0->type));
+    } else if (has_dst) {
+        defineLocal(ctx, ref0, call);
+    }
+}
+
+static void buildInstr(Context *ctx, NkIrInstr const *instr) {
+    if (instr->code == NkIrOp_nop || instr->code == NkIrOp_comment) {
+        return;
+    }
+
+    LLVMBasicBlockRef const current = LLVMGetInsertBlock(ctx->builder);
+
+    if (instr->code == NkIrOp_label) {
+        // Labels are collected in order, so the next one always belongs to this instruction
+        LLVMBasicBlockRef const block = ctx->proc.blocks[ctx->proc.next_label++];
+        if (!LLVMGetBasicBlockTerminator(current)) {
+            LLVMBuildBr(ctx->builder, block);
+        }
+        LLVMPositionBuilderAtEnd(ctx->builder, block);
+        return;
+    }
+
+    if (LLVMGetBasicBlockTerminator(current)) {
+        // Unreachable code after a terminator still needs a block to live in
+        LLVMPositionBuilderAtEnd(ctx->builder, insertBlockAfterCurrent(ctx));
+    }
+
+    NkIrRef const *ref0 = &instr->arg[0].ref;
+    NkIrRef const *ref1 = &instr->arg[1].ref;
+
+    switch ((NkIrOpcode)instr->code) {
+        case NkIrOp_nop:
+        case NkIrOp_comment:
+        case NkIrOp_label:
+            break;
+
+        case NkIrOp_mov: {
+            LLVMValueRef const val = getRefAsInt(ctx, ref1);
+            defineLocal(ctx, ref0, LLVMBuildBitCast(ctx->builder, val, getType(ctx, ref0->type), ""));
+            break;
+        }
+
+        case NkIrOp_cast:
+            buildCast(ctx, instr);
+            break;
+
+        case NkIrOp_alloc: {
+            LLVMValueRef const ptr = LLVMBuildAlloca(ctx->builder, getType(ctx, instr->arg[1].type), "");
+            defineLocal(ctx, ref0, LLVMBuildPtrToInt(ctx->builder, ptr, getType(ctx, ref0->type), ""));
+            break;
+        }
+
+        case NkIrOp_load: {
+            LLVMValueRef const ptr = getRefAsPtr(ctx, ref1);
+            defineLocal(ctx, ref0, LLVMBuildLoad2(ctx->builder, getType(ctx, ref0->type), ptr, ""));
+            break;
+        }
+
+        case NkIrOp_store: {
+            LLVMValueRef const ptr = getRefAsPtr(ctx, ref0);
+            LLVMBuildStore(ctx->builder, getRef(ctx, ref1), ptr);
+            break;
+        }
+
+        case NkIrOp_jmp:
+            LLVMBuildBr(ctx->builder, getLabelBlock(ctx, instr, 1));
+            break;
+
+        case NkIrOp_jmpz:
+            buildCondJmp(ctx, instr, LLVMIntEQ, LLVMRealOEQ);
+            break;
+
+        case NkIrOp_jmpnz:
+            buildCondJmp(ctx, instr, LLVMIntNE, LLVMRealONE);
+            break;
+
+        case NkIrOp_cmp_eq:
+            buildCmp(ctx, instr, LLVMIntEQ, LLVMIntEQ, LLVMRealOEQ);
+            break;
+        case NkIrOp_cmp_ne:
+            buildCmp(ctx, instr, LLVMIntNE, LLVMIntNE, LLVMRealONE);
+            break;
+        case NkIrOp_cmp_gt:
+            buildCmp(ctx, instr, LLVMIntSGT, LLVMIntUGT, LLVMRealOGT);
+            break;
+        case NkIrOp_cmp_ge:
+            buildCmp(ctx, instr, LLVMIntSGE, LLVMIntUGE, LLVMRealOGE);
+            break;
+        case NkIrOp_cmp_lt:
+            buildCmp(ctx, instr, LLVMIntSLT, LLVMIntULT, LLVMRealOLT);
+            break;
+        case NkIrOp_cmp_le:
+            buildCmp(ctx, instr, LLVMIntSLE, LLVMIntULE, LLVMRealOLE);
+            break;
+
+        case NkIrOp_add:
+            buildBinop(ctx, instr, LLVMAdd, LLVMAdd, LLVMFAdd);
+            break;
+        case NkIrOp_sub:
+            buildBinop(ctx, instr, LLVMSub, LLVMSub, LLVMFSub);
+            break;
+        case NkIrOp_mul:
+            buildBinop(ctx, instr, LLVMMul, LLVMMul, LLVMFMul);
+            break;
+
+        case NkIrOp_div:
+            buildBinop(ctx, instr, LLVMSDiv, LLVMUDiv, LLVMFDiv);
+            break;
+        case NkIrOp_mod:
+            buildBinop(ctx, instr, LLVMSRem, LLVMURem, LLVMFRem);
+            break;
+
+        case NkIrOp_and:
+            buildLogic(ctx, instr, LLVMAnd, LLVMAnd);
+            break;
+        case NkIrOp_or:
+            buildLogic(ctx, instr, LLVMOr, LLVMOr);
+            break;
+        case NkIrOp_xor:
+            buildLogic(ctx, instr, LLVMXor, LLVMXor);
+            break;
+        case NkIrOp_lsh:
+            buildLogic(ctx, instr, LLVMShl, LLVMShl);
+            break;
+        case NkIrOp_rsh:
+            buildLogic(ctx, instr, LLVMAShr, LLVMLShr);
+            break;
+
+        case NkIrOp_call:
+            buildCall(ctx, instr);
+            break;
+
+        case NkIrOp_ret:
+            if (ref1->kind) {
+                LLVMBuildRet(ctx->builder, getRef(ctx, ref1));
+            } else {
+                LLVMBuildRetVoid(ctx->builder);
+            }
+            break;
+    }
+}
+
+static void bindParam(Context *ctx, LLVMValueRef proc, usize idx, NkAtom name) {
+    LLVMValueRef const param = LLVMGetParam(proc, idx);
+    NkString const str = nk_atom2s(name);
+    LLVMSetValueName2(param, str.data, str.size);
+    LlvmValueMap_insert(&ctx->proc.locals, name, param)->val = param;
+}
+
+static void defineProc(Context *ctx, NkIrSymbol const *sym) {
+    NkIrProc const *proc = &sym->proc;
+    LLVMValueRef const llvm_proc = getGlobal(ctx, sym->name);
+
+    LabelDynArray da_labels = {.alloc = nk_arena_getAllocator(ctx->scratch)};
+    LabelArray const labels = collectLabels(proc->instrs, &da_labels);
+
+    ctx->proc = (ProcContext){
+        .instrs = proc->instrs,
+
+        .labels = labels,
+        .blocks = nk_arena_allocTn(ctx->scratch, LLVMBasicBlockRef, labels.size),
+
+        .locals = {NK_HASH_TREE_INIT(nk_arena_getAllocator(ctx->scratch))},
+
+        .next_label = 0,
+    };
+
+    // A separate entry block, because the entry block cannot be a jump target.
+    // Duplicate label names are made unique by LLVM.
+    LLVMBasicBlockRef const entry = LLVMAppendBasicBlockInContext(ctx->llvm, llvm_proc, "entry");
+    NK_ITERATE(Label const *, label, labels) {
+        ctx->proc.blocks[NK_INDEX(label, labels)] =
+            LLVMAppendBasicBlockInContext(ctx->llvm, llvm_proc, nk_atom2cs(label->name));
+    }
+    LLVMPositionBuilderAtEnd(ctx->builder, entry);
+
+    usize param_idx = 0;
+    if (proc->ret.name) {
+        bindParam(ctx, llvm_proc, param_idx++, proc->ret.name);
+    }
+    NK_ITERATE(NkIrParam const *, param, proc->params) {
+        bindParam(ctx, llvm_proc, param_idx++, param->name);
+    }
+
+    NK_ITERATE(NkIrInstr const *, instr, proc->instrs) {
+        buildInstr(ctx, instr);
+    }
+
+    if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder))) {
+        LLVMBuildUnreachable(ctx->builder);
+    }
+}
+
+static void defineSymbol(Context *ctx, NkIrSymbol const *sym) {
+    switch (sym->kind) {
+        case NkIrSymbol_Proc:
+            defineProc(ctx, sym);
+            break;
+
+        case NkIrSymbol_Data: {
+            NkIrData const *data = &sym->data;
+            LLVMValueRef const global = getGlobal(ctx, sym->name);
+            LLVMSetInitializer(
+                global,
+                data->addr ? buildConst(ctx, data->addr, 0, data->relocs, data->type)
+                           : LLVMConstNull(LLVMGlobalGetValueType(global)));
+            break;
+        }
+
+        case NkIrSymbol_None:
+        case NkIrSymbol_Extern:
+            break;
+    }
+}
+
+static unsigned getAttrKind(char const *name) {
+    return LLVMGetEnumAttributeKindForName(name, strlen(name));
+}
+
+static Context initContext(NkArena *scratch, LLVMContextRef llvm) {
+    return (Context){
+        .scratch = scratch,
+
+        .llvm = llvm,
+        .module = LLVMModuleCreateWithNameInContext("main", llvm),
+        .builder = LLVMCreateBuilderInContext(llvm),
+
+        .ptr_t = LLVMPointerTypeInContext(llvm, 0),
+        .void_t = LLVMVoidTypeInContext(llvm),
+
+        .sret_kind = getAttrKind("sret"),
+        .byval_kind = getAttrKind("byval"),
+        .align_kind = getAttrKind("align"),
+
+        .globals = {NK_HASH_TREE_INIT(nk_default_allocator)},
+        .types = {NK_HASH_TREE_INIT(nk_default_allocator)},
+
+        .failed = false,
+    };
+}
+
+static LLVMModuleRef finishContext(Context *ctx) {
+    LLVMDisposeBuilder(ctx->builder);
+    LlvmValueMap_free(&ctx->globals);
+    LlvmTypeMap_free(&ctx->types);
+
+    if (ctx->failed) {
+        LLVMDisposeModule(ctx->module);
+        return NULL;
+    }
+    return ctx->module;
+}
+
+LLVMModuleRef nk_llvm_buildModule(NkArena *scratch, LLVMContextRef llvm, NkIrSymbolArray mod) {
+    NK_LOG_TRC("%s", __func__);
+
+    LLVMModuleRef module = NULL;
+    NK_PROF_FUNC() {
+        Context ctx = initContext(scratch, llvm);
+
+        // Declaring everything first, so that symbols can be referenced before their definition
+        NK_ITERATE(NkIrSymbol const *, sym, mod) {
+            NK_ARENA_SCOPE(scratch) {
+                declareSymbol(&ctx, sym);
+            }
+        }
+
+        NK_ITERATE(NkIrSymbol const *, sym, mod) {
+            NK_ARENA_SCOPE(scratch) {
+                defineSymbol(&ctx, sym);
+            }
+        }
+
+        module = finishContext(&ctx);
+    }
+    return module;
+}
+
+// Loads the pointer stored in the idx-th slot of a `void **` array
+static LLVMValueRef loadSlot(Context *ctx, LLVMValueRef base, usize idx) {
+    LLVMValueRef idx_val = LLVMConstInt(LLVMInt64TypeInContext(ctx->llvm), idx, false);
+    LLVMValueRef const slot = LLVMBuildGEP2(ctx->builder, ctx->ptr_t, base, &idx_val, 1, "");
+    return LLVMBuildLoad2(ctx->builder, ctx->ptr_t, slot, "");
+}
+
+LLVMModuleRef nk_llvm_buildInvokeThunk(NkArena *scratch, LLVMContextRef llvm, NkIrSymbol const *proc_sym, NkAtom name) {
+    NK_LOG_TRC("%s", __func__);
+
+    nk_assert(proc_sym->kind == NkIrSymbol_Extern && proc_sym->extrn.kind == NkIrExtern_Proc);
+    nk_assert(!(proc_sym->extrn.proc.flags & NkIrProc_Variadic));
+
+    LLVMModuleRef module = NULL;
+    NK_PROF_FUNC() {
+        Context ctx = initContext(scratch, llvm);
+
+        declareSymbol(&ctx, proc_sym);
+        LLVMValueRef const proc = getGlobal(&ctx, proc_sym->name);
+
+        NkIrTypeArray const param_types = proc_sym->extrn.proc.param_types;
+        NkIrType const ret_t = proc_sym->extrn.proc.ret_type;
+        bool const sret = ret_t->kind == NkIrType_Aggregate && ret_t->size;
+
+        LLVMTypeRef thunk_param_types[] = {ctx.ptr_t, ctx.ptr_t};
+        LLVMTypeRef const thunk_t = LLVMFunctionType(ctx.void_t, thunk_param_types, 2, false);
+        LLVMValueRef const thunk = LLVMAddFunction(ctx.module, getSymbolName(&ctx, name), thunk_t);
+        LLVMValueRef const args_param = LLVMGetParam(thunk, 0);
+        LLVMValueRef const ret_param = LLVMGetParam(thunk, 1);
+
+        LLVMPositionBuilderAtEnd(ctx.builder, LLVMAppendBasicBlockInContext(llvm, thunk, ""));
+
+        LLVMValueRef const ret_ptr = ret_t->size ? loadSlot(&ctx, ret_param, 0) : NULL;
+
+        usize const arg_count = param_types.size + sret;
+        LLVMValueRef *args = nk_arena_allocTn(scratch, LLVMValueRef, arg_count);
+
+        usize arg_idx = 0;
+        if (sret) {
+            args[arg_idx++] = ret_ptr;
+        }
+        NK_ITERATE(NkIrType const *, type, param_types) {
+            LLVMValueRef const arg_ptr = loadSlot(&ctx, args_param, NK_INDEX(type, param_types));
+            // Aggregates are passed by pointer, the callee gets its own copy
+            args[arg_idx++] = (*type)->kind == NkIrType_Aggregate
+                                  ? arg_ptr
+                                  : LLVMBuildLoad2(ctx.builder, getType(&ctx, *type), arg_ptr, "");
+        }
+
+        LLVMValueRef const call =
+            LLVMBuildCall2(ctx.builder, LLVMGlobalGetValueType(proc), proc, args, arg_count, "");
+
+        if (sret) {
+            LLVMAddCallSiteAttribute(call, 1, makeTypeAttr(&ctx, ctx.sret_kind, ret_t));
+            LLVMAddCallSiteAttribute(call, 1, makeAlignAttr(&ctx, ret_t));
+        } else if (ret_t->size) {
+            LLVMBuildStore(ctx.builder, call, ret_ptr);
+        }
+        NK_ITERATE(NkIrType const *, type, param_types) {
+            if ((*type)->kind == NkIrType_Aggregate) {
+                LLVMAttributeIndex const attr_idx = 1 + sret + NK_INDEX(type, param_types);
+                LLVMAddCallSiteAttribute(call, attr_idx, makeTypeAttr(&ctx, ctx.byval_kind, *type));
+                LLVMAddCallSiteAttribute(call, attr_idx, makeAlignAttr(&ctx, *type));
+            }
+        }
+
+        LLVMBuildRetVoid(ctx.builder);
+
+        module = finishContext(&ctx);
+    }
+    return module;
+}
@@ -0,0 +1,23 @@
+#ifndef NKB_LLVM_BUILDER_H_
+#define NKB_LLVM_BUILDER_H_
+
+#include <llvm-c/Types.h>
+
+#include "nkb/ir.h"
+#include "ntk/arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LLVMModuleRef nk_llvm_buildModule(NkArena *scratch, LLVMContextRef ctx, NkIrSymbolArray mod);
+
+// Builds `void name(void **args, void **ret)` calling the extern proc with the values args point to,
+// and storing the result where ret[0] points to
+LLVMModuleRef nk_llvm_buildInvokeThunk(NkArena *scratch, LLVMContextRef ctx, NkIrSymbol const *proc, NkAtom name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NKB_LLVM_BUILDER_H_
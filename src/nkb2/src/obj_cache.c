@@ -0,0 +1,192 @@
+#include "obj_cache.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntk/arena.h"
+#include "ntk/error.h"
+#include "ntk/file.h"
+#include "ntk/log.h"
+#include "ntk/path.h"
+#include "ntk/profiler.h"
+#include "ntk/string_builder.h"
+#include "ntk/thread.h"
+#include "ntk/time.h"
+#include "ntk/utils.h"
+
+NK_LOG_USE_SCOPE(obj_cache);
+
+#define OBJ_FILE_EXT ".o"
+
+typedef struct NkObjCache_T {
+    char dir[NK_MAX_PATH];
+    u64 max_size;
+
+    NkHandle mtx;
+    usize hits;
+    usize misses;
+    usize stores;
+} NkObjCache_T;
+
+NkObjCache nk_objcache_open(NkString dir, u64 max_size) {
+    NK_LOG_TRC("%s", __func__);
+
+    if (dir.size >= NK_MAX_PATH) {
+        nk_error_printf("Object cache path is too long");
+        return NULL;
+    }
+
+    NkObjCache cache = nk_allocT(nk_default_allocator, NkObjCache_T);
+    *cache = (NkObjCache_T){
+        .max_size = max_size,
+        .mtx = nk_mutex_alloc(0),
+    };
+    memcpy(cache->dir, dir.data, dir.size);
+
+    if (nk_mkdir(cache->dir) < 0) {
+        nk_error_printf("Failed to create object cache directory `%s`: %s", cache->dir, nk_getLastErrorString());
+        nk_objcache_close(cache);
+        return NULL;
+    }
+
+    NK_LOG_INF("Using object cache `%s`", cache->dir);
+
+    return cache;
+}
+
+static int compareByMtime(void const *lhs, void const *rhs) {
+    u64 const l = ((NkFileInfo const *)lhs)->mtime;
+    u64 const r = ((NkFileInfo const *)rhs)->mtime;
+    return (l > r) - (l < r);
+}
+
+static void evict(NkArena *scratch, NkObjCache cache) {
+    NkFileInfoArray files = {0};
+    if (nk_listDir(scratch, cache->dir, &files) < 0) {
+        NK_LOG_WRN("Failed to list object cache directory `%s`: %s", cache->dir, nk_getLastErrorString());
+        return;
+    }
+
+    u64 total_size = 0;
+    NK_ITERATE(NkFileInfo const *, file, files) {
+        total_size += file->size;
+    }
+
+    if (!cache->max_size || total_size <= cache->max_size) {
+        return;
+    }
+
+    qsort(files.data, files.size, sizeof(NkFileInfo), compareByMtime);
+
+    usize evicted = 0;
+    NK_ITERATE(NkFileInfo const *, file, files) {
+        if (total_size <= cache->max_size) {
+            break;
+        }
+        if (nk_remove(nk_tprintf(scratch, "%s/" NKS_FMT, cache->dir, NKS_ARG(file->name))) == 0) {
+            total_size -= file->size;
+            evicted++;
+        }
+    }
+
+    NK_LOG_INF("Evicted %zu objects from the cache, %" PRIu64 " bytes left", evicted, total_size);
+}
+
+void nk_objcache_close(NkObjCache cache) {
+    NK_LOG_TRC("%s", __func__);
+
+    if (!cache) {
+        return;
+    }
+
+    NK_PROF_FUNC() {
+        if (cache->hits || cache->misses || cache->stores) {
+            NK_LOG_INF(
+                "Object cache `%s`: %zu hits, %zu misses, %zu stored",
+                cache->dir,
+                cache->hits,
+                cache->misses,
+                cache->stores);
+        }
+
+        if (cache->stores) {
+            NK_SCRATCH_SCOPE(scratch, NULL) {
+                evict(scratch, cache);
+            }
+        }
+
+        nk_mutex_free(cache->mtx);
+        nk_freeT(nk_default_allocator, cache, NkObjCache_T);
+    }
+}
+
+NkObjCacheKey nk_objcache_key(NkString data) {
+    u8 const *begin = (u8 const *)data.data;
+    u8 const *end = begin + data.size;
+
+    // The halves are independent hashes of the whole data, so that the key has the full 128 bits
+    return (NkObjCacheKey){
+        .lo = nk_hashArray(begin, end),
+        .hi = nk_hashArraySeeded(begin, end, 0x9e3779b97f4a7c15ull),
+    };
+}
+
+static char const *objPath(NkArena *scratch, NkObjCache cache, NkObjCacheKey key) {
+    return nk_tprintf(scratch, "%s/%016" PRIx64 "%016" PRIx64 OBJ_FILE_EXT, cache->dir, key.hi, key.lo);
+}
+
+bool nk_objcache_load(NkObjCache cache, NkAllocator alloc, NkObjCacheKey key, NkString *out) {
+    NK_LOG_TRC("%s", __func__);
+
+    bool ret = false;
+    NK_PROF_FUNC() {
+        NK_SCRATCH_SCOPE(scratch, NULL) {
+            char const *path = objPath(scratch, cache, key);
+
+            ret = nk_file_read(alloc, nk_cs2s(path), out);
+            if (ret) {
+                // Marks the object as recently used for eviction
+                nk_touch(path);
+            }
+
+            NK_LOG_DBG("Object cache %s: %s", ret ? "hit" : "miss", path);
+        }
+
+        NK_MUTEX_GUARD_SCOPE(cache->mtx) {
+            if (ret) {
+                cache->hits++;
+            } else {
+                cache->misses++;
+            }
+        }
+    }
+    return ret;
+}
+
+bool nk_objcache_store(NkObjCache cache, NkObjCacheKey key, NkString obj) {
+    NK_LOG_TRC("%s", __func__);
+
+    bool ret = false;
+    NK_PROF_FUNC() {
+        NK_SCRATCH_SCOPE(scratch, NULL) {
+            char const *path = objPath(scratch, cache, key);
+
+            // Written under a unique name first, so that readers never see a partial object
+            char const *tmp_path = nk_tprintf(scratch, "%s.%" PRIx64 ".tmp", path, (u64)nk_now_ns());
+
+            ret = nk_file_write(nk_cs2s(tmp_path), obj) && nk_rename(tmp_path, path) == 0;
+            if (!ret) {
+                NK_LOG_WRN("Failed to store object `%s`: %s", path, nk_getLastErrorString());
+                nk_remove(tmp_path);
+            }
+        }
+
+        if (ret) {
+            NK_MUTEX_GUARD_SCOPE(cache->mtx) {
+                cache->stores++;
+            }
+        }
+    }
+    return ret;
+}
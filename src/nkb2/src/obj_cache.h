@@ -0,0 +1,33 @@
+#ifndef NKB_OBJ_CACHE_H_
+#define NKB_OBJ_CACHE_H_
+
+#include "ntk/allocator.h"
+#include "ntk/common.h"
+#include "ntk/string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    u64 lo;
+    u64 hi;
+} NkObjCacheKey;
+
+typedef struct NkObjCache_T *NkObjCache;
+
+// Objects are stored in the directory as files named after their keys.
+// Least recently used ones are evicted on close once the directory outgrows max_size, 0 means no limit.
+NkObjCache nk_objcache_open(NkString dir, u64 max_size);
+void nk_objcache_close(NkObjCache cache);
+
+NkObjCacheKey nk_objcache_key(NkString data);
+
+bool nk_objcache_load(NkObjCache cache, NkAllocator alloc, NkObjCacheKey key, NkString *out);
+bool nk_objcache_store(NkObjCache cache, NkObjCacheKey key, NkString obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NKB_OBJ_CACHE_H_
@@ -0,0 +1,825 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nkb/ir.h"
+#include "ntk/arena.h"
+#include "ntk/atom.h"
+#include "ntk/common.h"
+#include "ntk/dl.h"
+#include "ntk/error.h"
+#include "ntk/file.h"
+#include "ntk/log.h"
+#include "ntk/path.h"
+#include "ntk/time.h"
+#include "ntk/utils.h"
+
+namespace {
+
+i64 fortyTwo() {
+    return 42;
+}
+
+class ir : public testing::Test {
+    void SetUp() override {
+        NK_LOG_INIT({});
+
+        m_i64_t.num = Int64;
+        m_i64_t.size = 8;
+        m_i64_t.align = 8;
+        m_i64_t.kind = NkIrType_Numeric;
+
+        m_i8_t.num = Int8;
+        m_i8_t.size = 1;
+        m_i8_t.align = 1;
+        m_i8_t.kind = NkIrType_Numeric;
+
+        m_nkb = nkir_createState();
+        m_mod = nkir_createModule(m_nkb);
+    }
+
+    void TearDown() override {
+        nkir_freeState(m_nkb);
+
+        for (auto const &dir : m_tmp_dirs) {
+            clearDir(dir);
+            nk_remove(dir.c_str());
+        }
+    }
+
+protected:
+    NkAtom defineProc(
+        std::string const &name,
+        NkIrInstrDynArray instrs,
+        NkIrParamArray params = {},
+        NkIrVisibility vis = NkIrVisibility_Default) {
+        NkIrSymbol sym{};
+        sym.proc.params = params;
+        sym.proc.ret = {0, &m_i64_t};
+        sym.proc.instrs = {instrs.data, instrs.size};
+        sym.name = nk_cs2atom(name.c_str());
+        sym.vis = vis;
+        sym.kind = NkIrSymbol_Proc;
+        nkir_moduleDefineSymbol(m_mod, &sym);
+        return sym.name;
+    }
+
+    NkAtom defineConstProc(std::string const &name, i64 value) {
+        NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(m_mod);
+        NkIrImm imm{};
+        imm.i64 = value;
+        nkda_append(&instrs, nkir_make_ret(nkir_makeRefImm(imm, &m_i64_t)));
+        return defineProc(name, instrs);
+    }
+
+    // Defines a proc that returns the result of the next proc plus one
+    NkAtom defineChainProc(
+        std::string const &name,
+        std::string const &next,
+        NkIrVisibility vis = NkIrVisibility_Default) {
+        NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(m_mod);
+        NkIrRef const res = nkir_makeRefLocal(nk_cs2atom("res"), &m_i64_t);
+        NkIrRef const sum = nkir_makeRefLocal(nk_cs2atom("sum"), &m_i64_t);
+        NkIrImm one{};
+        one.i64 = 1;
+        nkda_append(&instrs, nkir_make_call(res, nkir_makeRefGlobal(nk_cs2atom(next.c_str()), &m_i64_t), {}));
+        nkda_append(&instrs, nkir_make_add(sum, res, nkir_makeRefImm(one, &m_i64_t)));
+        nkda_append(&instrs, nkir_make_ret(sum));
+        return defineProc(name, instrs, {}, vis);
+    }
+
+    NkAtom defineExternProc(std::string const &name, NkIrTypeArray param_types = {}) {
+        NkIrSymbol sym{};
+        sym.extrn.proc.param_types = param_types;
+        sym.extrn.proc.ret_type = &m_i64_t;
+        sym.extrn.kind = NkIrExtern_Proc;
+        sym.name = nk_cs2atom(name.c_str());
+        sym.vis = NkIrVisibility_Default;
+        sym.kind = NkIrSymbol_Extern;
+        nkir_moduleDefineSymbol(m_mod, &sym);
+        return sym.name;
+    }
+
+    // Stamped, since ctest runs the tests of this fixture concurrently
+    std::string makeTempDir(char const *prefix) {
+        char tmp_path[NK_MAX_PATH];
+        EXPECT_GE(nk_getTempPath(tmp_path, sizeof(tmp_path)), 0);
+        char stamp[32];
+        std::snprintf(stamp, sizeof(stamp), "%" PRIx64, (u64)nk_now_ns());
+        std::string const dir = std::string{tmp_path} + prefix + "." + stamp;
+        EXPECT_EQ(nk_mkdir(dir.c_str()), 0);
+        m_tmp_dirs.push_back(dir);
+        return dir;
+    }
+
+    static std::vector<std::string> listDir(std::string const &dir) {
+        NkArena arena{};
+        defer {
+            nk_arena_free(&arena);
+        };
+        NkFileInfoArray files{};
+        std::vector<std::string> paths;
+        if (nk_listDir(&arena, dir.c_str(), &files) == 0) {
+            for (usize i = 0; i < files.size; i++) {
+                paths.push_back(dir + "/" + std::string{files.data[i].name.data, files.data[i].name.size});
+            }
+        }
+        return paths;
+    }
+
+    static void clearDir(std::string const &dir) {
+        for (auto const &path : listDir(dir)) {
+            nk_remove(path.c_str());
+        }
+    }
+
+    NkIrType_T m_i64_t{};
+    NkIrType_T m_i8_t{};
+
+    NkbState m_nkb{};
+    NkIrModule m_mod{};
+
+    std::vector<std::string> m_tmp_dirs;
+};
+
+} // namespace
+
+TEST_F(ir, find_symbol) {
+    NkAtom const a = defineConstProc("a", 1);
+    NkAtom const b = defineConstProc("b", 2);
+
+    NkIrSymbol sym_a{};
+    ASSERT_TRUE(nkir_findSymbol(m_mod, a, &sym_a));
+    EXPECT_EQ(sym_a.name, a);
+
+    NkIrSymbol sym_b{};
+    ASSERT_TRUE(nkir_findSymbol(m_mod, b, &sym_b));
+    EXPECT_EQ(sym_b.name, b);
+
+    NkIrSymbol sym_c{};
+    EXPECT_FALSE(nkir_findSymbol(m_mod, nk_cs2atom("c"), &sym_c));
+
+    // Redefinition doesn't shadow the first definition
+    defineConstProc("a", 3);
+    NkIrSymbolArray const syms = nkir_moduleGetSymbols(m_mod);
+    ASSERT_EQ(syms.size, 3u);
+    ASSERT_TRUE(nkir_findSymbol(m_mod, a, &sym_a));
+    EXPECT_EQ(sym_a.proc.instrs.data, syms.data[0].proc.instrs.data);
+}
+
+TEST_F(ir, lazy_jit) {
+    nkir_setJitMode(m_nkb, NkIrJit_Lazy);
+    nkir_setSymbolResolver(
+        m_mod,
+        [](NkAtom, void *) -> void * {
+            return nullptr;
+        },
+        nullptr);
+
+    defineConstProc("one", 1);
+    defineChainProc("two", "one");
+
+    // Compiling `broken` fails, because its extern cannot be resolved
+    defineExternProc("missing");
+    defineChainProc("broken", "missing");
+
+    // select(x) = x ? broken() : two()
+    NkIrParam const param{nk_cs2atom("x"), &m_i64_t};
+    NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(m_mod);
+    NkAtom const broken_label = nk_cs2atom("broken");
+    NkIrRef const two_res = nkir_makeRefLocal(nk_cs2atom("two_res"), &m_i64_t);
+    NkIrRef const broken_res = nkir_makeRefLocal(nk_cs2atom("broken_res"), &m_i64_t);
+    nkda_append(&instrs, nkir_make_jmpnz(nkir_makeRefParam(param.name, &m_i64_t), nkir_makeLabelAbs(broken_label)));
+    nkda_append(&instrs, nkir_make_call(two_res, nkir_makeRefGlobal(nk_cs2atom("two"), &m_i64_t), {}));
+    nkda_append(&instrs, nkir_make_ret(two_res));
+    nkda_append(&instrs, nkir_make_label(broken_label));
+    nkda_append(&instrs, nkir_make_call(broken_res, nkir_makeRefGlobal(nk_cs2atom("broken"), &m_i64_t), {}));
+    nkda_append(&instrs, nkir_make_ret(broken_res));
+    NkAtom const select = defineProc("select", instrs, {&param, 1});
+
+    auto const proc = (i64(*)(i64))nkir_getSymbolAddress(m_mod, select);
+    ASSERT_TRUE(proc);
+
+    EXPECT_EQ(proc(0), 2);
+    EXPECT_EQ(proc(0), 2);
+}
+
+TEST_F(ir, eager_retry) {
+    std::string const cache_dir = makeTempDir("nkb2_eager_retry");
+
+    auto const reset = [&]() {
+        nkir_freeState(m_nkb);
+        m_nkb = nkir_createState();
+        m_mod = nkir_createModule(m_nkb);
+
+        nkir_setJitMode(m_nkb, NkIrJit_Eager);
+        nkir_setObjectCache(m_nkb, nk_cs2s(cache_dir.c_str()), 0);
+
+        defineConstProc("one", 1);
+        defineChainProc("two", "one");
+        return defineChainProc("three", "two");
+    };
+
+    reset();
+    ASSERT_TRUE(nkir_getSymbolAddress(m_mod, nk_cs2atom("three")));
+
+    // Loading the corrupted object fails
+    auto const objects = listDir(cache_dir);
+    ASSERT_EQ(objects.size(), 1u);
+    ASSERT_TRUE(nk_file_write(nk_cs2s(objects[0].c_str()), nk_cs2s("garbage")));
+
+    NkAtom const three = reset();
+    NkErrorState err{};
+    NK_ERROR_SCOPE(&err) {
+        EXPECT_FALSE(nkir_getSymbolAddress(m_mod, three));
+        EXPECT_GE(nk_error_count(), 1u);
+        nk_error_freeState();
+    }
+
+    // Nothing is left marked as loaded by the failed attempt, so the retry compiles everything again
+    clearDir(cache_dir);
+    auto const proc = (i64(*)())nkir_getSymbolAddress(m_mod, three);
+    ASSERT_TRUE(proc);
+    EXPECT_EQ(proc(), 3);
+}
+
+TEST_F(ir, invoke) {
+    nkir_setSymbolResolver(
+        m_mod,
+        [](NkAtom sym, void *) -> void * {
+            return sym == nk_cs2atom("forty_two") ? (void *)fortyTwo : nullptr;
+        },
+        nullptr);
+
+    // sub(x, y) = x - y
+    NkIrParam const params[] = {{nk_cs2atom("x"), &m_i64_t}, {nk_cs2atom("y"), &m_i64_t}};
+    NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(m_mod);
+    NkIrRef const diff = nkir_makeRefLocal(nk_cs2atom("diff"), &m_i64_t);
+    nkda_append(
+        &instrs,
+        nkir_make_sub(diff, nkir_makeRefParam(params[0].name, &m_i64_t), nkir_makeRefParam(params[1].name, &m_i64_t)));
+    nkda_append(&instrs, nkir_make_ret(diff));
+    NkAtom const sub = defineProc("sub", instrs, {params, 2});
+
+    NkAtom const forty_two = defineExternProc("forty_two");
+
+    for (i64 i = 0; i < 3; i++) {
+        i64 x = 10 * i;
+        i64 y = 3;
+        i64 res = 0;
+        void *args[] = {&x, &y};
+        void *ret[] = {&res};
+        ASSERT_TRUE(nkir_invoke(m_mod, sub, args, ret));
+        EXPECT_EQ(res, 10 * i - 3);
+    }
+
+    // Later invokes reuse the thunk compiled by the first one
+    EXPECT_EQ(nkir_moduleGetStats(m_mod).invoke_thunks, 1u);
+
+    i64 res = 0;
+    void *ret[] = {&res};
+    ASSERT_TRUE(nkir_invoke(m_mod, forty_two, nullptr, ret));
+    EXPECT_EQ(res, 42);
+    EXPECT_EQ(nkir_moduleGetStats(m_mod).invoke_thunks, 2u);
+
+    NkErrorState err{};
+    NK_ERROR_SCOPE(&err) {
+        EXPECT_FALSE(nkir_invoke(m_mod, nk_cs2atom("missing"), nullptr, ret));
+        EXPECT_EQ(nk_error_count(), 1u);
+        nk_error_freeState();
+    }
+}
+
+TEST_F(ir, invoke_aggregate) {
+    struct Triple {
+        i64 x, y, z;
+    };
+
+    // Larger than two registers, so it is returned through a hidden pointer
+    NkIrAggregateElemInfo const elems[] = {{&m_i64_t, 3, 0}};
+    NkIrType_T triple_t{};
+    triple_t.aggr = {elems, 1};
+    triple_t.size = sizeof(Triple);
+    triple_t.align = alignof(Triple);
+    triple_t.kind = NkIrType_Aggregate;
+
+    NkIrImm imm{};
+    auto const immRef = [&](i64 val) {
+        imm.i64 = val;
+        return nkir_makeRefImm(imm, &m_i64_t);
+    };
+    auto const local = [&](char const *name) {
+        return nkir_makeRefLocal(nk_cs2atom(name), &m_i64_t);
+    };
+
+    // sum(t: Triple) = t.x + t.y + t.z, the aggregate is passed by value
+    NkIrParam const sum_params[] = {{nk_cs2atom("t"), &triple_t}};
+    // The param is the address of the callee's copy
+    NkIrRef const t_addr = nkir_makeRefParam(sum_params[0].name, &m_i64_t);
+    NkIrInstrDynArray sum_instrs = nkir_moduleNewInstrArray(m_mod);
+    nkda_append(&sum_instrs, nkir_make_load(local("x"), t_addr));
+    nkda_append(&sum_instrs, nkir_make_add(local("y_addr"), t_addr, immRef(8)));
+    nkda_append(&sum_instrs, nkir_make_load(local("y"), local("y_addr")));
+    nkda_append(&sum_instrs, nkir_make_add(local("z_addr"), t_addr, immRef(16)));
+    nkda_append(&sum_instrs, nkir_make_load(local("z"), local("z_addr")));
+    // The caller's copy is left intact
+    nkda_append(&sum_instrs, nkir_make_store(t_addr, immRef(0)));
+    nkda_append(&sum_instrs, nkir_make_add(local("xy"), local("x"), local("y")));
+    nkda_append(&sum_instrs, nkir_make_add(local("xyz"), local("xy"), local("z")));
+    nkda_append(&sum_instrs, nkir_make_ret(local("xyz")));
+    NkAtom const sum = defineProc("sum", sum_instrs, {sum_params, 1});
+
+    // make(x: i64) = Triple{x, x * 2, x * 3}, the result is written through the sret pointer
+    NkIrParam const make_params[] = {{nk_cs2atom("x"), &m_i64_t}};
+    NkIrRef const x = nkir_makeRefParam(make_params[0].name, &m_i64_t);
+    NkIrRef const out_addr = nkir_makeRefParam(nk_cs2atom("out"), &m_i64_t);
+    NkIrInstrDynArray make_instrs = nkir_moduleNewInstrArray(m_mod);
+    nkda_append(&make_instrs, nkir_make_store(out_addr, x));
+    nkda_append(&make_instrs, nkir_make_mul(local("y"), x, immRef(2)));
+    nkda_append(&make_instrs, nkir_make_add(local("y_addr"), out_addr, immRef(8)));
+    nkda_append(&make_instrs, nkir_make_store(local("y_addr"), local("y")));
+    nkda_append(&make_instrs, nkir_make_mul(local("z"), x, immRef(3)));
+    nkda_append(&make_instrs, nkir_make_add(local("z_addr"), out_addr, immRef(16)));
+    nkda_append(&make_instrs, nkir_make_store(local("z_addr"), local("z")));
+    nkda_append(&make_instrs, nkir_make_ret({}));
+
+    NkIrSymbol make_sym{};
+    make_sym.proc.params = {make_params, 1};
+    make_sym.proc.ret = {nk_cs2atom("out"), &triple_t};
+    make_sym.proc.instrs = {make_instrs.data, make_instrs.size};
+    make_sym.name = nk_cs2atom("make");
+    make_sym.vis = NkIrVisibility_Default;
+    make_sym.kind = NkIrSymbol_Proc;
+    nkir_moduleDefineSymbol(m_mod, &make_sym);
+
+    for (i64 i = 1; i <= 3; i++) {
+        Triple t{i, 10 * i, 100 * i};
+        i64 res = 0;
+        void *args[] = {&t};
+        void *ret[] = {&res};
+        ASSERT_TRUE(nkir_invoke(m_mod, sum, args, ret));
+        EXPECT_EQ(res, 111 * i);
+        EXPECT_EQ(t.x, i);
+
+        i64 arg = i;
+        Triple made{};
+        void *make_args[] = {&arg};
+        void *make_ret[] = {&made};
+        ASSERT_TRUE(nkir_invoke(m_mod, make_sym.name, make_args, make_ret));
+        EXPECT_EQ(made.x, i);
+        EXPECT_EQ(made.y, 2 * i);
+        EXPECT_EQ(made.z, 3 * i);
+    }
+
+    EXPECT_EQ(nkir_moduleGetStats(m_mod).invoke_thunks, 2u);
+}
+
+TEST_F(ir, tiered_jit) {
+    nkir_setJitMode(m_nkb, NkIrJit_Tiered);
+
+    auto const ref = [&](char const *name) {
+        return nkir_makeRefLocal(nk_cs2atom(name), &m_i64_t);
+    };
+    auto const imm = [&](i64 val) {
+        NkIrImm imm{};
+        imm.i64 = val;
+        return nkir_makeRefImm(imm, &m_i64_t);
+    };
+
+    // sum(n) = 0 + 1 + ... + n - 1
+    NkIrParam const param{nk_cs2atom("n"), &m_i64_t};
+    NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(m_mod);
+    NkAtom const loop_label = nk_cs2atom("loop");
+    NkAtom const end_label = nk_cs2atom("end");
+    NkIrRef const cond = nkir_makeRefLocal(nk_cs2atom("cond"), &m_i8_t);
+    nkda_append(&instrs, nkir_make_alloc(ref("acc"), &m_i64_t));
+    nkda_append(&instrs, nkir_make_alloc(ref("i"), &m_i64_t));
+    nkda_append(&instrs, nkir_make_store(ref("acc"), imm(0)));
+    nkda_append(&instrs, nkir_make_store(ref("i"), imm(0)));
+    nkda_append(&instrs, nkir_make_label(loop_label));
+    nkda_append(&instrs, nkir_make_load(ref("i_val"), ref("i")));
+    nkda_append(&instrs, nkir_make_cmp_lt(cond, ref("i_val"), nkir_makeRefParam(param.name, &m_i64_t)));
+    nkda_append(&instrs, nkir_make_jmpz(cond, nkir_makeLabelAbs(end_label)));
+    nkda_append(&instrs, nkir_make_load(ref("acc_val"), ref("acc")));
+    nkda_append(&instrs, nkir_make_add(ref("acc_next"), ref("acc_val"), ref("i_val")));
+    nkda_append(&instrs, nkir_make_store(ref("acc"), ref("acc_next")));
+    nkda_append(&instrs, nkir_make_add(ref("i_next"), ref("i_val"), imm(1)));
+    nkda_append(&instrs, nkir_make_store(ref("i"), ref("i_next")));
+    nkda_append(&instrs, nkir_make_jmp(nkir_makeLabelAbs(loop_label)));
+    nkda_append(&instrs, nkir_make_label(end_label));
+    nkda_append(&instrs, nkir_make_load(ref("res"), ref("acc")));
+    nkda_append(&instrs, nkir_make_ret(ref("res")));
+    NkAtom const sum = defineProc("sum", instrs, {&param, 1});
+
+    defineConstProc("one", 1);
+    NkAtom const two = defineChainProc("two", "one");
+
+    // Procs are recompiled in the background, and keep running unoptimized until that is done
+    auto const waitForTierUps = [&](usize count) {
+        i64 const deadline = nk_now_ns() + 30'000'000'000ll;
+        while (nkir_moduleGetStats(m_mod).tier_ups < count && nk_now_ns() < deadline) {
+            nk_usleep(1000);
+        }
+        return nkir_moduleGetStats(m_mod).tier_ups;
+    };
+
+    auto const sum_proc = (i64(*)(i64))nkir_getSymbolAddress(m_mod, sum);
+    ASSERT_TRUE(sum_proc);
+
+    EXPECT_EQ(sum_proc(10), 45);
+    EXPECT_EQ(nkir_moduleGetStats(m_mod).tier_ups, 0u);
+
+    // Promoted by loop iterations in the middle of the call
+    EXPECT_EQ(sum_proc(2000), 2000 * 1999 / 2);
+    EXPECT_EQ(waitForTierUps(1), 1u);
+
+    for (i64 n : {10, 100, 2000}) {
+        EXPECT_EQ(sum_proc(n), n * (n - 1) / 2);
+    }
+
+    auto const two_proc = (i64(*)())nkir_getSymbolAddress(m_mod, two);
+    ASSERT_TRUE(two_proc);
+
+    // Promoted by calls, along with the proc it calls
+    for (usize i = 0; i < 3000; i++) {
+        ASSERT_EQ(two_proc(), 2);
+    }
+    EXPECT_EQ(waitForTierUps(3), 3u);
+    EXPECT_EQ(two_proc(), 2);
+
+    // Each proc is promoted once
+    for (usize i = 0; i < 3000; i++) {
+        ASSERT_EQ(two_proc(), 2);
+    }
+    EXPECT_EQ(nkir_moduleGetStats(m_mod).tier_ups, 3u);
+}
+
+TEST_F(ir, jit_opt_profile) {
+    NkIrOptProfile opt{};
+    opt.level = NkIrOpt_O0;
+    opt.passes = nk_cs2s("function(instcombine,simplifycfg)");
+    nkir_moduleSetJitOptProfile(m_mod, opt);
+
+    defineConstProc("one", 1);
+    NkAtom const two = defineChainProc("two", "one");
+
+    auto const proc = (i64(*)())nkir_getSymbolAddress(m_mod, two);
+    ASSERT_TRUE(proc);
+
+    EXPECT_EQ(proc(), 2);
+}
+
+TEST_F(ir, concurrent_jit) {
+    static constexpr usize c_thread_count = 8;
+    static constexpr usize c_chain_depth = 20;
+
+    // Every thread builds and runs a module of its own, chain0 returns the thread index plus the depth
+    auto const buildChain = [this](NkIrModule mod, i64 value) {
+        NkIrRef const res = nkir_makeRefLocal(nk_cs2atom("res"), &m_i64_t);
+        NkIrRef const sum = nkir_makeRefLocal(nk_cs2atom("sum"), &m_i64_t);
+        NkIrImm imm{};
+
+        for (usize i = 0; i < c_chain_depth; i++) {
+            NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(mod);
+            if (i + 1 < c_chain_depth) {
+                NkAtom const next = nk_cs2atom(("chain" + std::to_string(i + 1)).c_str());
+                imm.i64 = 1;
+                nkda_append(&instrs, nkir_make_call(res, nkir_makeRefGlobal(next, &m_i64_t), {}));
+                nkda_append(&instrs, nkir_make_add(sum, res, nkir_makeRefImm(imm, &m_i64_t)));
+                nkda_append(&instrs, nkir_make_ret(sum));
+            } else {
+                imm.i64 = value;
+                nkda_append(&instrs, nkir_make_ret(nkir_makeRefImm(imm, &m_i64_t)));
+            }
+
+            NkIrSymbol sym{};
+            sym.proc.ret = {0, &m_i64_t};
+            sym.proc.instrs = {instrs.data, instrs.size};
+            sym.name = nk_cs2atom(("chain" + std::to_string(i)).c_str());
+            sym.vis = NkIrVisibility_Default;
+            sym.kind = NkIrSymbol_Proc;
+            nkir_moduleDefineSymbol(mod, &sym);
+        }
+    };
+
+    for (NkIrJitMode const mode : {NkIrJit_Eager, NkIrJit_Lazy}) {
+        nkir_setJitMode(m_nkb, mode);
+
+        std::vector<i64> results(c_thread_count);
+        std::vector<i64> invoke_results(c_thread_count);
+        std::vector<std::thread> threads;
+
+        for (usize t = 0; t < c_thread_count; t++) {
+            threads.emplace_back([&, t]() {
+                NkIrModule const mod = nkir_createModule(m_nkb);
+                buildChain(mod, (i64)t);
+
+                NkAtom const entry_name = nk_cs2atom("chain0");
+                auto const entry = (i64(*)())nkir_getSymbolAddress(mod, entry_name);
+                results[t] = entry ? entry() : -1;
+
+                void *ret[] = {&invoke_results[t]};
+                if (!nkir_invoke(mod, entry_name, nullptr, ret)) {
+                    invoke_results[t] = -1;
+                }
+            });
+        }
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (usize t = 0; t < c_thread_count; t++) {
+            EXPECT_EQ(results[t], (i64)(t + c_chain_depth - 1)) << "mode " << mode << ", thread " << t;
+            EXPECT_EQ(invoke_results[t], (i64)(t + c_chain_depth - 1)) << "mode " << mode << ", thread " << t;
+        }
+    }
+}
+
+TEST_F(ir, parallel_export) {
+    static constexpr usize c_chain_depth = 100;
+    static constexpr usize c_filler_count = 100;
+
+    nkir_setCodegenThreadCount(m_nkb, 4);
+
+    auto const chainName = [](usize i) {
+        return "chain" + std::to_string(i);
+    };
+
+    // Local procs referenced across the units have to stay linkable
+    defineChainProc(chainName(0), chainName(1));
+    for (usize i = 1; i < c_chain_depth - 1; i++) {
+        defineChainProc(chainName(i), chainName(i + 1), NkIrVisibility_Local);
+    }
+    defineConstProc(chainName(c_chain_depth - 1), 0);
+
+    for (usize i = 0; i < c_filler_count; i++) {
+        defineConstProc("filler" + std::to_string(i), (i64)i);
+    }
+
+    NkIrTarget const target = nkir_createTarget(m_nkb, nk_cs2s(HOST_TARGET_TRIPLE), {});
+    ASSERT_TRUE(target);
+
+    std::string const out_file = makeTempDir("nkb2_parallel_export") + "/out.so";
+    ASSERT_TRUE(nkir_exportModule(m_mod, target, nk_cs2s(out_file.c_str()), NkIrOutput_Shared, {NkIrOpt_O2, {}}));
+
+    NkHandle const dl = nkdl_loadLibrary(out_file.c_str());
+    ASSERT_FALSE(nk_handleIsNull(dl)) << nkdl_getLastErrorString();
+    defer {
+        nkdl_freeLibrary(dl);
+    };
+
+    auto const entry = (i64(*)())nkdl_resolveSymbol(dl, "chain0");
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry(), (i64)c_chain_depth - 1);
+
+    auto const filler = (i64(*)())nkdl_resolveSymbol(dl, "filler42");
+    ASSERT_TRUE(filler);
+    EXPECT_EQ(filler(), 42);
+
+    EXPECT_FALSE(nkdl_resolveSymbol(dl, "chain1"));
+}
+
+TEST_F(ir, export_archive) {
+    nkir_setCodegenThreadCount(m_nkb, 4);
+
+    for (usize i = 0; i < 8; i++) {
+        defineConstProc("filler" + std::to_string(i), (i64)i);
+    }
+
+    NkIrTarget const target = nkir_createTarget(m_nkb, nk_cs2s(HOST_TARGET_TRIPLE), {});
+    ASSERT_TRUE(target);
+
+    std::string const out_file = makeTempDir("nkb2_export_archive") + "/out.a";
+    ASSERT_TRUE(nkir_exportModule(m_mod, target, nk_cs2s(out_file.c_str()), NkIrOutput_Archiv, {NkIrOpt_O2, {}}));
+
+    NkArena arena{};
+    defer {
+        nk_arena_free(&arena);
+    };
+
+    NkString data{};
+    ASSERT_TRUE(nk_file_read(nk_arena_getAllocator(&arena), nk_cs2s(out_file.c_str()), &data));
+
+    // The archive is written in process, with the symbol index linkers need
+    std::string const archive{data.data, data.size};
+    EXPECT_EQ(archive.rfind("!<arch>\n/ ", 0), 0u);
+    EXPECT_NE(archive.find("filler0"), std::string::npos);
+    EXPECT_NE(archive.find("filler7"), std::string::npos);
+}
+
+TEST_F(ir, export_libc_call) {
+    // page_size(x) = sysconf(x), something the optimizer cannot fold away
+    NkIrType const sysconf_params[] = {&m_i64_t};
+    NkAtom const sysconf_sym = defineExternProc("sysconf", {sysconf_params, 1});
+
+    NkIrParam const param{nk_cs2atom("x"), &m_i64_t};
+    NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(m_mod);
+    NkIrRef const res = nkir_makeRefLocal(nk_cs2atom("res"), &m_i64_t);
+    NkIrRef const args[] = {nkir_makeRefParam(param.name, &m_i64_t)};
+    nkda_append(&instrs, nkir_make_call(res, nkir_makeRefGlobal(sysconf_sym, &m_i64_t), {args, 1}));
+    nkda_append(&instrs, nkir_make_ret(res));
+    defineProc("page_size", instrs, {&param, 1});
+
+    NkIrTarget const target = nkir_createTarget(m_nkb, nk_cs2s(HOST_TARGET_TRIPLE), {});
+    ASSERT_TRUE(target);
+
+    std::string const out_file = makeTempDir("nkb2_export_libc_call") + "/out.so";
+    ASSERT_TRUE(nkir_exportModule(m_mod, target, nk_cs2s(out_file.c_str()), NkIrOutput_Shared, {NkIrOpt_O2, {}}));
+
+    NkArena arena{};
+    defer {
+        nk_arena_free(&arena);
+    };
+
+    // The library records its libc dependency instead of relying on the loading process
+    NkString data{};
+    ASSERT_TRUE(nk_file_read(nk_arena_getAllocator(&arena), nk_cs2s(out_file.c_str()), &data));
+    EXPECT_NE(std::string(data.data, data.size).find(SYSTEM_LIBC), std::string::npos);
+
+    NkHandle const dl = nkdl_loadLibrary(out_file.c_str());
+    ASSERT_FALSE(nk_handleIsNull(dl)) << nkdl_getLastErrorString();
+    defer {
+        nkdl_freeLibrary(dl);
+    };
+
+    auto const page_size = (i64(*)(i64))nkdl_resolveSymbol(dl, "page_size");
+    ASSERT_TRUE(page_size);
+    EXPECT_EQ(page_size(_SC_PAGESIZE), sysconf(_SC_PAGESIZE));
+}
+
+TEST_F(ir, object_cache) {
+    std::string const cache_dir = makeTempDir("nkb2_object_cache");
+    // Separate from the cache, so that the linker outputs are not counted as objects
+    std::string const out_file = makeTempDir("nkb2_object_cache_out") + "/out.so";
+
+    auto const countObjects = [&]() {
+        return listDir(cache_dir).size();
+    };
+
+    // Every run starts from a fresh state, as a separate process would
+    auto const reset = [&](NkIrJitMode mode) {
+        nkir_freeState(m_nkb);
+        m_nkb = nkir_createState();
+        m_mod = nkir_createModule(m_nkb);
+
+        nkir_setJitMode(m_nkb, mode);
+        nkir_setObjectCache(m_nkb, nk_cs2s(cache_dir.c_str()), 0);
+
+        defineConstProc("one", 1);
+        defineChainProc("two", "one");
+        defineChainProc("three", "two");
+    };
+
+    auto const run = [&](NkIrJitMode mode) {
+        reset(mode);
+        auto const proc = (i64(*)())nkir_getSymbolAddress(m_mod, nk_cs2atom("three"));
+        return proc ? proc() : -1;
+    };
+
+    auto const runExported = [&]() {
+        reset(NkIrJit_Eager);
+
+        NkIrTarget const target = nkir_createTarget(m_nkb, nk_cs2s(HOST_TARGET_TRIPLE), {});
+        if (!target ||
+            !nkir_exportModule(m_mod, target, nk_cs2s(out_file.c_str()), NkIrOutput_Shared, {NkIrOpt_O2, {}})) {
+            return (i64)-1;
+        }
+
+        NkHandle const dl = nkdl_loadLibrary(out_file.c_str());
+        if (nk_handleIsNull(dl)) {
+            return (i64)-1;
+        }
+        defer {
+            nkdl_freeLibrary(dl);
+            nk_remove(out_file.c_str());
+        };
+
+        auto const proc = (i64(*)())nkdl_resolveSymbol(dl, "three");
+        return proc ? proc() : -1;
+    };
+
+    EXPECT_EQ(run(NkIrJit_Lazy), 3);
+    usize const lazy_count = countObjects();
+    EXPECT_EQ(lazy_count, 3u);
+
+    EXPECT_EQ(run(NkIrJit_Lazy), 3);
+    EXPECT_EQ(countObjects(), lazy_count);
+
+    EXPECT_EQ(run(NkIrJit_Eager), 3);
+    usize const eager_count = countObjects();
+    EXPECT_EQ(eager_count, lazy_count + 1);
+
+    EXPECT_EQ(run(NkIrJit_Eager), 3);
+    EXPECT_EQ(countObjects(), eager_count);
+
+    EXPECT_EQ(runExported(), 3);
+    usize const export_count = countObjects();
+    EXPECT_EQ(export_count, eager_count + 1);
+
+    EXPECT_EQ(runExported(), 3);
+    EXPECT_EQ(countObjects(), export_count);
+}
+
+TEST_F(ir, object_cache_layout) {
+    std::string const cache_dir = makeTempDir("nkb2_object_cache_layout");
+
+    // Types that print the same, {i64, i64}, but differ in alignment or field offsets
+    auto const run = [&](u32 align, u32 second_offset) {
+        nkir_freeState(m_nkb);
+        m_nkb = nkir_createState();
+        m_mod = nkir_createModule(m_nkb);
+
+        nkir_setJitMode(m_nkb, NkIrJit_Eager);
+        nkir_setObjectCache(m_nkb, nk_cs2s(cache_dir.c_str()), 0);
+
+        NkIrAggregateElemInfo const elems[] = {{&m_i64_t, 1, 0}, {&m_i64_t, 1, second_offset}};
+        NkIrType_T pair_t{};
+        pair_t.aggr = {elems, 2};
+        pair_t.size = second_offset + 8;
+        pair_t.align = align;
+        pair_t.kind = NkIrType_Aggregate;
+
+        NkIrInstrDynArray instrs = nkir_moduleNewInstrArray(m_mod);
+        NkIrImm one{};
+        one.i64 = 1;
+        nkda_append(&instrs, nkir_make_alloc(nkir_makeRefLocal(nk_cs2atom("pair"), &m_i64_t), &pair_t));
+        nkda_append(&instrs, nkir_make_ret(nkir_makeRefImm(one, &m_i64_t)));
+        NkAtom const proc_name = defineProc("get", instrs);
+
+        auto const proc = (i64(*)())nkir_getSymbolAddress(m_mod, proc_name);
+        EXPECT_TRUE(proc);
+        if (proc) {
+            EXPECT_EQ(proc(), 1);
+        }
+        return listDir(cache_dir).size();
+    };
+
+    EXPECT_EQ(run(8, 8), 1u);
+    EXPECT_EQ(run(8, 8), 1u);
+    EXPECT_EQ(run(16, 8), 2u);
+    EXPECT_EQ(run(8, 16), 3u);
+    EXPECT_EQ(run(16, 8), 3u);
+}
+
+TEST_F(ir, DISABLED_symbol_lookup_bench) {
+    static constexpr usize c_proc_count = 100'000;
+#ifdef NDEBUG
+    static constexpr usize c_chain_depth = 1'000;
+#else  // NDEBUG
+    static constexpr usize c_chain_depth = 100;
+#endif // NDEBUG
+
+    auto const chainName = [](usize i) {
+        return "chain" + std::to_string(i);
+    };
+
+    u64 const define_start_ns = nk_now_ns();
+
+    NkAtom const entry = defineChainProc(chainName(0), chainName(1));
+    for (usize i = 1; i < c_chain_depth - 1; i++) {
+        defineChainProc(chainName(i), chainName(i + 1));
+    }
+    defineConstProc(chainName(c_chain_depth - 1), 0);
+
+    for (usize i = c_chain_depth; i < c_proc_count; i++) {
+        defineConstProc("filler" + std::to_string(i), (i64)i);
+    }
+
+    u64 const define_ns = nk_now_ns() - define_start_ns;
+
+    NkIrSymbolArray const syms = nkir_moduleGetSymbols(m_mod);
+    ASSERT_EQ(syms.size, c_proc_count);
+
+    u64 const find_start_ns = nk_now_ns();
+    usize found = 0;
+    for (usize i = 0; i < syms.size; i++) {
+        NkIrSymbol sym;
+        if (nkir_findSymbol(m_mod, syms.data[i].name, &sym)) {
+            found += sym.proc.instrs.data == syms.data[i].proc.instrs.data;
+        }
+    }
+    u64 const find_ns = nk_now_ns() - find_start_ns;
+
+    EXPECT_EQ(found, c_proc_count);
+
+    u64 const resolve_start_ns = nk_now_ns();
+    auto const proc = (i64(*)())nkir_getSymbolAddress(m_mod, entry);
+    u64 const resolve_ns = nk_now_ns() - resolve_start_ns;
+
+    ASSERT_TRUE(proc);
+    EXPECT_EQ(proc(), (i64)c_chain_depth - 1);
+
+    std::printf(
+        "symbol bench: %zu procs, chain depth %zu: define %.2f ms, find %.1f ns/sym, resolve %.2f ms\n",
+        c_proc_count,
+        c_chain_depth,
+        define_ns / 1e6,
+        (f64)find_ns / c_proc_count,
+        resolve_ns / 1e6);
+}
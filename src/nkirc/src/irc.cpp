@@ -34,12 +34,18 @@ NkIrCompiler nkirc_create(NkArena *tmp_arena, NkIrcConfig conf) {
     };
     c->parser.decls = decltype(NkIrParserState::decls)::create(nk_arena_getAllocator(&c->parse_arena));
     c->extern_sym = {NKDA_INIT(nk_arena_getAllocator(&c->parse_arena))};
+    c->file_mappings = {NKDA_INIT(nk_default_allocator)};
     return c;
 }
 
 void nkirc_free(NkIrCompiler c) {
     c->fpmap.deinit();
 
+    NK_ITERATE(NkFileMapping *, mapping, c->file_mappings) {
+        nk_file_unmap(mapping);
+    }
+    nkda_free(&c->file_mappings);
+
     nk_arena_free(&c->parse_arena);
     nk_arena_free(&c->file_arena);
 
@@ -142,12 +148,15 @@ bool nkir_compileFile(NkIrCompiler c, NkString base_file, NkString in_file) {
 
     auto const in_file_s = NkString{in_file_path_str.c_str(), in_file_path_str.size()};
 
-    NkString text;
-    bool const ok = nk_file_read(nk_arena_getAllocator(&c->file_arena), in_file_s, &text);
+    NkFileMapping mapping;
+    bool const ok = nk_file_map(in_file_s, &mapping);
     if (!ok) {
         nkl_diag_printError("failed to read file `%s`", in_file_path_str.c_str());
         return false;
     }
+    nkda_append(&c->file_mappings, mapping);
+
+    NkString const text = mapping.text;
 
     auto const in_file_id = nk_s2atom(in_file_s);
 
@@ -8,6 +8,7 @@
 #include "nkb/ir.h"
 #include "nkl/common/token.h"
 #include "ntk/dyn_array.h"
+#include "ntk/file.h"
 #include "ntk/hash_map.hpp"
 #include "ntk/string.h"
 
@@ -69,6 +70,8 @@ struct NkIrCompiler_T {
     NkIrModule mod{};
     NkIrProc entry_point{NKIR_INVALID_IDX};
     NkArena file_arena{};
+    // Sources are mapped, so that the program can refer to their text
+    NkDynArray(NkFileMapping) file_mappings{};
 
     NkArena parse_arena{};
     NkIrParserState parser{};
@@ -29,6 +29,7 @@ typedef struct {
 } NklSource;
 
 void nkl_ast_inspect(NklSource src, NkStream out);
+void nkl_ast_inspectCompact(NkString text, NklCompactTokenArray tokens, NklAstNodeArray nodes, NkStream out);
 
 NK_INLINE u32 nkl_ast_nextChild(NklAstNodeArray nodes, u32 idx) {
     nk_assert(idx < nodes.size && "node index out of range");
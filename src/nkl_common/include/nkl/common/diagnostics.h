@@ -3,7 +3,9 @@
 
 #include <stdarg.h>
 
+#include "ntk/allocator.h"
 #include "ntk/common.h"
+#include "ntk/slice.h"
 #include "ntk/string.h"
 
 #ifdef __cplusplus
@@ -25,6 +27,14 @@ typedef struct {
     u32 len;
 } NklSourceLocation;
 
+// Offsets where the lines of a text start, the first one is zero
+typedef NkSlice(u32 const) NklLineIndex;
+
+NklLineIndex nkl_diag_indexLines(NkAllocator alloc, NkString src);
+
+// Computes the line and column of a text position, both start from one
+NklSourceLocation nkl_diag_locate(NklLineIndex lines, NkString file, u32 pos, u32 len);
+
 NK_PRINTF_LIKE(1) void nkl_diag_printError(char const *fmt, ...);
 NK_PRINTF_LIKE(2) void nkl_diag_printErrorFile(NklSourceLocation loc, char const *fmt, ...);
 NK_PRINTF_LIKE(3) void nkl_diag_printErrorQuote(NkString src, NklSourceLocation loc, char const *fmt, ...);
@@ -24,6 +24,23 @@ NK_INLINE NkString nkl_getTokenStr(NklToken const *token, NkString text) {
     return NK_LITERAL(NkString){text.data + token->pos, token->len};
 }
 
+#define NKL_COMPACT_TOKEN_MAX_ID 0xffu
+#define NKL_COMPACT_TOKEN_MAX_LEN 0xffffffu
+
+// Token without line and column, those are computed on demand from a line index
+typedef struct {
+    u32 pos;
+    u32 id : 8;
+    u32 len : 24;
+} NklCompactToken;
+
+typedef NkDynArray(NklCompactToken) NklCompactTokenDynArray;
+typedef NkSlice(NklCompactToken const) NklCompactTokenArray;
+
+NK_INLINE NkString nkl_getCompactTokenStr(NklCompactToken const *token, NkString text) {
+    return NK_LITERAL(NkString){text.data + token->pos, token->len};
+}
+
 #ifdef __cplusplus
 }
 #endif
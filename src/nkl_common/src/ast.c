@@ -3,19 +3,37 @@
 #include "nkl/common/token.h"
 #include "ntk/string.h"
 
-static void inspectNode(u32 idx, NklSource src, NkStream out, u32 indent) {
+typedef struct {
+    NkString text;
+    NklTokenArray tokens;
+    NklCompactTokenArray compact_tokens;
+} TokenSource;
+
+static bool getTokenStr(TokenSource const *src, u32 idx, NkString *out_str) {
+    if (idx < src->tokens.size) {
+        *out_str = nkl_getTokenStr(&src->tokens.data[idx], src->text);
+        return true;
+    }
+    if (idx < src->compact_tokens.size) {
+        *out_str = nkl_getCompactTokenStr(&src->compact_tokens.data[idx], src->text);
+        return true;
+    }
+    return false;
+}
+
+static void inspectNode(u32 idx, NklAstNodeArray nodes, TokenSource const *src, NkStream out, u32 indent) {
     nk_printf(out, "\n%5u ", idx);
 
     for (u32 i = 0; i < indent; i++) {
         nk_printf(out, "|  ");
     }
 
-    if (idx >= src.nodes.size) {
+    if (idx >= nodes.size) {
         nk_printf(out, "<invalid>\n");
         return;
     }
 
-    NklAstNode const *node = &src.nodes.data[idx++];
+    NklAstNode const *node = &nodes.data[idx++];
 
     if (node->id) {
         NkString const node_name = nk_atom2s(node->id);
@@ -24,9 +42,8 @@ static void inspectNode(u32 idx, NklSource src, NkStream out, u32 indent) {
         nk_printf(out, "(null)");
     }
 
-    if (node->token_idx < src.tokens.size) {
-        NklToken const *token = &src.tokens.data[node->token_idx];
-        NkString const token_text = nkl_getTokenStr(token, src.text);
+    NkString token_text;
+    if (getTokenStr(src, node->token_idx, &token_text)) {
         nk_printf(out, " \"");
         nks_escape(out, token_text);
         nk_printf(out, "\"");
@@ -34,13 +51,19 @@ static void inspectNode(u32 idx, NklSource src, NkStream out, u32 indent) {
         nk_printf(out, " \"<invalid>\"");
     }
 
-    for (u32 i = 0; i < node->arity; i++, idx = nkl_ast_nextChild(src.nodes, idx)) {
-        inspectNode(idx, src, out, indent + 1);
+    for (u32 i = 0; i < node->arity; i++, idx = nkl_ast_nextChild(nodes, idx)) {
+        inspectNode(idx, nodes, src, out, indent + 1);
     }
 }
 
 void nkl_ast_inspect(NklSource src, NkStream out) {
     if (src.nodes.size) {
-        inspectNode(0, src, out, 0);
+        inspectNode(0, src.nodes, &(TokenSource){.text = src.text, .tokens = src.tokens}, out, 0);
+    }
+}
+
+void nkl_ast_inspectCompact(NkString text, NklCompactTokenArray tokens, NklAstNodeArray nodes, NkStream out) {
+    if (nodes.size) {
+        inspectNode(0, nodes, &(TokenSource){.text = text, .compact_tokens = tokens}, out, 0);
     }
 }
@@ -1,5 +1,8 @@
 #include "nkl/common/diagnostics.h"
 
+#include <string.h>
+
+#include "ntk/dyn_array.h"
 #include "ntk/file.h"
 #include "ntk/stream.h"
 #include "ntk/string.h"
@@ -15,6 +18,39 @@ void nkl_diag_init(NklColorPolicy color_policy) {
     s_color_policy = color_policy;
 }
 
+NklLineIndex nkl_diag_indexLines(NkAllocator alloc, NkString src) {
+    NkDynArray(u32) lines = {.alloc = alloc};
+    nkda_append(&lines, 0);
+
+    char const *const end = src.data + src.size;
+    for (char const *it = src.data; (it = memchr(it, '\n', end - it)); it++) {
+        nkda_append(&lines, it - src.data + 1);
+    }
+
+    return (NklLineIndex){NKS_INIT(lines)};
+}
+
+NklSourceLocation nkl_diag_locate(NklLineIndex lines, NkString file, u32 pos, u32 len) {
+    // Last line that starts at or before the position
+    usize lo = 0;
+    usize hi = lines.size;
+    while (hi - lo > 1) {
+        usize const mid = lo + (hi - lo) / 2;
+        if (lines.data[mid] <= pos) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return (NklSourceLocation){
+        .file = file,
+        .lin = lo + 1,
+        .col = pos - (lines.size ? lines.data[lo] : 0) + 1,
+        .len = len,
+    };
+}
+
 void nkl_diag_printError(char const *fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
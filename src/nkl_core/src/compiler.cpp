@@ -116,7 +116,7 @@ NklModule nkl_createModule(NklCompiler c) {
     return new (nk_allocT<NklModule_T>(alloc)) NklModule_T{
         .com = c,
         .mod = nkir_createModule(c->ir),
-        .export_set{nullptr, alloc},
+        .export_set{NK_HASH_TREE_INIT(alloc)},
     };
 }
 
@@ -786,7 +786,7 @@ static Context *importFile(NklCompiler c, NkString filename) {
 
     DEFINE(&src, *nkl_getSource(nkl, file));
 
-    auto &pctx = getContextForFile(c, file).val;
+    auto pctx = getContextForFile(c, file).val;
     if (!pctx) {
         auto &ctx =
             *(pctx = new (nk_arena_allocT<Context>(&c->perm_arena)) Context{
@@ -804,6 +804,9 @@ static Context *importFile(NklCompiler c, NkString filename) {
                   .proc_stack{},
               });
 
+        // Compiling the file may import other files, so the file map entry cannot be held across it
+        getContextForFile(c, file).val = pctx;
+
         auto proc_t = nkl_get_proc(
             nkl,
             c->word_size,
@@ -1322,7 +1325,7 @@ static Interm compileImpl(Context &ctx, NklAstNode const &node, CompileConfig co
 
             auto found = DeclMap_findItem(&scope->locals, name);
             if (found) {
-                return resolveDecl(ctx, found->val);
+                return resolveDecl(ctx, *found->val);
             } else {
                 return error(ctx, "`" NKS_FMT "` is not declared", NKS_ARG(name_str));
             }
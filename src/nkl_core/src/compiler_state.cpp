@@ -201,7 +201,7 @@ static void pushScope(Context &ctx, NkArena *main_arena, NkArena *temp_arena) {
         .temp_arena = temp_arena,
         .temp_frame = nk_arena_grab(temp_arena),
 
-        .locals{nullptr, alloc},
+        .locals{NK_HASH_TREE_INIT(alloc)},
 
         .export_list{},
         .defer_stack{},
@@ -243,8 +243,9 @@ static Decl &makeDecl(Context &ctx, NkAtom name) {
         static Decl s_dummy{};
         return error(ctx, "redefinition of '%s'", nk_atom2cs(name)), s_dummy;
     }
-    auto kv = DeclMap_insertItem(&ctx.scope_stack->locals, {name, {}});
-    return kv->val;
+    auto const decl = new (nk_allocT<Decl>(ctx.scope_stack->locals.alloc)) Decl{};
+    DeclMap_insertItem(&ctx.scope_stack->locals, {name, decl});
+    return *decl;
 }
 
 // TODO: Figure out having to deep-clone the context for unresolved decls
@@ -292,7 +293,7 @@ Decl &resolve(Context &ctx, NkAtom name) {
     for (; scope; scope = scope->next) {
         auto found = DeclMap_findItem(&scope->locals, name);
         if (found) {
-            return found->val;
+            return *found->val;
         }
     }
 
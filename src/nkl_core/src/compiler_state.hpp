@@ -90,7 +90,7 @@ struct Interm {
 
 struct Decl_kv {
     NkAtom key;
-    Decl val;
+    Decl *val;
 };
 NK_HASH_TREE_TYPEDEF(DeclMap, Decl_kv);
 NK_HASH_TREE_PROTO(DeclMap, Decl_kv, NkAtom);
@@ -30,9 +30,11 @@ NklState nkl_state_create(StringSlice args, NklLexerProc lexer_proc, NklParserPr
         .lexer_proc = lexer_proc,
         .parser_proc = parser_proc,
         .files = {0},
+        .file_mappings = {0},
         .cli_args = args,
     };
     nkl->files.alloc = nk_arena_getAllocator(&nkl->permanent_arena);
+    nkl->file_mappings.alloc = nk_arena_getAllocator(&nkl->permanent_arena);
 
     nkl_types_init(nkl);
 
@@ -42,6 +44,10 @@ NklState nkl_state_create(StringSlice args, NklLexerProc lexer_proc, NklParserPr
 void nkl_state_free(NklState nkl) {
     nkl_types_free(nkl);
 
+    NK_ITERATE(NkFileMapping *, mapping, nkl->file_mappings) {
+        nk_file_unmap(mapping);
+    }
+
     NkArena arena = nkl->permanent_arena;
     nk_arena_free(&arena);
 }
@@ -49,22 +55,23 @@ void nkl_state_free(NklState nkl) {
 NklSource const *nkl_getSource(NklState nkl, NkAtom file) {
     Source_kv *found = FileMap_findItem(&nkl->files, file);
     if (!found) {
-        found = FileMap_insertItem(&nkl->files, (Source_kv){.key = file, .val = {0}});
+        NkAllocator alloc = nk_arena_getAllocator(&nkl->permanent_arena);
 
-        NklSource *src = &found->val;
-        src->file = file;
+        NklSource *src = nk_allocT(alloc, NklSource);
+        *src = (NklSource){.file = file};
 
-        NkAllocator alloc = nk_arena_getAllocator(&nkl->permanent_arena);
+        found = FileMap_insertItem(&nkl->files, (Source_kv){.key = file, .val = src});
 
         NkString filename = nk_atom2s(file);
 
-        NkString text;
-        bool const ok = nk_file_read(alloc, filename, &text);
+        NkFileMapping mapping;
+        bool const ok = nk_file_map(filename, &mapping);
         if (!ok) {
             nkl_reportError(
                 0, NULL, "failed to read file `" NKS_FMT "`: %s", NKS_ARG(filename), nk_getLastErrorString());
         } else {
-            src->text = text;
+            nkda_append(&nkl->file_mappings, mapping);
+            src->text = mapping.text;
 
             src->tokens = nkl->lexer_proc(nkl, alloc, file, src->text);
             if (!nkl_getErrorCount()) {
@@ -72,7 +79,7 @@ NklSource const *nkl_getSource(NklState nkl, NkAtom file) {
             }
         }
     }
-    return &found->val;
+    return found->val;
 }
 
 static _Thread_local NklErrorState *g_error_state;
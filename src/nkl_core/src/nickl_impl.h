@@ -5,6 +5,8 @@
 #include "ntk/arena.h"
 #include "ntk/atom.h"
 #include "ntk/common.h"
+#include "ntk/dyn_array.h"
+#include "ntk/file.h"
 #include "ntk/hash_tree.h"
 #include "ntk/slice.h"
 
@@ -28,14 +30,11 @@ typedef struct {
     TypeMap type_map;
     NkHandle mtx;
     u32 next_id;
-
-    // TODO: Use scratch arenas
-    NkArena tmp_arena;
 } NklTypeStorage;
 
 typedef struct {
     NkAtom key;
-    NklSource val;
+    NklSource *val;
 } Source_kv;
 NK_HASH_TREE_TYPEDEF(FileMap, Source_kv);
 NK_HASH_TREE_PROTO(FileMap, Source_kv, NkAtom);
@@ -49,6 +48,7 @@ typedef struct NklState_T {
     NklParserProc parser_proc;
 
     FileMap files;
+    NkDynArray(NkFileMapping) file_mappings;
 
     StringSlice cli_args;
 } NklState_T;
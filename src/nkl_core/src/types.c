@@ -80,11 +80,9 @@ static TypeSearchResult getTypeByFingerprint(NklState nkl, ByteArray fp, NklType
 void nkl_types_init(NklState nkl) {
     nkl->types = (NklTypeStorage){
         .type_arena = {0},
-        .type_map = {NULL, nk_arena_getAllocator(&nkl->types.type_arena)},
+        .type_map = {NK_HASH_TREE_INIT(nk_arena_getAllocator(&nkl->types.type_arena))},
         .mtx = nk_mutex_alloc(0),
         .next_id = 1,
-
-        .tmp_arena = {0},
     };
 }
 
@@ -92,7 +90,6 @@ void nkl_types_free(NklState nkl) {
     nk_mutex_free(nkl->types.mtx);
 
     nk_arena_free(&nkl->types.type_arena);
-    nk_arena_free(&nkl->types.tmp_arena);
 }
 
 static void get_ir_aggregate(NklState nkl, NklType *backing, NkIrAggregateLayout const layout) {
@@ -100,8 +97,8 @@ static void get_ir_aggregate(NklState nkl, NklType *backing, NkIrAggregateLayout
 
     NkIrTypeKind const kind = NkIrType_Aggregate;
 
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Ir);
         PUSH_VAL(&fp, u8, kind);
         PUSH_VAL(&fp, usize, layout.info_ar.size);
@@ -134,8 +131,8 @@ static void get_ir_numeric(NklState nkl, NklType *backing, NkIrNumericValueType
 
     NkIrTypeKind const kind = NkIrType_Numeric;
 
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Ir);
         PUSH_VAL(&fp, u8, kind);
         PUSH_VAL(&fp, u8, value_type);
@@ -162,8 +159,8 @@ static void get_ir_ptr(NklState nkl, usize word_size, NklType *backing, nktype_t
 
     NkIrTypeKind const kind = NkIrType_Pointer;
 
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Ir);
         PUSH_VAL(&fp, u8, kind);
         PUSH_VAL(&fp, u32, target_type->id);
@@ -190,8 +187,8 @@ static void get_ir_proc(NklState nkl, usize word_size, NklType *backing, NklProc
 
     NkIrTypeKind const kind = NkIrType_Procedure;
 
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Ir);
         PUSH_VAL(&fp, u8, kind);
         PUSH_VAL(&fp, usize, info.param_types.size);
@@ -242,8 +239,8 @@ nkltype_t nkl_get_any(NklState nkl, usize word_size) {
     NklTypeClass const tclass = NklType_Any;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
 
@@ -279,8 +276,8 @@ nkltype_t nkl_get_array(NklState nkl, nkltype_t elem_type, usize elem_count) {
     NklTypeClass const tclass = NklType_Array;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, u32, elem_type->id);
@@ -293,7 +290,7 @@ nkltype_t nkl_get_array(NklState nkl, nkltype_t elem_type, usize elem_count) {
             usize elem_counts[] = {elem_count};
 
             NkIrAggregateLayout layout = nkir_calcAggregateLayout(
-                nk_arena_getAllocator(&nkl->types.tmp_arena), elem_types, elem_counts, 1, 0, 0);
+                nk_arena_getAllocator(scratch), elem_types, elem_counts, 1, 0, 0);
             get_ir_aggregate(nkl, res.type, layout);
 
             res.type->tclass = tclass;
@@ -310,8 +307,8 @@ nkltype_t nkl_get_bool(NklState nkl) {
     NklTypeClass const tclass = NklType_Bool;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
 
@@ -337,8 +334,8 @@ nkltype_t nkl_get_enum(NklState nkl, NklFieldArray fields) {
     NklTypeClass const tclass = NklType_Enum;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, usize, fields.size);
@@ -380,8 +377,8 @@ nkltype_t nkl_get_numeric(NklState nkl, NkIrNumericValueType value_type) {
     NklTypeClass const tclass = NklType_Numeric;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, u8, value_type);
@@ -422,8 +419,8 @@ nkltype_t nkl_get_proc(NklState nkl, usize word_size, NklProcInfo info) {
     NklTypeClass const tclass = NklType_Procedure;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, usize, info.param_types.size);
@@ -455,8 +452,8 @@ nkltype_t nkl_get_ptr(NklState nkl, usize word_size, nkltype_t target_type, bool
     NklTypeClass const tclass = NklType_Pointer;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, u32, target_type->id);
@@ -484,8 +481,8 @@ nkltype_t nkl_get_slice(NklState nkl, usize word_size, nkltype_t target_type, bo
     NklTypeClass const tclass = NklType_Slice;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, u32, target_type->id);
@@ -524,8 +521,8 @@ nkltype_t nkl_get_struct(NklState nkl, NklFieldArray fields) {
     NklTypeClass const tclass = NklType_Struct;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, usize, fields.size);
@@ -571,8 +568,8 @@ nkltype_t nkl_get_tupleEx(NklState nkl, nkltype_t const *types, usize count, usi
     NklTypeClass const tclass = NklType_Tuple;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, usize, count);
@@ -587,7 +584,7 @@ nkltype_t nkl_get_tupleEx(NklState nkl, nkltype_t const *types, usize count, usi
 
         if (res.inserted) {
             NkIrAggregateLayout layout = nkir_calcAggregateLayout(
-                nk_arena_getAllocator(&nkl->types.tmp_arena), (nktype_t *)types, NULL, count, stride, 0);
+                nk_arena_getAllocator(scratch), (nktype_t *)types, NULL, count, stride, 0);
             get_ir_aggregate(nkl, res.type, layout);
 
             res.type->tclass = tclass;
@@ -613,8 +610,8 @@ nkltype_t nkl_get_typeref(NklState nkl, usize word_size) {
     NklTypeClass const tclass = NklType_Typeref;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
 
@@ -640,8 +637,8 @@ nkltype_t nkl_get_union(NklState nkl, NklFieldArray fields) {
     NklTypeClass const tclass = NklType_Union;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, usize, fields.size);
@@ -681,8 +678,8 @@ nkltype_t nkl_get_void(NklState nkl) {
     NklTypeClass const tclass = NklType_Tuple;
 
     TypeSearchResult res;
-    NK_ARENA_SCOPE(&nkl->types.tmp_arena) {
-        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(&nkl->types.tmp_arena))};
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        ByteDynArray fp = {NKDA_INIT(nk_arena_getAllocator(scratch))};
         PUSH_VAL(&fp, u8, TypeSubset_Nkl);
         PUSH_VAL(&fp, u8, tclass);
         PUSH_VAL(&fp, usize, 0);
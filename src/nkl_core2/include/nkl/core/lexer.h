@@ -26,6 +26,9 @@ enum {
     NklToken_Count,
 };
 
+// Keyword and operator lookup tables precomputed for a token table
+typedef struct NklLexerTables_T *NklLexerTables;
+
 typedef struct {
     NkString text;
     NkArena *arena;
@@ -36,9 +39,20 @@ typedef struct {
     u32 keywords_base;
     u32 operators_base;
     u32 tags_base;
+
+    // Optional, built from the token table on every call if null
+    NklLexerTables tables;
 } NklLexerData;
 
-bool nkl_lex(NklLexerData const *data, NklTokenArray *out_tokens);
+// Builds a perfect hash of the keywords and an operator trie, allocated in the arena
+NklLexerTables nkl_lex_prepare(
+    NkArena *arena,
+    char const **tokens,
+    u32 keywords_base,
+    u32 operators_base,
+    u32 tags_base);
+
+bool nkl_lex(NklLexerData const *data, NklCompactTokenArray *out_tokens);
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,28 @@ typedef enum {
     NklOutput_Object,
 } NklOutputKind;
 
+typedef enum {
+    NklOpt_O0 = 0,
+    NklOpt_O1,
+    NklOpt_O2,
+    NklOpt_O3,
+    NklOpt_Os,
+    NklOpt_Oz,
+} NklOptLevel;
+
+typedef struct {
+    NklOptLevel opt_level; // Used both for exporting and for JIT
+    NkString passes;       // Custom LLVM pass pipeline, replaces the one of opt_level
+    NkString cpu;          // Target CPU, `native` selects the host CPU with its features, `generic` if empty
+    NkString features;     // Target features, comma separated, e.g. `+avx2,-fma`
+} NklCompilerOpts;
+
+typedef enum {
+    NklJit_Eager = 0,
+    NklJit_Lazy,
+    NklJit_Tiered,
+} NklJitMode;
+
 typedef struct NklError {
     struct NklError *next;
 
@@ -43,8 +65,15 @@ typedef struct NklError {
 NK_EXPORT NklState nkl_newState(void);
 NK_EXPORT void nkl_freeState(NklState nkl);
 
-NK_EXPORT NklCompiler nkl_newCompiler(NklState nkl, NklTargetTriple target);
-NK_EXPORT NklCompiler nkl_newCompilerForHost(NklState nkl);
+NK_EXPORT void nkl_setJitMode(NklState nkl, NklJitMode mode);
+// 1 by default, 0 selects the number of hardware threads
+NK_EXPORT void nkl_setCodegenThreadCount(NklState nkl, usize count);
+// Keeps compiled object code in dir to reuse it across runs, trimmed to max_size bytes, 0 means no limit.
+// Disabled by default, an empty dir disables it again
+NK_EXPORT void nkl_setObjectCache(NklState nkl, NkString dir, u64 max_size);
+
+NK_EXPORT NklCompiler nkl_newCompiler(NklState nkl, NklTargetTriple target, NklCompilerOpts opts);
+NK_EXPORT NklCompiler nkl_newCompilerForHost(NklState nkl, NklCompilerOpts opts);
 
 NK_EXPORT NklModule nkl_newModule(NklCompiler com);
 NK_EXPORT NklModule nkl_newModuleNamed(NklCompiler com, NkString name);
@@ -27,27 +27,18 @@ typedef struct {
     NklState const nkl;
     NkAtom const file;
     NkString const text;
-    NklTokenArray const tokens;
+    NklCompactTokenArray const tokens;
     NkArena *const arena;
 
     char const **token_names;
 
     NklAstNodeDynArray nodes;
 
-    NklToken const *cur_token;
+    NklCompactToken const *cur_token;
 } ParserState;
 
 static void vreportError(ParserState *p, char const *fmt, va_list ap) {
-    nickl_vreportError(
-        p->nkl,
-        (NklSourceLocation){
-            .file = nk_atom2s(p->file),
-            .lin = p->cur_token->lin,
-            .col = p->cur_token->col,
-            .len = p->cur_token->len,
-        },
-        fmt,
-        ap);
+    nickl_vreportError(p->nkl, nickl_getTokenLoc(p->nkl, p->file, p->cur_token), fmt, ap);
 }
 
 NK_PRINTF_LIKE(2) static void reportError(ParserState *p, char const *fmt, ...) {
@@ -71,7 +62,7 @@ static void getToken(ParserState *p) {
     NK_LOG_STREAM_DBG {
         NkStream log = nk_log_getStream();
         nk_printf(log, "next token: \"");
-        nks_escape(log, nkl_getTokenStr(p->cur_token, p->text));
+        nks_escape(log, nkl_getCompactTokenStr(p->cur_token, p->text));
         nk_printf(log, "\":%u", p->cur_token->id);
     }
 }
@@ -81,7 +72,7 @@ static bool accept(ParserState *p, u32 id) {
         NK_LOG_STREAM_DBG {
             NkStream log = nk_log_getStream();
             nk_printf(log, "accept \"");
-            nks_escape(log, nkl_getTokenStr(p->cur_token, p->text));
+            nks_escape(log, nkl_getCompactTokenStr(p->cur_token, p->text));
             nk_printf(log, "\":%u", p->cur_token->id);
         }
 
@@ -93,7 +84,7 @@ static bool accept(ParserState *p, u32 id) {
 
 static bool expect(ParserState *p, u32 id) {
     if (!accept(p, id)) {
-        NkString const token_str = nkl_getTokenStr(p->cur_token, p->text);
+        NkString const token_str = nkl_getCompactTokenStr(p->cur_token, p->text);
         reportError(
             p,
             "expected `%s` before `" NKS_FMT "`",
@@ -132,7 +123,7 @@ static bool parseNode(ParserState *p) {
     if (accept(p, NklAstToken_LParen)) {
         if (!accept(p, NklAstToken_RParen)) {
             if (on(p, NklToken_Id)) {
-                NkString const token_str = nkl_getTokenStr(p->cur_token, p->text);
+                NkString const token_str = nkl_getCompactTokenStr(p->cur_token, p->text);
                 node->id = nk_s2atom(token_str);
                 getToken(p);
             } else if (on(p, NklToken_String)) {
@@ -141,7 +132,7 @@ static bool parseNode(ParserState *p) {
                 node->id = nk_s2atom((NkString){data, len});
                 getToken(p);
             } else {
-                NkString const token_str = nkl_getTokenStr(p->cur_token, p->text);
+                NkString const token_str = nkl_getCompactTokenStr(p->cur_token, p->text);
                 reportError(p, "unexpected token `" NKS_FMT "`", NKS_ARG(token_str));
                 return false;
             }
@@ -174,7 +165,7 @@ static bool parseNode(ParserState *p) {
     }
 
     else {
-        NkString const token_str = nkl_getTokenStr(p->cur_token, p->text);
+        NkString const token_str = nkl_getCompactTokenStr(p->cur_token, p->text);
         reportError(p, "unexpected token `" NKS_FMT "`", NKS_ARG(token_str));
         return false;
     }
@@ -191,7 +182,7 @@ static bool parse(ParserState *p) {
     TRY(parseNodeList(p, node));
 
     if (!on(p, NklToken_Eof)) {
-        NkString const token_str = nkl_getTokenStr(p->cur_token, p->text);
+        NkString const token_str = nkl_getCompactTokenStr(p->cur_token, p->text);
         reportError(p, "unexpected token `" NKS_FMT "`", NKS_ARG(token_str));
         return false;
     }
@@ -210,7 +201,7 @@ bool nkl_ast_parse(NklAstParserData const *data, NklAstNodeArray *out_nodes) {
         return false;
     }
 
-    NklTokenArray tokens;
+    NklCompactTokenArray tokens;
     if (!nickl_getTokensAst(nkl, file, &tokens)) {
         return false;
     }
@@ -232,14 +223,7 @@ bool nkl_ast_parse(NklAstParserData const *data, NklAstNodeArray *out_nodes) {
     NK_LOG_STREAM_INF {
         NkStream log = nk_log_getStream();
         nk_printf(log, "AST:");
-        nkl_ast_inspect(
-            (NklSource){
-                .file = 0,
-                .text = text,
-                .tokens = tokens,
-                .nodes = {NKS_INIT(p.nodes)},
-            },
-            log);
+        nkl_ast_inspectCompact(text, tokens, (NklAstNodeArray){NKS_INIT(p.nodes)}, log);
     }
 
     *out_nodes = (NklAstNodeArray){NKS_INIT(p.nodes)};
@@ -1,3 +1,4 @@
 #include "hash_trees.h"
 
 NK_HASH_TREE_IMPL_KV(NkAtomModuleMap, NkAtom, NklModule, nk_atom_hash, nk_atom_equal);
+NK_HASH_TREE_IMPL_KV(NkAtomFileCacheMap, NkAtom, NklFileCache, nk_atom_hash, nk_atom_equal);
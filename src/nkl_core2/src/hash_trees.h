@@ -1,6 +1,9 @@
 #ifndef NKL_CORE_HASH_TREES_H_
 #define NKL_CORE_HASH_TREES_H_
 
+#include "nkl/common/ast.h"
+#include "nkl/common/diagnostics.h"
+#include "nkl/common/token.h"
 #include "nkl/core/nickl.h"
 #include "ntk/atom.h"
 #include "ntk/hash_tree.h"
@@ -11,6 +14,18 @@ extern "C" {
 
 NK_HASH_TREE_FWD_KV(NkAtomModuleMap, NkAtom, NklModule);
 
+// Derived from the text of a file, lexed tokens always end with Eof, so empty arrays are not lexed yet
+typedef struct {
+    NklCompactTokenArray ir_tokens;
+    NklCompactTokenArray ast_tokens;
+    NklAstNodeArray ast_nodes;
+    bool has_ast_nodes;
+    // Only needed for diagnostics, so built on first use
+    NklLineIndex lines;
+} NklFileCache;
+
+NK_HASH_TREE_FWD_KV(NkAtomFileCacheMap, NkAtom, NklFileCache);
+
 #ifdef __cplusplus
 }
 #endif
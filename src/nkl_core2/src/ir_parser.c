@@ -58,7 +58,7 @@ typedef struct SourceInfo {
     NkAtom file;
     NkString text;
 
-    NklToken const *cur_token;
+    NklCompactToken const *cur_token;
 } SourceInfo;
 
 typedef struct {
@@ -147,16 +147,8 @@ typedef struct {
 static Void const ret;
 
 static void vreportError(ParserState *p, char const *fmt, va_list ap) {
-    nickl_vreportError(
-        p->mod->com->nkl,
-        (NklSourceLocation){
-            .file = nk_atom2s(p->src->file),
-            .lin = p->src->cur_token->lin,
-            .col = p->src->cur_token->col,
-            .len = p->src->cur_token->len,
-        },
-        fmt,
-        ap);
+    NklState const nkl = p->mod->com->nkl;
+    nickl_vreportError(nkl, nickl_getTokenLoc(nkl, p->src->file, p->src->cur_token), fmt, ap);
     p->error_occurred = true;
 }
 
@@ -171,8 +163,8 @@ static bool on(ParserState const *p, u32 id) {
     return p->src->cur_token->id == id;
 }
 
-static NkString tokenStr(ParserState *p, NklToken const *token) {
-    return nkl_getTokenStr(token, p->src->text);
+static NkString tokenStr(ParserState *p, NklCompactToken const *token) {
+    return nkl_getCompactTokenStr(token, p->src->text);
 }
 
 static NkString curTokenStr(ParserState *p) {
@@ -218,8 +210,8 @@ static bool accept(ParserState *p, u32 id) {
     return false;
 }
 
-static NklToken const *expect(ParserState *p, u32 id) {
-    NklToken const *ret = p->src->cur_token;
+static NklCompactToken const *expect(ParserState *p, u32 id) {
+    NklCompactToken const *ret = p->src->cur_token;
     if (!ACCEPT(id)) {
         NkString const str = escapedCurTokenStr(p);
         ERROR(
@@ -363,7 +355,7 @@ static NkIrType parseType(ParserState *p) {
 
         return type;
     } else if (on(p, NklToken_Id)) {
-        TRY(NklToken const *name_token = expect(p, NklToken_Id));
+        TRY(NklCompactToken const *name_token = expect(p, NklToken_Id));
         NkString const name_token_str = tokenStr(p, name_token);
         NkAtom const name = nk_s2atom(name_token_str);
 
@@ -858,7 +850,7 @@ static Void parseProc(ParserState *p, NkIrVisibility vis) {
         EXPECT(NklIrToken_Colon);
         TRY(NkIrType const type = parseType(p));
 
-        TRY(NklToken const *arg_name_token = expect(p, NklIrToken_PercentTag));
+        TRY(NklCompactToken const *arg_name_token = expect(p, NklIrToken_PercentTag));
         NkString const arg_name_token_str = tokenStr(p, arg_name_token);
         NkAtom const arg_name = nk_s2atom((NkString){arg_name_token_str.data + 1, arg_name_token_str.size - 1});
 
@@ -883,7 +875,7 @@ static Void parseProc(ParserState *p, NkIrVisibility vis) {
     }
 
     if (p->proc_ret.type->size > get_ptr_t(p)->size) {
-        TRY(NklToken const *ret_ref_token = expect(p, NklIrToken_PercentTag));
+        TRY(NklCompactToken const *ret_ref_token = expect(p, NklIrToken_PercentTag));
         NkString const ret_ref_token_str = tokenStr(p, ret_ref_token);
         p->proc_ret.name = nk_s2atom((NkString){ret_ref_token_str.data + 1, ret_ref_token_str.size - 1});
     } else {
@@ -1071,7 +1063,7 @@ static bool pushSource(ParserState *p, NkAtom file) {
         return false;
     }
 
-    NklTokenArray tokens;
+    NklCompactTokenArray tokens;
     if (!nickl_getTokensIr(p->mod->com->nkl, file, &tokens)) {
         p->error_occurred = true;
         return false;
@@ -1108,7 +1100,7 @@ static Void parseSymbol(ParserState *p) {
     }
 
     else if (ACCEPT(NklIrToken_type)) {
-        TRY(NklToken const *name_token = expect(p, NklToken_Id));
+        TRY(NklCompactToken const *name_token = expect(p, NklToken_Id));
         NkString const name_token_str = tokenStr(p, name_token);
         NkAtom const name = nk_s2atom(name_token_str);
 
@@ -1,6 +1,11 @@
 #include "nkl/core/lexer.h"
 
 #include <ctype.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
 
 #include "nkl/common/token.h"
 #include "ntk/arena.h"
@@ -10,30 +15,160 @@
 #include "ntk/slice.h"
 #include "ntk/string.h"
 #include "ntk/string_builder.h"
+#include "ntk/utils.h"
 
 NK_LOG_USE_SCOPE(lexer);
 
+#define OPERATOR_ALPHABET_SIZE 128
+
+typedef struct {
+    u32 token; // Operator index plus one, zero if no operator ends here
+    u16 next[OPERATOR_ALPHABET_SIZE];
+} OperatorNode;
+
+typedef struct NklLexerTables_T {
+    u32 first_keyword_id;
+    u32 first_operator_id;
+    u32 first_tag_id;
+
+    char const **keywords;
+    char const **tag_prefixes;
+
+    // Hash and displace, a keyword goes to the slot picked by the displacement of its bucket
+    u32 *keyword_lens;
+    u32 *keyword_disps;
+    u32 *keyword_slots; // Keyword index plus one, zero if empty
+    u32 keyword_bucket_mask;
+    u32 keyword_slot_mask;
+    u32 max_keyword_len;
+
+    // Root is the first node, zero links mean no transition
+    OperatorNode *operator_nodes;
+} NklLexerTables_T;
+
 typedef struct {
     NkString const text;
     NkArena *const arena;
     NkString *const err_str;
 
-    u32 const first_keyword_id;
-    u32 const first_operator_id;
-    u32 const first_tag_id;
-
-    char const **const keywords;
-    char const **const operators;
-    char const **const tag_prefixes;
+    NklLexerTables const tables;
 
     u32 pos;
-    u32 lin;
-    u32 col;
 } LexerState;
 
 // TODO: Support CRLF
 // TODO: Support UTF-8
 
+// Character classes of the C locale, without the locale lookups of ctype.h
+
+static bool isSpaceChar(char c) {
+    return c == ' ' || (u8)(c - '\t') < 5;
+}
+
+static bool isBlankChar(char c) {
+    return isSpaceChar(c) && c != '\n';
+}
+
+static bool isAlphaChar(char c) {
+    return (u8)((c | 0x20) - 'a') < 26;
+}
+
+static bool isDigitChar(char c) {
+    return (u8)(c - '0') < 10;
+}
+
+static bool isAlnumChar(char c) {
+    return isAlphaChar(c) || isDigitChar(c);
+}
+
+static bool isIdChar(char c) {
+    return isAlnumChar(c) || c == '_';
+}
+
+static bool isStringChar(char c) {
+    return c != '"' && c != '\\' && c != '\n' && c != '\0';
+}
+
+#ifdef __SSE2__
+
+#define SIMD_WIDTH 16
+
+static __m128i inRangeVec(__m128i v, char lo, char hi) {
+    __m128i const offset = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(hi - lo)), offset);
+}
+
+static __m128i isBlankVec(__m128i v) {
+    __m128i const space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    __m128i const newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    return _mm_or_si128(space, _mm_andnot_si128(newline, inRangeVec(v, '\t', '\r')));
+}
+
+static __m128i isDigitVec(__m128i v) {
+    return inRangeVec(v, '0', '9');
+}
+
+static __m128i isIdVec(__m128i v) {
+    __m128i const alpha = inRangeVec(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i const uscr = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(alpha, isDigitVec(v)), uscr);
+}
+
+static __m128i isStringVec(__m128i v) {
+    __m128i const quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+    __m128i const bslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+    __m128i const newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    __m128i const null = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+    __m128i const stop = _mm_or_si128(_mm_or_si128(quote, bslash), _mm_or_si128(newline, null));
+    return _mm_cmpeq_epi8(stop, _mm_setzero_si128());
+}
+
+// Scans whole vectors while they are in the class, the scalar loop finishes the run
+#define SKIP_VEC(TEXT, POS, IS_VEC)                                                       \
+    while ((POS) + SIMD_WIDTH <= (TEXT).size) {                                           \
+        __m128i const _v = _mm_loadu_si128((__m128i const *)((TEXT).data + (POS)));       \
+        u32 const _mask = ~(u32)_mm_movemask_epi8(IS_VEC(_v)) & ((1u << SIMD_WIDTH) - 1); \
+        if (_mask) {                                                                      \
+            (POS) += __builtin_ctz(_mask);                                                \
+            break;                                                                        \
+        }                                                                                 \
+        (POS) += SIMD_WIDTH;                                                              \
+    }
+
+#else // __SSE2__
+
+#define SKIP_VEC(TEXT, POS, IS_VEC)
+
+#endif // __SSE2__
+
+#define SKIP_WHILE(TEXT, POS, IS_VEC, IS_CHAR)                     \
+    do {                                                           \
+        SKIP_VEC(TEXT, POS, IS_VEC)                                \
+        while ((POS) < (TEXT).size && IS_CHAR((TEXT).data[POS])) { \
+            (POS)++;                                               \
+        }                                                          \
+    } while (0)
+
+static u32 skipBlanks(NkString text, u32 pos) {
+    SKIP_WHILE(text, pos, isBlankVec, isBlankChar);
+    return pos;
+}
+
+static u32 skipDigits(NkString text, u32 pos) {
+    SKIP_WHILE(text, pos, isDigitVec, isDigitChar);
+    return pos;
+}
+
+static u32 skipIdChars(NkString text, u32 pos) {
+    SKIP_WHILE(text, pos, isIdVec, isIdChar);
+    return pos;
+}
+
+static u32 skipStringChars(NkString text, u32 pos) {
+    SKIP_WHILE(text, pos, isStringVec, isStringChar);
+    return pos;
+}
+
 static char chr(LexerState const *l, i64 offset) {
     return l->pos + offset < (u32)l->text.size ? l->text.data[l->pos + offset] : '\0';
 }
@@ -42,72 +177,80 @@ static bool on(LexerState const *l, char c, i64 offset) {
     return chr(l, offset) == c;
 }
 
-static int onSpace(LexerState const *l, i64 offset) {
-    return isspace(chr(l, offset));
-}
-
-static int onAlpha(LexerState const *l, i64 offset) {
-    return isalpha(chr(l, offset));
+static bool onAlpha(LexerState const *l, i64 offset) {
+    return isAlphaChar(chr(l, offset));
 }
 
-static int onAlnum(LexerState const *l, i64 offset) {
-    return isalnum(chr(l, offset));
+static bool onAlnum(LexerState const *l, i64 offset) {
+    return isAlnumChar(chr(l, offset));
 }
 
-static int onDigit(LexerState const *l, i64 offset) {
-    return isdigit(chr(l, offset));
+static bool onDigit(LexerState const *l, i64 offset) {
+    return isDigitChar(chr(l, offset));
 }
 
-static int onXdigit(LexerState const *l, i64 offset) {
-    return isxdigit(chr(l, offset));
+static bool onXdigit(LexerState const *l, i64 offset) {
+    return onDigit(l, offset) || (u8)((chr(l, offset) | 0x20) - 'a') < 6;
 }
 
-static int onLower(LexerState const *l, i64 offset) {
-    return tolower(chr(l, offset));
+static char onLower(LexerState const *l, i64 offset) {
+    return chr(l, offset) | 0x20;
 }
 
 static bool onAlphaOrUscr(LexerState const *l, i64 offset) {
     return onAlpha(l, offset) || on(l, '_', offset);
 }
 
-static bool onAlnumOrUscr(LexerState const *l, i64 offset) {
-    return onAlnum(l, offset) || on(l, '_', offset);
-}
-
 static int onPrint(LexerState const *l, i64 offset) {
     return isprint(chr(l, offset));
 }
 
+// Lines are not tracked, positions are mapped to lines and columns only for diagnostics
 static void advance(LexerState *l, i64 n) {
     for (i64 i = 0; i < n && chr(l, 0); i++) {
-        if (on(l, '\n', 0)) {
-            l->col = 1;
-            l->lin++;
-        } else {
-            l->col++;
-        }
         l->pos++;
     }
 }
 
-static void accept(LexerState *l, NklToken *token, i64 n) {
+static void accept(LexerState *l, NklCompactToken *token, i64 n) {
     advance(l, n);
     token->len += n;
 }
 
-static void discard(LexerState *l, NklToken *token) {
-    l->pos -= token->len;
-    l->col -= token->len;
-    token->len = 0;
+static void acceptUntil(LexerState *l, NklCompactToken *token, u32 end) {
+    token->len += end - l->pos;
+    l->pos = end;
+}
+
+// Stops at the byte, a null byte or the end of text
+static void skipUntil(LexerState *l, char stop) {
+#ifdef __SSE2__
+    __m128i const stop_vec = _mm_set1_epi8(stop);
+    while (l->pos + SIMD_WIDTH <= l->text.size) {
+        __m128i const v = _mm_loadu_si128((__m128i const *)(l->text.data + l->pos));
+        u32 const stop_mask = (u32)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, stop_vec), _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+        if (stop_mask) {
+            l->pos += __builtin_ctz(stop_mask);
+            return;
+        }
+        l->pos += SIMD_WIDTH;
+    }
+#endif // __SSE2__
+
+    while (chr(l, 0) && !on(l, stop, 0)) {
+        l->pos++;
+    }
 }
 
 static void skipSpaces(LexerState *l) {
     // TODO: Properly handle backslash in the source
-    while ((onSpace(l, 0) || (on(l, '\\', 0) && on(l, '\n', 1))) && !on(l, '\n', 0)) {
+    for (;;) {
+        l->pos = skipBlanks(l->text, l->pos);
         if (on(l, '\\', 0) && on(l, '\n', 1)) {
             advance(l, 2);
         } else {
-            advance(l, 1);
+            break;
         }
     }
 }
@@ -125,24 +268,225 @@ static NK_PRINTF_LIKE(2) void reportError(LexerState *l, char const *fmt, ...) {
     va_end(ap);
 }
 
-static NklToken scan(LexerState *l) {
+static u32 hashKeyword(NkString str) {
+    // FNV-1a
+    u32 hash = 2166136261u;
+    for (usize i = 0; i < str.size; i++) {
+        hash = (hash ^ (u8)str.data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static u32 keywordSlot(NklLexerTables tables, u32 hash, u32 disp) {
+    // Remixes the hash, so that every displacement gives an independent slot
+    u32 h = hash ^ (disp * 0x9e3779b9u);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h & tables->keyword_slot_mask;
+}
+
+// Returns the keyword index plus one, or zero
+static u32 findKeyword(NklLexerTables tables, NkString str) {
+    if (!tables->keyword_slots || str.size > tables->max_keyword_len) {
+        return 0;
+    }
+
+    u32 const hash = hashKeyword(str);
+    u32 const disp = tables->keyword_disps[hash & tables->keyword_bucket_mask];
+    if (!disp) {
+        return 0;
+    }
+
+    u32 const keyword = tables->keyword_slots[keywordSlot(tables, hash, disp)];
+    if (keyword && tables->keyword_lens[keyword - 1] == str.size &&
+        memcmp(tables->keywords[keyword - 1], str.data, str.size) == 0) {
+        return keyword;
+    }
+    return 0;
+}
+
+static void buildKeywordHash(NkArena *arena, NklLexerTables tables) {
+    u32 count = 0;
+    for (char const **it = tables->keywords; it && *it; it++) {
+        count++;
+    }
+
+    if (!count) {
+        return;
+    }
+
+    // Half empty table, so that displacements are found quickly
+    u32 const bucket_count = nk_ceilToPowerOf2(count);
+    u32 const slot_count = bucket_count * 2;
+
+    tables->keyword_bucket_mask = bucket_count - 1;
+    tables->keyword_slot_mask = slot_count - 1;
+
+    tables->keyword_lens = nk_arena_allocTn(arena, u32, count);
+    tables->keyword_disps = nk_arena_allocTn(arena, u32, bucket_count);
+    tables->keyword_slots = nk_arena_allocTn(arena, u32, slot_count);
+
+    memset(tables->keyword_disps, 0, sizeof(u32) * bucket_count);
+    memset(tables->keyword_slots, 0, sizeof(u32) * slot_count);
+
+    NK_SCRATCH_SCOPE(scratch, arena) {
+        u32 *hashes = nk_arena_allocTn(scratch, u32, count);
+        bool *dups = nk_arena_allocTn(scratch, bool, count);
+        u32 *bucket_sizes = nk_arena_allocTn(scratch, u32, bucket_count);
+        memset(bucket_sizes, 0, sizeof(u32) * bucket_count);
+
+        u32 max_bucket_size = 0;
+        for (u32 i = 0; i < count; i++) {
+            NkString const keyword = nk_cs2s(tables->keywords[i]);
+
+            tables->keyword_lens[i] = keyword.size;
+            tables->max_keyword_len = nk_maxu(tables->max_keyword_len, keyword.size);
+
+            hashes[i] = hashKeyword(keyword);
+
+            // The first of duplicate keywords wins
+            dups[i] = false;
+            for (u32 j = 0; j < i && !dups[i]; j++) {
+                dups[i] = hashes[j] == hashes[i] && strcmp(tables->keywords[j], tables->keywords[i]) == 0;
+            }
+
+            if (!dups[i]) {
+                u32 const bucket_size = ++bucket_sizes[hashes[i] & tables->keyword_bucket_mask];
+                max_bucket_size = nk_maxu(max_bucket_size, bucket_size);
+            }
+        }
+
+        u32 *bucket_slots = nk_arena_allocTn(scratch, u32, max_bucket_size);
+
+        // Largest buckets are placed first, while the table is still empty
+        for (u32 size = max_bucket_size; size > 0; size--) {
+            for (u32 bucket = 0; bucket < bucket_count; bucket++) {
+                if (bucket_sizes[bucket] != size) {
+                    continue;
+                }
+
+                for (u32 disp = 1;; disp++) {
+                    nk_assert(disp < (1u << 24) && "failed to build a perfect hash");
+
+                    u32 placed = 0;
+                    for (u32 i = 0; i < count && placed < size; i++) {
+                        if (dups[i] || (hashes[i] & tables->keyword_bucket_mask) != bucket) {
+                            continue;
+                        }
+
+                        u32 const slot = keywordSlot(tables, hashes[i], disp);
+                        if (tables->keyword_slots[slot]) {
+                            break;
+                        }
+
+                        bool collides = false;
+                        for (u32 j = 0; j < placed; j++) {
+                            collides |= bucket_slots[j] == slot;
+                        }
+                        if (collides) {
+                            break;
+                        }
+
+                        tables->keyword_slots[slot] = i + 1;
+                        bucket_slots[placed++] = slot;
+                    }
+
+                    if (placed == size) {
+                        tables->keyword_disps[bucket] = disp;
+                        break;
+                    }
+
+                    for (u32 j = 0; j < placed; j++) {
+                        tables->keyword_slots[bucket_slots[j]] = 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void buildOperatorTrie(NkArena *arena, NklLexerTables tables, char const **operators) {
+    NkDynArray(OperatorNode) nodes = {.alloc = nk_arena_getAllocator(arena)};
+    nkda_append(&nodes, (OperatorNode){0});
+
+    for (char const **it = operators; it && *it; it++) {
+        u32 node = 0;
+        for (char const *c = *it; *c; c++) {
+            nk_assert((u8)*c < OPERATOR_ALPHABET_SIZE && "unsupported operator character");
+
+            if (!nodes.data[node].next[(u8)*c]) {
+                nk_assert(nodes.size <= UINT16_MAX && "too many operators");
+
+                nodes.data[node].next[(u8)*c] = nodes.size;
+                nkda_append(&nodes, (OperatorNode){0});
+            }
+            node = nodes.data[node].next[(u8)*c];
+        }
+
+        // The first of duplicate operators wins
+        if (!nodes.data[node].token) {
+            nodes.data[node].token = it - operators + 1;
+        }
+    }
+
+    tables->operator_nodes = nodes.data;
+}
+
+static u32 lastTokenId(u32 first_id, char const **tokens) {
+    u32 id = first_id;
+    for (char const **it = tokens; it && *it; it++) {
+        id++;
+    }
+    return id - 1;
+}
+
+NklLexerTables nkl_lex_prepare(
+    NkArena *arena,
+    char const **tokens,
+    u32 keywords_base,
+    u32 operators_base,
+    u32 tags_base) {
+    NK_LOG_TRC("%s", __func__);
+
+    NklLexerTables tables = nk_arena_allocT(arena, NklLexerTables_T);
+    NK_PROF_FUNC() {
+        *tables = (NklLexerTables_T){
+            .first_keyword_id = keywords_base + 1,
+            .first_operator_id = operators_base + 1,
+            .first_tag_id = tags_base + 1,
+
+            .keywords = tokens + keywords_base + 1,
+            .tag_prefixes = tokens + tags_base + 1,
+        };
+
+        buildKeywordHash(arena, tables);
+        buildOperatorTrie(arena, tables, tokens + operators_base + 1);
+
+        nk_assert(
+            lastTokenId(tables->first_keyword_id, tables->keywords) <= NKL_COMPACT_TOKEN_MAX_ID &&
+            lastTokenId(tables->first_operator_id, tokens + operators_base + 1) <= NKL_COMPACT_TOKEN_MAX_ID &&
+            lastTokenId(tables->first_tag_id, tables->tag_prefixes) <= NKL_COMPACT_TOKEN_MAX_ID &&
+            "token ids do not fit in compact tokens");
+    }
+    return tables;
+}
+
+static NklCompactToken scan(LexerState *l) {
     skipSpaces(l);
 
     if (l->pos == 0 && on(l, '#', 0) && on(l, '!', 1)) {
-        while (chr(l, 0) && !on(l, '\n', 0)) {
-            advance(l, 1);
-        }
+        skipUntil(l, '\n');
         skipSpaces(l);
     }
 
     while ((on(l, '/', 0) && on(l, '/', 1)) || (on(l, '/', 0) && on(l, '*', 1))) {
         if (on(l, '/', 1)) {
-            while (!on(l, '\n', 0)) {
-                advance(l, 1);
-            }
+            skipUntil(l, '\n');
         } else {
             advance(l, 2);
             while (chr(l, 0)) {
+                skipUntil(l, '*');
                 if (on(l, '*', 0) && on(l, '/', 1)) {
                     advance(l, 2);
                     break;
@@ -154,12 +498,10 @@ static NklToken scan(LexerState *l) {
         skipSpaces(l);
     }
 
-    NklToken token = {
-        .id = NklToken_Error,
+    NklCompactToken token = {
         .pos = l->pos,
+        .id = NklToken_Error,
         .len = 0,
-        .lin = l->lin,
-        .col = l->col,
     };
 
     if (!chr(l, 0)) {
@@ -180,40 +522,41 @@ static NklToken scan(LexerState *l) {
 
         bool escaped = false;
 
-        while (chr(l, 0) && !on(l, '\"', 0) && !on(l, '\n', 0)) {
+        for (;;) {
+            acceptUntil(l, &token, skipStringChars(l->text, l->pos));
+            if (!on(l, '\\', 0)) {
+                break;
+            }
+
             accept(l, &token, 1);
-            if (on(l, '\\', -1)) {
-                switch (chr(l, 0)) {
-                    case 'n':
-                    case 't':
-                    case '0':
-                    case '\\':
-                    case '"':
-                    case '\n':
-                        escaped = true;
-                        accept(l, &token, 1);
-                        break;
-                    default:
-                        if (!chr(l, 0)) {
-                            reportError(l, "unexpected end of file");
+            switch (chr(l, 0)) {
+                case 'n':
+                case 't':
+                case '0':
+                case '\\':
+                case '"':
+                case '\n':
+                    escaped = true;
+                    accept(l, &token, 1);
+                    break;
+                default:
+                    if (!chr(l, 0)) {
+                        reportError(l, "unexpected end of file");
+                        token.id = NklToken_Error;
+                        return token;
+                    } else {
+                        token.pos = l->pos - 1;
+                        token.len = 2;
+                        if (onPrint(l, 0)) {
+                            reportError(l, "invalid escape sequence `\\%c`", chr(l, 0));
                             token.id = NklToken_Error;
                             return token;
                         } else {
-                            token.pos = l->pos - 1;
-                            token.len = 2;
-                            token.lin = l->lin;
-                            token.col = l->col - 1;
-                            if (onPrint(l, 0)) {
-                                reportError(l, "invalid escape sequence `\\%c`", chr(l, 0));
-                                token.id = NklToken_Error;
-                                return token;
-                            } else {
-                                reportError(l, "invalid escape sequence `\\\\x%" PRIx8 "`", chr(l, 0) & 0xff);
-                                token.id = NklToken_Error;
-                                return token;
-                            }
+                            reportError(l, "invalid escape sequence `\\\\x%" PRIx8 "`", chr(l, 0) & 0xff);
+                            token.id = NklToken_Error;
+                            return token;
                         }
-                }
+                    }
             }
         }
 
@@ -263,15 +606,12 @@ static NklToken scan(LexerState *l) {
 
             token.id = NklToken_Int;
 
-            while (onDigit(l, 0)) {
-                accept(l, &token, 1);
-            }
+            acceptUntil(l, &token, skipDigits(l->text, l->pos));
 
             if (on(l, '.', 0)) {
                 token.id = NklToken_Float;
-                do {
-                    accept(l, &token, 1);
-                } while (onDigit(l, 0));
+                accept(l, &token, 1);
+                acceptUntil(l, &token, skipDigits(l->text, l->pos));
             }
 
             if (onLower(l, 0) == 'e') {
@@ -285,9 +625,7 @@ static NklToken scan(LexerState *l) {
                     token.id = NklToken_Error;
                     return token;
                 }
-                while (onDigit(l, 0)) {
-                    accept(l, &token, 1);
-                }
+                acceptUntil(l, &token, skipDigits(l->text, l->pos));
             }
 
             if (onAlpha(l, 0)) {
@@ -302,62 +640,52 @@ static NklToken scan(LexerState *l) {
     }
 
     if (onAlphaOrUscr(l, 0)) {
-        while (onAlnumOrUscr(l, 0)) {
-            accept(l, &token, 1);
-        }
+        acceptUntil(l, &token, skipIdChars(l->text, l->pos));
 
-        NkString const token_str = nkl_getTokenStr(&token, l->text);
-        char const **it = l->keywords;
-        for (; it && *it && !nks_equalCStr(token_str, *it); it++) {
-        }
-
-        if (it && *it) {
-            ptrdiff_t const idx = it - l->keywords;
-            token.id = l->first_keyword_id + idx;
-        } else {
-            token.id = NklToken_Id;
-        }
+        u32 const keyword = findKeyword(l->tables, nkl_getCompactTokenStr(&token, l->text));
+        token.id = keyword ? l->tables->first_keyword_id + keyword - 1 : NklToken_Id;
 
         return token;
     }
 
     {
         // TODO: Allow multicharacter tags
-        char const **it = l->tag_prefixes;
+        char const **it = l->tables->tag_prefixes;
         for (; it && *it && !(on(l, **it, 0) && onAlphaOrUscr(l, 1)); it++) {
         }
 
         if (it && *it) {
-            do {
-                accept(l, &token, 1);
-            } while (onAlnumOrUscr(l, 0));
+            accept(l, &token, 1);
+            acceptUntil(l, &token, skipIdChars(l->text, l->pos));
 
-            ptrdiff_t const idx = it - l->tag_prefixes;
-            token.id = l->first_tag_id + idx;
+            ptrdiff_t const idx = it - l->tables->tag_prefixes;
+            token.id = l->tables->first_tag_id + idx;
             return token;
         }
     }
 
     {
-        char const **it = l->operators;
-        for (; it && *it; it++) {
-            char const *op = *it;
-
-            while (*op && on(l, *op, 0)) {
-                accept(l, &token, 1);
-                op++;
-            }
-
-            if (*op) {
-                discard(l, &token);
-            } else {
+        // Longest match
+        OperatorNode const *nodes = l->tables->operator_nodes;
+        u32 node = 0;
+        u32 op = 0;
+        u32 op_len = 0;
+
+        for (u32 len = 1;; len++) {
+            u8 const c = chr(l, len - 1);
+            if (!c || c >= OPERATOR_ALPHABET_SIZE || !nodes[node].next[c]) {
                 break;
             }
+            node = nodes[node].next[c];
+            if (nodes[node].token) {
+                op = nodes[node].token;
+                op_len = len;
+            }
         }
 
-        if (it && *it) {
-            ptrdiff_t const idx = it - l->operators;
-            token.id = l->first_operator_id + idx;
+        if (op) {
+            accept(l, &token, op_len);
+            token.id = l->tables->first_operator_id + op - 1;
             return token;
         }
     }
@@ -373,12 +701,12 @@ static NklToken scan(LexerState *l) {
     }
 }
 
-bool nkl_lex(NklLexerData const *data, NklTokenArray *out_tokens) {
+bool nkl_lex(NklLexerData const *data, NklCompactTokenArray *out_tokens) {
     NK_LOG_TRC("%s", __func__);
 
     bool ret;
     NK_PROF_FUNC() {
-        NklTokenDynArray tokens = {.alloc = nk_arena_getAllocator(data->arena)};
+        NklCompactTokenDynArray tokens = {.alloc = nk_arena_getAllocator(data->arena)};
         nkda_reserve(&tokens, 1000);
 
         LexerState l = {
@@ -386,32 +714,38 @@ bool nkl_lex(NklLexerData const *data, NklTokenArray *out_tokens) {
             .arena = data->arena,
             .err_str = data->err_str,
 
-            .first_keyword_id = data->keywords_base + 1,
-            .first_operator_id = data->operators_base + 1,
-            .first_tag_id = data->tags_base + 1,
-
-            .keywords = data->tokens + l.first_keyword_id,
-            .operators = data->tokens + l.first_operator_id,
-            .tag_prefixes = data->tokens + l.first_tag_id,
+            .tables = data->tables ? data->tables
+                                   : nkl_lex_prepare(
+                                         data->arena,
+                                         data->tokens,
+                                         data->keywords_base,
+                                         data->operators_base,
+                                         data->tags_base),
 
             .pos = 0,
-            .lin = 1,
-            .col = 1,
         };
 
-        NklToken token;
+        NklCompactToken token;
         do {
             token = scan(&l);
+
+            // Lengths are packed, so a longer token would be cut
+            if (token.id != NklToken_Error && l.pos - token.pos > NKL_COMPACT_TOKEN_MAX_LEN) {
+                reportError(&l, "token is too long");
+                token.id = NklToken_Error;
+                token.len = 0;
+            }
+
             nkda_append(&tokens, token);
 
 #ifdef ENABLE_LOGGING
             NKSB_FIXED_BUFFER(sb, 256);
-            nks_escape(nksb_getStream(&sb), nkl_getTokenStr(&token, data->text));
-            NK_LOG_DBG("%u:%u: \"" NKS_FMT "\":%u", token.lin, token.col, NKS_ARG(sb), token.id);
+            nks_escape(nksb_getStream(&sb), nkl_getCompactTokenStr(&token, data->text));
+            NK_LOG_DBG("%u: \"" NKS_FMT "\":%u", token.pos, NKS_ARG(sb), (u32)token.id);
 #endif // ENABLE_LOGGING
         } while (token.id != NklToken_Error && token.id != NklToken_Eof);
 
-        *out_tokens = (NklTokenArray){NKS_INIT(tokens)};
+        *out_tokens = (NklCompactTokenArray){NKS_INIT(tokens)};
         ret = token.id == NklToken_Eof;
     }
 
@@ -13,6 +13,7 @@
 #include "ntk/dl.h"
 #include "ntk/dyn_array.h"
 #include "ntk/error.h"
+#include "ntk/file.h"
 #include "ntk/log.h"
 #include "ntk/path.h"
 #include "ntk/string.h"
@@ -51,6 +52,8 @@ NklState nkl_newState(void) {
         .nkb = nkir_createState(),
     };
     nkl->text_map = (NkAtomStringMap){.alloc = nk_arena_getAllocator(&nkl->arena)};
+    nkl->file_cache = (NkAtomFileCacheMap){.alloc = nk_arena_getAllocator(&nkl->arena)};
+    nkl->file_mappings = (NklFileMappingDynArray){.alloc = nk_arena_getAllocator(&nkl->arena)};
     return nkl;
 }
 
@@ -63,10 +66,42 @@ void nkl_freeState(NklState nkl) {
 
     nkir_freeState(nkl->nkb);
 
+    NK_ITERATE(NkFileMapping *, mapping, nkl->file_mappings) {
+        nk_file_unmap(mapping);
+    }
+
     NkArena arena = nkl->arena;
     nk_arena_free(&arena);
 }
 
+static_assert((int)NklJit_Eager == NkIrJit_Eager, "");
+static_assert((int)NklJit_Lazy == NkIrJit_Lazy, "");
+static_assert((int)NklJit_Tiered == NkIrJit_Tiered, "");
+
+void nkl_setJitMode(NklState nkl, NklJitMode mode) {
+    NK_LOG_TRC("%s", __func__);
+
+    nk_assert(nkl && "state is null");
+
+    nkir_setJitMode(nkl->nkb, (NkIrJitMode)mode);
+}
+
+void nkl_setCodegenThreadCount(NklState nkl, usize count) {
+    NK_LOG_TRC("%s", __func__);
+
+    nk_assert(nkl && "state is null");
+
+    nkir_setCodegenThreadCount(nkl->nkb, count);
+}
+
+void nkl_setObjectCache(NklState nkl, NkString dir, u64 max_size) {
+    NK_LOG_TRC("%s", __func__);
+
+    nk_assert(nkl && "state is null");
+
+    nkir_setObjectCache(nkl->nkb, dir, max_size);
+}
+
 static NkString targetTripleToString(NkArena *arena, NklTargetTriple triple) {
     NkStringBuilder sb = {.alloc = nk_arena_getAllocator(arena)};
     nksb_printf(&sb, "%s-%s-%s", nk_atom2cs(triple.arch), nk_atom2cs(triple.vendor), nk_atom2cs(triple.sys));
@@ -76,17 +111,30 @@ static NkString targetTripleToString(NkArena *arena, NklTargetTriple triple) {
     return (NkString){NKS_INIT(sb)};
 }
 
-NklCompiler nkl_newCompiler(NklState nkl, NklTargetTriple triple) {
+static_assert((int)NklOpt_O0 == NkIrOpt_O0, "");
+static_assert((int)NklOpt_O1 == NkIrOpt_O1, "");
+static_assert((int)NklOpt_O2 == NkIrOpt_O2, "");
+static_assert((int)NklOpt_O3 == NkIrOpt_O3, "");
+static_assert((int)NklOpt_Os == NkIrOpt_Os, "");
+static_assert((int)NklOpt_Oz == NkIrOpt_Oz, "");
+
+NklCompiler nkl_newCompiler(NklState nkl, NklTargetTriple triple, NklCompilerOpts opts) {
     NK_LOG_TRC("%s", __func__);
 
     NkErrorState err = {.alloc = nk_arena_getAllocator(&nkl->scratch)};
 
     NkIrTarget tgt = NULL;
-    NK_ARENA_SCOPE(&nkl->scratch) {
-        NkString const triple_str = targetTripleToString(&nkl->scratch, triple);
+    NK_SCRATCH_SCOPE(scratch, NULL) {
+        NkString const triple_str = targetTripleToString(scratch, triple);
 
         NK_ERROR_SCOPE(&err) {
-            tgt = nkir_createTarget(nkl->nkb, triple_str);
+            tgt = nkir_createTarget(
+                nkl->nkb,
+                triple_str,
+                (NkIrTargetOpts){
+                    .cpu = opts.cpu,
+                    .features = opts.features,
+                });
         }
     }
 
@@ -95,13 +143,18 @@ NklCompiler nkl_newCompiler(NklState nkl, NklTargetTriple triple) {
     NklCompiler com = nk_arena_allocT(&nkl->arena, NklCompiler_T);
     *com = (NklCompiler_T){
         .nkl = nkl,
-        .lib_aliases = {.alloc = nk_arena_getAllocator(&nkl->arena)},
         .target = tgt,
+        .opt =
+            {
+                .level = (NkIrOptLevel)opts.opt_level,
+                .passes = nks_copy(nk_arena_getAllocator(&nkl->arena), opts.passes),
+            },
+        .lib_aliases = {.alloc = nk_arena_getAllocator(&nkl->arena)},
     };
     return com;
 }
 
-NklCompiler nkl_newCompilerForHost(NklState nkl) {
+NklCompiler nkl_newCompilerForHost(NklState nkl, NklCompilerOpts opts) {
     NK_LOG_TRC("%s", __func__);
 
     return nkl_newCompiler(
@@ -111,7 +164,8 @@ NklCompiler nkl_newCompilerForHost(NklState nkl) {
             .vendor = nk_cs2atom(HOST_TARGET_VENDOR),
             .sys = nk_cs2atom(HOST_TARGET_SYS),
             .abi = strlen(HOST_TARGET_ABI) ? nk_cs2atom(HOST_TARGET_ABI) : 0,
-        });
+        },
+        opts);
 }
 
 static void *symbolResolver(NkAtom sym, void *userdata) {
@@ -202,6 +256,7 @@ static NklModule newModuleImpl(NklCompiler com, NkAtom name) {
     }
 
     nkir_setSymbolResolver(mod->ir, symbolResolver, mod);
+    nkir_moduleSetJitOptProfile(mod->ir, com->opt);
 
     return mod;
 }
@@ -450,7 +505,7 @@ bool nkl_exportModule(NklModule mod, NkString out_file, NklOutputKind kind) {
 
     NkErrorState err = {.alloc = nk_arena_getAllocator(&nkl->scratch)};
     NK_ERROR_SCOPE(&err) {
-        nkir_exportModule(mod->ir, mod->com->target, out_file, (NkIrOutputKind)kind);
+        nkir_exportModule(mod->ir, mod->com->target, out_file, (NkIrOutputKind)kind, mod->com->opt);
     }
     HANDLE_ERRORS();
 
@@ -64,7 +64,40 @@ void nickl_vreportError(NklState nkl, NklSourceLocation loc, char const *fmt, va
 }
 
 static void defineTextImpl(NklState nkl, NkAtom file, NkString text) {
-    NkAtomStringMap_insert(&nkl->text_map, file, text);
+    NkAtomStringMap_insert(&nkl->text_map, file, text)->val = text;
+
+    // Everything derived from the previous text is stale now
+    NklFileCache *cache = NkAtomFileCacheMap_find(&nkl->file_cache, file);
+    if (cache) {
+        *cache = (NklFileCache){0};
+    }
+}
+
+static NklFileCache *getFileCache(NklState nkl, NkAtom file) {
+    NklFileCache *cache = NkAtomFileCacheMap_find(&nkl->file_cache, file);
+    if (!cache) {
+        cache = &NkAtomFileCacheMap_insert(&nkl->file_cache, file, (NklFileCache){0})->val;
+    }
+    return cache;
+}
+
+NklSourceLocation nickl_getTokenLoc(NklState nkl, NkAtom file, NklCompactToken const *token) {
+    NklFileCache *cache = getFileCache(nkl, file);
+    if (!cache->lines.size) {
+        NkString const *text = NkAtomStringMap_find(&nkl->text_map, file);
+        nk_assert(text && "tokens without text");
+        cache->lines = nkl_diag_indexLines(nk_arena_getAllocator(&nkl->arena), *text);
+    }
+    return nkl_diag_locate(cache->lines, nk_atom2s(file), token->pos, token->len);
+}
+
+static void logCacheHit(char const *what, NkAtom file) {
+    NK_LOG_STREAM_DBG {
+        NkStream log = nk_log_getStream();
+        nk_printf(log, "Using cached %s for file \"", what);
+        nkir_printName(log, "file", file);
+        nk_printf(log, "\"");
+    }
 }
 
 void nickl_printModuleName(NkStream out, NkAtom mod) {
@@ -94,13 +127,14 @@ bool nickl_getText(NklState nkl, NkAtom file, NkString *out_text) {
     } else {
         NK_LOG_DBG("Loading text for file `%s`", nk_atom2cs(file));
 
-        NkAllocator const alloc = nk_arena_getAllocator(&nkl->arena);
-
-        if (!nk_file_read(alloc, nk_atom2s(file), &text)) {
+        NkFileMapping mapping;
+        if (!nk_file_map(nk_atom2s(file), &mapping)) {
             nickl_reportErrorLoc(nkl, (NklSourceLocation){0}, "%s: %s", nk_atom2cs(file), nk_getLastErrorString());
             return false;
         }
+        nkda_append(&nkl->file_mappings, mapping);
 
+        text = mapping.text;
         defineTextImpl(nkl, file, text);
     }
 
@@ -176,14 +210,24 @@ char const *s_ir_tokens[] = {
     NULL,
 };
 
-bool nickl_getTokensIr(NklState nkl, NkAtom file, NklTokenArray *out_tokens) {
+bool nickl_getTokensIr(NklState nkl, NkAtom file, NklCompactTokenArray *out_tokens) {
     NK_LOG_TRC("%s", __func__);
 
-    // TODO: Cache tokens
+    NklCompactTokenArray const cached = getFileCache(nkl, file)->ir_tokens;
+    if (cached.size) {
+        logCacheHit("IR tokens", file);
+        *out_tokens = cached;
+        return true;
+    }
 
     NkString text;
     TRY(nickl_getText(nkl, file, &text), false);
 
+    if (!nkl->ir_lexer_tables) {
+        nkl->ir_lexer_tables = nkl_lex_prepare(
+            &nkl->arena, s_ir_tokens, NklIrToken_KeywordsBase, NklIrToken_OperatorsBase, NklIrToken_TagsBase);
+    }
+
     NkString err_str = {0};
     if (!nkl_lex(
             &(NklLexerData){
@@ -195,23 +239,16 @@ bool nickl_getTokensIr(NklState nkl, NkAtom file, NklTokenArray *out_tokens) {
                 .keywords_base = NklIrToken_KeywordsBase,
                 .operators_base = NklIrToken_OperatorsBase,
                 .tags_base = NklIrToken_TagsBase,
+
+                .tables = nkl->ir_lexer_tables,
             },
             out_tokens)) {
         nk_assert(out_tokens->size);
-        NklToken const err_token = nks_last(*out_tokens);
-        nickl_reportErrorLoc(
-            nkl,
-            (NklSourceLocation){
-                .file = nk_atom2s(file),
-                .lin = err_token.lin,
-                .col = err_token.col,
-                .len = err_token.len,
-            },
-            NKS_FMT,
-            NKS_ARG(err_str));
+        nickl_reportErrorLoc(nkl, nickl_getTokenLoc(nkl, file, &nks_last(*out_tokens)), NKS_FMT, NKS_ARG(err_str));
         return false;
     }
 
+    getFileCache(nkl, file)->ir_tokens = *out_tokens;
     return true;
 }
 
@@ -240,14 +277,23 @@ char const *s_ast_tokens[] = {
     NULL,
 };
 
-bool nickl_getTokensAst(NklState nkl, NkAtom file, NklTokenArray *out_tokens) {
+bool nickl_getTokensAst(NklState nkl, NkAtom file, NklCompactTokenArray *out_tokens) {
     NK_LOG_TRC("%s", __func__);
 
-    // TODO: Cache tokens
+    NklCompactTokenArray const cached = getFileCache(nkl, file)->ast_tokens;
+    if (cached.size) {
+        logCacheHit("AST tokens", file);
+        *out_tokens = cached;
+        return true;
+    }
 
     NkString text;
     TRY(nickl_getText(nkl, file, &text), false);
 
+    if (!nkl->ast_lexer_tables) {
+        nkl->ast_lexer_tables = nkl_lex_prepare(&nkl->arena, s_ast_tokens, 0, NklAstToken_OperatorsBase, 0);
+    }
+
     NkString err_str = {0};
     if (!nkl_lex(
             &(NklLexerData){
@@ -257,30 +303,28 @@ bool nickl_getTokensAst(NklState nkl, NkAtom file, NklTokenArray *out_tokens) {
 
                 .tokens = s_ast_tokens,
                 .operators_base = NklAstToken_OperatorsBase,
+
+                .tables = nkl->ast_lexer_tables,
             },
             out_tokens)) {
         nk_assert(out_tokens->size);
-        NklToken const err_token = nks_last(*out_tokens);
-        nickl_reportErrorLoc(
-            nkl,
-            (NklSourceLocation){
-                .file = nk_atom2s(file),
-                .lin = err_token.lin,
-                .col = err_token.col,
-                .len = err_token.len,
-            },
-            NKS_FMT,
-            NKS_ARG(err_str));
+        nickl_reportErrorLoc(nkl, nickl_getTokenLoc(nkl, file, &nks_last(*out_tokens)), NKS_FMT, NKS_ARG(err_str));
         return false;
     }
 
+    getFileCache(nkl, file)->ast_tokens = *out_tokens;
     return true;
 }
 
 bool nickl_getAst(NklState nkl, NkAtom file, NklAstNodeArray *out_nodes) {
     NK_LOG_TRC("%s", __func__);
 
-    // TODO: Cache ast
+    NklFileCache const *cache = getFileCache(nkl, file);
+    if (cache->has_ast_nodes) {
+        logCacheHit("AST", file);
+        *out_nodes = cache->ast_nodes;
+        return true;
+    }
 
     TRY(nkl_ast_parse(
             &(NklAstParserData){
@@ -291,6 +335,11 @@ bool nickl_getAst(NklState nkl, NkAtom file, NklAstNodeArray *out_nodes) {
             out_nodes),
         false);
 
+    // Parsing might have grown the cache map, so the entry is looked up again
+    NklFileCache *updated = getFileCache(nkl, file);
+    updated->ast_nodes = *out_nodes;
+    updated->has_ast_nodes = true;
+
     return true;
 }
 
@@ -372,8 +421,7 @@ bool nickl_defineSymbol(NklModule mod, NkIrSymbol const *sym) {
     }
 
     NK_LOG_STREAM_INF {
-        NkArena *scratch = &mod->com->nkl->scratch;
-        NK_ARENA_SCOPE(scratch) {
+        NK_SCRATCH_SCOPE(scratch, NULL) {
             NkStream log = nk_log_getStream();
             nk_printf(log, "symbol:\n");
             nkir_inspectSymbol(log, scratch, sym);
@@ -432,10 +480,10 @@ bool nickl_linkSymbol(NklModule dst_mod, NklModule src_mod, NkIrSymbol const *sy
 
     {
         // TODO: Verify linker symbol compatibility
-        NkIrSymbol const *found = nkir_findSymbol(dst_mod->ir, sym->name);
-        if (found && found->kind != NkIrSymbol_Extern) {
-            NK_ARENA_SCOPE(&nkl->scratch) {
-                NkStringBuilder sb = {.alloc = nk_arena_getAllocator(&nkl->scratch)};
+        NkIrSymbol found;
+        if (nkir_findSymbol(dst_mod->ir, sym->name, &found) && found.kind != NkIrSymbol_Extern) {
+            NK_SCRATCH_SCOPE(scratch, NULL) {
+                NkStringBuilder sb = {.alloc = nk_arena_getAllocator(scratch)};
                 NkStream err = nksb_getStream(&sb);
                 nk_printf(err, "Failed to link ");
                 nickl_printSymbol(err, src_mod->name, sym->name);
@@ -6,22 +6,34 @@
 #include "nkl/common/ast.h"
 #include "nkl/common/diagnostics.h"
 #include "nkl/common/token.h"
+#include "nkl/core/lexer.h"
 #include "nkl/core/nickl.h"
 #include "ntk/atom.h"
 #include "ntk/dyn_array.h"
+#include "ntk/file.h"
 #include "ntk/string.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef NkDynArray(NkFileMapping) NklFileMappingDynArray;
+
 typedef struct NklState_T {
     NkArena arena;
+    // Holds error states across nested calls, so it cannot be one of the thread scratch arenas
     NkArena scratch;
 
     NkbState nkb;
 
     NkAtomStringMap text_map;
+    NkAtomFileCacheMap file_cache;
+    // Loaded files are mapped, they stay valid until the state is freed
+    NklFileMappingDynArray file_mappings;
+
+    // Built on first use
+    NklLexerTables ir_lexer_tables;
+    NklLexerTables ast_lexer_tables;
 
     NklError *error;
 } NklState_T;
@@ -29,6 +41,7 @@ typedef struct NklState_T {
 typedef struct NklCompiler_T {
     NklState nkl;
     NkIrTarget target;
+    NkIrOptProfile opt;
 
     NkAtomMap lib_aliases;
 } NklCompiler_T;
@@ -54,14 +67,16 @@ NK_PRINTF_LIKE(2) void nickl_reportError(NklState nkl, char const *fmt, ...);
 NK_PRINTF_LIKE(3) void nickl_reportErrorLoc(NklState nkl, NklSourceLocation loc, char const *fmt, ...);
 void nickl_vreportError(NklState nkl, NklSourceLocation loc, char const *fmt, va_list ap);
 
+NklSourceLocation nickl_getTokenLoc(NklState nkl, NkAtom file, NklCompactToken const *token);
+
 void nickl_printModuleName(NkStream out, NkAtom name);
 void nickl_printSymbol(NkStream out, NkAtom mod, NkAtom sym);
 
 bool nickl_getText(NklState nkl, NkAtom file, NkString *out_text);
 bool nickl_defineText(NklState nkl, NkAtom file, NkString text);
 
-bool nickl_getTokensIr(NklState nkl, NkAtom file, NklTokenArray *out_tokens);
-bool nickl_getTokensAst(NklState nkl, NkAtom file, NklTokenArray *out_tokens);
+bool nickl_getTokensIr(NklState nkl, NkAtom file, NklCompactTokenArray *out_tokens);
+bool nickl_getTokensAst(NklState nkl, NkAtom file, NklCompactTokenArray *out_tokens);
 
 bool nickl_getAst(NklState nkl, NkAtom file, NklAstNodeArray *out_nodes);
 
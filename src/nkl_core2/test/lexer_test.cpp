@@ -0,0 +1,337 @@
+#include "nkl/core/lexer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "ir_tokens.h"
+#include "nkl/common/diagnostics.h"
+#include "ntk/arena.h"
+#include "ntk/log.h"
+#include "ntk/time.h"
+
+namespace {
+
+// Same layout as the IR token table of the compiler
+char const *s_tokens[] = {
+    "end of file",
+    "identifier",
+    "integer constant",
+    "hex integer constant",
+    "float constant",
+    "string constant",
+    "string constant",
+    "newline",
+    "error",
+
+    nullptr, // NklIrToken_KeywordsBase
+
+    "cmp",
+    "const",
+    "data",
+    "extern",
+    "include",
+    "local",
+    "proc",
+    "pub",
+    "type",
+    "void",
+
+#define X(TYPE, VALUE_TYPE) #TYPE,
+    NKIR_NUMERIC_ITERATE(X)
+#undef X
+
+#define IR(NAME) #NAME,
+#define UNA_IR(NAME) #NAME,
+#define BIN_IR(NAME) #NAME,
+#define CMP_IR(NAME) #NAME,
+#include "nkb/ir.inl"
+
+        nullptr, // NklIrToken_OperatorsBase
+
+    "(",
+    ")",
+    ",",
+    "->",
+    "...",
+    ":",
+    "@+",
+    "@-",
+    "[",
+    "]",
+    "{",
+    "|",
+    "}",
+
+    nullptr, // NklIrToken_TagsBase
+
+    "$",
+    "%",
+    "@",
+
+    nullptr,
+};
+
+} // namespace
+
+class lexer : public testing::Test {
+    void SetUp() override {
+        NK_LOG_INIT({});
+    }
+
+    void TearDown() override {
+        nk_arena_free(&m_arena);
+    }
+
+protected:
+    static NklLexerData makeData(NkString text, NkArena *arena, NklLexerTables tables, NkString *err_str = nullptr) {
+        return {
+            .text = text,
+            .arena = arena,
+            .err_str = err_str,
+            .tokens = s_tokens,
+            .keywords_base = NklIrToken_KeywordsBase,
+            .operators_base = NklIrToken_OperatorsBase,
+            .tags_base = NklIrToken_TagsBase,
+            .tables = tables,
+        };
+    }
+
+    std::vector<u32> lex(char const *text, NklLexerTables tables = nullptr) {
+        NklLexerData const data = makeData(nk_cs2s(text), &m_arena, tables);
+        NklCompactTokenArray tokens{};
+        EXPECT_TRUE(nkl_lex(&data, &tokens));
+
+        std::vector<u32> ids;
+        for (usize i = 0; i < tokens.size; i++) {
+            ids.emplace_back(tokens.data[i].id);
+        }
+        return ids;
+    }
+
+    NklLexerTables prepare() {
+        return nkl_lex_prepare(
+            &m_arena, s_tokens, NklIrToken_KeywordsBase, NklIrToken_OperatorsBase, NklIrToken_TagsBase);
+    }
+
+    NkArena m_arena{};
+};
+
+TEST_F(lexer, keywords) {
+    for (u32 id = NklIrToken_KeywordsBase + 1; id < NklIrToken_OperatorsBase; id++) {
+        EXPECT_EQ(lex(s_tokens[id]), (std::vector<u32>{id, NklToken_Eof})) << s_tokens[id];
+    }
+
+    EXPECT_EQ(lex("pro"), (std::vector<u32>{NklToken_Id, NklToken_Eof}));
+    EXPECT_EQ(lex("procs"), (std::vector<u32>{NklToken_Id, NklToken_Eof}));
+    EXPECT_EQ(lex("Proc"), (std::vector<u32>{NklToken_Id, NklToken_Eof}));
+    EXPECT_EQ(lex("_proc"), (std::vector<u32>{NklToken_Id, NklToken_Eof}));
+    EXPECT_EQ(lex("a_very_long_identifier"), (std::vector<u32>{NklToken_Id, NklToken_Eof}));
+}
+
+TEST_F(lexer, operators) {
+    EXPECT_EQ(
+        lex("(,)->...:[|]{}"),
+        (std::vector<u32>{
+            NklIrToken_LParen,
+            NklIrToken_Comma,
+            NklIrToken_RParen,
+            NklIrToken_MinusGreater,
+            NklIrToken_Ellipsis,
+            NklIrToken_Colon,
+            NklIrToken_LBracket,
+            NklIrToken_Pipe,
+            NklIrToken_RBracket,
+            NklIrToken_LBrace,
+            NklIrToken_RBrace,
+            NklToken_Eof,
+        }));
+
+    EXPECT_EQ(
+        lex("@+ @- @x"), (std::vector<u32>{NklIrToken_AtPlus, NklIrToken_AtMinus, NklIrToken_AtTag, NklToken_Eof}));
+    EXPECT_EQ(lex("-> -1"), (std::vector<u32>{NklIrToken_MinusGreater, NklToken_Int, NklToken_Eof}));
+}
+
+TEST_F(lexer, unknown_operator) {
+    NkString err_str{};
+    NklLexerData const data = makeData(nk_cs2s(".."), &m_arena, nullptr, &err_str);
+    NklCompactTokenArray tokens{};
+    EXPECT_FALSE(nkl_lex(&data, &tokens));
+    EXPECT_EQ(std::string(err_str.data, err_str.size), "unexpected character `.`");
+}
+
+TEST_F(lexer, positions) {
+    // Runs are longer than a vector to exercise the fast paths, the line comment at the end has no newline
+    char const *text = "/* a block comment\n"
+                       "   that spans lines */ proc a_rather_long_identifier_name   1234567890123456789\n"
+                       "\n"
+                       "    \"a string that is longer than sixteen bytes\\n\" // trailing comment\n"
+                       "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t$tag_with_a_long_name_too // at the end";
+
+    NklLexerData const data = makeData(nk_cs2s(text), &m_arena, nullptr);
+    NklCompactTokenArray tokens{};
+    ASSERT_TRUE(nkl_lex(&data, &tokens));
+
+    NklLineIndex const lines = nkl_diag_indexLines(nk_arena_getAllocator(&m_arena), nk_cs2s(text));
+
+    struct Expected {
+        u32 id;
+        u32 lin;
+        u32 col;
+        u32 len;
+    };
+    Expected const expected[] = {
+        {NklIrToken_proc, 2, 24, 4},
+        {NklToken_Id, 2, 29, 29},
+        {NklToken_Int, 2, 61, 19},
+        {NklToken_Newline, 2, 80, 2},
+        {NklToken_EscapedString, 4, 5, 46},
+        {NklToken_Newline, 4, 71, 1},
+        {NklIrToken_DollarTag, 5, 19, 25},
+        {NklToken_Eof, 5, 58, 0},
+    };
+
+    ASSERT_EQ(tokens.size, std::size(expected));
+    for (usize i = 0; i < tokens.size; i++) {
+        NklSourceLocation const loc = nkl_diag_locate(lines, {}, tokens.data[i].pos, tokens.data[i].len);
+        EXPECT_EQ(tokens.data[i].id, expected[i].id) << "token " << i;
+        EXPECT_EQ(loc.lin, expected[i].lin) << "token " << i;
+        EXPECT_EQ(loc.col, expected[i].col) << "token " << i;
+        EXPECT_EQ(loc.len, expected[i].len) << "token " << i;
+    }
+}
+
+TEST_F(lexer, line_index) {
+    static_assert(sizeof(NklCompactToken) == 8);
+
+    auto const locate = [&](char const *text, u32 pos) {
+        NklLineIndex const lines = nkl_diag_indexLines(nk_arena_getAllocator(&m_arena), nk_cs2s(text));
+        NklSourceLocation const loc = nkl_diag_locate(lines, {}, pos, 0);
+        return std::vector<u32>{loc.lin, loc.col};
+    };
+
+    EXPECT_EQ(locate("", 0), (std::vector<u32>{1, 1}));
+    EXPECT_EQ(locate("abc", 2), (std::vector<u32>{1, 3}));
+    EXPECT_EQ(locate("abc\n", 3), (std::vector<u32>{1, 4}));
+    EXPECT_EQ(locate("abc\n", 4), (std::vector<u32>{2, 1}));
+    EXPECT_EQ(locate("a\n\n\nbc", 5), (std::vector<u32>{4, 2}));
+}
+
+TEST_F(lexer, duplicate_keywords) {
+    char const *tokens[] = {
+        "end of file",
+        "identifier",
+        "integer constant",
+        "hex integer constant",
+        "float constant",
+        "string constant",
+        "string constant",
+        "newline",
+        "error",
+        nullptr,
+        "foo",
+        "bar",
+        "foo",
+        nullptr,
+        nullptr,
+        nullptr,
+    };
+
+    NklLexerData const data{
+        .text = nk_cs2s("bar foo"),
+        .arena = &m_arena,
+        .err_str = nullptr,
+        .tokens = tokens,
+        .keywords_base = NklToken_Count,
+        .operators_base = NklToken_Count + 4,
+        .tags_base = NklToken_Count + 5,
+        .tables = nullptr,
+    };
+    NklCompactTokenArray out{};
+    ASSERT_TRUE(nkl_lex(&data, &out));
+
+    ASSERT_EQ(out.size, 3u);
+    EXPECT_EQ(out.data[0].id, NklToken_Count + 2);
+    EXPECT_EQ(out.data[1].id, NklToken_Count + 1);
+}
+
+TEST_F(lexer, prepared_tables) {
+    char const *text = R"(
+pub proc plus(:i64 %a, :i64 %b) :i64 {
+    add %a, %b -> %ret
+    cmp lt %a, %b -> %less
+    jmpz %less, @end
+    call printf, ("%d\n", ..., :i64 %ret) -> :i32
+@end
+    ret %ret
+}
+)";
+
+    EXPECT_EQ(lex(text, prepare()), lex(text));
+}
+
+TEST_F(lexer, DISABLED_throughput_bench) {
+    static constexpr usize c_target_size = 8 << 20;
+    static constexpr int c_iter_count = 5;
+
+    NklLexerTables const tables = prepare();
+
+    auto const measure = [&](char const *name, std::string const &text) {
+        i64 best_ns = INT64_MAX;
+        usize token_count = 0;
+        for (int i = 0; i < c_iter_count; i++) {
+            NkArena arena{};
+
+            NklLexerData const data = makeData({text.data(), text.size()}, &arena, tables);
+            NklCompactTokenArray tokens{};
+
+            i64 const start_ns = nk_now_ns();
+            bool const ok = nkl_lex(&data, &tokens);
+            best_ns = std::min(best_ns, nk_now_ns() - start_ns);
+
+            ASSERT_TRUE(ok);
+            token_count = tokens.size;
+
+            nk_arena_free(&arena);
+        }
+
+        std::printf(
+            "lexer bench (%s): %.1f MB, %zu tokens: %.1f MB/s\n",
+            name,
+            text.size() / 1e6,
+            token_count,
+            text.size() / 1e6 / (best_ns * 1e-9));
+    };
+
+    {
+        std::string text;
+        for (usize i = 0; text.size() < c_target_size; i++) {
+            auto const n = std::to_string(i);
+            text += "pub proc proc_" + n + "(:i64 %a, :i64 %b) :i64 {\n";
+            text += "    add %a, " + n + " -> %sum\n";
+            text += "    mul :i64 %sum, %b -> %prod\n";
+            text += "    cmp lt %prod, 0x" + n + " -> %neg\n";
+            text += "    jmpnz %neg, @end\n";
+            text += "    call callee_" + n + ", (%prod, ..., :f64 1.5) -> :i64 %res\n";
+            text += "@end\n";
+            text += "    ret %res // " + n + "\n";
+            text += "}\n\n";
+        }
+        measure("dense", text);
+    }
+
+    {
+        std::string text;
+        for (usize i = 0; text.size() < c_target_size; i++) {
+            auto const n = std::to_string(i);
+            text += "/* A block comment describing the next declaration in some detail,\n";
+            text += "   spanning a couple of lines like generated documentation does */\n";
+            text += "        extern \"a_library_with_a_descriptive_name\" proc a_long_generated_name_" + n + "()\n";
+        }
+        measure("long runs", text);
+    }
+}
@@ -1,10 +1,17 @@
+#include <cinttypes>
+#include <cstdio>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "nkl/core/nickl.h"
+#include "ntk/file.h"
 #include "ntk/log.h"
+#include "ntk/path.h"
 #include "ntk/string.h"
+#include "ntk/time.h"
 #include "ntk/utils.h"
 
 class nkl_run_ir : public testing::Test {
@@ -17,7 +24,7 @@ protected:
 
         nkl = nkl_newState();
 
-        com = nkl_newCompilerForHost(nkl);
+        com = nkl_newCompilerForHost(nkl, {});
 
         nkl_addLibraryAlias(com, nk_cs2s("c"), nk_cs2s(SYSTEM_LIBC));
         nkl_addLibraryAlias(com, nk_cs2s("m"), nk_cs2s(SYSTEM_LIBM));
@@ -25,9 +32,50 @@ protected:
     }
 
     void TearDown() override {
-        defer {
-            nkl_freeState(nkl);
-        };
+        nkl_freeState(nkl);
+
+        // Removed after the state is freed, since it keeps the source files mapped
+        for (auto const &path : m_tmp_files) {
+            nk_remove(path.c_str());
+        }
+    }
+
+    // Writes a header with proc_count procs and a main file that includes it, returns the path of the main file
+    std::string writeMultiIncludeFiles(int proc_count) {
+        char tmp_path[NK_MAX_PATH];
+        EXPECT_GE(nk_getTempPath(tmp_path, sizeof(tmp_path)), 0);
+
+        // Stamped, so that concurrent runs do not share the files
+        char stamp[32];
+        std::snprintf(stamp, sizeof(stamp), "%" PRIx64, (u64)nk_now_ns());
+
+        std::string const header_name = std::string{"nkl_multi_include_header."} + stamp + ".nkir";
+        std::string const header_path = tmp_path + header_name;
+        std::string const main_path = std::string{tmp_path} + "nkl_multi_include_main." + stamp + ".nkir";
+
+        std::string header;
+        for (int i = 0; i < proc_count; i++) {
+            header += "pub proc add" + std::to_string(i) + "(:i64 %a) :i64 {\n";
+            header += "    add %a, " + std::to_string(i) + " -> %ret\n";
+            header += "    ret %ret\n";
+            header += "}\n\n";
+        }
+
+        std::string const main = "include \"" + header_name + R"("
+
+pub proc answer() :i64 {
+    call add7, (35) -> :i64 %ret
+    ret %ret
+}
+)";
+
+        EXPECT_TRUE(nk_file_write({header_path.c_str(), header_path.size()}, {header.c_str(), header.size()}));
+        EXPECT_TRUE(nk_file_write({main_path.c_str(), main_path.size()}, {main.c_str(), main.size()}));
+
+        m_tmp_files.emplace_back(header_path);
+        m_tmp_files.emplace_back(main_path);
+
+        return main_path;
     }
 
     std::string printErrors() {
@@ -45,6 +93,7 @@ protected:
 
     NklState nkl;
     NklCompiler com;
+    std::vector<std::string> m_tmp_files;
 };
 
 #define COMPILE(...)                                             \
@@ -280,6 +329,56 @@ pub proc bar() :i32 {
     EXPECT_EQ(foo(), 12);
 }
 
+TEST_F(nkl_run_ir, multi_include) {
+    auto const main_path = writeMultiIncludeFiles(10);
+
+    for (int i = 0; i < 3; i++) {
+        auto mod = nkl_newModule(com);
+
+        bool const ok = nkl_compileFileIr(mod, {main_path.c_str(), main_path.size()});
+        ASSERT_TRUE(ok && !nkl_getErrors(nkl)) << printErrors();
+
+        auto answer = (i64 (*)())nkl_getSymbolAddress(mod, nk_cs2s("answer"));
+        ASSERT_TRUE(answer);
+        EXPECT_EQ(answer(), 42);
+    }
+}
+
+TEST_F(nkl_run_ir, DISABLED_multi_include_bench) {
+    static constexpr int c_header_proc_count = 500;
+    static constexpr int c_module_count = 50;
+
+    auto const main_path = writeMultiIncludeFiles(c_header_proc_count);
+
+    // The first module lexes the files, the rest reuse the cached tokens
+    i64 first_ns = 0;
+    i64 rest_ns = 0;
+
+    for (int i = 0; i < c_module_count; i++) {
+        auto mod = nkl_newModule(com);
+
+        i64 const start_ns = nk_now_ns();
+        bool const ok = nkl_compileFileIr(mod, {main_path.c_str(), main_path.size()});
+        i64 const elapsed_ns = nk_now_ns() - start_ns;
+        ASSERT_TRUE(ok && !nkl_getErrors(nkl)) << printErrors();
+
+        (i ? rest_ns : first_ns) += elapsed_ns;
+
+        if (i == c_module_count - 1) {
+            auto answer = (i64 (*)())nkl_getSymbolAddress(mod, nk_cs2s("answer"));
+            ASSERT_TRUE(answer);
+            EXPECT_EQ(answer(), 42);
+        }
+    }
+
+    std::printf(
+        "include bench: %d procs, %d modules: first %.2f ms, cached %.2f ms/module\n",
+        c_header_proc_count,
+        c_module_count,
+        first_ns * 1e-6,
+        rest_ns * 1e-6 / (c_module_count - 1));
+}
+
 // TEST_F(nkl_run_ir, link_cycle) {
 //     auto mod0 = nkl_newModuleNamed(com, nk_cs2s("mod0"));
 //     auto mod1 = nkl_newModuleNamed(com, nk_cs2s("mod1"));
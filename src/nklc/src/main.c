@@ -1,3 +1,6 @@
+#include <errno.h>
+#include <stdlib.h>
+
 #include "nkl/common/diagnostics.h"
 #include "nkl/core/nickl.h"
 #include "ntk/allocator.h"
@@ -11,6 +14,8 @@
 #include "ntk/stream.h"
 #include "ntk/string.h"
 #include "ntk/string_builder.h"
+#include "ntk/thread.h"
+#include "ntk/utils.h"
 
 static void printErrorUsage() {
     nk_printf(nk_file_getStream(nk_stderr()), "See `%s --help` for usage information\n", NK_BINARY_NAME);
@@ -23,6 +28,14 @@ static void printUsage() {
         "\nOptions:"
         "\n    -o, --output <file>                              Output file path"
         "\n    -k, --kind {run,exe,static,shared,archive,obj}   Output file kind"
+        "\n    -j, --jit {eager,lazy,tiered}                    JIT mode for `run`"
+        "\n    -O, --opt {0,1,2,3,s,z}                          Optimization level, 3 by default"
+        "\n        --passes <pipeline>                          Custom LLVM pass pipeline, overrides `--opt`"
+        "\n        --cpu <name>                                 Target CPU, `native` to tune for the host"
+        "\n        --features <list>                            Target features, e.g. `+avx2,-fma`"
+        "\n        --codegen-threads <count>                    Threads generating code, 0 to use all cores"
+        "\n        --cache-dir <dir>                            Directory to reuse compiled code from across runs"
+        "\n        --cache-size <MiB>                           Cache size limit, 512 by default, 0 for no limit"
         "\n    -c, --color {auto,always,never}                  Choose when to color output"
         "\n    -h, --help                                       Display this message and exit"
         "\n    -v, --version                                    Show version information"
@@ -38,6 +51,28 @@ static void printUsage() {
         "\n");
 }
 
+// Accepts only plain decimal digits, strtoull would take signs and leading spaces
+static bool parseCount(NkString val, u64 max, u64 *out) {
+    if (!val.size) {
+        return false;
+    }
+    for (usize i = 0; i < val.size; i++) {
+        if (val.data[i] < '0' || val.data[i] > '9') {
+            return false;
+        }
+    }
+
+    errno = 0;
+    char *end = NULL;
+    unsigned long long const count = strtoull(val.data, &end, 10);
+    if (errno == ERANGE || end != val.data + val.size || count > max) {
+        return false;
+    }
+
+    *out = count;
+    return true;
+}
+
 static void printVersion() {
     printf(NK_BINARY_NAME " " NK_BUILD_VERSION " " NK_BUILD_TIME "\n");
 }
@@ -80,13 +115,22 @@ typedef struct {
     NkString in_file;
     NkString out_file;
     NklOutputKind out_kind;
+    NklJitMode jit_mode;
+    NklCompilerOpts com_opts;
+    usize codegen_threads;
+    NkString cache_dir;
+    u64 cache_size;
     bool run;
 } RunInfo;
 
 static int run(RunInfo const info) {
     NklState const nkl = info.nkl;
 
-    NklCompiler const com = nkl_newCompilerForHost(nkl);
+    nkl_setJitMode(nkl, info.jit_mode);
+    nkl_setCodegenThreadCount(nkl, info.codegen_threads);
+    nkl_setObjectCache(nkl, info.cache_dir, info.cache_size);
+
+    NklCompiler const com = nkl_newCompilerForHost(nkl, info.com_opts);
 
     // TODO: Hardcoded lib names
     nkl_addLibraryAlias(com, nk_cs2s("c"), nk_cs2s(SYSTEM_LIBC));
@@ -121,6 +165,9 @@ static int parseArgsAndRun(char **argv) {
     RunInfo run_info = {
         .out_file = nk_cs2s("a.out"),
         .out_kind = NklOutput_Binary,
+        .com_opts = {.opt_level = NklOpt_O3},
+        .codegen_threads = 1,
+        .cache_size = 512ull << 20,
     };
 
     bool help = false;
@@ -191,6 +238,73 @@ static int parseArgsAndRun(char **argv) {
                     printErrorUsage();
                     return 1;
                 }
+            } else if (nks_equal(key, nk_cs2s("-j")) || nks_equal(key, nk_cs2s("--jit"))) {
+                GET_VALUE;
+                if (nks_equal(val, nk_cs2s("eager"))) {
+                    run_info.jit_mode = NklJit_Eager;
+                } else if (nks_equal(val, nk_cs2s("lazy"))) {
+                    run_info.jit_mode = NklJit_Lazy;
+                } else if (nks_equal(val, nk_cs2s("tiered"))) {
+                    run_info.jit_mode = NklJit_Tiered;
+                } else {
+                    nkl_diag_printError(
+                        "invalid JIT mode `" NKS_FMT "`. Possible values are `eager`, `lazy`, `tiered`", NKS_ARG(val));
+                    printErrorUsage();
+                    return 1;
+                }
+            } else if (nks_equal(key, nk_cs2s("-O")) || nks_equal(key, nk_cs2s("--opt"))) {
+                GET_VALUE;
+                if (nks_equal(val, nk_cs2s("0"))) {
+                    run_info.com_opts.opt_level = NklOpt_O0;
+                } else if (nks_equal(val, nk_cs2s("1"))) {
+                    run_info.com_opts.opt_level = NklOpt_O1;
+                } else if (nks_equal(val, nk_cs2s("2"))) {
+                    run_info.com_opts.opt_level = NklOpt_O2;
+                } else if (nks_equal(val, nk_cs2s("3"))) {
+                    run_info.com_opts.opt_level = NklOpt_O3;
+                } else if (nks_equal(val, nk_cs2s("s"))) {
+                    run_info.com_opts.opt_level = NklOpt_Os;
+                } else if (nks_equal(val, nk_cs2s("z"))) {
+                    run_info.com_opts.opt_level = NklOpt_Oz;
+                } else {
+                    nkl_diag_printError(
+                        "invalid optimization level `" NKS_FMT
+                        "`. Possible values are `0`, `1`, `2`, `3`, `s`, `z`",
+                        NKS_ARG(val));
+                    printErrorUsage();
+                    return 1;
+                }
+            } else if (nks_equal(key, nk_cs2s("--passes"))) {
+                GET_VALUE;
+                run_info.com_opts.passes = val;
+            } else if (nks_equal(key, nk_cs2s("--cpu"))) {
+                GET_VALUE;
+                run_info.com_opts.cpu = val;
+            } else if (nks_equal(key, nk_cs2s("--features"))) {
+                GET_VALUE;
+                run_info.com_opts.features = val;
+            } else if (nks_equal(key, nk_cs2s("--codegen-threads"))) {
+                GET_VALUE;
+                u64 count = 0;
+                if (!parseCount(val, UINT64_MAX, &count)) {
+                    nkl_diag_printError("invalid thread count `" NKS_FMT "`", NKS_ARG(val));
+                    printErrorUsage();
+                    return 1;
+                }
+                // More threads than cores only add contention
+                run_info.codegen_threads = nk_minu(count, nk_thread_hardwareConcurrency());
+            } else if (nks_equal(key, nk_cs2s("--cache-dir"))) {
+                GET_VALUE;
+                run_info.cache_dir = val;
+            } else if (nks_equal(key, nk_cs2s("--cache-size"))) {
+                GET_VALUE;
+                u64 size_mib = 0;
+                if (!parseCount(val, UINT64_MAX >> 20, &size_mib)) {
+                    nkl_diag_printError("invalid cache size `" NKS_FMT "`", NKS_ARG(val));
+                    printErrorUsage();
+                    return 1;
+                }
+                run_info.cache_size = size_mib << 20;
             } else if (nks_equal(key, nk_cs2s("-c")) || nks_equal(key, nk_cs2s("--color"))) {
                 GET_VALUE;
                 if (nks_equal(val, nk_cs2s("auto"))) {
@@ -8,10 +8,19 @@
 extern "C" {
 #endif
 
+// Arena reserves address space in blocks and commits pages on demand.
+// A new block is chained once the current one is full, and released when popped.
+// size is the total size of allocations, data, capacity and reserved describe the current block.
+// Allocations return null when the memory cannot be reserved or committed.
+// Arena can also be put over an existing buffer by setting data, capacity = reserved = buffer size and fixed.
 typedef struct {
     u8 *data;
     usize size;
     usize capacity;
+    usize reserved;
+    usize peak;
+    usize _base;
+    bool fixed;
 } NkArena;
 
 NK_EXPORT NkAllocator nk_arena_getAllocator(NkArena *arena);
@@ -42,6 +51,43 @@ NK_INLINE void nk_arena_popFrame(NkArena *arena, NkArenaFrame frame) {
     nk_arena_pop(arena, arena->size - frame.size);
 }
 
+typedef struct {
+    usize size;
+    usize peak;
+    usize committed;
+    usize reserved;
+} NkArenaStats;
+
+// Sums memory over all blocks of the arena
+NK_EXPORT NkArenaStats nk_arena_getStats(NkArena const *arena);
+
+// Useful to measure the peak of a single phase
+NK_INLINE void nk_arena_resetPeak(NkArena *arena) {
+    arena->peak = arena->size;
+}
+
+// Scratch arenas are per-thread arenas for temporary allocations, reused across calls.
+// Arenas that are still being allocated from by the caller, e.g. the output arena of the current function,
+// have to be passed as conflicts, so that a different scratch arena is handed out.
+
+typedef struct {
+    NkArena *arena;
+    NkArenaFrame frame;
+} NkScratch;
+
+NK_EXPORT NkScratch nk_scratch_beginEx(NkArena *const *conflicts, usize conflict_count);
+
+NK_INLINE NkScratch nk_scratch_begin(NkArena *conflict) {
+    return nk_scratch_beginEx(&conflict, conflict ? 1 : 0);
+}
+
+NK_INLINE void nk_scratch_end(NkScratch scratch) {
+    nk_arena_popFrame(scratch.arena, scratch.frame);
+}
+
+// Releases scratch arenas of the calling thread, which otherwise happens when the thread exits
+NK_EXPORT void nk_scratch_free(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -64,4 +110,9 @@ T *nk_arena_allocT(NkArena *arena, usize n = 1) {
     NkArenaFrame NK_CAT(_frame_, __LINE__); \
     NK_DEFER_LOOP(NK_CAT(_frame_, __LINE__) = nk_arena_grab(arena), nk_arena_popFrame(arena, NK_CAT(_frame_, __LINE__)))
 
+#define NK_SCRATCH_SCOPE(NAME, CONFLICT)                                       \
+    NkScratch NK_CAT(_scratch_, __LINE__) = nk_scratch_begin(CONFLICT);        \
+    for (NkArena *NAME = NK_CAT(_scratch_, __LINE__).arena, *_i_ = NULL; !_i_; \
+         _i_ = NAME, nk_scratch_end(NK_CAT(_scratch_, __LINE__)))
+
 #endif // NTK_ARENA_H_
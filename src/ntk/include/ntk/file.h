@@ -2,6 +2,8 @@
 #define NTK_FILE_H_
 
 #include "ntk/allocator.h"
+#include "ntk/arena.h"
+#include "ntk/slice.h"
 #include "ntk/stream.h"
 #include "ntk/string.h"
 
@@ -10,6 +12,17 @@ extern "C" {
 #endif
 
 NK_EXPORT bool nk_file_read(NkAllocator alloc, NkString filepath, NkString *out);
+NK_EXPORT bool nk_file_write(NkString filepath, NkString data);
+
+typedef struct {
+    NkString text;
+    usize _capacity;
+    bool _mapped;
+} NkFileMapping;
+
+// Maps the file read-only without copying, falls back to reading it if mapping is not possible
+NK_EXPORT bool nk_file_map(NkString filepath, NkFileMapping *out);
+NK_EXPORT void nk_file_unmap(NkFileMapping *mapping);
 
 NK_EXPORT NkStream nk_file_getStream(NkHandle file);
 
@@ -38,6 +51,29 @@ NK_EXPORT NkHandle nk_open(char const *path, i32 flags);
 
 NK_EXPORT i32 nk_close(NkHandle file);
 
+// Maps the whole file read-only, fails for empty and special files
+NK_EXPORT i32 nk_mapFile(NkHandle file, NkString *out);
+NK_EXPORT i32 nk_unmapFile(NkString view);
+
+// Succeeds if the directory already exists
+NK_EXPORT i32 nk_mkdir(char const *path);
+NK_EXPORT i32 nk_remove(char const *path);
+// Replaces the destination if it exists
+NK_EXPORT i32 nk_rename(char const *old_path, char const *new_path);
+// Sets the modification time of the file to the current time
+NK_EXPORT i32 nk_touch(char const *path);
+
+typedef struct {
+    NkString name;
+    u64 size;
+    u64 mtime; // Only meaningful for comparison with each other
+} NkFileInfo;
+
+typedef NkSlice(NkFileInfo) NkFileInfoArray;
+
+// Lists regular files in the directory, without recursion
+NK_EXPORT i32 nk_listDir(NkArena *arena, char const *path, NkFileInfoArray *out);
+
 NK_EXPORT NkHandle nk_stdin(void);
 NK_EXPORT NkHandle nk_stdout(void);
 NK_EXPORT NkHandle nk_stderr(void);
@@ -1,22 +1,58 @@
 #ifndef NTK_HASH_TREE_H_
 #define NTK_HASH_TREE_H_
 
+#include <string.h>
+
 #include "ntk/allocator.h"
 #include "ntk/common.h"
 #include "ntk/utils.h"
 
-#define NK_HASH_TREE_TYPEDEF(TTree, TItem)          \
-    typedef struct _##TTree##_Node _##TTree##_Node; \
-    struct _##TTree##_Node {                        \
-        TItem item;                                 \
-        u64 hash;                                   \
-        _##TTree##_Node *child[2];                  \
-    };                                              \
-    typedef struct {                                \
-        _##TTree##_Node *root;                      \
-        NkAllocator alloc;                          \
+#ifndef NK_HASH_TREE_INITIAL_CAPACITY
+#define NK_HASH_TREE_INITIAL_CAPACITY 16
+#endif // NK_HASH_TREE_INITIAL_CAPACITY
+
+// Max load factor is 3/4, higher loads make Robin Hood inserts shift long runs of items
+#define NK_HASH_TREE_MAX_LOAD_NUM 3
+#define NK_HASH_TREE_MAX_LOAD_DEN 4
+
+NK_INLINE u64 _nk_hashTreeFixHash(u64 hash) {
+    return hash ? hash : 1;
+}
+
+// Fibonacci hashing spreads weak hashes over the table, capacity must be a power of 2
+NK_INLINE usize _nk_hashTreeHomeSlot(u64 hash, usize capacity) {
+    return capacity > 1 ? (usize)((hash * 0x9e3779b97f4a7c15ull) >> (64 - __builtin_ctzll(capacity))) : 0;
+}
+
+NK_INLINE usize _nk_hashTreeNextSlot(u64 const *hashes, usize capacity, usize idx) {
+    while (idx < capacity && !hashes[idx]) {
+        idx++;
+    }
+    return idx;
+}
+
+// Iterates over the items in an unspecified order
+#define NK_HASH_TREE_ITERATE(TYPE, IT, HT)                                           \
+    for (TYPE IT = (HT).items + _nk_hashTreeNextSlot((HT).hashes, (HT).capacity, 0); \
+         IT < (HT).items + (HT).capacity;                                            \
+         IT = (HT).items + _nk_hashTreeNextSlot((HT).hashes, (HT).capacity, IT - (HT).items + 1))
+
+// Hash trees are open-addressing hash tables with Robin Hood linear probing.
+// Hashes and items are stored in separate arrays, so that probing only touches the hashes.
+// Zero hash marks an empty slot. Items are moved on growth, pointers returned from
+// insert and find are invalidated by subsequent inserts.
+
+#define NK_HASH_TREE_TYPEDEF(TTree, TItem) \
+    typedef struct {                       \
+        TItem *items;                      \
+        NkAllocator alloc;                 \
+        u64 *hashes;                       \
+        usize size;                        \
+        usize capacity;                    \
     } TTree
 
+#define NK_HASH_TREE_INIT(_alloc) .items = NULL, .alloc = (_alloc), .hashes = NULL, .size = 0, .capacity = 0
+
 #define NK_HASH_TREE_TYPEDEF_K(TTree, TItem) NK_HASH_TREE_TYPEDEF(TTree, TItem)
 
 #define NK_HASH_TREE_TYPEDEF_KV(TTree, TKey, TVal) \
@@ -49,71 +85,114 @@
 #define NK_HASH_TREE_PROTO_K_EXPORT(TTree, TKey) _NK_HASH_TREE_PROTO_K(NK_EXPORT, TTree, TKey)
 #define NK_HASH_TREE_PROTO_KV_EXPORT(TTree, TKey, TVal) _NK_HASH_TREE_PROTO_KV(NK_EXPORT, TTree, TKey, TVal)
 
-#define NK_HASH_TREE_IMPL(TTree, TItem, TKey, GetKeyFunc, KeyHashFunc, KeyEqualFunc)                        \
-    typedef struct {                                                                                        \
-        _##TTree##_Node **node;                                                                             \
-        bool existing;                                                                                      \
-    } _##TTree##_SearchResult;                                                                              \
-                                                                                                            \
-    static _##TTree##_SearchResult _##TTree##_findNode(_##TTree##_Node **node, TKey const *key, u64 hash) { \
-        while (*node) {                                                                                     \
-            switch ((hash > (*node)->hash) - (hash < (*node)->hash)) {                                      \
-                case 0: {                                                                                   \
-                    TKey const *existing_key = GetKeyFunc(&(*node)->item);                                  \
-                    if (KeyEqualFunc(*key, *existing_key)) {                                                \
-                        return NK_LITERAL(_##TTree##_SearchResult){node, true};                             \
-                    }                                                                                       \
-                    NK_FALLTHROUGH;                                                                         \
-                }                                                                                           \
-                case -1:                                                                                    \
-                    node = (*node)->child + 0;                                                              \
-                    break;                                                                                  \
-                case +1:                                                                                    \
-                    node = (*node)->child + 1;                                                              \
-                    break;                                                                                  \
-            }                                                                                               \
-        }                                                                                                   \
-        return NK_LITERAL(_##TTree##_SearchResult){node, false};                                            \
-    }                                                                                                       \
-                                                                                                            \
-    TItem *TTree##_insertItem(TTree *ht, TItem item) {                                                      \
-        TKey const *key = GetKeyFunc(&item);                                                                \
-        u64 hash = KeyHashFunc(*key);                                                                       \
-        _##TTree##_SearchResult res = _##TTree##_findNode(&ht->root, key, hash);                            \
-        if (!res.existing) {                                                                                \
-            NkAllocator _alloc = ht->alloc.proc ? ht->alloc : nk_default_allocator;                         \
-            *res.node = (_##TTree##_Node *)nk_allocAligned(                                                 \
-                _alloc, sizeof(_##TTree##_Node), nk_maxu(alignof(TItem), alignof(_##TTree##_Node)));        \
-            **res.node = NK_LITERAL(_##TTree##_Node){                                                       \
-                .item = item,                                                                               \
-                .hash = hash,                                                                               \
-                .child = {0},                                                                               \
-            };                                                                                              \
-        }                                                                                                   \
-        return (TItem *)*res.node;                                                                          \
-    }                                                                                                       \
-                                                                                                            \
-    TItem *TTree##_findItem(TTree *ht, TKey key) {                                                          \
-        u64 hash = KeyHashFunc(key);                                                                        \
-        _##TTree##_SearchResult res = _##TTree##_findNode(&ht->root, &key, hash);                           \
-        return (TItem *)*res.node;                                                                          \
-    }                                                                                                       \
-                                                                                                            \
-    static void _##TTree##_freeNode(NkAllocator alloc, _##TTree##_Node *node) {                             \
-        if (!node) {                                                                                        \
-            return;                                                                                         \
-        }                                                                                                   \
-        _##TTree##_freeNode(alloc, node->child[0]);                                                         \
-        _##TTree##_freeNode(alloc, node->child[1]);                                                         \
-        nk_free(alloc, node, sizeof(_##TTree##_Node));                                                      \
-    }                                                                                                       \
-                                                                                                            \
-    void TTree##_free(TTree *ht) {                                                                          \
-        NkAllocator _alloc = ht->alloc.proc ? ht->alloc : nk_default_allocator;                             \
-        _##TTree##_freeNode(_alloc, ht->root);                                                              \
-        ht->root = NULL;                                                                                    \
-    }                                                                                                       \
-                                                                                                            \
+#define NK_HASH_TREE_IMPL(TTree, TItem, TKey, GetKeyFunc, KeyHashFunc, KeyEqualFunc)                                   \
+    static NkAllocator _##TTree##_alloc(TTree *ht) {                                                                   \
+        return ht->alloc.proc ? ht->alloc : nk_default_allocator;                                                      \
+    }                                                                                                                  \
+                                                                                                                       \
+    static usize _##TTree##_blockSize(usize capacity) {                                                                \
+        return capacity * (sizeof(TItem) + sizeof(u64));                                                               \
+    }                                                                                                                  \
+                                                                                                                       \
+    static u8 _##TTree##_blockAlign(void) {                                                                            \
+        return (u8)nk_maxu(alignof(TItem), alignof(u64));                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    static usize _##TTree##_slotDist(TTree *ht, usize idx, u64 slot_hash) {                                            \
+        return (idx - _nk_hashTreeHomeSlot(slot_hash, ht->capacity)) & (ht->capacity - 1);                             \
+    }                                                                                                                  \
+                                                                                                                       \
+    static TItem *_##TTree##_placeAt(TTree *ht, usize idx, usize dist, TItem item, u64 hash) {                         \
+        TItem *placed = &ht->items[idx];                                                                               \
+        ht->size++;                                                                                                    \
+        for (;;) {                                                                                                     \
+            u64 const slot_hash = ht->hashes[idx];                                                                     \
+            if (!slot_hash) {                                                                                          \
+                ht->hashes[idx] = hash;                                                                                \
+                ht->items[idx] = item;                                                                                 \
+                return placed;                                                                                         \
+            }                                                                                                          \
+            usize const slot_dist = _##TTree##_slotDist(ht, idx, slot_hash);                                           \
+            if (slot_dist < dist) {                                                                                    \
+                TItem const slot_item = ht->items[idx];                                                                \
+                ht->hashes[idx] = hash;                                                                                \
+                ht->items[idx] = item;                                                                                 \
+                hash = slot_hash;                                                                                      \
+                item = slot_item;                                                                                      \
+                dist = slot_dist;                                                                                      \
+            }                                                                                                          \
+            idx = (idx + 1) & (ht->capacity - 1);                                                                      \
+            dist++;                                                                                                    \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    static void _##TTree##_grow(TTree *ht) {                                                                           \
+        NkAllocator const alloc = _##TTree##_alloc(ht);                                                                \
+        TTree const old = *ht;                                                                                         \
+        usize const capacity = old.capacity ? old.capacity << 1 : NK_HASH_TREE_INITIAL_CAPACITY;                       \
+        ht->items = (TItem *)nk_allocAligned(alloc, _##TTree##_blockSize(capacity), _##TTree##_blockAlign());          \
+        ht->hashes = (u64 *)(ht->items + capacity);                                                                    \
+        ht->size = 0;                                                                                                  \
+        ht->capacity = capacity;                                                                                       \
+        memset(ht->hashes, 0, capacity * sizeof(u64));                                                                 \
+        for (usize i = 0; i < old.capacity; i++) {                                                                     \
+            if (old.hashes[i]) {                                                                                       \
+                _##TTree##_placeAt(ht, _nk_hashTreeHomeSlot(old.hashes[i], capacity), 0, old.items[i], old.hashes[i]); \
+            }                                                                                                          \
+        }                                                                                                              \
+        if (old.items) {                                                                                               \
+            nk_freeAligned(alloc, old.items, _##TTree##_blockSize(old.capacity), _##TTree##_blockAlign());             \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    TItem *TTree##_insertItem(TTree *ht, TItem item) {                                                                 \
+        TKey const *key = GetKeyFunc(&item);                                                                           \
+        u64 const hash = _nk_hashTreeFixHash(KeyHashFunc(*key));                                                       \
+        if ((ht->size + 1) * NK_HASH_TREE_MAX_LOAD_DEN > ht->capacity * NK_HASH_TREE_MAX_LOAD_NUM) {                   \
+            _##TTree##_grow(ht);                                                                                       \
+        }                                                                                                              \
+        usize idx = _nk_hashTreeHomeSlot(hash, ht->capacity);                                                          \
+        for (usize dist = 0;; dist++) {                                                                                \
+            u64 const slot_hash = ht->hashes[idx];                                                                     \
+            if (!slot_hash || _##TTree##_slotDist(ht, idx, slot_hash) < dist) {                                        \
+                return _##TTree##_placeAt(ht, idx, dist, item, hash);                                                  \
+            }                                                                                                          \
+            if (slot_hash == hash && KeyEqualFunc(*key, *GetKeyFunc(&ht->items[idx]))) {                               \
+                return &ht->items[idx];                                                                                \
+            }                                                                                                          \
+            idx = (idx + 1) & (ht->capacity - 1);                                                                      \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    TItem *TTree##_findItem(TTree *ht, TKey key) {                                                                     \
+        if (!ht->size) {                                                                                               \
+            return NULL;                                                                                               \
+        }                                                                                                              \
+        u64 const hash = _nk_hashTreeFixHash(KeyHashFunc(key));                                                        \
+        usize idx = _nk_hashTreeHomeSlot(hash, ht->capacity);                                                          \
+        for (usize dist = 0;; dist++) {                                                                                \
+            u64 const slot_hash = ht->hashes[idx];                                                                     \
+            if (!slot_hash || _##TTree##_slotDist(ht, idx, slot_hash) < dist) {                                        \
+                return NULL;                                                                                           \
+            }                                                                                                          \
+            if (slot_hash == hash && KeyEqualFunc(key, *GetKeyFunc(&ht->items[idx]))) {                                \
+                return &ht->items[idx];                                                                                \
+            }                                                                                                          \
+            idx = (idx + 1) & (ht->capacity - 1);                                                                      \
+        }                                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
+    void TTree##_free(TTree *ht) {                                                                                     \
+        if (ht->items) {                                                                                               \
+            nk_freeAligned(                                                                                            \
+                _##TTree##_alloc(ht), ht->items, _##TTree##_blockSize(ht->capacity), _##TTree##_blockAlign());         \
+        }                                                                                                              \
+        ht->items = NULL;                                                                                              \
+        ht->hashes = NULL;                                                                                             \
+        ht->size = 0;                                                                                                  \
+        ht->capacity = 0;                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
     _NK_NOP_TOPLEVEL
 
 #define NK_HASH_TREE_IMPL_K(TTree, TKey, KeyHashFunc, KeyEqualFunc) \
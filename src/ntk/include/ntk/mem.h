@@ -8,6 +8,13 @@ extern "C" {
 #endif
 
 NK_EXPORT void *nk_mem_reserveAndCommit(usize len);
+
+// Reserves address space without backing it, returns NULL on failure
+NK_EXPORT void *nk_mem_reserve(usize len);
+NK_EXPORT i32 nk_mem_commit(void *addr, usize len);
+// Returns the pages to the system, keeping the address range reserved
+NK_EXPORT i32 nk_mem_decommit(void *addr, usize len);
+
 NK_EXPORT i32 nk_mem_release(void *addr, usize len);
 
 #ifdef __cplusplus
@@ -13,13 +13,13 @@ typedef NkDynArray(char) NkStringBuilder;
 
 #define NKSB_INIT NKDA_INIT
 
-#define NKSB_FIXED_BUFFER_EX(NAME, BUF, SIZE)                      \
-    NkArena NK_CAT(_arena, __LINE__) = {(BUF), 0, (SIZE)};         \
-    NkStringBuilder NAME = {                                       \
-        (char *)nk_arena_alloc(&NK_CAT(_arena, __LINE__), (SIZE)), \
-        0,                                                         \
-        (SIZE),                                                    \
-        nk_arena_getAllocator(&NK_CAT(_arena, __LINE__)),          \
+#define NKSB_FIXED_BUFFER_EX(NAME, BUF, SIZE)                                  \
+    NkArena NK_CAT(_arena, __LINE__) = {(BUF), 0, (SIZE), (SIZE), 0, 0, true}; \
+    NkStringBuilder NAME = {                                                   \
+        (char *)nk_arena_alloc(&NK_CAT(_arena, __LINE__), (SIZE)),             \
+        0,                                                                     \
+        (SIZE),                                                                \
+        nk_arena_getAllocator(&NK_CAT(_arena, __LINE__)),                      \
     }
 
 #define NKSB_FIXED_BUFFER(NAME, SIZE) \
@@ -20,6 +20,21 @@ NK_EXPORT i32 nk_mutex_unlock(NkHandle mutex);
 
 #define NK_MUTEX_GUARD_SCOPE(mtx) NK_DEFER_LOOP(nk_mutex_lock(mtx), nk_mutex_unlock(mtx))
 
+typedef void (*NkThreadProc)(void *arg);
+
+NK_EXPORT NkHandle nk_thread_start(NkThreadProc proc, void *arg);
+NK_EXPORT i32 nk_thread_join(NkHandle thread);
+
+NK_EXPORT void nk_thread_yield(void);
+
+typedef void (*NkThreadExitProc)(void);
+
+// Makes the calling thread call proc when it exits, in the reverse order of registration.
+// Not called for the main thread when the process exits.
+NK_EXPORT i32 nk_thread_atExit(NkThreadExitProc proc);
+
+NK_EXPORT u32 nk_thread_hardwareConcurrency(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -99,13 +99,13 @@ NK_INLINE i64 nk_maxi(i64 x, i64 y) {
 
 #undef _MAGIC
 
-// TODO: Use stronger hash function
-
 NK_INLINE void nk_hashCombine(u64 *seed, usize n) {
     *seed ^= n + 0x9e3779b9 + (*seed << 6) + (*seed >> 2);
 }
 
 NK_EXPORT u64 nk_hashArray(u8 const *begin, u8 const *end);
+// Different seeds give independent hashes of the same data
+NK_EXPORT u64 nk_hashArraySeeded(u8 const *begin, u8 const *end, u64 seed);
 
 #define nk_hashVal(val) nk_hashArray((u8 const *)&(val), (u8 const *)(&(val) + 1))
 
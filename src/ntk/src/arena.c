@@ -2,6 +2,7 @@
 
 #include "ntk/log.h"
 #include "ntk/mem.h"
+#include "ntk/thread.h"
 #include "ntk/utils.h"
 
 #if defined(__SANITIZE_ADDRESS__)
@@ -15,35 +16,158 @@
 
 NK_LOG_USE_SCOPE(arena);
 
-// TODO Hardcoded arena size
-#define FIXED_ARENA_SIZE ((usize)(1 << 24)) // 16 Mib
+// Address space is reserved in blocks, a new block is chained once the current one is full
+#define ARENA_BLOCK_SIZE (sizeof(void *) == 8 ? (usize)1 << 28 : (usize)1 << 24) // 256 MiB, or 16 MiB on 32-bit
+#define ARENA_COMMIT_GRANULE ((usize)1 << 16)                                 // 64 KiB
+// Committed memory above size + ARENA_RETAIN_SIZE is returned to the system once there is twice that much
+#define ARENA_RETAIN_SIZE ((usize)1 << 22) // 4 MiB
+
+// Every block starts with a header that saves the state of the previous block.
+// It takes a whole granule, so that the data of the block stays page aligned.
+#define ARENA_HEADER_SIZE ARENA_COMMIT_GRANULE
+
+typedef struct {
+    u8 *prev_data;
+    usize prev_size;
+    usize prev_capacity;
+    usize prev_reserved;
+    usize prev_base;
+} BlockHeader;
+
+static BlockHeader *getHeader(NkArena const *arena) {
+    return (BlockHeader *)(arena->data - ARENA_HEADER_SIZE);
+}
+
+static bool pushBlock(NkArena *arena, usize min_size) {
+    usize const reserved = nk_roundUp(nk_maxu(ARENA_BLOCK_SIZE, ARENA_HEADER_SIZE + min_size), ARENA_COMMIT_GRANULE);
+
+    NK_LOG_TRC("arena=%p vreserve(%zu)", (void *)arena, reserved);
+
+    u8 *block = (u8 *)nk_mem_reserve(reserved);
+    if (!block) {
+        NK_LOG_ERR("Failed to reserve arena memory");
+        return false;
+    }
+    if (nk_mem_commit(block, ARENA_HEADER_SIZE)) {
+        NK_LOG_ERR("Failed to commit arena memory");
+        nk_mem_release(block, reserved);
+        return false;
+    }
+
+    *(BlockHeader *)block = (BlockHeader){
+        .prev_data = arena->data,
+        .prev_size = arena->size,
+        .prev_capacity = arena->capacity,
+        .prev_reserved = arena->reserved,
+        .prev_base = arena->_base,
+    };
+
+    arena->data = block + ARENA_HEADER_SIZE;
+    arena->capacity = 0;
+    arena->reserved = reserved - ARENA_HEADER_SIZE;
+    arena->_base = arena->size;
+    return true;
+}
+
+static void popBlock(NkArena *arena) {
+    BlockHeader const header = *getHeader(arena);
+
+    NK_LOG_TRC("arena=%p vfree(%p, %zu)", (void *)arena, (void *)getHeader(arena), arena->reserved);
+
+    ASAN_UNPOISON_MEMORY_REGION(arena->data, arena->capacity);
+    nk_mem_release(getHeader(arena), ARENA_HEADER_SIZE + arena->reserved);
+
+    arena->data = header.prev_data;
+    arena->size = header.prev_size;
+    arena->capacity = header.prev_capacity;
+    arena->reserved = header.prev_reserved;
+    arena->_base = header.prev_base;
+}
+
+static bool commit(NkArena *arena, usize size) {
+    usize const new_capacity =
+        nk_minu(nk_roundUp(nk_maxu(size, arena->capacity << 1), ARENA_COMMIT_GRANULE), arena->reserved);
+
+    NK_LOG_TRC("arena=%p commit(%zu -> %zu)", (void *)arena, arena->capacity, new_capacity);
+
+    if (nk_mem_commit(arena->data + arena->capacity, new_capacity - arena->capacity)) {
+        NK_LOG_ERR("Failed to commit arena memory");
+        return false;
+    }
+
+    ASAN_POISON_MEMORY_REGION(arena->data + arena->capacity, new_capacity - arena->capacity);
+    arena->capacity = new_capacity;
+    return true;
+}
+
+static void decommit(NkArena *arena) {
+    usize const size = arena->size - arena->_base;
+    // Fixed arenas are fully committed and never shrink
+    if (!arena->data || arena->fixed || arena->capacity - size <= 2 * ARENA_RETAIN_SIZE) {
+        return;
+    }
+
+    usize const new_capacity = nk_roundUp(size + ARENA_RETAIN_SIZE, ARENA_COMMIT_GRANULE);
+
+    NK_LOG_TRC("arena=%p decommit(%zu -> %zu)", (void *)arena, arena->capacity, new_capacity);
+
+    // Unpoisoning first, so that no stale shadow is left for the pages that may be reused
+    ASAN_UNPOISON_MEMORY_REGION(arena->data + new_capacity, arena->capacity - new_capacity);
+    nk_mem_decommit(arena->data + new_capacity, arena->capacity - new_capacity);
+    arena->capacity = new_capacity;
+}
+
+// Top of the current block
+static u8 *getTop(NkArena const *arena) {
+    return arena->data + (arena->size - arena->_base);
+}
+
+static u8 *alignTop(NkArena const *arena, u8 align, bool pad) {
+    u8 *mem = getTop(arena);
+    return mem + pad * ((align - ((usize)mem & (align - 1))) & (align - 1));
+}
 
 static void *allocAlignedRaw(NkArena *arena, usize size, u8 align, bool pad) {
     nk_assert(align && nk_isZeroOrPowerOf2(align) && "invalid alignment");
 
-    if (!arena->data) {
-        NK_LOG_TRC("arena=%p valloc(%zu)", (void *)arena, FIXED_ARENA_SIZE);
-        arena->data = (u8 *)nk_mem_reserveAndCommit(FIXED_ARENA_SIZE);
-        ASAN_POISON_MEMORY_REGION(arena->data, FIXED_ARENA_SIZE);
-        arena->size = 0;
-        arena->capacity = FIXED_ARENA_SIZE;
+    u8 *mem = arena->data ? alignTop(arena, align, pad) : NULL;
+
+    if (!mem || (usize)(mem - arena->data) + size > arena->reserved) {
+        if (arena->fixed) {
+            NK_LOG_ERR("Out of memory");
+            return NULL;
+        }
+        if (!pushBlock(arena, size + align + RED_ZONE_SIZE)) {
+            return NULL;
+        }
+        mem = alignTop(arena, align, pad);
     }
 
-    u8 *mem = arena->data + arena->size;
-    mem += pad * ((align - ((usize)mem & (align - 1))) & (align - 1));
+    mem += pad * nk_minu(RED_ZONE_SIZE, arena->data + arena->reserved - mem - size);
 
-    if (mem + size > arena->data + arena->capacity) {
-        NK_LOG_ERR("Out of memory");
-        nk_trap();
-    } else {
-        mem += pad * nk_minu(RED_ZONE_SIZE, arena->data + arena->capacity - mem - size);
+    usize const offset = mem + size - arena->data;
+    if (offset > arena->capacity && !commit(arena, offset)) {
+        return NULL;
     }
 
     ASAN_UNPOISON_MEMORY_REGION(mem, size);
-    arena->size += mem - (arena->data + arena->size) + size;
+    arena->size = arena->_base + offset;
+    arena->peak = nk_maxu(arena->peak, arena->size);
     return mem;
 }
 
+static void popRaw(NkArena *arena, usize size) {
+    nk_assert(arena->size >= size && "trying to pop more bytes that available");
+
+    usize const new_size = arena->size - size;
+    while (arena->_base > new_size) {
+        popBlock(arena);
+    }
+
+    ASAN_POISON_MEMORY_REGION(arena->data + (new_size - arena->_base), arena->size - new_size);
+    arena->size = new_size;
+}
+
 static void *arenaAllocatorProc(void *data, NkAllocatorMode mode, usize size, u8 align, void *old_mem, usize old_size) {
     (void)old_mem;
 
@@ -59,26 +183,28 @@ static void *arenaAllocatorProc(void *data, NkAllocatorMode mode, usize size, u8
         case NkAllocatorMode_Free:
             NK_LOG_TRC("arena=%p free(%p, %zu, %hhu)", data, old_mem, old_size, align);
 
-            nk_assert(arena->data + arena->size >= (u8 *)old_mem + old_size && "invalid allocation");
             nk_assert(((usize)old_mem & (align - 1)) == 0 && "invalid alignment");
 
-            if (arena->data + arena->size == (u8 *)old_mem + old_size) {
+            if (arena->data && getTop(arena) == (u8 *)old_mem + old_size) {
                 nk_arena_pop(arena, old_size);
             }
             return NULL;
 
         case NkAllocatorMode_Realloc: {
-            nk_assert(arena->data + arena->size >= (u8 *)old_mem + old_size && "invalid allocation");
             nk_assert(((usize)old_mem & (align - 1)) == 0 && "invalid alignment");
 
             void *ret = NULL;
 
-            if (arena->data + arena->size == (u8 *)old_mem + old_size) {
-                nk_arena_pop(arena, old_size);
+            if (arena->data && getTop(arena) == (u8 *)old_mem + old_size &&
+                (usize)((u8 *)old_mem - arena->data) + size <= arena->reserved) {
+                // Not decommitting here, the old data has to stay in place
+                popRaw(arena, old_size);
                 ret = allocAlignedRaw(arena, size, align, false);
             } else {
                 ret = allocAlignedRaw(arena, size, align, true);
-                memcpy(ret, old_mem, old_size);
+                if (ret) {
+                    memcpy(ret, old_mem, nk_minu(old_size, size));
+                }
             }
 
             NK_LOG_TRC("arena=%p realloc(%zu, %hhu, %p, %zu) -> %p", data, size, align, old_mem, old_size, ret);
@@ -87,10 +213,17 @@ static void *arenaAllocatorProc(void *data, NkAllocatorMode mode, usize size, u8
         }
 
         case NkAllocatorMode_QuerySpaceLeft:
-            *(NkAllocatorSpaceLeftQueryResult *)old_mem = (NkAllocatorSpaceLeftQueryResult){
-                .kind = NkAllocatorSpaceLeftQueryResultKind_Limited,
-                .bytes_left = (arena->data ? arena->capacity : FIXED_ARENA_SIZE) - arena->size,
-            };
+            // Arena chains new blocks as needed, so the space is only limited by the system unless the arena is fixed
+            if (arena->fixed) {
+                *(NkAllocatorSpaceLeftQueryResult *)old_mem = (NkAllocatorSpaceLeftQueryResult){
+                    .kind = NkAllocatorSpaceLeftQueryResultKind_Limited,
+                    .bytes_left = arena->reserved - arena->size,
+                };
+            } else {
+                *(NkAllocatorSpaceLeftQueryResult *)old_mem = (NkAllocatorSpaceLeftQueryResult){
+                    .kind = NkAllocatorSpaceLeftQueryResultKind_Unknown,
+                };
+            }
             return NULL;
 
         default:
@@ -111,16 +244,88 @@ void *nk_arena_allocAligned(NkArena *arena, usize size, u8 align) {
 }
 
 void nk_arena_pop(NkArena *arena, usize size) {
-    nk_assert(arena->size >= size && "trying to pop more bytes that available");
-    arena->size -= size;
-    ASAN_POISON_MEMORY_REGION(arena->data + arena->size, size);
+    popRaw(arena, size);
+    decommit(arena);
 }
 
 void nk_arena_free(NkArena *arena) {
-    if (arena->data) {
-        NK_LOG_TRC("arena=%p vfree(%p, %zu)", (void *)arena, (void *)arena->data, FIXED_ARENA_SIZE);
-        ASAN_UNPOISON_MEMORY_REGION(arena->data, FIXED_ARENA_SIZE);
-        nk_mem_release(arena->data, FIXED_ARENA_SIZE);
+    while (arena->data && !arena->fixed) {
+        popBlock(arena);
     }
     *arena = (NkArena){0};
 }
+
+NkArenaStats nk_arena_getStats(NkArena const *arena) {
+    NkArenaStats stats = {
+        .size = arena->size,
+        .peak = arena->peak,
+    };
+
+    if (arena->fixed) {
+        stats.committed = arena->capacity;
+        stats.reserved = arena->reserved;
+        return stats;
+    }
+
+    NkArena block = *arena;
+    while (block.data) {
+        stats.committed += ARENA_HEADER_SIZE + block.capacity;
+        stats.reserved += ARENA_HEADER_SIZE + block.reserved;
+
+        BlockHeader const *header = getHeader(&block);
+        block.data = header->prev_data;
+        block.capacity = header->prev_capacity;
+        block.reserved = header->prev_reserved;
+    }
+
+    return stats;
+}
+
+// Two arenas are enough as long as every function lists the arena it allocates its results from as a conflict
+#define SCRATCH_ARENA_COUNT 2
+
+static _Thread_local NkArena g_scratch_arenas[SCRATCH_ARENA_COUNT];
+static _Thread_local bool g_scratch_exit_registered;
+
+// Called on thread exit, the frames that are still in use are freed too
+static void freeScratchArenas(void) {
+    for (usize i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+        nk_arena_free(&g_scratch_arenas[i]);
+    }
+}
+
+NkScratch nk_scratch_beginEx(NkArena *const *conflicts, usize conflict_count) {
+    if (!g_scratch_exit_registered) {
+        g_scratch_exit_registered = true;
+        if (nk_thread_atExit(freeScratchArenas)) {
+            NK_LOG_WRN("Failed to register scratch arenas for release on thread exit");
+        }
+    }
+
+    for (usize i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+        NkArena *arena = &g_scratch_arenas[i];
+
+        bool conflicting = false;
+        for (usize j = 0; j < conflict_count; j++) {
+            if (conflicts[j] == arena) {
+                conflicting = true;
+                break;
+            }
+        }
+
+        if (!conflicting) {
+            return (NkScratch){arena, nk_arena_grab(arena)};
+        }
+    }
+
+    NK_LOG_ERR("All scratch arenas are in conflict");
+    nk_trap();
+    return (NkScratch){0};
+}
+
+void nk_scratch_free(void) {
+    for (usize i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+        nk_assert(g_scratch_arenas[i].size == 0 && "freeing scratch arena in use");
+    }
+    freeScratchArenas();
+}
@@ -1,34 +1,226 @@
 #include "ntk/atom.h"
 
-#include "ntk/arena.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#include "ntk/allocator.h"
 #include "ntk/hash_tree.h"
 #include "ntk/profiler.h"
 #include "ntk/string.h"
+#include "ntk/thread.h"
 
 NK_HASH_TREE_IMPL_K(NkAtomSet, NkAtom, nk_atom_hash, nk_atom_equal);
 NK_HASH_TREE_IMPL_KV(NkAtomMap, NkAtom, NkAtom, nk_atom_hash, nk_atom_equal);
 NK_HASH_TREE_IMPL_KV(NkAtomStringMap, NkAtom, NkString, nk_atom_hash, nk_atom_equal);
 NK_HASH_TREE_IMPL_KV(NkStringAtomMap, NkString, NkAtom, nks_hash, nks_equal);
 
-static NkArena g_arena;
-static NkStringAtomMap g_str2atom;
-static NkAtomStringMap g_atom2str;
-static NkAtom g_next_atom = 1000;
+// Interned strings are immutable records, which are published with release stores and never freed.
+//
+// atom -> string goes through a two level page table indexed by the atom, reads are wait-free.
+// string -> atom goes through a sharded open-addressing table. Lookups are lock-free,
+// inserts take a per-shard spin lock and publish new slots and grown tables with release stores.
+
+typedef struct {
+    NkString str;
+    u64 hash;
+    NkAtom atom;
+} AtomRecord;
+
+#define ATOM_PAGE_BITS 16
+#define ATOM_PAGE_SIZE (1u << ATOM_PAGE_BITS)
+#define ATOM_PAGE_COUNT (1u << (32 - ATOM_PAGE_BITS))
+
+typedef struct {
+    AtomRecord const *_Atomic records[ATOM_PAGE_SIZE];
+} AtomPage;
+
+typedef struct AtomTable AtomTable;
+struct AtomTable {
+    AtomTable *retired;
+    usize capacity;
+    AtomRecord const *_Atomic slots[];
+};
+
+#define ATOM_SHARD_BITS 6
+#define ATOM_SHARD_COUNT (1u << ATOM_SHARD_BITS)
+#define ATOM_TABLE_INITIAL_CAPACITY 64
+
+typedef struct {
+    AtomTable *_Atomic table;
+    usize size;
+    atomic_bool locked;
+} AtomShard;
+
+static AtomPage *_Atomic g_atom_pages[ATOM_PAGE_COUNT];
+static AtomShard g_atom_shards[ATOM_SHARD_COUNT];
+static _Atomic NkAtom g_next_atom = 1000;
+
+static u64 mixHash(u64 hash) {
+    return hash * 0x9e3779b97f4a7c15ull;
+}
+
+static AtomShard *getShard(u64 hash) {
+    return &g_atom_shards[mixHash(hash) >> (64 - ATOM_SHARD_BITS)];
+}
+
+static usize getHomeSlot(u64 hash, usize capacity) {
+    return (usize)(mixHash(hash) >> ATOM_SHARD_BITS) & (capacity - 1);
+}
+
+static void lockShard(AtomShard *shard) {
+    for (;;) {
+        if (!atomic_exchange_explicit(&shard->locked, true, memory_order_acquire)) {
+            return;
+        }
+        // Writers only hold the lock for a single insert, so yielding is enough to let the holder finish
+        while (atomic_load_explicit(&shard->locked, memory_order_relaxed)) {
+            nk_thread_yield();
+        }
+    }
+}
+
+static void unlockShard(AtomShard *shard) {
+    atomic_store_explicit(&shard->locked, false, memory_order_release);
+}
+
+static AtomRecord const *makeRecord(NkString str, u64 hash, NkAtom atom) {
+    AtomRecord *rec =
+        (AtomRecord *)nk_allocAligned(nk_default_allocator, sizeof(AtomRecord) + str.size + 1, alignof(AtomRecord));
+    char *data = (char *)(rec + 1);
+    memcpy(data, str.data, str.size);
+    data[str.size] = '\0';
+    *rec = (AtomRecord){
+        .str = {data, str.size},
+        .hash = hash,
+        .atom = atom,
+    };
+    return rec;
+}
+
+static void freeRecord(AtomRecord const *rec) {
+    nk_freeAligned(
+        nk_default_allocator, (void *)rec, sizeof(AtomRecord) + rec->str.size + 1, alignof(AtomRecord));
+}
+
+static AtomPage *getPage(NkAtom atom) {
+    AtomPage *_Atomic *ppage = &g_atom_pages[atom >> ATOM_PAGE_BITS];
+    AtomPage *page = atomic_load_explicit(ppage, memory_order_acquire);
+    if (!page) {
+        AtomPage *new_page = nk_allocT(nk_default_allocator, AtomPage);
+        memset(new_page, 0, sizeof(*new_page));
+        if (atomic_compare_exchange_strong_explicit(
+                ppage, &page, new_page, memory_order_acq_rel, memory_order_acquire)) {
+            page = new_page;
+        } else {
+            nk_freeT(nk_default_allocator, new_page, AtomPage);
+        }
+    }
+    return page;
+}
+
+// Returns false if the atom already has a record
+static bool publishAtom(AtomRecord const *rec) {
+    AtomPage *page = getPage(rec->atom);
+    AtomRecord const *expected = NULL;
+    return atomic_compare_exchange_strong_explicit(
+        &page->records[rec->atom & (ATOM_PAGE_SIZE - 1)],
+        &expected,
+        rec,
+        memory_order_release,
+        memory_order_relaxed);
+}
+
+static AtomRecord const *findRecord(AtomTable const *table, NkString str, u64 hash) {
+    if (!table) {
+        return NULL;
+    }
+    usize const mask = table->capacity - 1;
+    for (usize idx = getHomeSlot(hash, table->capacity);; idx = (idx + 1) & mask) {
+        AtomRecord const *rec = atomic_load_explicit(&table->slots[idx], memory_order_acquire);
+        if (!rec) {
+            return NULL;
+        }
+        if (rec->hash == hash && nks_equal(rec->str, str)) {
+            return rec;
+        }
+    }
+}
+
+static void placeRecord(AtomTable *table, AtomRecord const *rec) {
+    usize const mask = table->capacity - 1;
+    usize idx = getHomeSlot(rec->hash, table->capacity);
+    while (atomic_load_explicit(&table->slots[idx], memory_order_relaxed)) {
+        idx = (idx + 1) & mask;
+    }
+    atomic_store_explicit(&table->slots[idx], rec, memory_order_release);
+}
+
+static AtomTable *allocTable(usize capacity) {
+    usize const size = sizeof(AtomTable) + capacity * sizeof(AtomRecord const *);
+    AtomTable *table = (AtomTable *)nk_allocAligned(nk_default_allocator, size, alignof(AtomTable));
+    memset(table, 0, size);
+    table->capacity = capacity;
+    return table;
+}
+
+// Must be called with the shard locked.
+// Old tables may still be read concurrently, so they are retired instead of freed.
+static void insertRecord(AtomShard *shard, AtomRecord const *rec) {
+    AtomTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    if (!table || (shard->size + 1) * 2 > table->capacity) {
+        AtomTable *new_table = allocTable(table ? table->capacity << 1 : ATOM_TABLE_INITIAL_CAPACITY);
+        if (table) {
+            for (usize i = 0; i < table->capacity; i++) {
+                AtomRecord const *old_rec = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+                if (old_rec) {
+                    placeRecord(new_table, old_rec);
+                }
+            }
+        }
+        new_table->retired = table;
+        atomic_store_explicit(&shard->table, new_table, memory_order_release);
+        table = new_table;
+    }
+    placeRecord(table, rec);
+    shard->size++;
+}
 
 void nk_atom_init(void) {
-    NkAllocator alloc = nk_arena_getAllocator(&g_arena);
-    g_str2atom.alloc = alloc;
-    g_atom2str.alloc = alloc;
 }
 
 void nk_atom_deinit(void) {
+    for (usize i = 0; i < ATOM_SHARD_COUNT; i++) {
+        AtomShard *shard = &g_atom_shards[i];
+        lockShard(shard);
+        AtomTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+        if (table) {
+            AtomTable *retired = table->retired;
+            table->retired = NULL;
+            while (retired) {
+                AtomTable *next = retired->retired;
+                nk_freeAligned(
+                    nk_default_allocator,
+                    retired,
+                    sizeof(AtomTable) + retired->capacity * sizeof(AtomRecord const *),
+                    alignof(AtomTable));
+                retired = next;
+            }
+        }
+        unlockShard(shard);
+    }
 }
 
 NkString nk_atom2s(NkAtom atom) {
-    NkString ret;
+    NkString ret = {0};
     NK_PROF_FUNC() {
-        NkString const *found = NkAtomStringMap_find(&g_atom2str, atom);
-        ret = found ? *found : (NkString){0};
+        AtomPage const *page = atomic_load_explicit(&g_atom_pages[atom >> ATOM_PAGE_BITS], memory_order_acquire);
+        if (page) {
+            AtomRecord const *rec =
+                atomic_load_explicit(&page->records[atom & (ATOM_PAGE_SIZE - 1)], memory_order_acquire);
+            if (rec) {
+                ret = rec->str;
+            }
+        }
     }
     return ret;
 }
@@ -40,15 +232,27 @@ char const *nk_atom2cs(NkAtom atom) {
 NkAtom nk_s2atom(NkString str) {
     NkAtom ret = 0;
     NK_PROF_FUNC() {
-        NkAtom const *found = NkStringAtomMap_find(&g_str2atom, str);
+        u64 const hash = nks_hash(str);
+        AtomShard *shard = getShard(hash);
 
-        if (found) {
-            ret = *found;
-        } else {
-            NkAtom atom = g_next_atom++;
-            nk_atom_define(atom, str);
-            ret = atom;
+        AtomRecord const *found = findRecord(atomic_load_explicit(&shard->table, memory_order_acquire), str, hash);
+        if (!found) {
+            lockShard(shard);
+
+            found = findRecord(atomic_load_explicit(&shard->table, memory_order_relaxed), str, hash);
+            if (!found) {
+                NkAtom const atom = atomic_fetch_add_explicit(&g_next_atom, 1, memory_order_relaxed);
+                found = makeRecord(str, hash, atom);
+
+                // Publishing the atom first, so that anyone who finds the record can resolve it
+                publishAtom(found);
+                insertRecord(shard, found);
+            }
+
+            unlockShard(shard);
         }
+
+        ret = found->atom;
     }
     return ret;
 }
@@ -59,17 +263,31 @@ NkAtom nk_cs2atom(char const *str) {
 
 void nk_atom_define(NkAtom atom, NkString str) {
     NK_PROF_FUNC() {
-        NkString const str_copy = nks_copyNt(nk_arena_getAllocator(&g_arena), str);
-        NkStringAtomMap_insert(&g_str2atom, str_copy, atom);
-        NkAtomStringMap_insert(&g_atom2str, atom, str_copy);
+        u64 const hash = nks_hash(str);
+        AtomShard *shard = getShard(hash);
+
+        lockShard(shard);
+
+        AtomRecord const *found = findRecord(atomic_load_explicit(&shard->table, memory_order_relaxed), str, hash);
+        if (!found || found->atom != atom) {
+            AtomRecord const *rec = makeRecord(str, hash, atom);
+            bool const published = publishAtom(rec);
+            if (!found) {
+                insertRecord(shard, rec);
+            } else if (!published) {
+                // Neither the atom nor the string needs the record
+                freeRecord(rec);
+            }
+        }
+
+        unlockShard(shard);
     }
 }
 
 NkAtom nk_atom_unique(NkString str) {
-    NkAtom atom = g_next_atom++;
+    NkAtom const atom = atomic_fetch_add_explicit(&g_next_atom, 1, memory_order_relaxed);
     NK_PROF_FUNC() {
-        NkString const str_copy = nks_copyNt(nk_arena_getAllocator(&g_arena), str);
-        NkAtomStringMap_insert(&g_atom2str, atom, str_copy);
+        publishAtom(makeRecord(str, 0, atom));
     }
     return atom;
 }
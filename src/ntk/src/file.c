@@ -39,6 +39,76 @@ bool nk_file_read(NkAllocator alloc, NkString filepath, NkString *out) {
     return ok;
 }
 
+bool nk_file_write(NkString filepath, NkString data) {
+    NK_LOG_TRC("%s", __func__);
+    NK_LOG_DBG("Writing file `" NKS_FMT "`", NKS_ARG(filepath));
+
+    bool ok = false;
+    NK_PROF_FUNC() {
+        NKSB_FIXED_BUFFER(path, NK_MAX_PATH);
+        nksb_tryAppendStr(&path, filepath);
+        nksb_tryAppendNull(&path);
+
+        NkHandle file = nk_open(path.data, NkOpenFlags_Write | NkOpenFlags_Create | NkOpenFlags_Truncate);
+        if (!nk_handleIsNull(file)) {
+            ok = true;
+            while (data.size) {
+                i32 const res = nk_write(file, data.data, data.size);
+                if (res <= 0) {
+                    ok = false;
+                    break;
+                }
+                data.data += res;
+                data.size -= res;
+            }
+        }
+        nk_close(file);
+    }
+    return ok;
+}
+
+bool nk_file_map(NkString filepath, NkFileMapping *out) {
+    NK_LOG_TRC("%s", __func__);
+    NK_LOG_DBG("Mapping file `" NKS_FMT "`", NKS_ARG(filepath));
+
+    bool ok = false;
+    NK_PROF_FUNC() {
+        NKSB_FIXED_BUFFER(path, NK_MAX_PATH);
+        nksb_tryAppendStr(&path, filepath);
+        nksb_tryAppendNull(&path);
+
+        NkHandle file = nk_open(path.data, NkOpenFlags_Read);
+        if (!nk_handleIsNull(file)) {
+            NkString view;
+            if (nk_mapFile(file, &view) == 0) {
+                *out = (NkFileMapping){.text = view, ._capacity = 0, ._mapped = true};
+                ok = true;
+            } else {
+                NkStringBuilder sb = {.alloc = nk_default_allocator};
+                if (nksb_readFromStreamEx(&sb, nk_file_getStream(file), BUF_SIZE)) {
+                    *out = (NkFileMapping){.text = {NKS_INIT(sb)}, ._capacity = sb.capacity, ._mapped = false};
+                    ok = true;
+                } else {
+                    nksb_free(&sb);
+                }
+            }
+        }
+        nk_close(file);
+    }
+    return ok;
+}
+
+void nk_file_unmap(NkFileMapping *mapping) {
+    NK_LOG_TRC("%s", __func__);
+
+    if (mapping->_mapped) {
+        nk_unmapFile(mapping->text);
+    } else if (mapping->_capacity) {
+        nk_free(nk_default_allocator, (void *)mapping->text.data, mapping->_capacity);
+    }
+    *mapping = (NkFileMapping){0};
+}
+
 static i32 streamProc(void *stream_data, char *buf, usize size, NkStreamMode mode) {
     NkHandle const file = nk_handleFromVoidPtr(stream_data);
 
@@ -1,11 +1,16 @@
 #include "ntk/file.h"
 
+#include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "common.h"
+#include "ntk/dyn_array.h"
 #include "ntk/profiler.h"
 
 char const *nk_null_file = "/dev/null";
@@ -56,6 +61,80 @@ i32 nk_close(NkHandle file) {
     return ret;
 }
 
+i32 nk_mapFile(NkHandle file, NkString *out) {
+    i32 ret = -1;
+    NK_PROF_FUNC() {
+        struct stat st;
+        if (fstat(handle2fd(file), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, handle2fd(file), 0);
+            if (addr != MAP_FAILED) {
+                *out = (NkString){addr, (usize)st.st_size};
+                ret = 0;
+            }
+        }
+    }
+    return ret;
+}
+
+i32 nk_unmapFile(NkString view) {
+    return munmap((void *)view.data, view.size);
+}
+
+i32 nk_mkdir(char const *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+i32 nk_remove(char const *path) {
+    return remove(path);
+}
+
+i32 nk_rename(char const *old_path, char const *new_path) {
+    return rename(old_path, new_path);
+}
+
+i32 nk_touch(char const *path) {
+    return utimensat(AT_FDCWD, path, NULL, 0);
+}
+
+i32 nk_listDir(NkArena *arena, char const *path, NkFileInfoArray *out) {
+    i32 ret = 0;
+    NK_PROF_FUNC() {
+        DIR *dir = opendir(path);
+        if (!dir) {
+            ret = -1;
+        } else {
+            NkDynArray(NkFileInfo) files = {.alloc = nk_arena_getAllocator(arena)};
+
+            struct dirent *entry;
+            while ((entry = readdir(dir))) {
+                struct stat st;
+                if (fstatat(dirfd(dir), entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+                    continue;
+                }
+
+#ifdef __APPLE__
+                struct timespec const mtime = st.st_mtimespec;
+#else
+                struct timespec const mtime = st.st_mtim;
+#endif
+
+                nkda_append(
+                    &files,
+                    ((NkFileInfo){
+                        .name = nks_copyNt(nk_arena_getAllocator(arena), nk_cs2s(entry->d_name)),
+                        .size = (u64)st.st_size,
+                        .mtime = (u64)mtime.tv_sec * 1000000000ull + (u64)mtime.tv_nsec,
+                    }));
+            }
+
+            closedir(dir);
+
+            *out = (NkFileInfoArray){NKS_INIT(files)};
+        }
+    }
+    return ret;
+}
+
 NkHandle nk_stdin(void) {
     return fd2handle(0);
 }
@@ -6,6 +6,22 @@ void *nk_mem_reserveAndCommit(usize len) {
     return mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 }
 
+void *nk_mem_reserve(usize len) {
+    void *addr = mmap(NULL, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+i32 nk_mem_commit(void *addr, usize len) {
+    return mprotect(addr, len, PROT_READ | PROT_WRITE);
+}
+
+i32 nk_mem_decommit(void *addr, usize len) {
+    if (madvise(addr, len, MADV_DONTNEED)) {
+        return -1;
+    }
+    return mprotect(addr, len, PROT_NONE);
+}
+
 i32 nk_mem_release(void *addr, usize len) {
     return munmap(addr, len);
 }
@@ -1,8 +1,11 @@
 #include "ntk/thread.h"
 
 #include <pthread.h>
+#include <sched.h>
 
 #include "common.h"
+#include "ntk/allocator.h"
+#include "ntk/error.h"
 #include "ntk/pool.h"
 
 NK_POOL_DEFINE(MutexPool, pthread_mutex_t);
@@ -47,3 +50,86 @@ i32 nk_mutex_unlock(NkHandle h_mutex) {
     nk_assert(!nk_handleIsNull(h_mutex) && "Using uninitialized mutex");
     return pthread_mutex_unlock(handle2native(h_mutex));
 }
+
+typedef struct {
+    NkThreadProc proc;
+    void *arg;
+} ThreadStartInfo;
+
+static void *threadEntry(void *arg) {
+    ThreadStartInfo const info = *(ThreadStartInfo *)arg;
+    nk_freeT(nk_default_allocator, (ThreadStartInfo *)arg, ThreadStartInfo);
+
+    info.proc(info.arg);
+    return NULL;
+}
+
+NkHandle nk_thread_start(NkThreadProc proc, void *arg) {
+    ThreadStartInfo *info = nk_allocT(nk_default_allocator, ThreadStartInfo);
+    *info = (ThreadStartInfo){
+        .proc = proc,
+        .arg = arg,
+    };
+
+    pthread_t thread;
+    i32 const res = pthread_create(&thread, NULL, threadEntry, info);
+    if (res) {
+        nk_freeT(nk_default_allocator, info, ThreadStartInfo);
+        nk_setLastError(res);
+        return NK_NULL_HANDLE;
+    }
+
+    return (NkHandle){(intptr_t)thread};
+}
+
+i32 nk_thread_join(NkHandle h_thread) {
+    nk_assert(!nk_handleIsNull(h_thread) && "Using uninitialized thread");
+    return pthread_join((pthread_t)h_thread.val, NULL);
+}
+
+void nk_thread_yield(void) {
+    sched_yield();
+}
+
+typedef struct ExitProcNode {
+    struct ExitProcNode *next;
+    NkThreadExitProc proc;
+} ExitProcNode;
+
+static pthread_key_t g_exit_key;
+static pthread_once_t g_exit_key_once = PTHREAD_ONCE_INIT;
+
+static void runExitProcs(void *arg) {
+    for (ExitProcNode *node = arg; node;) {
+        ExitProcNode *next = node->next;
+        node->proc();
+        nk_freeT(nk_default_allocator, node, ExitProcNode);
+        node = next;
+    }
+}
+
+static void createExitKey(void) {
+    pthread_key_create(&g_exit_key, runExitProcs);
+}
+
+i32 nk_thread_atExit(NkThreadExitProc proc) {
+    pthread_once(&g_exit_key_once, createExitKey);
+
+    ExitProcNode *node = nk_allocT(nk_default_allocator, ExitProcNode);
+    *node = (ExitProcNode){
+        .next = pthread_getspecific(g_exit_key),
+        .proc = proc,
+    };
+
+    i32 const res = pthread_setspecific(g_exit_key, node);
+    if (res) {
+        nk_freeT(nk_default_allocator, node, ExitProcNode);
+        nk_setLastError(res);
+    }
+    return res;
+}
+
+u32 nk_thread_hardwareConcurrency(void) {
+    long const count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
@@ -1,7 +1,9 @@
 #include "ntk/file.h"
 
 #include "common.h"
+#include "ntk/dyn_array.h"
 #include "ntk/profiler.h"
+#include "ntk/string_builder.h"
 
 char const *nk_null_file = "nul";
 
@@ -91,6 +93,108 @@ i32 nk_close(NkHandle file) {
     return ret;
 }
 
+i32 nk_mapFile(NkHandle file, NkString *out) {
+    i32 ret = -1;
+    NK_PROF_FUNC() {
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(handle2native(file), &size) && size.QuadPart > 0) {
+            HANDLE hMapping = CreateFileMapping(
+                handle2native(file), // HANDLE                hFile
+                NULL,                // LPSECURITY_ATTRIBUTES lpFileMappingAttributes
+                PAGE_READONLY,       // DWORD                 flProtect
+                0,                   // DWORD                 dwMaximumSizeHigh
+                0,                   // DWORD                 dwMaximumSizeLow
+                NULL                 // LPCSTR                lpName
+            );
+            if (hMapping) {
+                // The view keeps the mapping alive
+                void *addr = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(hMapping);
+                if (addr) {
+                    *out = (NkString){addr, (usize)size.QuadPart};
+                    ret = 0;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+i32 nk_unmapFile(NkString view) {
+    return UnmapViewOfFile(view.data) ? 0 : -1;
+}
+
+i32 nk_mkdir(char const *path) {
+    return CreateDirectory(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS ? 0 : -1;
+}
+
+i32 nk_remove(char const *path) {
+    return DeleteFile(path) ? 0 : -1;
+}
+
+i32 nk_rename(char const *old_path, char const *new_path) {
+    return MoveFileEx(old_path, new_path, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+
+i32 nk_touch(char const *path) {
+    HANDLE hFile = CreateFile(
+        path,
+        FILE_WRITE_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    BOOL const bSuccess = SetFileTime(hFile, NULL, NULL, &now);
+
+    CloseHandle(hFile);
+    return bSuccess ? 0 : -1;
+}
+
+i32 nk_listDir(NkArena *arena, char const *path, NkFileInfoArray *out) {
+    i32 ret = 0;
+    NK_PROF_FUNC() {
+        NKSB_FIXED_BUFFER(pattern, NK_MAX_PATH);
+        nksb_tryAppendStr(&pattern, nk_cs2s(path));
+        nksb_tryAppendStr(&pattern, nk_cs2s("\\*"));
+        nksb_tryAppendNull(&pattern);
+
+        WIN32_FIND_DATA data;
+        HANDLE hFind = FindFirstFile(pattern.data, &data);
+        if (hFind == INVALID_HANDLE_VALUE) {
+            ret = GetLastError() == ERROR_FILE_NOT_FOUND ? 0 : -1;
+            *out = (NkFileInfoArray){0};
+        } else {
+            NkDynArray(NkFileInfo) files = {.alloc = nk_arena_getAllocator(arena)};
+
+            do {
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                    continue;
+                }
+
+                nkda_append(
+                    &files,
+                    ((NkFileInfo){
+                        .name = nks_copyNt(nk_arena_getAllocator(arena), nk_cs2s(data.cFileName)),
+                        .size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow,
+                        .mtime = ((u64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime,
+                    }));
+            } while (FindNextFile(hFind, &data));
+
+            FindClose(hFind);
+
+            *out = (NkFileInfoArray){NKS_INIT(files)};
+        }
+    }
+    return ret;
+}
+
 NkHandle nk_stdin() {
     return native2handle(GetStdHandle(STD_INPUT_HANDLE));
 }
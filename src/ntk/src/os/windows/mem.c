@@ -11,6 +11,34 @@ void *nk_mem_reserveAndCommit(usize len) {
     );
 }
 
+void *nk_mem_reserve(usize len) {
+    return VirtualAlloc(
+        NULL,         // LPVOID lpAddress
+        len,          // SIZE_T dwSize
+        MEM_RESERVE,  // DWORD  flAllocationType
+        PAGE_NOACCESS // DWORD  flProtect
+    );
+}
+
+i32 nk_mem_commit(void *addr, usize len) {
+    void *ret = VirtualAlloc(
+        addr,          // LPVOID lpAddress
+        len,           // SIZE_T dwSize
+        MEM_COMMIT,    // DWORD  flAllocationType
+        PAGE_READWRITE // DWORD  flProtect
+    );
+    return ret ? 0 : -1;
+}
+
+i32 nk_mem_decommit(void *addr, usize len) {
+    BOOL bSuccess = VirtualFree(
+        addr,        // LPVOID lpAddress
+        len,         // SIZE_T dwSize
+        MEM_DECOMMIT // DWORD  dwFreeType
+    );
+    return bSuccess ? 0 : -1;
+}
+
 i32 nk_mem_release(void *addr, usize len) {
     (void)len;
     BOOL bSuccess = VirtualFree(
@@ -1,6 +1,7 @@
 #include "ntk/thread.h"
 
 #include "common.h"
+#include "ntk/allocator.h"
 
 NkHandle nk_mutex_alloc(i32 flags) {
     (void)flags;
@@ -21,3 +22,95 @@ i32 nk_mutex_unlock(NkHandle h_mutex) {
     nk_assert(!nk_handleIsNull(h_mutex) && "Using uninitialized mutex");
     return ReleaseMutex(handle2native(h_mutex)) ? 0 : -1;
 }
+
+typedef struct {
+    NkThreadProc proc;
+    void *arg;
+} ThreadStartInfo;
+
+static DWORD WINAPI threadEntry(LPVOID arg) {
+    ThreadStartInfo const info = *(ThreadStartInfo *)arg;
+    nk_freeT(nk_default_allocator, (ThreadStartInfo *)arg, ThreadStartInfo);
+
+    info.proc(info.arg);
+    return 0;
+}
+
+NkHandle nk_thread_start(NkThreadProc proc, void *arg) {
+    ThreadStartInfo *info = nk_allocT(nk_default_allocator, ThreadStartInfo);
+    *info = (ThreadStartInfo){
+        .proc = proc,
+        .arg = arg,
+    };
+
+    HANDLE thread = CreateThread(NULL, 0, threadEntry, info, 0, NULL);
+    if (!thread) {
+        nk_freeT(nk_default_allocator, info, ThreadStartInfo);
+        return NK_NULL_HANDLE;
+    }
+
+    return native2handle(thread);
+}
+
+i32 nk_thread_join(NkHandle h_thread) {
+    nk_assert(!nk_handleIsNull(h_thread) && "Using uninitialized thread");
+
+    HANDLE thread = handle2native(h_thread);
+    i32 const res = WaitForSingleObject(thread, INFINITE) == WAIT_FAILED ? -1 : 0;
+    CloseHandle(thread);
+    return res;
+}
+
+void nk_thread_yield(void) {
+    SwitchToThread();
+}
+
+typedef struct ExitProcNode {
+    struct ExitProcNode *next;
+    NkThreadExitProc proc;
+} ExitProcNode;
+
+static DWORD g_exit_key = FLS_OUT_OF_INDEXES;
+static INIT_ONCE g_exit_key_once = INIT_ONCE_STATIC_INIT;
+
+static VOID WINAPI runExitProcs(PVOID arg) {
+    for (ExitProcNode *node = arg; node;) {
+        ExitProcNode *next = node->next;
+        node->proc();
+        nk_freeT(nk_default_allocator, node, ExitProcNode);
+        node = next;
+    }
+}
+
+static BOOL CALLBACK createExitKey(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+    (void)once;
+    (void)param;
+    (void)ctx;
+    // Fiber local storage, unlike thread local storage, calls the callback when the thread exits
+    g_exit_key = FlsAlloc(runExitProcs);
+    return g_exit_key != FLS_OUT_OF_INDEXES;
+}
+
+i32 nk_thread_atExit(NkThreadExitProc proc) {
+    if (!InitOnceExecuteOnce(&g_exit_key_once, createExitKey, NULL, NULL)) {
+        return -1;
+    }
+
+    ExitProcNode *node = nk_allocT(nk_default_allocator, ExitProcNode);
+    *node = (ExitProcNode){
+        .next = FlsGetValue(g_exit_key),
+        .proc = proc,
+    };
+
+    if (!FlsSetValue(g_exit_key, node)) {
+        nk_freeT(nk_default_allocator, node, ExitProcNode);
+        return -1;
+    }
+    return 0;
+}
+
+u32 nk_thread_hardwareConcurrency(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (u32)info.dwNumberOfProcessors : 1;
+}
@@ -1,23 +1,109 @@
 #include "ntk/utils.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "ntk/stream.h"
 #include "ntk/string_builder.h"
 
-#define HASH_ARRAY_STEP sizeof(usize)
+// nk_hashArray is a wyhash-style hash: 64x64->128 bit multiply-xor mixing of the input read in 8 byte words.
+// Short keys (identifiers, type fingerprints) take a branchy path with at most two overlapping reads,
+// long keys are consumed 48 bytes at a time in three independent lanes.
+
+static u64 const c_hash_secret[] = {
+    0x2d358dccaa6c78a5ull,
+    0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull,
+    0x4d5a2da51de1aa47ull,
+};
+
+NK_INLINE void hashMum(u64 *a, u64 *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t const r = (__uint128_t)*a * *b;
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+#else
+    u64 const ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+    u64 const rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    u64 const t = rl + (rm0 << 32);
+    u64 lo = t + (rm1 << 32);
+    u64 hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+NK_INLINE u64 hashMix(u64 a, u64 b) {
+    hashMum(&a, &b);
+    return a ^ b;
+}
+
+NK_INLINE u64 hashRead8(u8 const *p) {
+    u64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+NK_INLINE u64 hashRead4(u8 const *p) {
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+NK_INLINE u64 hashRead3(u8 const *p, usize len) {
+    return ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+}
 
 u64 nk_hashArray(u8 const *begin, u8 const *end) {
-    u64 hash = 0;
-    usize i = 0;
-    while (begin + (i + 1) * HASH_ARRAY_STEP <= end) {
-        nk_hashCombine(&hash, *(usize const *)(begin + i++ * HASH_ARRAY_STEP));
-    }
-    i *= HASH_ARRAY_STEP;
-    while (begin + i < end) {
-        nk_hashCombine(&hash, begin[i++]);
+    return nk_hashArraySeeded(begin, end, 0);
+}
+
+u64 nk_hashArraySeeded(u8 const *begin, u8 const *end, u64 seed_in) {
+    u8 const *p = begin;
+    usize const len = end - begin;
+
+    u64 seed = hashMix(c_hash_secret[0] ^ seed_in, c_hash_secret[1]);
+    u64 a;
+    u64 b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            usize const off = (len >> 3) << 2;
+            a = (hashRead4(p) << 32) | hashRead4(p + off);
+            b = (hashRead4(p + len - 4) << 32) | hashRead4(p + len - 4 - off);
+        } else if (len > 0) {
+            a = hashRead3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        usize i = len;
+        if (i > 48) {
+            u64 see1 = seed;
+            u64 see2 = seed;
+            do {
+                seed = hashMix(hashRead8(p) ^ c_hash_secret[1], hashRead8(p + 8) ^ seed);
+                see1 = hashMix(hashRead8(p + 16) ^ c_hash_secret[2], hashRead8(p + 24) ^ see1);
+                see2 = hashMix(hashRead8(p + 32) ^ c_hash_secret[3], hashRead8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hashMix(hashRead8(p) ^ c_hash_secret[1], hashRead8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hashRead8(p + i - 16);
+        b = hashRead8(p + i - 8);
     }
-    return hash;
+
+    a ^= c_hash_secret[1];
+    b ^= seed;
+    hashMum(&a, &b);
+    return hashMix(a ^ c_hash_secret[0] ^ len, b ^ c_hash_secret[1]);
 }
 
 #define strtof32 strtof
@@ -1,6 +1,7 @@
 #include "ntk/allocator.h"
 
 #include <cstring>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -193,3 +194,152 @@ TEST_F(allocator, arena_stress) {
         }
     }
 }
+
+TEST_F(allocator, arena_grow) {
+    static constexpr usize c_chunk_size = 1 << 20;
+    static constexpr usize c_chunk_count = 64;
+
+    auto const frame = nk_arena_grab(&m_arena);
+
+    u8 *prev = nullptr;
+    for (usize i = 0; i < c_chunk_count; i++) {
+        auto const chunk = nk_arena_allocT<u8>(&m_arena, c_chunk_size);
+        memset(chunk, (int)i, c_chunk_size);
+
+        if (prev) {
+            EXPECT_GE(chunk, prev + c_chunk_size);
+        }
+        prev = chunk;
+    }
+
+    auto const stats = nk_arena_getStats(&m_arena);
+    EXPECT_GE(stats.size, c_chunk_size * c_chunk_count);
+    EXPECT_EQ(stats.peak, stats.size);
+    EXPECT_GE(stats.committed, stats.size);
+    EXPECT_GE(stats.reserved, stats.committed);
+
+    EXPECT_EQ(prev[0], c_chunk_count - 1);
+    EXPECT_EQ(prev[c_chunk_size - 1], c_chunk_count - 1);
+
+    nk_arena_popFrame(&m_arena, frame);
+
+    auto const popped_stats = nk_arena_getStats(&m_arena);
+    EXPECT_EQ(popped_stats.size, 0u);
+    EXPECT_EQ(popped_stats.peak, stats.peak);
+    EXPECT_LT(popped_stats.committed, stats.committed);
+
+    nk_arena_resetPeak(&m_arena);
+    EXPECT_EQ(nk_arena_getStats(&m_arena).peak, 0u);
+
+    // Decommitted memory is usable again
+    auto const chunk = nk_arena_allocT<u8>(&m_arena, c_chunk_size * c_chunk_count);
+    memset(chunk, 0xff, c_chunk_size * c_chunk_count);
+    EXPECT_EQ(chunk[c_chunk_size * c_chunk_count - 1], 0xff);
+}
+
+TEST_F(allocator, arena_realloc_grow) {
+    usize size = 16;
+    auto data = nk_allocT<usize>(m_alloc, size);
+    for (usize i = 0; i < size; i++) {
+        data[i] = i;
+    }
+
+    // Growing the last allocation in place, across several commits
+    while (size < (1 << 22)) {
+        auto const new_data = nk_reallocT<usize>(m_alloc, size * 2, data, size);
+        EXPECT_EQ(new_data, data);
+        data = new_data;
+        for (usize i = size; i < size * 2; i++) {
+            data[i] = i;
+        }
+        size *= 2;
+    }
+
+    for (usize i = 0; i < size; i++) {
+        ASSERT_EQ(data[i], i);
+    }
+}
+
+TEST_F(allocator, arena_chain) {
+    static constexpr usize c_chunk_size = (usize)1 << 27; // 128 MiB
+    static constexpr usize c_chunk_count = 8;
+
+    nk_arena_allocT<u8>(&m_arena, 1);
+    auto const first_stats = nk_arena_getStats(&m_arena);
+
+    auto const frame = nk_arena_grab(&m_arena);
+
+    u8 *chunks[c_chunk_count];
+    for (usize i = 0; i < c_chunk_count; i++) {
+        chunks[i] = nk_arena_allocT<u8>(&m_arena, c_chunk_size);
+        ASSERT_TRUE(chunks[i]);
+        chunks[i][0] = (u8)i;
+        chunks[i][c_chunk_size - 1] = (u8)i;
+    }
+
+    // Larger than a whole block
+    auto const big = nk_arena_allocT<u8>(&m_arena, c_chunk_size * c_chunk_count);
+    ASSERT_TRUE(big);
+    big[c_chunk_size * c_chunk_count - 1] = 0xff;
+
+    for (usize i = 0; i < c_chunk_count; i++) {
+        EXPECT_EQ(chunks[i][0], i);
+        EXPECT_EQ(chunks[i][c_chunk_size - 1], i);
+    }
+
+    auto const stats = nk_arena_getStats(&m_arena);
+    EXPECT_GE(stats.size, c_chunk_size * c_chunk_count * 2);
+    EXPECT_GT(stats.reserved, first_stats.reserved);
+    EXPECT_GE(stats.reserved, stats.committed);
+
+    nk_arena_popFrame(&m_arena, frame);
+
+    auto const popped_stats = nk_arena_getStats(&m_arena);
+    EXPECT_EQ(popped_stats.size, first_stats.size);
+    EXPECT_EQ(popped_stats.reserved, first_stats.reserved);
+
+    // Growing the last allocation past the end of the block moves it into a new one
+    usize size = 16;
+    auto data = nk_allocT<u8>(m_alloc, size);
+    memset(data, 0x42, size);
+    data = nk_reallocT<u8>(m_alloc, c_chunk_size * c_chunk_count, data, size);
+    ASSERT_TRUE(data);
+    EXPECT_EQ(data[0], 0x42);
+    EXPECT_EQ(data[size - 1], 0x42);
+}
+
+TEST_F(allocator, scratch) {
+    auto const outer = nk_scratch_begin(nullptr);
+    auto const outer_data = nk_arena_allocT<u64>(outer.arena);
+    *outer_data = 42;
+
+    {
+        // Results go into the outer arena, so temporaries must come from another one
+        auto const inner = nk_scratch_begin(outer.arena);
+        EXPECT_NE(inner.arena, outer.arena);
+
+        nk_arena_allocT<u64>(inner.arena, 1000);
+
+        auto const nested = nk_scratch_begin(inner.arena);
+        EXPECT_EQ(nested.arena, outer.arena);
+        nk_arena_allocT<u64>(nested.arena, 1000);
+        nk_scratch_end(nested);
+
+        nk_scratch_end(inner);
+        EXPECT_EQ(inner.arena->size, inner.frame.size);
+    }
+
+    EXPECT_EQ(*outer_data, 42u);
+
+    NkArena *other_thread_arena = nullptr;
+    std::thread{[&]() {
+        auto const scratch = nk_scratch_begin(nullptr);
+        other_thread_arena = scratch.arena;
+        nk_scratch_end(scratch);
+        nk_scratch_free();
+    }}.join();
+    EXPECT_NE(other_thread_arena, outer.arena);
+
+    nk_scratch_end(outer);
+    EXPECT_EQ(outer.arena->size, outer.frame.size);
+}
@@ -1,9 +1,15 @@
 #include "ntk/atom.h"
 
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "ntk/log.h"
 #include "ntk/string.h"
+#include "ntk/time.h"
 
 class atom : public testing::Test {
     void SetUp() override {
@@ -12,6 +18,76 @@ class atom : public testing::Test {
 
     void TearDown() override {
     }
+
+protected:
+#ifdef NDEBUG
+    static constexpr usize c_shared_count = 100'000;
+#else  // NDEBUG
+    static constexpr usize c_shared_count = 10'000;
+#endif // NDEBUG
+    static constexpr usize c_unique_count = c_shared_count / 4;
+
+    // Interns strings from several threads, both shared between them and unique to each.
+    // Callers pass a fresh prefix, so that the interning path is exercised and not just lookups.
+    static void internConcurrently(std::string const &prefix, usize thread_count, i64 *elapsed_ns) {
+        std::vector<std::string> shared_strs;
+        for (usize i = 0; i < c_shared_count; i++) {
+            shared_strs.emplace_back(prefix + "_shared_" + std::to_string(i));
+        }
+
+        std::vector<std::vector<std::string>> unique_strs(thread_count);
+        for (usize t = 0; t < thread_count; t++) {
+            for (usize i = 0; i < c_unique_count; i++) {
+                unique_strs[t].emplace_back(prefix + "_t" + std::to_string(t) + "_" + std::to_string(i));
+            }
+        }
+
+        std::vector<std::vector<NkAtom>> shared_atoms(thread_count, std::vector<NkAtom>(c_shared_count));
+        std::vector<std::vector<NkAtom>> unique_atoms(thread_count, std::vector<NkAtom>(c_unique_count));
+
+        auto const start_ns = nk_now_ns();
+
+        std::vector<std::thread> threads;
+        for (usize t = 0; t < thread_count; t++) {
+            threads.emplace_back([&, t]() {
+                // Threads walk the shared strings from different offsets to maximize contention on new entries
+                usize const offset = t * c_shared_count / thread_count;
+                for (usize i = 0; i < c_shared_count; i++) {
+                    usize const idx = (offset + i) % c_shared_count;
+                    auto const &str = shared_strs[idx];
+                    shared_atoms[t][idx] = nk_s2atom({str.data(), str.size()});
+
+                    if (i % 4 == 0) {
+                        auto const &ustr = unique_strs[t][i / 4];
+                        unique_atoms[t][i / 4] = nk_s2atom({ustr.data(), ustr.size()});
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        *elapsed_ns = nk_now_ns() - start_ns;
+
+        std::set<NkAtom> distinct;
+        for (usize i = 0; i < c_shared_count; i++) {
+            NkAtom const atom = shared_atoms[0][i];
+            for (usize t = 1; t < thread_count; t++) {
+                ASSERT_EQ(atom, shared_atoms[t][i]);
+            }
+            ASSERT_EQ(shared_strs[i], nk_s2stdView(nk_atom2s(atom)));
+            distinct.emplace(atom);
+        }
+        for (usize t = 0; t < thread_count; t++) {
+            for (usize i = 0; i < c_unique_count; i++) {
+                NkAtom const atom = unique_atoms[t][i];
+                ASSERT_EQ(unique_strs[t][i], nk_s2stdView(nk_atom2s(atom)));
+                distinct.emplace(atom);
+            }
+        }
+        EXPECT_EQ(distinct.size(), c_shared_count + thread_count * c_unique_count);
+    }
 };
 
 TEST_F(atom, forward) {
@@ -57,3 +133,42 @@ TEST_F(atom, unique) {
 
     EXPECT_EQ(c_str_hello, nk_s2stdView(nk_atom2s(hello_unique)));
 }
+
+TEST_F(atom, define) {
+    // Predefined atoms are below the ones handed out by nk_s2atom
+    static constexpr NkAtom c_atom = 900;
+    static constexpr NkAtom c_alias = 901;
+
+    for (int i = 0; i < 3; i++) {
+        nk_atom_define(c_atom, nk_cs2s("predefined"));
+        EXPECT_EQ(nk_cs2atom("predefined"), c_atom);
+        EXPECT_EQ(nk_s2stdView(nk_atom2s(c_atom)), "predefined");
+    }
+
+    // The string keeps resolving to the first atom it was defined with
+    nk_atom_define(c_alias, nk_cs2s("predefined"));
+    EXPECT_EQ(nk_cs2atom("predefined"), c_atom);
+    EXPECT_EQ(nk_s2stdView(nk_atom2s(c_alias)), "predefined");
+}
+
+TEST_F(atom, concurrent_stress) {
+    for (usize thread_count = 1; thread_count <= 8; thread_count *= 2) {
+        i64 elapsed_ns = 0;
+        ASSERT_NO_FATAL_FAILURE(internConcurrently("stress" + std::to_string(thread_count), thread_count, &elapsed_ns));
+    }
+}
+
+TEST_F(atom, DISABLED_concurrent_bench) {
+    for (usize thread_count = 1; thread_count <= 8; thread_count *= 2) {
+        i64 elapsed_ns = 0;
+        ASSERT_NO_FATAL_FAILURE(internConcurrently("bench" + std::to_string(thread_count), thread_count, &elapsed_ns));
+
+        auto const op_count = (f64)(thread_count * (c_shared_count + c_unique_count));
+
+        printf(
+            "atom bench: %zu threads: %6.1f ns/op, %6.2f Mop/s\n",
+            thread_count,
+            elapsed_ns / op_count,
+            op_count * 1e3 / elapsed_ns);
+    }
+}
@@ -0,0 +1,127 @@
+#include "ntk/file.h"
+
+#include <gtest/gtest.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+
+#include "ntk/arena.h"
+#include "ntk/log.h"
+#include "ntk/path.h"
+#include "ntk/string.h"
+#include "ntk/time.h"
+#include "ntk/utils.h"
+
+class File : public testing::Test {
+    void SetUp() override {
+        NK_LOG_INIT({});
+
+        char tmp_path[NK_MAX_PATH];
+        ASSERT_GE(nk_getTempPath(tmp_path, sizeof(tmp_path)), 0);
+        // Stamped, since ctest runs the tests of this fixture concurrently
+        char stamp[32];
+        std::snprintf(stamp, sizeof(stamp), "%" PRIx64, (u64)nk_now_ns());
+        m_dir = std::string{tmp_path} + "ntk_file_test." + stamp;
+        ASSERT_EQ(nk_mkdir(m_dir.c_str()), 0);
+    }
+
+    void TearDown() override {
+        for (auto const &name : {"a", "b", "c"}) {
+            nk_remove(path(name).c_str());
+        }
+        nk_remove(m_dir.c_str());
+        nk_arena_free(&m_arena);
+    }
+
+protected:
+    std::string path(char const *name) const {
+        return m_dir + "/" + name;
+    }
+
+    NkFileInfo const *findFile(NkFileInfoArray files, char const *name) const {
+        NK_ITERATE(NkFileInfo const *, file, files) {
+            if (nks_equal(file->name, nk_cs2s(name))) {
+                return file;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string m_dir;
+    NkArena m_arena{};
+};
+
+TEST_F(File, write_read) {
+    auto const a = path("a");
+    ASSERT_TRUE(nk_file_write(nk_cs2s(a.c_str()), nk_cs2s("hello")));
+
+    NkString str{};
+    ASSERT_TRUE(nk_file_read(nk_arena_getAllocator(&m_arena), nk_cs2s(a.c_str()), &str));
+    EXPECT_EQ(std::string(str.data, str.size), "hello");
+
+    // Existing file is truncated
+    ASSERT_TRUE(nk_file_write(nk_cs2s(a.c_str()), nk_cs2s("bye")));
+    ASSERT_TRUE(nk_file_read(nk_arena_getAllocator(&m_arena), nk_cs2s(a.c_str()), &str));
+    EXPECT_EQ(std::string(str.data, str.size), "bye");
+}
+
+TEST_F(File, map) {
+    auto const a = path("a");
+
+    std::string data;
+    while (data.size() < 3 * 4096 + 123) {
+        data += "line " + std::to_string(data.size()) + "\n";
+    }
+    ASSERT_TRUE(nk_file_write(nk_cs2s(a.c_str()), {data.data(), data.size()}));
+
+    NkFileMapping mapping{};
+    ASSERT_TRUE(nk_file_map(nk_cs2s(a.c_str()), &mapping));
+    EXPECT_EQ(std::string(mapping.text.data, mapping.text.size), data);
+    nk_file_unmap(&mapping);
+    EXPECT_EQ(mapping.text.size, 0u);
+
+    // Empty files cannot be mapped, so they are read
+    ASSERT_TRUE(nk_file_write(nk_cs2s(a.c_str()), {}));
+    ASSERT_TRUE(nk_file_map(nk_cs2s(a.c_str()), &mapping));
+    EXPECT_EQ(mapping.text.size, 0u);
+    nk_file_unmap(&mapping);
+
+    EXPECT_FALSE(nk_file_map(nk_cs2s(path("b").c_str()), &mapping));
+}
+
+TEST_F(File, mkdir) {
+    EXPECT_EQ(nk_mkdir(m_dir.c_str()), 0);
+}
+
+TEST_F(File, list_rename_remove) {
+    ASSERT_TRUE(nk_file_write(nk_cs2s(path("a").c_str()), nk_cs2s("a")));
+    ASSERT_TRUE(nk_file_write(nk_cs2s(path("b").c_str()), nk_cs2s("bb")));
+
+    NkFileInfoArray files{};
+    ASSERT_EQ(nk_listDir(&m_arena, m_dir.c_str(), &files), 0);
+
+    NkFileInfo const *a = findFile(files, "a");
+    ASSERT_TRUE(a);
+    EXPECT_EQ(a->size, 1u);
+
+    NkFileInfo const *b = findFile(files, "b");
+    ASSERT_TRUE(b);
+    EXPECT_EQ(b->size, 2u);
+
+    ASSERT_EQ(nk_rename(path("b").c_str(), path("a").c_str()), 0);
+    ASSERT_EQ(nk_rename(path("a").c_str(), path("c").c_str()), 0);
+    ASSERT_EQ(nk_touch(path("c").c_str()), 0);
+
+    ASSERT_EQ(nk_listDir(&m_arena, m_dir.c_str(), &files), 0);
+    EXPECT_FALSE(findFile(files, "a"));
+    EXPECT_FALSE(findFile(files, "b"));
+    ASSERT_TRUE(findFile(files, "c"));
+    EXPECT_EQ(findFile(files, "c")->size, 2u);
+
+    ASSERT_EQ(nk_remove(path("c").c_str()), 0);
+    EXPECT_NE(nk_remove(path("c").c_str()), 0);
+
+    ASSERT_EQ(nk_listDir(&m_arena, m_dir.c_str(), &files), 0);
+    EXPECT_FALSE(findFile(files, "c"));
+}
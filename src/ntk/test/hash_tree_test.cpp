@@ -5,6 +5,7 @@
 #include "ntk/arena.h"
 #include "ntk/log.h"
 #include "ntk/string.h"
+#include "ntk/time.h"
 #include "ntk/utils.h"
 
 class HashTree : public testing::Test {
@@ -226,3 +227,110 @@ TEST_F(HashTree, hash_map) {
     EXPECT_FALSE(IntStringMap_find(&map, 4));
     EXPECT_FALSE(IntStringMap_find(&map, 5));
 }
+
+static u64 u64_hash(u64 key) {
+    return nk_hashVal(key);
+}
+
+static bool u64_equal(u64 lhs, u64 rhs) {
+    return lhs == rhs;
+}
+
+NK_HASH_TREE_DEFINE_KV(U64Map, u64, u64, u64_hash, u64_equal);
+
+static u64 splitmix64(u64 *state) {
+    u64 z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+TEST_F(HashTree, many_keys) {
+    static constexpr usize c_key_count = 100'000;
+
+    U64Map map{};
+    defer {
+        U64Map_free(&map);
+    };
+
+    u64 state = 42;
+    for (usize i = 0; i < c_key_count; i++) {
+        U64Map_insert(&map, splitmix64(&state), i);
+    }
+
+    state = 42;
+    for (usize i = 0; i < c_key_count; i++) {
+        auto const key = splitmix64(&state);
+        auto const found = U64Map_find(&map, key);
+        ASSERT_TRUE(found);
+        EXPECT_EQ(*found, i);
+        EXPECT_FALSE(U64Map_find(&map, ~key));
+    }
+}
+
+TEST_F(HashTree, DISABLED_bench) {
+#ifdef NDEBUG
+    static constexpr usize c_max_key_count = 10'000'000;
+#else  // NDEBUG
+    static constexpr usize c_max_key_count = 1'000'000;
+#endif // NDEBUG
+
+    auto const keys = nk_allocT<u64>(nk_default_allocator, c_max_key_count);
+    defer {
+        nk_freeT(nk_default_allocator, keys, c_max_key_count);
+    };
+
+    u64 state = 42;
+    for (usize i = 0; i < c_max_key_count; i++) {
+        keys[i] = splitmix64(&state);
+    }
+
+    for (usize key_count = 1000; key_count <= c_max_key_count; key_count *= 10) {
+        // Small tables are rebuilt several times to get stable timings
+        usize const rounds = nk_maxu(100'000 / key_count, 1);
+
+        i64 insert_ns = 0;
+        i64 find_ns = 0;
+        i64 miss_ns = 0;
+
+        for (usize round = 0; round < rounds; round++) {
+            U64Map map{};
+            defer {
+                U64Map_free(&map);
+            };
+
+            auto const insert_start_ns = nk_now_ns();
+            for (usize i = 0; i < key_count; i++) {
+                U64Map_insert(&map, keys[i], i);
+            }
+            insert_ns += nk_now_ns() - insert_start_ns;
+
+            usize found_count = 0;
+            auto const find_start_ns = nk_now_ns();
+            for (usize i = 0; i < key_count; i++) {
+                auto const found = U64Map_find(&map, keys[i]);
+                found_count += found && *found == i;
+            }
+            find_ns += nk_now_ns() - find_start_ns;
+
+            usize missed_count = 0;
+            auto const miss_start_ns = nk_now_ns();
+            for (usize i = 0; i < key_count; i++) {
+                missed_count += !U64Map_find(&map, ~keys[i]);
+            }
+            miss_ns += nk_now_ns() - miss_start_ns;
+
+            EXPECT_EQ(found_count, key_count);
+            EXPECT_EQ(missed_count, key_count);
+        }
+
+        auto const op_count = (f64)(key_count * rounds);
+
+        printf(
+            "hash tree bench: %9zu keys: insert %6.1f ns/op, find %6.1f ns/op, miss %6.1f ns/op\n",
+            key_count,
+            insert_ns / op_count,
+            find_ns / op_count,
+            miss_ns / op_count);
+    }
+}
@@ -0,0 +1,92 @@
+#include "ntk/thread.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "ntk/log.h"
+
+class Thread : public testing::Test {
+    void SetUp() override {
+        NK_LOG_INIT({});
+    }
+
+    void TearDown() override {
+    }
+};
+
+TEST_F(Thread, start_join) {
+    static constexpr usize c_thread_count = 8;
+
+    std::atomic<usize> counter{};
+
+    NkHandle threads[c_thread_count];
+    for (auto &thread : threads) {
+        thread = nk_thread_start(
+            [](void *arg) {
+                (*(std::atomic<usize> *)arg)++;
+            },
+            &counter);
+        ASSERT_FALSE(nk_handleIsNull(thread));
+    }
+
+    for (auto thread : threads) {
+        EXPECT_EQ(nk_thread_join(thread), 0);
+    }
+
+    EXPECT_EQ(counter, c_thread_count);
+}
+
+TEST_F(Thread, mutex) {
+    static constexpr usize c_thread_count = 4;
+    static constexpr usize c_iter_count = 10000;
+
+    struct Ctx {
+        NkHandle mtx;
+        usize value;
+    } ctx{nk_mutex_alloc(0), 0};
+
+    NkHandle threads[c_thread_count];
+    for (auto &thread : threads) {
+        thread = nk_thread_start(
+            [](void *arg) {
+                auto ctx = (Ctx *)arg;
+                for (usize i = 0; i < c_iter_count; i++) {
+                    NK_MUTEX_GUARD_SCOPE(ctx->mtx) {
+                        ctx->value++;
+                    }
+                }
+            },
+            &ctx);
+        ASSERT_FALSE(nk_handleIsNull(thread));
+    }
+
+    for (auto thread : threads) {
+        nk_thread_join(thread);
+    }
+
+    EXPECT_EQ(ctx.value, c_thread_count * c_iter_count);
+
+    nk_mutex_free(ctx.mtx);
+}
+
+TEST_F(Thread, hardware_concurrency) {
+    EXPECT_GE(nk_thread_hardwareConcurrency(), 1u);
+}
+
+TEST_F(Thread, at_exit) {
+    static std::atomic<usize> s_order{};
+
+    NkHandle thread = nk_thread_start(
+        [](void *) {
+            // Registered first, called last
+            EXPECT_EQ(nk_thread_atExit([]() { EXPECT_EQ(s_order++, 1u); }), 0);
+            EXPECT_EQ(nk_thread_atExit([]() { EXPECT_EQ(s_order++, 0u); }), 0);
+            EXPECT_EQ(s_order, 0u);
+        },
+        nullptr);
+    ASSERT_FALSE(nk_handleIsNull(thread));
+    EXPECT_EQ(nk_thread_join(thread), 0);
+
+    EXPECT_EQ(s_order, 2u);
+}
@@ -1,7 +1,69 @@
 #include "ntk/utils.h"
 
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include "ntk/time.h"
+
+namespace {
+
+u64 splitmix64(u64 *state) {
+    u64 z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+u64 hashBytes(std::vector<u8> const &bytes) {
+    return nk_hashArray(bytes.data(), bytes.data() + bytes.size());
+}
+
+void hashBenchKeys(char const *name, std::vector<std::vector<u8>> const &keys) {
+    static constexpr usize c_rounds = 10;
+
+    usize total_size = 0;
+    for (auto const &key : keys) {
+        total_size += key.size();
+    }
+
+    u64 sink = 0;
+    auto const start_ns = nk_now_ns();
+    for (usize round = 0; round < c_rounds; round++) {
+        for (auto const &key : keys) {
+            sink ^= hashBytes(key);
+        }
+    }
+    auto const elapsed_ns = nk_now_ns() - start_ns;
+
+    std::unordered_set<u64> hashes;
+    std::unordered_set<u32> hashes32;
+    for (auto const &key : keys) {
+        u64 const hash = hashBytes(key);
+        hashes.emplace(hash);
+        hashes32.emplace((u32)hash);
+    }
+
+    auto const key_count = (f64)keys.size();
+
+    printf(
+        "hash bench: %-12s %7zu keys, avg %5.1f bytes: %5.2f ns/key, "
+        "64-bit collisions %zu, 32-bit collisions %zu (ideal ~%.0f) [%llx]\n",
+        name,
+        keys.size(),
+        total_size / key_count,
+        elapsed_ns / (key_count * c_rounds),
+        keys.size() - hashes.size(),
+        keys.size() - hashes32.size(),
+        key_count * key_count / (2.0 * 4294967296.0),
+        (unsigned long long)(sink & 0xf));
+}
+
+} // namespace
+
 TEST(utils, log2_u32) {
     EXPECT_EQ(nk_log2u32(1), 0u);
     for (usize i = 1; i < 32; i++) {
@@ -21,3 +83,145 @@ TEST(utils, log2_u64) {
     }
     EXPECT_EQ(nk_log2u64(-1), 63u);
 }
+
+TEST(utils, hash_array) {
+    std::vector<u8> buf(256);
+    u64 state = 42;
+    for (auto &b : buf) {
+        b = (u8)splitmix64(&state);
+    }
+
+    std::unordered_set<u64> hashes;
+    for (usize len = 0; len <= buf.size(); len++) {
+        u64 const hash = nk_hashArray(buf.data(), buf.data() + len);
+        EXPECT_EQ(hash, nk_hashArray(buf.data(), buf.data() + len));
+        hashes.emplace(hash);
+
+        // Flipping any single bit must change the hash
+        for (usize i = 0; i < len; i += 7) {
+            buf[i] ^= 1 << (i % 8);
+            EXPECT_NE(hash, nk_hashArray(buf.data(), buf.data() + len)) << "len=" << len << " i=" << i;
+            buf[i] ^= 1 << (i % 8);
+        }
+    }
+    EXPECT_EQ(hashes.size(), buf.size() + 1);
+
+    // Unaligned input hashes the same as aligned
+    std::vector<u8> shifted(buf.size() + 1);
+    std::copy(buf.begin(), buf.end(), shifted.begin() + 1);
+    for (usize len = 0; len <= buf.size(); len++) {
+        EXPECT_EQ(nk_hashArray(buf.data(), buf.data() + len), nk_hashArray(&shifted[1], &shifted[1] + len));
+    }
+}
+
+TEST(utils, hash_collisions) {
+    static constexpr usize c_key_count = 100'000;
+
+    // Sequentially numbered names, the worst case for weak word-combining hashes
+    std::unordered_set<u64> hashes;
+    for (usize i = 0; i < c_key_count; i++) {
+        auto const key = "tmp" + std::to_string(i);
+        hashes.emplace(nk_hashArray((u8 const *)key.data(), (u8 const *)key.data() + key.size()));
+    }
+    EXPECT_EQ(hashes.size(), c_key_count);
+}
+
+TEST(utils, hash_seeded) {
+    for (auto const &key : {std::string{}, std::string{"abc"}, std::string(16, 'x'), std::string(100, 'y')}) {
+        auto const begin = (u8 const *)key.data();
+        auto const end = begin + key.size();
+
+        EXPECT_EQ(nk_hashArraySeeded(begin, end, 0), nk_hashArray(begin, end));
+        EXPECT_NE(nk_hashArraySeeded(begin, end, 1), nk_hashArray(begin, end)) << key;
+        EXPECT_NE(nk_hashArraySeeded(begin, end, 1), nk_hashArraySeeded(begin, end, 2)) << key;
+    }
+}
+
+TEST(utils, DISABLED_hash_bench) {
+#ifdef NDEBUG
+    static constexpr usize c_key_count = 1'000'000;
+#else  // NDEBUG
+    static constexpr usize c_key_count = 100'000;
+#endif // NDEBUG
+
+    u64 state = 42;
+
+    {
+        static constexpr char c_head_chars[] = "abcdefghijklmnopqrstuvwxyz_";
+        static constexpr char c_tail_chars[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+
+        std::vector<std::vector<u8>> keys;
+        std::unordered_set<std::string> seen;
+        while (keys.size() < c_key_count) {
+            usize const len = 1 + splitmix64(&state) % 24;
+            std::string key;
+            key += c_head_chars[splitmix64(&state) % (sizeof(c_head_chars) - 1)];
+            while (key.size() < len) {
+                key += c_tail_chars[splitmix64(&state) % (sizeof(c_tail_chars) - 1)];
+            }
+            if (seen.emplace(key).second) {
+                keys.emplace_back(key.begin(), key.end());
+            }
+        }
+        hashBenchKeys("identifiers", keys);
+    }
+
+    {
+        // Sequentially numbered names, the worst case for weak word-combining hashes
+        std::vector<std::vector<u8>> keys;
+        for (usize i = 0; i < c_key_count; i++) {
+            auto const key = "tmp" + std::to_string(i);
+            keys.emplace_back(key.begin(), key.end());
+        }
+        hashBenchKeys("numbered", keys);
+    }
+
+    {
+        // Shaped like the type fingerprints in nkl_core: subset, kind, element count, (type id, count) pairs
+        std::vector<std::vector<u8>> keys;
+        std::unordered_set<std::string> seen;
+        auto const push = [](std::vector<u8> &fp, auto val) {
+            fp.insert(fp.end(), (u8 const *)&val, (u8 const *)&val + sizeof(val));
+        };
+        for (usize i = 0; i < c_key_count; i++) {
+            std::vector<u8> fp;
+            usize const elem_count = i % 5;
+            push(fp, (u8)0);
+            push(fp, (u8)(i % 3));
+            push(fp, (usize)elem_count);
+            for (usize j = 0; j < elem_count; j++) {
+                push(fp, (u32)((i / 5 + j) % 100'000));
+                push(fp, (u32)(1 + (i >> (j + 4)) % 16));
+            }
+            if (seen.emplace(fp.begin(), fp.end()).second) {
+                keys.emplace_back(std::move(fp));
+            }
+        }
+        hashBenchKeys("fingerprints", keys);
+    }
+
+    {
+        static constexpr usize c_buf_size = 1 << 16;
+        static constexpr usize c_rounds = 2'000;
+
+        std::vector<u8> buf(c_buf_size);
+        for (auto &b : buf) {
+            b = (u8)splitmix64(&state);
+        }
+
+        u64 sink = 0;
+        auto const start_ns = nk_now_ns();
+        for (usize round = 0; round < c_rounds; round++) {
+            buf[0] = (u8)round;
+            sink ^= nk_hashArray(buf.data(), buf.data() + buf.size());
+        }
+        auto const elapsed_ns = nk_now_ns() - start_ns;
+
+        printf(
+            "hash bench: %-12s %7zu bytes: %5.2f GB/s [%llx]\n",
+            "bulk",
+            c_buf_size,
+            (f64)(c_buf_size * c_rounds) / elapsed_ns,
+            (unsigned long long)(sink & 0xf));
+    }
+}